@@ -0,0 +1,566 @@
+/**********************************************************************************************************************
+    file:           agent.c
+    description:    Session keeping agent of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifdef LINUX
+#define _GNU_SOURCE                     // struct ucred
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "gekko.h"
+#include "pool.h"
+#include "agent.h"
+/**********************************************************************************************************************
+    wire header of requests and replies, a request carries the caller's stdout and stderr along
+**********************************************************************************************************************/
+typedef struct {
+    char            magic[4];
+    uint32_t        length;             // request: payload bytes, reply: exit status
+} GKO_AGENT_HEADER;
+
+static volatile sig_atomic_t gko_agent_stop = 0;
+/**********************************************************************************************************************
+    description:    Stop serving on SIGINT and SIGTERM, requests in progress finish first
+    arguments:      sig:    signal number
+    return:         -
+**********************************************************************************************************************/
+static void gko_agent_signal(int sig)
+{
+    (void)sig;
+    gko_agent_stop = 1;
+}
+/**********************************************************************************************************************
+    description:    Path of the agent socket
+    arguments:      path:   buffer to store
+                    size:   buffer size
+    return:         error code
+**********************************************************************************************************************/
+int gko_agent_path(char *path, size_t size)
+{
+    struct sockaddr_un  addr;
+    const char         *home    = getenv("HOME");
+
+    if (!path || !home) return GEKKO_ERROR;
+
+    snprintf(path, size, "%s%s", home, GEKKO_AGENT_SOCKET);
+
+    return (strlen(path) < sizeof(addr.sun_path)) ? GEKKO_OK : GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Connect to the agent socket
+    arguments:      path:   socket path
+    return:         connected socket, negative if no agent listens
+**********************************************************************************************************************/
+static int gko_agent_connect(const char *path)
+{
+    struct sockaddr_un  addr;
+    int                 fd      = -1;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != GEKKO_OK) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+/**********************************************************************************************************************
+    description:    Send or receive exactly len bytes
+    arguments:      fd:     socket
+                    data:   buffer
+                    len:    length
+    return:         error code
+**********************************************************************************************************************/
+static int gko_agent_send(int fd, const void *data, size_t len)
+{
+    const char *p   = (const char *)data;
+    ssize_t     n   = 0;
+
+    while (len) {
+        n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return GEKKO_ERROR;
+        p += n;
+        len -= (size_t)n;
+    }
+
+    return GEKKO_OK;
+}
+
+static int gko_agent_recv(int fd, void *data, size_t len)
+{
+    char       *p   = (char *)data;
+    ssize_t     n   = 0;
+
+    while (len) {
+        n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return GEKKO_ERROR;
+        p += n;
+        len -= (size_t)n;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Check that the peer runs as the same user, the agent holds authenticated sessions
+    arguments:      fd:     accepted socket
+    return:         true or false
+**********************************************************************************************************************/
+static bool gko_agent_trusted(int fd)
+{
+#ifdef LINUX
+    struct ucred    cred;
+    socklen_t       len     = sizeof(cred);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != GEKKO_OK) return false;
+
+    return cred.uid == getuid();
+#elif defined(DARWIN)
+    uid_t           uid;
+    gid_t           gid;
+
+    if (getpeereid(fd, &uid, &gid) != GEKKO_OK) return false;
+
+    return uid == getuid();
+#else
+    (void)fd;
+
+    return false;
+#endif
+}
+/**********************************************************************************************************************
+    description:    Close the pool in a slot and drop the slot
+    arguments:      agent:  agent
+                    i:      slot
+    return:         -
+**********************************************************************************************************************/
+static void gko_agent_drop(GKO_AGENT *agent, int i)
+{
+    gko_pool_destroy(&agent->pools[i].pool);
+    agent->pools[i] = agent->pools[--agent->count];
+}
+/**********************************************************************************************************************
+    description:    Check that every session of a pool can still send a keepalive
+    arguments:      pool:   pool
+    return:         true or false
+**********************************************************************************************************************/
+static bool gko_agent_alive(GKO_POOL *pool)
+{
+    int     next    = 0;
+    int     i       = 0;
+
+    for (i = 0; i < pool->count; i++) {
+        if (libssh2_keepalive_send(pool->sessions[i].session, &next) != GEKKO_OK) return false;
+    }
+
+    return true;
+}
+/**********************************************************************************************************************
+    description:    Keep pools warm and close the ones left idle for too long
+    arguments:      agent:  agent
+    return:         -
+**********************************************************************************************************************/
+static void gko_agent_tick(GKO_AGENT *agent)
+{
+    time_t  now     = time(NULL);
+    int     i       = 0;
+
+    for (i = agent->count; i-- > 0; ) {
+        if (now - agent->pools[i].used >= agent->idle) {
+            printf("agent: %s idle for %d s, closing its sessions.\n", agent->pools[i].remark, agent->idle);
+            gko_agent_drop(agent, i);
+        } else if (!gko_agent_alive(&agent->pools[i].pool)) {
+            printf("agent: %s lost its connection, closing its sessions.\n", agent->pools[i].remark);
+            gko_agent_drop(agent, i);
+        }
+    }
+
+    fflush(stdout);
+}
+/**********************************************************************************************************************
+    description:    Warm pool of a grip, opened on first use and reopened when the grip changed or went away
+    arguments:      agent:  agent
+                    remark: grip name
+                    grip:   grip as loaded for this request
+    return:         pool, NULL if no session could be opened
+**********************************************************************************************************************/
+GKO_POOL *gko_agent_pool(GKO_AGENT *agent, const char *remark, const GRIP *grip)
+{
+    GKO_AGENT_POOL *slot    = NULL;
+    int             oldest  = 0;
+    int             i       = 0;
+
+    if (!agent) return NULL;
+    if (!remark) return NULL;
+    if (!grip) return NULL;
+
+    for (i = 0; i < agent->count; i++) {
+        if (strcmp(agent->pools[i].remark, remark) != GEKKO_OK) continue;
+
+        if (memcmp(&agent->pools[i].grip, grip, sizeof(GRIP)) == GEKKO_OK && gko_agent_alive(&agent->pools[i].pool)) {
+            agent->pools[i].used = time(NULL);
+            printf("agent: reusing %d warm sessions of %s.\n", agent->pools[i].pool.count, remark);
+            return &agent->pools[i].pool;
+        }
+
+        gko_agent_drop(agent, i);
+        break;
+    }
+
+    // the least recently used grip makes room
+    if (agent->count == GEKKO_AGENT_POOLS_MAX) {
+        for (i = 1; i < agent->count; i++) {
+            if (agent->pools[i].used < agent->pools[oldest].used) oldest = i;
+        }
+        gko_agent_drop(agent, oldest);
+    }
+
+    slot = &agent->pools[agent->count];
+    memset(slot, 0, sizeof(GKO_AGENT_POOL));
+    snprintf(slot->remark, NAME_MAX, "%s", remark);
+    memcpy(&slot->grip, grip, sizeof(GRIP));
+
+    if (gko_pool_create(&slot->pool, grip, grip->sessions) != GEKKO_OK) return NULL;
+
+    for (i = 0; i < slot->pool.count; i++) {
+        libssh2_keepalive_config(slot->pool.sessions[i].session, 0, GEKKO_AGENT_KEEPALIVE_S);
+    }
+
+    slot->used = time(NULL);
+    agent->count++;
+
+    return &slot->pool;
+}
+/**********************************************************************************************************************
+    description:    Hand a pool back after a request, a failed request may have left a session mid-protocol
+    arguments:      agent:  agent
+                    pool:   pool from gko_agent_pool()
+                    status: request result
+    return:         -
+**********************************************************************************************************************/
+void gko_agent_release(GKO_AGENT *agent, GKO_POOL *pool, int status)
+{
+    int i = 0;
+
+    if (!agent || !pool) return;
+
+    for (i = 0; i < agent->count; i++) {
+        if (&agent->pools[i].pool != pool) continue;
+
+        agent->pools[i].used = time(NULL);
+        if (status != GEKKO_OK) gko_agent_drop(agent, i);
+        return;
+    }
+}
+/**********************************************************************************************************************
+    description:    Serve one request: run it in the caller's directory with the caller's stdout and stderr
+    arguments:      agent:  agent
+                    fd:     accepted socket
+    return:         -
+**********************************************************************************************************************/
+static void gko_agent_request(GKO_AGENT *agent, int fd)
+{
+    GKO_AGENT_HEADER    header;
+    struct msghdr       msg;
+    struct iovec        iov;
+    struct cmsghdr     *cmsg                            = NULL;
+    char                control[CMSG_SPACE(2 * sizeof(int))];
+    char               *payload                         = NULL;
+    char               *argv[GEKKO_AGENT_ARGS_MAX + 1]  = {0};
+    int                 fds[2]                          = {-1, -1};
+    int                 saved[3]                        = {-1, -1, -1};
+    int                 argc                            = 0;
+    int                 status                          = GEKKO_ERROR;
+    size_t              i                               = 0;
+
+    if (!gko_agent_trusted(fd)) {
+        printf("agent: refused a connection from another user.\n");
+        return;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &header;
+    iov.iov_len = sizeof(header);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (recvmsg(fd, &msg, 0) != (ssize_t)sizeof(header)) return;
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+            cmsg->cmsg_len == CMSG_LEN(2 * sizeof(int))) {
+            memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+        }
+    }
+
+    if (memcmp(header.magic, GEKKO_AGENT_MAGIC, sizeof(header.magic)) != GEKKO_OK ||
+        header.length == 0 || header.length > GEKKO_AGENT_REQUEST_MAX || fds[0] < 0 || fds[1] < 0) {
+        goto __error_request;
+    }
+
+    payload = (char *)malloc(header.length);
+    if (!payload || gko_agent_recv(fd, payload, header.length) != GEKKO_OK) goto __error_request;
+    if (payload[header.length - 1] != '\0') goto __error_request;
+
+    // working directory first, then the arguments, each NUL terminated
+    for (i = strlen(payload) + 1; i < header.length && argc < GEKKO_AGENT_ARGS_MAX; i += strlen(payload + i) + 1) {
+        argv[argc++] = payload + i;
+    }
+    if (!argc) goto __error_request;
+
+    if (strcmp(argv[0], "stop") == GEKKO_OK) {
+        gko_agent_stop = 1;
+        status = GEKKO_OK;
+        goto __error_request;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    saved[0] = dup(STDOUT_FILENO);
+    saved[1] = dup(STDERR_FILENO);
+    saved[2] = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (saved[0] < 0 || saved[1] < 0 || saved[2] < 0) goto __error_request;
+
+    dup2(fds[0], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+
+    if (chdir(payload) != GEKKO_OK) {
+        fprintf(stderr, "Cannot enter %s.\n", payload);
+    } else {
+        // getopt keeps state between calls, start over for every request
+#ifdef LINUX
+        optind = 0;
+#else
+        optreset = 1;
+        optind = 1;
+#endif
+        status = agent->handler(argc, argv, agent);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    dup2(saved[0], STDOUT_FILENO);
+    dup2(saved[1], STDERR_FILENO);
+    if (fchdir(saved[2]) != GEKKO_OK) fprintf(stderr, "agent: cannot return to its directory.\n");
+
+    agent->served++;
+    printf("agent: served %s in %s (%d).\n", argv[0], payload, status);
+    fflush(stdout);
+
+__error_request:
+    for (i = 0; i < 3; i++) {
+        if (saved[i] >= 0) close(saved[i]);
+    }
+    if (fds[0] >= 0) close(fds[0]);
+    if (fds[1] >= 0) close(fds[1]);
+    free(payload);
+
+    memcpy(header.magic, GEKKO_AGENT_MAGIC, sizeof(header.magic));
+    header.length = (uint32_t)status;
+    gko_agent_send(fd, &header, sizeof(header));
+}
+/**********************************************************************************************************************
+    description:    Run the agent until stopped, one request at a time
+    arguments:      idle:       seconds an unused pool stays open, 0 for default
+                    handler:    runs a forwarded command line
+    return:         error code
+**********************************************************************************************************************/
+int gko_agent_serve(int idle, GKO_AGENT_HANDLER handler)
+{
+    GKO_AGENT           agent;
+    struct sockaddr_un  addr;
+    struct sigaction    sa;
+    struct pollfd       pfd;
+    char                path[PATH_MAX]  = {0};
+    int                 fd              = -1;
+    int                 n               = 0;
+
+    if (!handler) return GEKKO_ERROR;
+
+    if (gko_agent_path(path, sizeof(path)) != GEKKO_OK) {
+        fprintf(stderr, "Cannot place the agent socket under $HOME.\n");
+        return GEKKO_ERROR;
+    }
+
+    fd = gko_agent_connect(path);
+    if (fd >= 0) {
+        close(fd);
+        fprintf(stderr, "An agent already listens on %s.\n", path);
+        return GEKKO_ERROR;
+    }
+
+    memset(&agent, 0, sizeof(agent));
+    agent.idle = (idle > 0) ? idle : GEKKO_AGENT_IDLE_S;
+    agent.handler = handler;
+
+    agent.listen = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (agent.listen < 0) {
+        fprintf(stderr, "Socket creation failed.\n");
+        return GEKKO_ERROR;
+    }
+    fcntl(agent.listen, F_SETFD, FD_CLOEXEC);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    // a socket left behind by an agent that died is replaced
+    unlink(path);
+    if (bind(agent.listen, (struct sockaddr *)&addr, sizeof(addr)) != GEKKO_OK ||
+        chmod(path, 0600) != GEKKO_OK || listen(agent.listen, 16) != GEKKO_OK) {
+        fprintf(stderr, "Cannot listen on %s.\n", path);
+        close(agent.listen);
+        return GEKKO_ERROR;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = gko_agent_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+
+    printf("agent: listening on %s, sessions close after %d s unused.\n", path, agent.idle);
+    fflush(stdout);
+
+    while (!gko_agent_stop) {
+        pfd.fd = agent.listen;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        n = poll(&pfd, 1, GEKKO_AGENT_KEEPALIVE_S * 1000);
+        if (n < 0 && errno != EINTR) break;
+
+        gko_agent_tick(&agent);
+        if (n <= 0) continue;
+
+        fd = accept(agent.listen, NULL, NULL);
+        if (fd < 0) continue;
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        gko_agent_request(&agent, fd);
+        close(fd);
+    }
+
+    while (agent.count) gko_agent_drop(&agent, agent.count - 1);
+
+    close(agent.listen);
+    unlink(path);
+
+    printf("agent: stopped after %llu requests.\n", (unsigned long long)agent.served);
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Hand a command line to a running agent, which runs it with our stdout and stderr
+    arguments:      argc:   Count of command line arguments
+                    argv:   Values of command line arguments
+                    status: exit status of the command as run by the agent
+    return:         GEKKO_OK if an agent took the command, GEKKO_ERROR to run it here
+**********************************************************************************************************************/
+int gko_agent_forward(int argc, char *argv[], int *status)
+{
+    GKO_AGENT_HEADER    header;
+    struct msghdr       msg;
+    struct iovec        iov;
+    struct cmsghdr     *cmsg                = NULL;
+    char                control[CMSG_SPACE(2 * sizeof(int))];
+    char                path[PATH_MAX]      = {0};
+    char               *payload             = NULL;
+    size_t              length              = 0;
+    size_t              len                 = 0;
+    int                 fds[2]              = {STDOUT_FILENO, STDERR_FILENO};
+    int                 fd                  = -1;
+    int                 i                   = 0;
+    int                 ret                 = GEKKO_ERROR;
+
+    if (!status) return GEKKO_ERROR;
+    if (argc < 1 || argc > GEKKO_AGENT_ARGS_MAX) return GEKKO_ERROR;
+    if (gko_agent_path(path, sizeof(path)) != GEKKO_OK) return GEKKO_ERROR;
+
+    fd = gko_agent_connect(path);
+    if (fd < 0) return GEKKO_ERROR;
+
+    payload = (char *)malloc(GEKKO_AGENT_REQUEST_MAX);
+    if (!payload || !getcwd(payload, PATH_MAX)) goto __error_payload;
+
+    length = strlen(payload) + 1;
+    for (i = 0; i < argc; i++) {
+        len = strlen(argv[i]) + 1;
+        if (length + len > GEKKO_AGENT_REQUEST_MAX) goto __error_payload;
+        memcpy(payload + length, argv[i], len);
+        length += len;
+    }
+
+    memcpy(header.magic, GEKKO_AGENT_MAGIC, sizeof(header.magic));
+    header.length = (uint32_t)length;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    iov.iov_base = &header;
+    iov.iov_len = sizeof(header);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    // whatever we printed must come out before the agent starts writing to the same descriptors
+    fflush(stdout);
+    fflush(stderr);
+
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(header)) goto __error_payload;
+
+    // from here on the agent owns the command, running it again locally could do the work twice
+    ret = GEKKO_OK;
+    *status = GEKKO_ERROR;
+
+    if (gko_agent_send(fd, payload, length) != GEKKO_OK ||
+        gko_agent_recv(fd, &header, sizeof(header)) != GEKKO_OK ||
+        memcmp(header.magic, GEKKO_AGENT_MAGIC, sizeof(header.magic)) != GEKKO_OK) {
+        fprintf(stderr, "The agent went away before finishing.\n");
+    } else {
+        *status = (int)header.length;
+    }
+
+__error_payload:
+    free(payload);
+    close(fd);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,61 @@
+/**********************************************************************************************************************
+    file:           agent.h
+    description:    Session keeping agent of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_AGENT_H
+#define __GEKKO_AGENT_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "gekko.h"
+#include "pool.h"
+/**********************************************************************************************************************
+    agent defaults
+**********************************************************************************************************************/
+#define GEKKO_AGENT_SOCKET              SEP ".gekko" SEP "agent.sock"
+#define GEKKO_AGENT_MAGIC               "GKA1"
+#define GEKKO_AGENT_IDLE_S              (600)       // a pool nobody used for this long is closed
+#define GEKKO_AGENT_KEEPALIVE_S         (30)
+#define GEKKO_AGENT_POOLS_MAX           (16)
+#define GEKKO_AGENT_REQUEST_MAX         (64 * 1024)
+#define GEKKO_AGENT_ARGS_MAX            (64)
+/**********************************************************************************************************************
+    warm sessions of one grip
+**********************************************************************************************************************/
+typedef struct {
+    char                remark[NAME_MAX];
+    GRIP                grip;               // configuration the pool was opened with
+    GKO_POOL            pool;
+    time_t              used;
+} GKO_AGENT_POOL;
+/**********************************************************************************************************************
+    agent
+**********************************************************************************************************************/
+typedef struct GKO_AGENT GKO_AGENT;
+
+typedef int (*GKO_AGENT_HANDLER)(int argc, char *argv[], GKO_AGENT *agent);
+
+struct GKO_AGENT {
+    int                 listen;
+    int                 idle;
+    GKO_AGENT_HANDLER   handler;
+    GKO_AGENT_POOL      pools[GEKKO_AGENT_POOLS_MAX];
+    int                 count;
+    uint64_t            served;
+};
+/**********************************************************************************************************************
+    agent functions
+**********************************************************************************************************************/
+int       gko_agent_path(char *path, size_t size);
+int       gko_agent_serve(int idle, GKO_AGENT_HANDLER handler);
+int       gko_agent_forward(int argc, char *argv[], int *status);
+GKO_POOL *gko_agent_pool(GKO_AGENT *agent, const char *remark, const GRIP *grip);
+void      gko_agent_release(GKO_AGENT *agent, GKO_POOL *pool, int status);
+
+#endif  // __GEKKO_AGENT_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,275 @@
+/**********************************************************************************************************************
+    file:           bulk.c
+    description:    Tar stream bulk upload of small files
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "gekko.h"
+#include "bulk.h"
+/**********************************************************************************************************************
+    description:    Split a path into ustar prefix and name
+    arguments:      path:   relative path
+                    split:  offset of the separating '/', or -1 when the name alone fits
+    return:         true if the path can be stored
+**********************************************************************************************************************/
+static bool gko_tar_split(const char *path, long *split)
+{
+    size_t  len = strlen(path);
+    size_t  i   = 0;
+
+    *split = -1;
+    if (len <= sizeof(((GKO_TAR_HEADER *)0)->name)) return true;
+
+    for (i = len; i-- > 0; ) {
+        if (path[i] != '/') continue;
+        if (len - i - 1 > sizeof(((GKO_TAR_HEADER *)0)->name)) return false;
+        if (i <= sizeof(((GKO_TAR_HEADER *)0)->prefix)) {
+            *split = (long)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+/**********************************************************************************************************************
+    description:    Check if an entry goes into the bulk stream
+    arguments:      entry:      dirty entry
+                    threshold:  size limit, 0 for default and negative to disable bulk mode
+    return:         boolean
+**********************************************************************************************************************/
+bool gko_bulk_eligible(const GKO_ENTRY *entry, int64_t threshold)
+{
+    long split = 0;
+
+    if (threshold < 0) return false;
+    if (threshold == 0) threshold = GEKKO_BULK_THRESHOLD;
+
+    if (!S_ISREG(entry->mode)) return false;
+    if (entry->size >= (uint64_t)threshold) return false;
+
+    return gko_tar_split(entry->path, &split);
+}
+/**********************************************************************************************************************
+    description:    Buffered write to channel
+    arguments:      stream: bulk stream
+                    data:   bytes, NULL for zero padding
+                    len:    length
+    return:         error code
+**********************************************************************************************************************/
+int gko_bulk_flush(GKO_BULK_STREAM *stream)
+{
+    GKO_LIMITED_CHANNEL limited = {stream->channel, stream->rate, stream->cls};
+
+    if (!stream->used) return GEKKO_OK;
+    if (gko_limited_writer(&limited, stream->buffer, stream->used) != GEKKO_OK) return GEKKO_ERROR;
+
+    stream->total += stream->used;
+    stream->used = 0;
+
+    return GEKKO_OK;
+}
+
+int gko_bulk_write(GKO_BULK_STREAM *stream, const void *data, size_t len)
+{
+    size_t n = 0;
+
+    while (len) {
+        if (stream->used == GEKKO_BULK_BUFFER && gko_bulk_flush(stream) != GEKKO_OK) return GEKKO_ERROR;
+
+        n = GEKKO_BULK_BUFFER - stream->used;
+        if (n > len) n = len;
+
+        if (data) {
+            memcpy(stream->buffer + stream->used, data, n);
+            data = (const char *)data + n;
+        } else {
+            memset(stream->buffer + stream->used, 0, n);
+        }
+
+        stream->used += n;
+        len -= n;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Append a member header to the archive, the member data follows padded to a block
+    arguments:      stream: bulk stream
+                    path:   relative path
+                    mode:   permission bits
+                    size:   bytes of data that follow
+                    mtime:  modification time in seconds
+                    type:   ustar type flag
+    return:         error code
+**********************************************************************************************************************/
+int gko_bulk_header(GKO_BULK_STREAM *stream, const char *path, uint32_t mode, uint64_t size, int64_t mtime,
+                    char type)
+{
+    GKO_TAR_HEADER  header;
+    unsigned char  *p       = (unsigned char *)&header;
+    unsigned int    sum     = 0;
+    long            split   = 0;
+    size_t          i       = 0;
+
+    if (!gko_tar_split(path, &split)) return GEKKO_ERROR;
+
+    memset(&header, 0, sizeof(header));
+    if (split < 0) {
+        memcpy(header.name, path, strlen(path));
+    } else {
+        memcpy(header.prefix, path, (size_t)split);
+        memcpy(header.name, path + split + 1, strlen(path + split + 1));
+    }
+
+    snprintf(header.mode, sizeof(header.mode), "%07o", mode & 07777);
+    snprintf(header.uid, sizeof(header.uid), "%07o", 0);
+    snprintf(header.gid, sizeof(header.gid), "%07o", 0);
+    snprintf(header.size, sizeof(header.size), "%011llo", (unsigned long long)size);
+    snprintf(header.mtime, sizeof(header.mtime), "%011llo", (unsigned long long)mtime);
+    header.typeflag = type;
+    memcpy(header.magic, "ustar", 6);
+    memcpy(header.version, "00", 2);
+
+    memset(header.chksum, ' ', sizeof(header.chksum));
+    for (i = 0; i < sizeof(header); i++) sum += p[i];
+    snprintf(header.chksum, sizeof(header.chksum), "%06o", sum);
+    header.chksum[7] = ' ';
+
+    return gko_bulk_write(stream, &header, sizeof(header));
+}
+/**********************************************************************************************************************
+    description:    Append one regular file to the archive
+    arguments:      stream: bulk stream
+                    rootfd: local sync root
+                    entry:  entry to archive
+    return:         error code
+**********************************************************************************************************************/
+int gko_bulk_file(GKO_BULK_STREAM *stream, int rootfd, const GKO_ENTRY *entry)
+{
+    uint64_t        left    = entry->size;
+    ssize_t         n       = 0;
+    int             fd      = -1;
+
+    fd = openat(rootfd, entry->path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open file %s.\n", entry->path);
+        return GEKKO_ERROR;
+    }
+
+    if (gko_bulk_header(stream, entry->path, entry->mode, entry->size, entry->mtime_ns / 1000000000LL,
+                        GEKKO_TAR_FILE) != GEKKO_OK) goto __error;
+
+    // read straight into the stream buffer, the header promised exactly entry->size bytes
+    while (left) {
+        if (stream->used == GEKKO_BULK_BUFFER && gko_bulk_flush(stream) != GEKKO_OK) goto __error;
+
+        n = (ssize_t)(GEKKO_BULK_BUFFER - stream->used);
+        if ((uint64_t)n > left) n = (ssize_t)left;
+
+        n = read(fd, stream->buffer + stream->used, (size_t)n);
+        if (n <= 0) {
+            fprintf(stderr, "File %s changed during sync.\n", entry->path);
+            goto __error;
+        }
+
+        stream->used += (size_t)n;
+        left -= (uint64_t)n;
+    }
+
+    close(fd);
+
+    return gko_bulk_write(stream, NULL, (GEKKO_TAR_BLOCK - entry->size % GEKKO_TAR_BLOCK) % GEKKO_TAR_BLOCK);
+
+__error:
+    close(fd);
+
+    return GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Stream small files as one tar archive into a remote extractor on an exec channel
+    arguments:      xfer:       transfer context
+                    scan:       local scan
+                    files:      scan entries to send
+                    count:      number of entries
+                    command:    remote extractor, the quoted remote root is appended, NULL for tar
+    return:         error code
+**********************************************************************************************************************/
+int gko_bulk_upload(GKO_TRANSFER *xfer, const GKO_SCAN *scan, const size_t *files, size_t count,
+                    const char *command)
+{
+    GKO_BULK_STREAM     stream;
+    struct timespec     begin, end;
+    char                quoted[PATH_MAX * 2]                = {0};
+    char                line[GEKKO_TRANSFER_COMMAND_MAX]    = {0};
+    uint64_t            bytes                               = 0;
+    double              elapsed                             = 0;
+    size_t              i                                   = 0;
+    int                 ret                                 = GEKKO_ERROR;
+
+    if (!xfer) return GEKKO_ERROR;
+    if (!scan) return GEKKO_ERROR;
+    if (!files || !count) return GEKKO_OK;
+
+    if (!command || !command[0]) command = GEKKO_BULK_COMMAND;
+    if (gko_shell_quote(quoted, sizeof(quoted), xfer->remote) != GEKKO_OK) return GEKKO_ERROR;
+    snprintf(line, sizeof(line), "%s %s", command, quoted);
+
+    memset(&stream, 0, sizeof(stream));
+    stream.rate = xfer->rate;
+    stream.cls = GKO_RATE_SMALL;            // the archive carries small files, it rides their class
+    stream.buffer = (char *)malloc(GEKKO_BULK_BUFFER);
+    if (!stream.buffer) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    stream.channel = gko_channel_exec(xfer->session, line);
+    if (!stream.channel) {
+        fprintf(stderr, "Cannot run %s on remote.\n", line);
+        free(stream.buffer);
+        return GEKKO_ERROR;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (gko_bulk_file(&stream, xfer->rootfd, &scan->entries[files[i]]) != GEKKO_OK) break;
+        bytes += scan->entries[files[i]].size;
+    }
+
+    // two zero blocks end the archive
+    if (i == count && gko_bulk_write(&stream, NULL, GEKKO_TAR_BLOCK * 2) == GEKKO_OK &&
+        gko_bulk_flush(&stream) == GEKKO_OK) {
+        ret = GEKKO_OK;
+    }
+
+    if (gko_channel_finish(stream.channel) != GEKKO_OK) ret = GEKKO_ERROR;
+    free(stream.buffer);
+
+    if (ret != GEKKO_OK) return GEKKO_ERROR;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    xfer->files += count;
+    xfer->bytes += bytes;
+    xfer->sent  += stream.total;
+
+    printf("bulk: %lu files, %llu bytes in %.3f s (%.0f files/s).\n", (unsigned long)count,
+           (unsigned long long)bytes, elapsed, (elapsed > 0) ? count / elapsed : 0.0);
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,74 @@
+/**********************************************************************************************************************
+    file:           bulk.h
+    description:    Tar stream bulk upload of small files
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_BULK_H
+#define __GEKKO_BULK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "scan.h"
+#include "transfer.h"
+/**********************************************************************************************************************
+    bulk defaults
+**********************************************************************************************************************/
+#define GEKKO_BULK_THRESHOLD            (16384)
+#define GEKKO_BULK_MIN_FILES            (8)
+#define GEKKO_BULK_COMMAND              "tar -x -f - -C"
+#define GEKKO_BULK_BUFFER               (1 << 16)
+#define GEKKO_TAR_BLOCK                 (512)
+#define GEKKO_TAR_FILE                  '0'
+#define GEKKO_TAR_DIR                   '5'
+/**********************************************************************************************************************
+    ustar header
+**********************************************************************************************************************/
+typedef struct {
+    char            name[100];
+    char            mode[8];
+    char            uid[8];
+    char            gid[8];
+    char            size[12];
+    char            mtime[12];
+    char            chksum[8];
+    char            typeflag;
+    char            linkname[100];
+    char            magic[6];
+    char            version[2];
+    char            uname[32];
+    char            gname[32];
+    char            devmajor[8];
+    char            devminor[8];
+    char            prefix[155];
+    char            pad[12];
+} GKO_TAR_HEADER;
+/**********************************************************************************************************************
+    buffered channel stream
+**********************************************************************************************************************/
+typedef struct {
+    LIBSSH2_CHANNEL    *channel;
+    GKO_RATE           *rate;
+    GKO_RATE_CLASS      cls;                // rate class the stream is counted in
+    char               *buffer;
+    size_t              used;
+    uint64_t            total;
+} GKO_BULK_STREAM;
+/**********************************************************************************************************************
+    bulk functions
+**********************************************************************************************************************/
+bool gko_bulk_eligible(const GKO_ENTRY *entry, int64_t threshold);
+int  gko_bulk_flush(GKO_BULK_STREAM *stream);
+int  gko_bulk_write(GKO_BULK_STREAM *stream, const void *data, size_t len);
+int  gko_bulk_header(GKO_BULK_STREAM *stream, const char *path, uint32_t mode, uint64_t size, int64_t mtime,
+                     char type);
+int  gko_bulk_file(GKO_BULK_STREAM *stream, int rootfd, const GKO_ENTRY *entry);
+int  gko_bulk_upload(GKO_TRANSFER *xfer, const GKO_SCAN *scan, const size_t *files, size_t count,
+                     const char *command);
+
+#endif  // __GEKKO_BULK_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
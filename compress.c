@@ -0,0 +1,365 @@
+/**********************************************************************************************************************
+    file:           compress.c
+    description:    Adaptive per-file compression of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <sys/types.h>
+
+#ifdef GEKKO_ZSTD
+#include <zstd.h>
+#endif
+
+#include "gekko.h"
+#include "compress.h"
+/**********************************************************************************************************************
+    description:    Check if this build can compress at all
+    arguments:      -
+    return:         true or false
+**********************************************************************************************************************/
+bool gko_compress_available(void)
+{
+#ifdef GEKKO_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+/**********************************************************************************************************************
+    description:    Estimate Shannon entropy of a byte sample
+    arguments:      data:   sample
+                    len:    sample length
+                    text:   set if the sample holds no NUL byte, may be NULL
+    return:         bits per byte, 0 to 8
+**********************************************************************************************************************/
+double gko_compress_entropy(const uint8_t *data, size_t len, bool *text)
+{
+    uint32_t    counts[4][256];
+    uint32_t    total[256];
+    double      bits    = 0;
+    double      p       = 0;
+    size_t      i       = 0;
+    int         c       = 0;
+
+    if (text) *text = true;
+    if (!data || !len) return 0;
+
+    memset(counts, 0, sizeof(counts));
+
+    // four interleaved tables keep consecutive equal bytes from stalling on the same counter
+    for (; i + 4 <= len; i += 4) {
+        counts[0][data[i]]++;
+        counts[1][data[i + 1]]++;
+        counts[2][data[i + 2]]++;
+        counts[3][data[i + 3]]++;
+    }
+    for (; i < len; i++) counts[0][data[i]]++;
+
+    // plain lane-wise loops, the compiler turns them into vector adds
+    for (c = 0; c < 256; c++) total[c] = counts[0][c] + counts[1][c] + counts[2][c] + counts[3][c];
+
+    for (c = 0; c < 256; c++) {
+        if (!total[c]) continue;
+        p = (double)total[c] / len;
+        bits -= p * log2(p);
+    }
+
+    if (text) *text = (total[0] == 0);
+
+    return bits;
+}
+/**********************************************************************************************************************
+    description:    Classify an open file by the leading bytes
+    arguments:      fd:         open file, the file position is left alone
+                    entropy:    estimated bits per byte to store, may be NULL
+    return:         file class
+**********************************************************************************************************************/
+GKO_CLASS gko_compress_sniff(int fd, double *entropy)
+{
+    uint8_t     sample[GEKKO_COMPRESS_SNIFF];
+    ssize_t     n       = 0;
+    double      bits    = 8;
+    bool        text    = false;
+
+    n = pread(fd, sample, sizeof(sample), 0);
+    if (n > 0) bits = gko_compress_entropy(sample, (size_t)n, &text);
+    if (entropy) *entropy = bits;
+
+    if (bits >= GEKKO_COMPRESS_ENTROPY_MAX) return GKO_CLASS_DENSE;
+
+    return (text) ? GKO_CLASS_TEXT : GKO_CLASS_BINARY;
+}
+/**********************************************************************************************************************
+    description:    Compression level of a file class
+    arguments:      cls:    file class
+                    level:  level configured for the grip, 0 for default
+    return:         level, 0 to send raw
+**********************************************************************************************************************/
+int gko_compress_level(GKO_CLASS cls, int level)
+{
+    if (level < 0) return 0;
+    if (level == 0) level = GEKKO_COMPRESS_LEVEL;
+
+    switch (cls) {
+    case GKO_CLASS_TEXT:    return level;
+    case GKO_CLASS_BINARY:  return (level < GEKKO_COMPRESS_LEVEL_BINARY) ? level : GEKKO_COMPRESS_LEVEL_BINARY;
+    default:                return 0;
+    }
+}
+/**********************************************************************************************************************
+    description:    Name of a file class
+    arguments:      cls:    file class
+    return:         name
+**********************************************************************************************************************/
+const char *gko_compress_class_name(GKO_CLASS cls)
+{
+    switch (cls) {
+    case GKO_CLASS_TEXT:    return "text";
+    case GKO_CLASS_BINARY:  return "binary";
+    case GKO_CLASS_DENSE:   return "dense";
+    default:                return "unknown";
+    }
+}
+/**********************************************************************************************************************
+    description:    Start compressing a file from its current position
+    arguments:      c:      compressor to set up, release with gko_compressor_free()
+                    fd:     open file, stays owned by the caller
+                    level:  zstd level
+    return:         error code
+**********************************************************************************************************************/
+int gko_compressor_init(GKO_COMPRESSOR *c, int fd, int level)
+{
+    if (!c) return GEKKO_ERROR;
+
+    memset(c, 0, sizeof(GKO_COMPRESSOR));
+    c->fd = fd;
+
+#ifdef GEKKO_ZSTD
+    c->cctx = ZSTD_createCCtx();
+    c->in = (uint8_t *)gko_source_buffer(GEKKO_COMPRESS_BUFFER);
+    if (!c->cctx || !c->in) {
+        fprintf(stderr, "Insufficient memory.\n");
+        gko_compressor_free(c);
+        return GEKKO_ERROR;
+    }
+
+    if (gko_source_open(&c->src, fd, (uint64_t)lseek(fd, 0, SEEK_CUR), 0, c->in, GEKKO_COMPRESS_BUFFER) !=
+        GEKKO_OK) {
+        gko_compressor_free(c);
+        return GEKKO_ERROR;
+    }
+
+    ZSTD_CCtx_setParameter((ZSTD_CCtx *)c->cctx, ZSTD_c_compressionLevel, level);
+
+    return GEKKO_OK;
+#else
+    (void)level;
+
+    return GEKKO_ERROR;
+#endif
+}
+/**********************************************************************************************************************
+    description:    Pull the next compressed bytes, reading the file as needed
+    arguments:      c:      compressor
+                    out:    buffer
+                    size:   buffer size
+    return:         bytes produced, 0 once the frame is closed, negative on error
+**********************************************************************************************************************/
+ssize_t gko_compressor_read(GKO_COMPRESSOR *c, void *out, size_t size)
+{
+#ifdef GEKKO_ZSTD
+    ZSTD_inBuffer   input;
+    ZSTD_outBuffer  output;
+    size_t          left    = 0;
+    ssize_t         n       = 0;
+
+    output.dst = out;
+    output.size = size;
+    output.pos = 0;
+
+    while (output.pos < output.size && !c->done) {
+        if (!gko_source_pending(&c->src) && !c->eof) {
+            n = gko_source_fill(&c->src, GEKKO_COMPRESS_BUFFER);
+            if (n < 0) return -1;
+
+            c->eof = (n == 0);
+        }
+
+        input.src = gko_source_data(&c->src);
+        input.size = gko_source_pending(&c->src);
+        input.pos = 0;
+
+        // once the file is drained the frame is flushed and closed, possibly over several calls
+        left = ZSTD_compressStream2((ZSTD_CCtx *)c->cctx, &output, &input, (c->eof) ? ZSTD_e_end : ZSTD_e_continue);
+        if (ZSTD_isError(left)) {
+            fprintf(stderr, "zstd: %s.\n", ZSTD_getErrorName(left));
+            return -1;
+        }
+
+        gko_source_consume(&c->src, input.pos);
+        if (c->eof && left == 0) c->done = true;
+    }
+
+    c->wire += output.pos;
+
+    return (ssize_t)output.pos;
+#else
+    (void)c;
+    (void)out;
+    (void)size;
+
+    return -1;
+#endif
+}
+/**********************************************************************************************************************
+    description:    Release a compressor
+    arguments:      c:      compressor
+    return:         -
+**********************************************************************************************************************/
+void gko_compressor_free(GKO_COMPRESSOR *c)
+{
+    if (!c) return;
+
+#ifdef GEKKO_ZSTD
+    ZSTD_freeCCtx((ZSTD_CCtx *)c->cctx);
+#endif
+    gko_source_close(&c->src);
+    free(c->in);
+    c->cctx = NULL;
+    c->in = NULL;
+}
+/**********************************************************************************************************************
+    description:    Compress a file from its current position into a zstd stream
+    arguments:      fd:     open file
+                    level:  zstd level
+                    write:  stream writer
+                    ctx:    writer context
+                    wire:   compressed bytes written to store, may be NULL
+    return:         error code
+**********************************************************************************************************************/
+int gko_compress_encode(int fd, int level, GKO_WRITER write, void *ctx, uint64_t *wire)
+{
+    GKO_COMPRESSOR  c;
+    uint8_t        *out     = NULL;
+    ssize_t         n       = 0;
+    int             ret     = GEKKO_ERROR;
+
+    if (gko_compressor_init(&c, fd, level) != GEKKO_OK) return GEKKO_ERROR;
+
+    out = (uint8_t *)malloc(GEKKO_COMPRESS_BUFFER);
+    if (!out) {
+        fprintf(stderr, "Insufficient memory.\n");
+        gko_compressor_free(&c);
+        return GEKKO_ERROR;
+    }
+
+    while ((n = gko_compressor_read(&c, out, GEKKO_COMPRESS_BUFFER)) > 0) {
+        if (write(ctx, out, (size_t)n) != GEKKO_OK) break;
+    }
+
+    if (n == 0) {
+        if (wire) *wire = c.wire;
+        ret = GEKKO_OK;
+    }
+
+    gko_compressor_free(&c);
+    free(out);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Decompress a zstd stream into a file
+    arguments:      read:   stream reader
+                    ctx:    reader context
+                    outfd:  file to write
+    return:         error code
+**********************************************************************************************************************/
+int gko_compress_decode(GKO_READER read, void *ctx, int outfd)
+{
+#ifdef GEKKO_ZSTD
+    ZSTD_DCtx      *dctx    = NULL;
+    ZSTD_inBuffer   input;
+    ZSTD_outBuffer  output;
+    uint8_t        *in      = NULL;
+    uint8_t        *out     = NULL;
+    size_t          size    = ZSTD_DStreamOutSize();
+    size_t          left    = 1;
+    size_t          done    = 0;
+    ssize_t         n       = 0;
+    ssize_t         w       = 0;
+    int             ret     = GEKKO_ERROR;
+
+    dctx = ZSTD_createDCtx();
+    in = (uint8_t *)malloc(GEKKO_COMPRESS_BUFFER);
+    out = (uint8_t *)malloc(size);
+    if (!dctx || !in || !out) goto __error_malloc;
+
+    while ((n = read(ctx, in, GEKKO_COMPRESS_BUFFER)) > 0) {
+        input.src = in;
+        input.size = (size_t)n;
+        input.pos = 0;
+
+        while (input.pos < input.size) {
+            output.dst = out;
+            output.size = size;
+            output.pos = 0;
+
+            left = ZSTD_decompressStream(dctx, &output, &input);
+            if (ZSTD_isError(left)) goto __error_malloc;
+
+            for (done = 0; done < output.pos; done += (size_t)w) {
+                w = write(outfd, out + done, output.pos - done);
+                if (w <= 0) goto __error_malloc;
+            }
+        }
+    }
+
+    // a stream cut short ends in the middle of a frame
+    if (n == 0 && left == 0) ret = GEKKO_OK;
+
+__error_malloc:
+    ZSTD_freeDCtx(dctx);
+    free(in);
+    free(out);
+
+    return ret;
+#else
+    (void)read;
+    (void)ctx;
+    (void)outfd;
+
+    return GEKKO_ERROR;
+#endif
+}
+/**********************************************************************************************************************
+    description:    Print bytes saved against CPU spent for every file class that saw a file
+    arguments:      stats:  GKO_CLASS_MAX class statistics
+    return:         -
+**********************************************************************************************************************/
+void gko_compress_report(const GKO_COMPRESS_STATS *stats)
+{
+    const GKO_COMPRESS_STATS   *s       = NULL;
+    double                      saved   = 0;
+    int                         c       = 0;
+
+    for (c = 0; c < GKO_CLASS_MAX; c++) {
+        s = &stats[c];
+        if (!s->files) continue;
+
+        saved = (double)s->bytes - (double)s->wire;
+        printf("compress %s: %llu files, %llu bytes as %llu on the wire (%.1f%%), %.3f s CPU, "
+               "%.1f MB saved per CPU second.\n", gko_compress_class_name((GKO_CLASS)c),
+               (unsigned long long)s->files, (unsigned long long)s->bytes, (unsigned long long)s->wire,
+               s->bytes ? 100.0 * s->wire / s->bytes : 0.0, s->cpu,
+               (s->cpu > 0) ? saved / s->cpu / 1e6 : 0.0);
+    }
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
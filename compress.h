@@ -0,0 +1,73 @@
+/**********************************************************************************************************************
+    file:           compress.h
+    description:    Adaptive per-file compression of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_COMPRESS_H
+#define __GEKKO_COMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "delta.h"
+#include "source.h"
+/**********************************************************************************************************************
+    compress defaults
+**********************************************************************************************************************/
+#define GEKKO_COMPRESS_SNIFF            (16384)     // leading bytes the decision is made on
+#define GEKKO_COMPRESS_MIN_SIZE         (65536)     // smaller files ride the bulk archive or go raw
+#define GEKKO_COMPRESS_LEVEL            (3)
+#define GEKKO_COMPRESS_LEVEL_BINARY     (1)         // binaries rarely shrink enough to pay for more
+#define GEKKO_COMPRESS_ENTROPY_MAX      (7.2)       // bits per byte, denser content is sent raw
+#define GEKKO_COMPRESS_BUFFER           (1 << 17)
+/**********************************************************************************************************************
+    file classes, decided by the sniff
+**********************************************************************************************************************/
+typedef enum {
+    GKO_CLASS_TEXT = 0,                 // no NUL byte, low entropy: logs, JSON, source
+    GKO_CLASS_BINARY,                   // compressible binary
+    GKO_CLASS_DENSE,                    // media, archives, anything already compressed
+    GKO_CLASS_MAX
+} GKO_CLASS;
+/**********************************************************************************************************************
+    statistics of one file class
+**********************************************************************************************************************/
+typedef struct {
+    uint64_t        files;
+    uint64_t        bytes;
+    uint64_t        wire;
+    double          cpu;                // seconds of sniffing and compressing
+} GKO_COMPRESS_STATS;
+/**********************************************************************************************************************
+    pull side of a compressed stream, for callers that cannot block on the writer
+**********************************************************************************************************************/
+typedef struct {
+    void           *cctx;
+    int             fd;
+    GKO_SOURCE      src;                // input is compressed in place, from the mapping for large files
+    uint8_t        *in;
+    uint64_t        wire;
+    bool            eof;
+    bool            done;
+} GKO_COMPRESSOR;
+/**********************************************************************************************************************
+    compress functions
+**********************************************************************************************************************/
+bool        gko_compress_available(void);
+double      gko_compress_entropy(const uint8_t *data, size_t len, bool *text);
+GKO_CLASS   gko_compress_sniff(int fd, double *entropy);
+int         gko_compress_level(GKO_CLASS cls, int level);
+const char *gko_compress_class_name(GKO_CLASS cls);
+int         gko_compressor_init(GKO_COMPRESSOR *c, int fd, int level);
+ssize_t     gko_compressor_read(GKO_COMPRESSOR *c, void *out, size_t size);
+void        gko_compressor_free(GKO_COMPRESSOR *c);
+int         gko_compress_encode(int fd, int level, GKO_WRITER write, void *ctx, uint64_t *wire);
+int         gko_compress_decode(GKO_READER read, void *ctx, int outfd);
+void        gko_compress_report(const GKO_COMPRESS_STATS *stats);
+
+#endif  // __GEKKO_COMPRESS_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,374 @@
+/**********************************************************************************************************************
+    file:           config.c
+    description:    JSON configuration parsing of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "gekko.h"
+#include "config.h"
+#include "jsmn.h"
+/**********************************************************************************************************************
+    description:    Read a whole file into one NUL terminated buffer
+    arguments:      path:   file path
+                    length: bytes read
+    return:         buffer to free, NULL on error
+**********************************************************************************************************************/
+static char *gko_config_read(const char *path, size_t *length)
+{
+    struct stat     st;
+    char           *json    = NULL;
+    size_t          done    = 0;
+    ssize_t         n       = 0;
+    int             fd      = -1;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open file %s.\n", path);
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size > GEKKO_CONFIG_FILE_MAX) {
+        fprintf(stderr, "Cannot read file %s.\n", path);
+        goto __error_stat;
+    }
+
+    json = (char *)zalloc((size_t)st.st_size + 1);
+    if (!json) {
+        fprintf(stderr, "Insufficient memory.\n");
+        goto __error_stat;
+    }
+
+    while (done < (size_t)st.st_size) {
+        n = read(fd, json + done, (size_t)st.st_size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+
+    if (done != (size_t)st.st_size) {
+        fprintf(stderr, "Cannot read file %s.\n", path);
+        free(json);
+        json = NULL;
+        goto __error_stat;
+    }
+
+    *length = done;
+
+__error_stat:
+    close(fd);
+
+    return json;
+}
+/**********************************************************************************************************************
+    description:    Tokenize a document in one pass. Parsing starts in the caller's buffer and moves to a heap buffer
+                    of twice the size whenever jsmn runs out of tokens, resuming where it stopped.
+    arguments:      json:   document
+                    length: document bytes
+                    tokens: caller's buffer in, the buffer holding the tokens out, free it if it changed
+                    size:   tokens the caller's buffer holds
+    return:         tokens parsed, a negative jsmn error on error
+**********************************************************************************************************************/
+static int gko_config_tokenize(const char *json, size_t length, jsmntok_t **tokens, size_t size)
+{
+    jsmn_parser     p;
+    jsmntok_t      *grown   = NULL;
+    jsmntok_t      *stack   = *tokens;
+    int             count   = 0;
+
+    jsmn_init(&p);
+
+    for (;;) {
+        count = jsmn_parse(&p, json, length, *tokens, (unsigned int)size);
+        if (count != JSMN_ERROR_NOMEM) break;
+
+        grown = (jsmntok_t *)malloc(size * 2 * sizeof(jsmntok_t));
+        if (!grown) break;
+
+        memcpy(grown, *tokens, size * sizeof(jsmntok_t));
+        if (*tokens != stack) free(*tokens);
+
+        *tokens = grown;
+        size *= 2;
+    }
+
+    return count;
+}
+/**********************************************************************************************************************
+    description:    Index of the token after a token and everything nested in it
+    arguments:      tokens: tokens
+                    i:      token
+    return:         next sibling index
+**********************************************************************************************************************/
+static int gko_config_skip(const jsmntok_t *tokens, int i)
+{
+    int left = 1;
+
+    // an object counts its keys, a key its value, an array its items
+    while (left > 0) {
+        left += tokens[i].size - 1;
+        i++;
+    }
+
+    return i;
+}
+/**********************************************************************************************************************
+    description:    Store one value into the field a key binds to
+    arguments:      field:  binding
+                    value:  value text
+                    base:   struct the field belongs to
+    return:         error code
+**********************************************************************************************************************/
+static int gko_config_store(const GKO_CONFIG_FIELD *field, const char *value, void *base)
+{
+    void *target = (uint8_t *)base + field->offset;
+
+    switch (field->kind) {
+    case GKO_CONFIG_STRING:
+        snprintf((char *)target, field->size, "%s", value);
+        break;
+    case GKO_CONFIG_INT:
+        *(int *)target = atoi(value);
+        break;
+    case GKO_CONFIG_INT64:
+        *(int64_t *)target = strtoll(value, NULL, 10);
+        break;
+    case GKO_CONFIG_PORT:
+        *(uint16_t *)target = (uint16_t)atoi(value);
+        break;
+    case GKO_CONFIG_PARSE:
+        if (field->parse(value, target) != GEKKO_OK) {
+            fprintf(stderr, "Invalid %s: %s\n", field->key, value);
+            return GEKKO_ERROR;
+        }
+        break;
+    default:
+        return GEKKO_ERROR;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Copy a value token out of the document, decoding the escapes of a string
+    arguments:      json:   document
+                    tok:    value token
+                    value:  buffer to store, truncated to its size
+                    size:   buffer size
+    return:         -
+**********************************************************************************************************************/
+static void gko_config_value(const char *json, const jsmntok_t *tok, char *value, size_t size)
+{
+    const char     *s       = json + tok->start;
+    const char     *end     = json + tok->end;
+    size_t          n       = 0;
+
+    while (s < end && n + 1 < size) {
+        if (tok->type != JSMN_STRING || *s != '\\' || s + 1 == end) {
+            value[n++] = *s++;
+            continue;
+        }
+
+        switch (s[1]) {
+        case 'n':   value[n++] = '\n';    break;
+        case 't':   value[n++] = '\t';    break;
+        case 'r':   value[n++] = '\r';    break;
+        case 'b':   value[n++] = '\b';    break;
+        case 'f':   value[n++] = '\f';    break;
+        case 'u':   value[n++] = *s++;    continue;     // kept as written
+        default:    value[n++] = s[1];    break;
+        }
+        s += 2;
+    }
+
+    value[n] = '\0';
+}
+/**********************************************************************************************************************
+    description:    Parse a JSON object file into a struct. Top level keys found in the table are stored into their
+                    fields, other keys and nested values are skipped. Values are copied through the stack, nothing is
+                    allocated per key.
+    arguments:      path:       file path
+                    fields:     key table
+                    count:      keys in the table
+                    base:       struct the fields belong to
+                    verbose:    print every stored key
+    return:         error code
+**********************************************************************************************************************/
+int gko_config_load(const char *path, const GKO_CONFIG_FIELD *fields, size_t count, void *base, bool verbose)
+{
+    jsmntok_t               stack[TOKEN_MAX];
+    jsmntok_t              *t               = stack;
+    const jsmntok_t        *key             = NULL;
+    const jsmntok_t        *val             = NULL;
+    const GKO_CONFIG_FIELD *field           = NULL;
+    char                    value[PATH_MAX] = {0};
+    char                   *json            = NULL;
+    size_t                  length          = 0;
+    size_t                  klen            = 0;
+    size_t                  f               = 0;
+    int                     ret             = GEKKO_ERROR;
+    int                     tokens          = 0;
+    int                     pairs           = 0;
+    int                     i               = 0;
+
+    if (!path || !fields || !base) return GEKKO_ERROR;
+
+    json = gko_config_read(path, &length);
+    if (!json) return GEKKO_ERROR;
+
+    tokens = gko_config_tokenize(json, length, &t, sizeof(stack) / sizeof(stack[0]));
+    if (tokens < 0) {
+        fprintf(stderr, "Failed to parse JSON %s (%d).\n", path, tokens);
+        goto __error_parse;
+    }
+
+    if (tokens < 1 || t[0].type != JSMN_OBJECT) {
+        fprintf(stderr, "Invalid json file %s (%d).\n", path, tokens);
+        goto __error_parse;
+    }
+
+    for (i = 1, pairs = t[0].size; pairs > 0; pairs--, i = gko_config_skip(t, i)) {
+        key = &t[i];
+        val = &t[i + 1];
+        klen = (size_t)(key->end - key->start);
+
+        for (f = 0, field = NULL; f < count; f++) {
+            if (strlen(fields[f].key) != klen) continue;
+            if (memcmp(fields[f].key, json + key->start, klen) != 0) continue;
+            field = &fields[f];
+            break;
+        }
+
+        if (!field) continue;
+
+        if (key->size < 1 || val->type == JSMN_OBJECT || val->type == JSMN_ARRAY) {
+            fprintf(stderr, "Invalid %s in %s.\n", field->key, path);
+            goto __error_parse;
+        }
+
+        gko_config_value(json, val, value, sizeof(value));
+
+        if (verbose) printf("%s = %s\n", field->key, value);
+
+        if (gko_config_store(field, value, base) != GEKKO_OK) goto __error_parse;
+    }
+
+    ret = GEKKO_OK;
+
+__error_parse:
+    if (t != stack) free(t);
+    free(json);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Write a string as a JSON string
+    arguments:      file:   output
+                    s:      string
+    return:         -
+**********************************************************************************************************************/
+static void gko_config_quote(FILE *file, const char *s)
+{
+    fputc('"', file);
+
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', file);
+            fputc(*s, file);
+        } else if (*s == '\n') {
+            fputs("\\n", file);
+        } else if (*s == '\t') {
+            fputs("\\t", file);
+        } else if ((unsigned char)*s < 0x20) {
+            fprintf(file, "\\u%04x", (unsigned char)*s);
+        } else {
+            fputc(*s, file);
+        }
+    }
+
+    fputc('"', file);
+}
+/**********************************************************************************************************************
+    description:    Write a struct as a JSON object file, atomically replacing the old one. Empty strings, zeros and
+                    enum values without a name are left out, loading the file back leaves them zero.
+    arguments:      path:   file path
+                    fields: key table
+                    count:  keys in the table
+                    base:   struct the fields belong to
+    return:         error code
+**********************************************************************************************************************/
+int gko_config_save(const char *path, const GKO_CONFIG_FIELD *fields, size_t count, const void *base)
+{
+    const void     *target          = NULL;
+    const char     *name            = NULL;
+    FILE           *file            = NULL;
+    char            temp[PATH_MAX]  = {0};
+    bool            first           = true;
+    bool            error           = false;
+    size_t          f               = 0;
+
+    if (!path || !fields || !base) return GEKKO_ERROR;
+
+    snprintf(temp, PATH_MAX, "%s.tmp", path);
+
+    file = fopen(temp, "w");
+    if (!file) {
+        fprintf(stderr, "Cannot open file %s.\n", temp);
+        return GEKKO_ERROR;
+    }
+
+    fputs("{", file);
+
+    for (f = 0; f < count; f++) {
+        target = (const uint8_t *)base + fields[f].offset;
+
+        switch (fields[f].kind) {
+        case GKO_CONFIG_STRING: if (!*(const char *)target) continue;       break;
+        case GKO_CONFIG_INT:    if (!*(const int *)target) continue;        break;
+        case GKO_CONFIG_INT64:  if (!*(const int64_t *)target) continue;    break;
+        case GKO_CONFIG_PORT:   if (!*(const uint16_t *)target) continue;   break;
+        case GKO_CONFIG_PARSE:
+            name = (fields[f].name) ? fields[f].name(target) : NULL;
+            if (!name) continue;
+            break;
+        default:
+            continue;
+        }
+
+        fprintf(file, "%s\n    \"%s\": ", (first) ? "" : ",", fields[f].key);
+        first = false;
+
+        switch (fields[f].kind) {
+        case GKO_CONFIG_STRING: gko_config_quote(file, (const char *)target);                       break;
+        case GKO_CONFIG_INT:    fprintf(file, "%d", *(const int *)target);                          break;
+        case GKO_CONFIG_INT64:  fprintf(file, "%lld", (long long)*(const int64_t *)target);         break;
+        case GKO_CONFIG_PORT:   fprintf(file, "%u", (unsigned)*(const uint16_t *)target);           break;
+        default:                gko_config_quote(file, name);                                       break;
+        }
+    }
+
+    fputs("\n}\n", file);
+
+    error |= (fflush(file) != 0);
+    error |= (fsync(fileno(file)) != 0);
+    error |= (fclose(file) != 0);
+
+    if (error || rename(temp, path) != 0) {
+        fprintf(stderr, "Cannot write file %s.\n", path);
+        unlink(temp);
+        return GEKKO_ERROR;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
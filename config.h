@@ -0,0 +1,55 @@
+/**********************************************************************************************************************
+    file:           config.h
+    description:    JSON configuration parsing of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_CONFIG_H
+#define __GEKKO_CONFIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+/**********************************************************************************************************************
+    config defaults
+**********************************************************************************************************************/
+#define GEKKO_CONFIG_FILE_MAX           (16 << 20)  // larger files are refused rather than parsed
+/**********************************************************************************************************************
+    value kinds a key binds to
+**********************************************************************************************************************/
+typedef enum {
+    GKO_CONFIG_STRING = 0,              // char array, truncated to its size
+    GKO_CONFIG_INT,
+    GKO_CONFIG_INT64,
+    GKO_CONFIG_PORT,                    // uint16_t
+    GKO_CONFIG_PARSE,                   // custom parser, i.e. an enum name
+} GKO_CONFIG_KIND;
+/**********************************************************************************************************************
+    one key of a file and the struct field it lands in
+**********************************************************************************************************************/
+typedef int         (*GKO_CONFIG_PARSER)(const char *value, void *field);
+typedef const char *(*GKO_CONFIG_NAMER)(const void *field);  // NULL leaves the key out of a saved file
+
+typedef struct {
+    const char         *key;
+    GKO_CONFIG_KIND     kind;
+    size_t              offset;
+    size_t              size;
+    GKO_CONFIG_PARSER   parse;
+    GKO_CONFIG_NAMER    name;
+} GKO_CONFIG_FIELD;
+
+#define GKO_CONFIG_BIND(key, kind, type, member) \
+    { key, kind, offsetof(type, member), sizeof(((type *)0)->member), NULL, NULL }
+#define GKO_CONFIG_ENUM(key, type, member, parse, name) \
+    { key, GKO_CONFIG_PARSE, offsetof(type, member), sizeof(((type *)0)->member), parse, name }
+/**********************************************************************************************************************
+    config functions
+**********************************************************************************************************************/
+int gko_config_load(const char *path, const GKO_CONFIG_FIELD *fields, size_t count, void *base, bool verbose);
+int gko_config_save(const char *path, const GKO_CONFIG_FIELD *fields, size_t count, const void *base);
+
+#endif  // __GEKKO_CONFIG_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,524 @@
+/**********************************************************************************************************************
+    file:           delta.c
+    description:    Rolling checksum delta encoding of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+
+#include "gekko.h"
+#include "hash.h"
+#include "delta.h"
+/**********************************************************************************************************************
+    delta types
+**********************************************************************************************************************/
+#define GEKKO_DELTA_IO_BUFFER           (GEKKO_DELTA_LITERAL_MAX + 64)
+#define GEKKO_DELTA_NONE                (0xFFFFFFFFU)
+
+typedef struct {
+    GKO_WRITER      write;
+    void           *ctx;
+    uint8_t        *buffer;
+    size_t          used;
+    uint64_t        total;
+} GKO_DELTA_OUT;
+/**********************************************************************************************************************
+    description:    Little endian serialization helpers
+    arguments:      p:      buffer
+                    v:      value
+    return:         value for readers
+**********************************************************************************************************************/
+static void gko_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void gko_put64(uint8_t *p, uint64_t v)
+{
+    gko_put32(p, (uint32_t)v);
+    gko_put32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint32_t gko_get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t gko_get64(const uint8_t *p)
+{
+    return (uint64_t)gko_get32(p) | ((uint64_t)gko_get32(p + 4) << 32);
+}
+/**********************************************************************************************************************
+    description:    Pick block size for a file, roughly its square root like rsync does
+    arguments:      size:   file size
+    return:         block size
+**********************************************************************************************************************/
+uint32_t gko_delta_block_size(uint64_t size)
+{
+    uint64_t block = GEKKO_DELTA_BLOCK_MIN;
+
+    while (block < GEKKO_DELTA_BLOCK_MAX && block * block < size) block <<= 1;
+
+    return (uint32_t)block;
+}
+/**********************************************************************************************************************
+    description:    Read exactly len bytes
+    arguments:      read:   reader
+                    ctx:    reader context
+                    data:   destination
+                    len:    bytes to read
+    return:         error code
+**********************************************************************************************************************/
+int gko_delta_read_full(GKO_READER read, void *ctx, void *data, size_t len)
+{
+    uint8_t    *p   = (uint8_t *)data;
+    ssize_t     n   = 0;
+
+    while (len) {
+        n = read(ctx, p, len);
+        if (n <= 0) return GEKKO_ERROR;
+        p += n;
+        len -= (size_t)n;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Weak rolling checksum of a block
+    arguments:      p:      block
+                    len:    block length
+                    a:      running byte sum to store
+                    b:      running weighted sum to store
+    return:         checksum
+**********************************************************************************************************************/
+static uint32_t gko_delta_weak(const uint8_t *p, size_t len, uint32_t *a, uint32_t *b)
+{
+    uint32_t    s1  = 0;
+    uint32_t    s2  = 0;
+    size_t      i   = 0;
+
+    for (i = 0; i < len; i++) {
+        s1 += p[i];
+        s2 += (uint32_t)(len - i) * p[i];
+    }
+
+    *a = s1;
+    *b = s2;
+
+    return (s1 & 0xFFFF) | (s2 << 16);
+}
+/**********************************************************************************************************************
+    description:    Buffered output of delta and signature streams
+    arguments:      out:    output
+                    data:   bytes
+                    len:    length
+    return:         error code
+**********************************************************************************************************************/
+static int gko_delta_flush(GKO_DELTA_OUT *out)
+{
+    if (!out->used) return GEKKO_OK;
+    if (out->write(out->ctx, out->buffer, out->used) != GEKKO_OK) return GEKKO_ERROR;
+
+    out->total += out->used;
+    out->used = 0;
+
+    return GEKKO_OK;
+}
+
+static int gko_delta_emit(GKO_DELTA_OUT *out, const void *data, size_t len)
+{
+    if (out->used + len > GEKKO_DELTA_IO_BUFFER) {
+        if (gko_delta_flush(out) != GEKKO_OK) return GEKKO_ERROR;
+
+        if (len > GEKKO_DELTA_IO_BUFFER / 2) {
+            if (out->write(out->ctx, data, len) != GEKKO_OK) return GEKKO_ERROR;
+            out->total += len;
+            return GEKKO_OK;
+        }
+    }
+
+    memcpy(out->buffer + out->used, data, len);
+    out->used += len;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Write block signatures of a basis file
+    arguments:      fd:     basis file
+                    block:  block size
+                    write:  writer
+                    ctx:    writer context
+    return:         error code
+**********************************************************************************************************************/
+int gko_delta_signature(int fd, uint32_t block, GKO_WRITER write, void *ctx)
+{
+    GKO_DELTA_OUT   out;
+    struct stat     st;
+    uint8_t        *data    = NULL;
+    uint8_t         rec[20];
+    uint64_t        left    = 0;
+    uint32_t        count   = 0;
+    uint32_t        a, b;
+    size_t          len     = 0;
+    size_t          got     = 0;
+    ssize_t         n       = 0;
+    int             ret     = GEKKO_ERROR;
+
+    if (!block || fstat(fd, &st) != 0) return GEKKO_ERROR;
+
+    memset(&out, 0, sizeof(out));
+    out.write  = write;
+    out.ctx    = ctx;
+    out.buffer = (uint8_t *)malloc(GEKKO_DELTA_IO_BUFFER);
+    data = (uint8_t *)malloc(block);
+    if (!out.buffer || !data) goto __error_malloc;
+
+    left = (uint64_t)st.st_size;
+    count = (uint32_t)((left + block - 1) / block);
+
+    memcpy(rec, GEKKO_DELTA_SIG_MAGIC, 4);
+    gko_put32(rec + 4, block);
+    gko_put64(rec + 8, left);
+    gko_put32(rec + 16, count);
+    if (gko_delta_emit(&out, rec, 20) != GEKKO_OK) goto __error_malloc;
+
+    while (left) {
+        len = (left < block) ? (size_t)left : block;
+
+        for (got = 0; got < len; got += (size_t)n) {
+            n = read(fd, data + got, len - got);
+            if (n <= 0) goto __error_malloc;
+        }
+
+        gko_put32(rec, gko_delta_weak(data, len, &a, &b));
+        gko_put64(rec + 4, gko_hash(data, len));
+        if (gko_delta_emit(&out, rec, 12) != GEKKO_OK) goto __error_malloc;
+
+        left -= len;
+    }
+
+    ret = gko_delta_flush(&out);
+
+__error_malloc:
+    free(data);
+    free(out.buffer);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Read block signatures
+    arguments:      read:   reader
+                    ctx:    reader context
+                    sig:    signatures to fill, release with gko_delta_signature_free()
+    return:         error code
+**********************************************************************************************************************/
+int gko_delta_signature_read(GKO_READER read, void *ctx, GKO_SIGNATURE *sig)
+{
+    uint8_t     rec[20];
+    uint32_t    i   = 0;
+
+    memset(sig, 0, sizeof(GKO_SIGNATURE));
+
+    if (gko_delta_read_full(read, ctx, rec, 20) != GEKKO_OK) return GEKKO_ERROR;
+    if (memcmp(rec, GEKKO_DELTA_SIG_MAGIC, 4) != GEKKO_OK) return GEKKO_ERROR;
+
+    sig->block = gko_get32(rec + 4);
+    sig->size  = gko_get64(rec + 8);
+    sig->count = gko_get32(rec + 16);
+
+    if (!sig->block || sig->count != (sig->size + sig->block - 1) / sig->block) return GEKKO_ERROR;
+    if (!sig->count) return GEKKO_OK;
+
+    sig->weak   = (uint32_t *)malloc(sig->count * sizeof(uint32_t));
+    sig->strong = (uint64_t *)malloc(sig->count * sizeof(uint64_t));
+    if (!sig->weak || !sig->strong) goto __error;
+
+    for (i = 0; i < sig->count; i++) {
+        if (gko_delta_read_full(read, ctx, rec, 12) != GEKKO_OK) goto __error;
+        sig->weak[i]   = gko_get32(rec);
+        sig->strong[i] = gko_get64(rec + 4);
+    }
+
+    return GEKKO_OK;
+
+__error:
+    gko_delta_signature_free(sig);
+
+    return GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Release block signatures
+    arguments:      sig:    signatures
+    return:         -
+**********************************************************************************************************************/
+void gko_delta_signature_free(GKO_SIGNATURE *sig)
+{
+    if (!sig) return;
+
+    free(sig->weak);
+    free(sig->strong);
+    memset(sig, 0, sizeof(GKO_SIGNATURE));
+}
+/**********************************************************************************************************************
+    description:    Emit pending literal run and block copy
+    arguments:      out:    output
+                    data:   literal start
+                    len:    literal length
+                    first:  first block of pending copy
+                    count:  pending block count
+                    stats:  statistics
+    return:         error code
+**********************************************************************************************************************/
+static int gko_delta_literal(GKO_DELTA_OUT *out, const uint8_t *data, size_t len, GKO_DELTA_STATS *stats)
+{
+    uint8_t op[5];
+    size_t  n = 0;
+
+    while (len) {
+        n = (len > GEKKO_DELTA_LITERAL_MAX) ? GEKKO_DELTA_LITERAL_MAX : len;
+
+        op[0] = GEKKO_DELTA_OP_LITERAL;
+        gko_put32(op + 1, (uint32_t)n);
+        if (gko_delta_emit(out, op, 5) != GEKKO_OK) return GEKKO_ERROR;
+        if (gko_delta_emit(out, data, n) != GEKKO_OK) return GEKKO_ERROR;
+
+        stats->literal += n;
+        data += n;
+        len -= n;
+    }
+
+    return GEKKO_OK;
+}
+
+static int gko_delta_copy(GKO_DELTA_OUT *out, uint32_t first, uint32_t count)
+{
+    uint8_t op[9];
+
+    if (!count) return GEKKO_OK;
+
+    op[0] = GEKKO_DELTA_OP_COPY;
+    gko_put32(op + 1, first);
+    gko_put32(op + 5, count);
+
+    return gko_delta_emit(out, op, 9);
+}
+/**********************************************************************************************************************
+    description:    Encode a file against basis signatures
+    arguments:      data:   new file content
+                    size:   new file size
+                    sig:    block signatures of the basis file
+                    write:  writer
+                    ctx:    writer context
+                    stats:  statistics to store, may be NULL
+    return:         error code
+**********************************************************************************************************************/
+int gko_delta_encode(const uint8_t *data, size_t size, const GKO_SIGNATURE *sig,
+                     GKO_WRITER write, void *ctx, GKO_DELTA_STATS *stats)
+{
+    GKO_DELTA_OUT       out;
+    GKO_DELTA_STATS     local;
+    uint32_t           *head    = NULL;
+    uint32_t           *next    = NULL;
+    uint32_t            full    = 0;
+    uint32_t            bits    = 1;
+    uint32_t            block   = sig->block;
+    uint32_t            weak    = 0;
+    uint32_t            a = 0, b = 0;
+    uint32_t            first   = 0;
+    uint32_t            count   = 0;
+    uint32_t            k       = GEKKO_DELTA_NONE;
+    uint32_t            slot    = 0;
+    uint64_t            strong  = 0;
+    bool                hashed  = false;
+    size_t              pos     = 0;
+    size_t              lit     = 0;
+    uint8_t             op[12];
+    int                 ret     = GEKKO_ERROR;
+
+    if (!stats) stats = &local;
+    memset(stats, 0, sizeof(GKO_DELTA_STATS));
+
+    memset(&out, 0, sizeof(out));
+    out.write  = write;
+    out.ctx    = ctx;
+    out.buffer = (uint8_t *)malloc(GEKKO_DELTA_IO_BUFFER);
+    if (!out.buffer) return GEKKO_ERROR;
+
+    // only whole blocks take part in matching, a short tail block is resent as literal
+    full = (uint32_t)(sig->size / block);
+    while ((1U << bits) < full * 2 && bits < 31) bits++;
+
+    if (full) {
+        head = (uint32_t *)malloc(((size_t)1 << bits) * sizeof(uint32_t));
+        next = (uint32_t *)malloc(full * sizeof(uint32_t));
+        if (!head || !next) goto __error_malloc;
+
+        memset(head, 0xFF, ((size_t)1 << bits) * sizeof(uint32_t));
+        for (k = full; k-- > 0; ) {
+            slot = (sig->weak[k] * 2654435761U) >> (32 - bits);
+            next[k] = head[slot];
+            head[slot] = k;
+        }
+    }
+
+    memcpy(op, GEKKO_DELTA_MAGIC, 4);
+    gko_put32(op + 4, block);
+    if (gko_delta_emit(&out, op, 8) != GEKKO_OK) goto __error_malloc;
+
+    if (full && size >= block) weak = gko_delta_weak(data, block, &a, &b);
+
+    while (full && pos + block <= size) {
+        hashed = false;
+
+        // prefer the block right after the previous match, that keeps copies coalesced
+        k = (count && first + count < full) ? first + count : GEKKO_DELTA_NONE;
+        if (k != GEKKO_DELTA_NONE && sig->weak[k] == weak) {
+            strong = gko_hash(data + pos, block);
+            hashed = true;
+            if (sig->strong[k] != strong) k = GEKKO_DELTA_NONE;
+        } else {
+            k = GEKKO_DELTA_NONE;
+        }
+
+        if (k == GEKKO_DELTA_NONE) {
+            slot = (weak * 2654435761U) >> (32 - bits);
+            for (k = head[slot]; k != GEKKO_DELTA_NONE; k = next[k]) {
+                if (sig->weak[k] != weak) continue;
+                if (!hashed) {
+                    strong = gko_hash(data + pos, block);
+                    hashed = true;
+                }
+                if (sig->strong[k] == strong) break;
+            }
+        }
+
+        if (k != GEKKO_DELTA_NONE) {
+            if (pos > lit) {
+                if (gko_delta_copy(&out, first, count) != GEKKO_OK) goto __error_malloc;
+                count = 0;
+                if (gko_delta_literal(&out, data + lit, pos - lit, stats) != GEKKO_OK) goto __error_malloc;
+            }
+
+            if (count && k == first + count) {
+                count++;
+            } else {
+                if (gko_delta_copy(&out, first, count) != GEKKO_OK) goto __error_malloc;
+                first = k;
+                count = 1;
+            }
+
+            stats->matched += block;
+            pos += block;
+            lit = pos;
+            if (pos + block <= size) weak = gko_delta_weak(data + pos, block, &a, &b);
+            continue;
+        }
+
+        if (pos + block < size) {
+            a = a - data[pos] + data[pos + block];
+            b = b - block * (uint32_t)data[pos] + a;
+            weak = (a & 0xFFFF) | (b << 16);
+        }
+        pos++;
+    }
+
+    if (gko_delta_copy(&out, first, count) != GEKKO_OK) goto __error_malloc;
+    if (gko_delta_literal(&out, data + lit, size - lit, stats) != GEKKO_OK) goto __error_malloc;
+
+    op[0] = GEKKO_DELTA_OP_END;
+    gko_put64(op + 1, gko_hash(data, size));
+    if (gko_delta_emit(&out, op, 9) != GEKKO_OK) goto __error_malloc;
+
+    ret = gko_delta_flush(&out);
+    stats->wire = out.total;
+
+__error_malloc:
+    free(head);
+    free(next);
+    free(out.buffer);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Rebuild a file from its basis and a delta stream
+    arguments:      basefd: basis file
+                    read:   delta reader
+                    ctx:    reader context
+                    outfd:  file to write
+    return:         error code
+**********************************************************************************************************************/
+int gko_delta_patch(int basefd, GKO_READER read, void *ctx, int outfd)
+{
+    GKO_HASH    state;
+    uint8_t    *buffer  = NULL;
+    uint8_t     op[9];
+    uint32_t    block   = 0;
+    uint64_t    offset  = 0;
+    uint64_t    len     = 0;
+    size_t      n       = 0;
+    ssize_t     got     = 0;
+    int         ret     = GEKKO_ERROR;
+
+    buffer = (uint8_t *)malloc(GEKKO_DELTA_IO_BUFFER);
+    if (!buffer) return GEKKO_ERROR;
+
+    if (gko_delta_read_full(read, ctx, op, 8) != GEKKO_OK) goto __error;
+    if (memcmp(op, GEKKO_DELTA_MAGIC, 4) != GEKKO_OK) goto __error;
+    block = gko_get32(op + 4);
+    if (!block) goto __error;
+
+    gko_hash_init(&state);
+
+    for (;;) {
+        if (gko_delta_read_full(read, ctx, op, 1) != GEKKO_OK) goto __error;
+
+        if (op[0] == GEKKO_DELTA_OP_END) {
+            if (gko_delta_read_full(read, ctx, op + 1, 8) != GEKKO_OK) goto __error;
+            if (gko_hash_final(&state) == gko_get64(op + 1)) ret = GEKKO_OK;
+            break;
+
+        } else if (op[0] == GEKKO_DELTA_OP_LITERAL) {
+            if (gko_delta_read_full(read, ctx, op + 1, 4) != GEKKO_OK) goto __error;
+            len = gko_get32(op + 1);
+            if (len > GEKKO_DELTA_IO_BUFFER) goto __error;
+            if (gko_delta_read_full(read, ctx, buffer, (size_t)len) != GEKKO_OK) goto __error;
+            if (write(outfd, buffer, (size_t)len) != (ssize_t)len) goto __error;
+            gko_hash_update(&state, buffer, (size_t)len);
+
+        } else if (op[0] == GEKKO_DELTA_OP_COPY) {
+            if (gko_delta_read_full(read, ctx, op + 1, 8) != GEKKO_OK) goto __error;
+            offset = (uint64_t)gko_get32(op + 1) * block;
+            len = (uint64_t)gko_get32(op + 5) * block;
+
+            while (len) {
+                n = (len > GEKKO_DELTA_IO_BUFFER) ? GEKKO_DELTA_IO_BUFFER : (size_t)len;
+                got = pread(basefd, buffer, n, (off_t)offset);
+                if (got <= 0) goto __error;
+                if (write(outfd, buffer, (size_t)got) != got) goto __error;
+                gko_hash_update(&state, buffer, (size_t)got);
+                offset += (uint64_t)got;
+                len -= (uint64_t)got;
+            }
+
+        } else {
+            goto __error;
+        }
+    }
+
+__error:
+    free(buffer);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
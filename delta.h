@@ -0,0 +1,66 @@
+/**********************************************************************************************************************
+    file:           delta.h
+    description:    Rolling checksum delta encoding of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_DELTA_H
+#define __GEKKO_DELTA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+/**********************************************************************************************************************
+    delta defaults
+**********************************************************************************************************************/
+#define GEKKO_DELTA_SIG_MAGIC           "GKS1"
+#define GEKKO_DELTA_MAGIC               "GKD1"
+#define GEKKO_DELTA_BLOCK_MIN           (2048)
+#define GEKKO_DELTA_BLOCK_MAX           (131072)
+#define GEKKO_DELTA_MIN_SIZE            (65536)
+#define GEKKO_DELTA_LITERAL_MAX         (65536)
+/**********************************************************************************************************************
+    delta stream opcodes
+**********************************************************************************************************************/
+#define GEKKO_DELTA_OP_LITERAL          'L'         // u32 length, then literal bytes
+#define GEKKO_DELTA_OP_COPY             'C'         // u32 first block, u32 block count of the basis file
+#define GEKKO_DELTA_OP_END              'E'         // u64 content hash of the rebuilt file
+/**********************************************************************************************************************
+    stream callbacks, readers return bytes read, 0 on end of stream and negative on error
+**********************************************************************************************************************/
+typedef int     (*GKO_WRITER)(void *ctx, const void *data, size_t len);
+typedef ssize_t (*GKO_READER)(void *ctx, void *data, size_t len);
+/**********************************************************************************************************************
+    block signatures of a basis file
+**********************************************************************************************************************/
+typedef struct {
+    uint32_t        block;
+    uint32_t        count;
+    uint64_t        size;
+    uint32_t       *weak;
+    uint64_t       *strong;
+} GKO_SIGNATURE;
+/**********************************************************************************************************************
+    delta statistics
+**********************************************************************************************************************/
+typedef struct {
+    uint64_t        literal;
+    uint64_t        matched;
+    uint64_t        wire;
+} GKO_DELTA_STATS;
+/**********************************************************************************************************************
+    delta functions
+**********************************************************************************************************************/
+uint32_t gko_delta_block_size(uint64_t size);
+int      gko_delta_read_full(GKO_READER read, void *ctx, void *data, size_t len);
+int      gko_delta_signature(int fd, uint32_t block, GKO_WRITER write, void *ctx);
+int      gko_delta_signature_read(GKO_READER read, void *ctx, GKO_SIGNATURE *sig);
+void     gko_delta_signature_free(GKO_SIGNATURE *sig);
+int      gko_delta_encode(const uint8_t *data, size_t size, const GKO_SIGNATURE *sig,
+                          GKO_WRITER write, void *ctx, GKO_DELTA_STATS *stats);
+int      gko_delta_patch(int basefd, GKO_READER read, void *ctx, int outfd);
+
+#endif  // __GEKKO_DELTA_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,349 @@
+/**********************************************************************************************************************
+    file:           fanout.c
+    description:    Shared file buffers of a multi-host push
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "gekko.h"
+#include "fanout.h"
+/**********************************************************************************************************************
+    description:    Set up shared buffers over a scan, hosts register the files they push with gko_fanout_want()
+    arguments:      fo:     fanout to set up, release with gko_fanout_free()
+                    rootfd: local sync root
+                    scan:   scan every host's dirty list was taken from
+                    hosts:  number of hosts, at most GEKKO_FANOUT_HOSTS_MAX
+                    limit:  buffer bytes held at once, 0 for the default
+    return:         error code
+**********************************************************************************************************************/
+int gko_fanout_init(GKO_FANOUT *fo, int rootfd, const GKO_SCAN *scan, int hosts, size_t limit)
+{
+    if (!fo) return GEKKO_ERROR;
+    if (!scan) return GEKKO_ERROR;
+    if (hosts <= 0 || hosts > GEKKO_FANOUT_HOSTS_MAX) return GEKKO_ERROR;
+
+    memset(fo, 0, sizeof(GKO_FANOUT));
+    fo->scan   = scan;
+    fo->rootfd = rootfd;
+    fo->hosts  = hosts;
+    fo->limit  = (limit) ? limit : GEKKO_FANOUT_BYTES;
+
+    fo->position = (size_t *)zalloc((scan->count + 1) * sizeof(size_t));
+    if (!fo->position) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    pthread_mutex_init(&fo->lock, NULL);
+    pthread_cond_init(&fo->cond, NULL);
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Index of an entry in the shared scan, host lists hold copies of its entries
+    arguments:      fo:     fanout
+                    entry:  entry of the shared scan or a copy of one
+    return:         scan index, scan->count if not found
+**********************************************************************************************************************/
+static size_t gko_fanout_index(const GKO_FANOUT *fo, const GKO_ENTRY *entry)
+{
+    const GKO_SCAN *scan    = fo->scan;
+    size_t          lo      = 0;
+    size_t          hi      = scan->count;
+    size_t          mid     = 0;
+    int             cmp     = 0;
+
+    if (entry >= scan->entries && entry < scan->entries + scan->count) return (size_t)(entry - scan->entries);
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        cmp = (scan->entries[mid].path == entry->path) ? 0 : strcmp(scan->entries[mid].path, entry->path);
+        if (cmp == 0) return mid;
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return scan->count;
+}
+/**********************************************************************************************************************
+    description:    Register the files one host pushes, small regular files get a shared buffer
+    arguments:      fo:     fanout
+                    host:   host number
+                    dirty:  copies of the shared scan entries flagged for the host, dirty ones are pushed
+    return:         error code
+**********************************************************************************************************************/
+int gko_fanout_want(GKO_FANOUT *fo, int host, const GKO_SCAN *dirty)
+{
+    GKO_FANOUT_ITEM    *grown   = NULL;
+    const GKO_ENTRY    *entry   = NULL;
+    size_t              index   = 0;
+    size_t              i       = 0;
+
+    if (!fo) return GEKKO_ERROR;
+    if (!dirty) return GEKKO_ERROR;
+    if (host < 0 || host >= fo->hosts) return GEKKO_ERROR;
+
+    for (i = 0; i < dirty->count; i++) {
+        entry = &dirty->entries[i];
+        if (!(entry->flags & GKO_ENTRY_DIRTY)) continue;
+        if (!S_ISREG(entry->mode) || !entry->size || entry->size > GEKKO_FANOUT_FILE_MAX) continue;
+
+        index = gko_fanout_index(fo, entry);
+        if (index == fo->scan->count) continue;
+
+        if (!fo->position[index]) {
+            if (fo->count == fo->capacity) {
+                fo->capacity = (fo->capacity) ? fo->capacity * 2 : 1024;
+                grown = (GKO_FANOUT_ITEM *)realloc(fo->items, fo->capacity * sizeof(GKO_FANOUT_ITEM));
+                if (!grown) {
+                    fprintf(stderr, "Insufficient memory.\n");
+                    return GEKKO_ERROR;
+                }
+                fo->items = grown;
+            }
+
+            memset(&fo->items[fo->count], 0, sizeof(GKO_FANOUT_ITEM));
+            fo->items[fo->count].entry  = index;
+            fo->items[fo->count].length = (size_t)entry->size;
+            fo->position[index] = ++fo->count;
+        }
+
+        fo->items[fo->position[index] - 1].pending |= (1ULL << host);
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Count a session that may wait for buffer space, call gko_fanout_leave() when it is done
+    arguments:      fo:     fanout, may be NULL
+    return:         -
+**********************************************************************************************************************/
+void gko_fanout_join(GKO_FANOUT *fo)
+{
+    if (!fo) return;
+
+    pthread_mutex_lock(&fo->lock);
+    fo->running++;
+    pthread_mutex_unlock(&fo->lock);
+}
+/**********************************************************************************************************************
+    description:    Uncount a session, the ones left waiting check whether they are the last ones running
+    arguments:      fo:     fanout, may be NULL
+    return:         -
+**********************************************************************************************************************/
+void gko_fanout_leave(GKO_FANOUT *fo)
+{
+    if (!fo) return;
+
+    pthread_mutex_lock(&fo->lock);
+    fo->running--;
+    pthread_cond_broadcast(&fo->cond);
+    pthread_mutex_unlock(&fo->lock);
+}
+/**********************************************************************************************************************
+    description:    Free the buffer of an item no host needs any more, called locked
+    arguments:      fo:     fanout
+                    item:   item
+    return:         -
+**********************************************************************************************************************/
+static void gko_fanout_drop(GKO_FANOUT *fo, GKO_FANOUT_ITEM *item)
+{
+    if (item->pending || item->using || !item->buffer) return;
+
+    free(item->buffer);
+    item->buffer = NULL;
+    fo->bytes -= item->length;
+    pthread_cond_broadcast(&fo->cond);
+}
+/**********************************************************************************************************************
+    description:    Read a whole file into a new buffer
+    arguments:      rootfd: local sync root
+                    path:   path relative to the root
+                    length: expected size
+    return:         buffer, NULL if the file cannot be read or changed size
+**********************************************************************************************************************/
+static uint8_t *gko_fanout_read(int rootfd, const char *path, size_t length)
+{
+    uint8_t    *buffer  = NULL;
+    size_t      done    = 0;
+    ssize_t     n       = 0;
+    int         fd      = -1;
+
+    fd = openat(rootfd, path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    buffer = (uint8_t *)malloc(length);
+    while (buffer && done < length) {
+        n = pread(fd, buffer + done, length - done, (off_t)done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    close(fd);
+
+    if (done != length) {
+        free(buffer);
+        return NULL;
+    }
+
+    return buffer;
+}
+/**********************************************************************************************************************
+    description:    Take the shared buffer of a file, reading it on the first take. A session over the byte limit
+                    waits until slower hosts release what they hold, unless every other session is waiting too;
+                    that one reads the file itself instead and memory stays bounded.
+    arguments:      fo:     fanout, may be NULL
+                    host:   host number
+                    entry:  entry being sent
+                    wait:   block for space or a read in progress, an event loop passes false
+                    data:   file contents to store
+                    length: file size to store
+    return:         true if served from a buffer, release it with gko_fanout_release()
+**********************************************************************************************************************/
+bool gko_fanout_take(GKO_FANOUT *fo, int host, const GKO_ENTRY *entry, bool wait, const uint8_t **data,
+                     size_t *length)
+{
+    GKO_FANOUT_ITEM    *item    = NULL;
+    uint8_t            *buffer  = NULL;
+    size_t              index   = 0;
+    bool                served  = false;
+
+    if (!fo || !entry || !data || !length) return false;
+
+    index = gko_fanout_index(fo, entry);
+    if (index == fo->scan->count || !fo->position[index]) return false;
+
+    pthread_mutex_lock(&fo->lock);
+    item = &fo->items[fo->position[index] - 1];
+
+    while (!served && (item->pending & (1ULL << host)) && !item->failed) {
+        if (item->buffer) {
+            item->using |= (1ULL << host);
+            *data = item->buffer;
+            *length = item->length;
+            fo->shared++;
+            served = true;
+            break;
+        }
+
+        if (item->loading) {
+            if (!wait) break;
+            pthread_cond_wait(&fo->cond, &fo->lock);
+            continue;
+        }
+
+        if (fo->bytes + item->length > fo->limit) {
+            if (!wait || fo->waiting + 1 >= fo->running) {
+                fo->bypassed++;
+                break;
+            }
+            fo->waiting++;
+            pthread_cond_wait(&fo->cond, &fo->lock);
+            fo->waiting--;
+            continue;
+        }
+
+        // the read happens unlocked, other hosts wanting the file wait for it rather than read it again
+        item->loading = true;
+        fo->bytes += item->length;
+        if (fo->bytes > fo->peak) fo->peak = fo->bytes;
+        pthread_mutex_unlock(&fo->lock);
+
+        buffer = gko_fanout_read(fo->rootfd, entry->path, item->length);
+
+        pthread_mutex_lock(&fo->lock);
+        item->loading = false;
+        if (buffer) {
+            item->buffer = buffer;
+            fo->reads++;
+            fo->read_bytes += item->length;
+        } else {
+            item->failed = true;
+            fo->bytes -= item->length;
+        }
+        pthread_cond_broadcast(&fo->cond);
+    }
+
+    pthread_mutex_unlock(&fo->lock);
+
+    return served;
+}
+/**********************************************************************************************************************
+    description:    Mark a file done for a host, whichever way it was sent, and free its buffer after the last host
+    arguments:      fo:     fanout, may be NULL
+                    host:   host number
+                    entry:  entry sent
+    return:         -
+**********************************************************************************************************************/
+void gko_fanout_release(GKO_FANOUT *fo, int host, const GKO_ENTRY *entry)
+{
+    GKO_FANOUT_ITEM    *item    = NULL;
+    size_t              index   = 0;
+
+    if (!fo || !entry) return;
+
+    index = gko_fanout_index(fo, entry);
+    if (index == fo->scan->count || !fo->position[index]) return;
+
+    pthread_mutex_lock(&fo->lock);
+    item = &fo->items[fo->position[index] - 1];
+    item->pending &= ~(1ULL << host);
+    item->using &= ~(1ULL << host);
+    gko_fanout_drop(fo, item);
+    pthread_mutex_unlock(&fo->lock);
+}
+/**********************************************************************************************************************
+    description:    Mark every file of a host done, files it sent another way or not at all stop holding buffers
+    arguments:      fo:     fanout, may be NULL
+                    host:   host number
+    return:         -
+**********************************************************************************************************************/
+void gko_fanout_done(GKO_FANOUT *fo, int host)
+{
+    size_t  i   = 0;
+
+    if (!fo) return;
+
+    pthread_mutex_lock(&fo->lock);
+    for (i = 0; i < fo->count; i++) {
+        fo->items[i].pending &= ~(1ULL << host);
+        fo->items[i].using &= ~(1ULL << host);
+        gko_fanout_drop(fo, &fo->items[i]);
+    }
+    pthread_cond_broadcast(&fo->cond);
+    pthread_mutex_unlock(&fo->lock);
+}
+/**********************************************************************************************************************
+    description:    Release shared buffers
+    arguments:      fo:     fanout
+    return:         -
+**********************************************************************************************************************/
+void gko_fanout_free(GKO_FANOUT *fo)
+{
+    size_t  i   = 0;
+
+    if (!fo) return;
+
+    for (i = 0; i < fo->count; i++) free(fo->items[i].buffer);
+    free(fo->items);
+    free(fo->position);
+    pthread_mutex_destroy(&fo->lock);
+    pthread_cond_destroy(&fo->cond);
+    memset(fo, 0, sizeof(GKO_FANOUT));
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
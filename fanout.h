@@ -0,0 +1,75 @@
+/**********************************************************************************************************************
+    file:           fanout.h
+    description:    Shared file buffers of a multi-host push
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_FANOUT_H
+#define __GEKKO_FANOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "gekko.h"
+#include "scan.h"
+/**********************************************************************************************************************
+    fanout defaults
+**********************************************************************************************************************/
+#define GEKKO_FANOUT_HOSTS_MAX          (64)        // one bit per host in every item
+#define GEKKO_FANOUT_BYTES              (256 << 20) // buffers held at once, a session over it waits for the others
+#define GEKKO_FANOUT_FILE_MAX           (16 << 20)  // larger files are mapped, every host reads the page cache
+#define GEKKO_FANOUT_SEP                ","         // between grip names on the command line
+/**********************************************************************************************************************
+    one file some hosts still have to send
+**********************************************************************************************************************/
+typedef struct {
+    size_t              entry;          // index into the shared scan
+    uint8_t            *buffer;
+    size_t              length;
+    uint64_t            pending;        // hosts that have not finished the file
+    uint64_t            using;          // hosts sending from the buffer right now
+    bool                loading;
+    bool                failed;
+} GKO_FANOUT_ITEM;
+/**********************************************************************************************************************
+    files read once and sent to every host that needs them
+**********************************************************************************************************************/
+typedef struct {
+    const GKO_SCAN     *scan;
+    int                 rootfd;
+    int                 hosts;
+    GKO_FANOUT_ITEM    *items;
+    size_t              count;
+    size_t              capacity;
+    size_t             *position;       // item + 1 of every scan entry, 0 when no host wants it
+    size_t              bytes;          // buffer bytes held
+    size_t              limit;
+    size_t              peak;
+    int                 running;        // sessions that may wait
+    int                 waiting;
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    uint64_t            reads;          // files read into a buffer
+    uint64_t            read_bytes;
+    uint64_t            shared;         // sends served from a buffer
+    uint64_t            bypassed;       // sends that read the file themselves to keep memory bounded
+} GKO_FANOUT;
+/**********************************************************************************************************************
+    fanout functions
+**********************************************************************************************************************/
+int  gko_fanout_init(GKO_FANOUT *fo, int rootfd, const GKO_SCAN *scan, int hosts, size_t limit);
+int  gko_fanout_want(GKO_FANOUT *fo, int host, const GKO_SCAN *dirty);
+void gko_fanout_join(GKO_FANOUT *fo);
+void gko_fanout_leave(GKO_FANOUT *fo);
+bool gko_fanout_take(GKO_FANOUT *fo, int host, const GKO_ENTRY *entry, bool wait, const uint8_t **data,
+                     size_t *length);
+void gko_fanout_release(GKO_FANOUT *fo, int host, const GKO_ENTRY *entry);
+void gko_fanout_done(GKO_FANOUT *fo, int host);
+void gko_fanout_free(GKO_FANOUT *fo);
+
+#endif  // __GEKKO_FANOUT_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
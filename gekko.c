@@ -11,48 +11,72 @@
 #include <unistd.h>
 #include <limits.h>
 #include <dirent.h>
+#include <fnmatch.h>
+#include <fcntl.h>
 #include <stdbool.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "gekko.h"
-#include "jsmn.h"
-#include <libssh2.h>
-#include <libssh2_sftp.h>
-#include <libssh2_publickey.h>
-
-#ifdef DARWIN
-#include <sys/socket.h>
-#include <arpa/inet.h>
-#endif
-
-#ifdef WINDOWS
-#include <winsock.h>
-#endif
-
-#ifdef LINUX
-#include <sys/socket.h>
-#include <arpa/inet.h>
-#endif
+#include "scan.h"
+#include "hash.h"
+#include "index.h"
+#include "delta.h"
+#include "sync.h"
+#include "watch.h"
+#include "ignore.h"
+#include "snapshot.h"
+#include "compress.h"
+#include "agent.h"
+#include "rate.h"
+#include "schedule.h"
+#include "source.h"
+#include "prefetch.h"
+#include "config.h"
+#include "registry.h"
+#include "fanout.h"
+#include "relay.h"
+#include "plan.h"
 /**********************************************************************************************************************
-    global variables
+    camouflage defaults
 **********************************************************************************************************************/
-static int                  sock        = -1;
-static char                *grips_dir   = NULL;
-static LIBSSH2_SESSION     *session     = NULL;
-static LIBSSH2_CHANNEL     *channel     = NULL;
+#define GEKKO_CAMO_BENCH_RULES          (4000)      // generated rules of the large benchmark set
 /**********************************************************************************************************************
-    useful macros
+    one host of a fan-out run
 **********************************************************************************************************************/
-#define gko_error_return(prompt)                    \
-    if (ret != GEKKO_OK) {                          \
-        fprintf(stderr, prompt " (%d).\n", ret);    \
-        return GEKKO_ERROR;                         \
-    }
+typedef struct {
+    GRIP                grip;
+    const char         *name;
+    const char         *remote;
+    char                idx[PATH_MAX];
+    char                snap[PATH_MAX];
+    GKO_SCAN            scan;               // own copy of the entries, flags and known hashes differ per host
+    GKO_INDEX           index;
+    GKO_INDEX           snapshot;
+    size_t             *deleted;
+    size_t              deleted_count;
+    size_t              dirty;
+    int                 rootfd;
+    int                 number;
+    GKO_FANOUT         *fanout;
+    pthread_t           thread;
+    bool                started;
+    bool                ready;
+    int                 ret;
+} GKO_RUN_HOST;
+/**********************************************************************************************************************
+    global variables
+**********************************************************************************************************************/
+static char                *grips_dir   = NULL;
 /**********************************************************************************************************************
     description:    allocate memory and clear
     arguments:      size:   allocate size
     return:         pointer to allocated memory
 **********************************************************************************************************************/
-static void *zalloc(size_t size)
+void *zalloc(size_t size)
 {
     void *memory = NULL;
 
@@ -64,30 +88,6 @@ static void *zalloc(size_t size)
 
     return memory;
 }
-/**********************************************************************************************************************
-    description:    windows specific strndup implementation
-    arguments:      str:    string
-                    chars:  max string length to duplicate
-    return:         duplicate string
-**********************************************************************************************************************/
-#ifdef WINDOWS
-static char *strndup(const char *str, size_t chars)
-{
-    char   *buffer;
-    int     n;
-
-    buffer = (char *)zalloc(chars + 1);
-    if (buffer) {
-        for (n = 0; ((n < chars) && (str[n] != 0)); n++) {
-            buffer[n] = str[n];
-        }
-
-        buffer[n] = 0;
-    }
-
-    return buffer;
-}
-#endif
 /**********************************************************************************************************************
     description:    Check if file exists
     arguments:      path:   file path
@@ -123,104 +123,17 @@ static bool gko_dir_exists(const char *path)
     return true;
 }
 /**********************************************************************************************************************
-    description:    Create instance
-    arguments:      grip:   grip instance
-    return:         error code
-**********************************************************************************************************************/
-static int gko_instance_create(GRIP *grip)
-{
-    struct sockaddr_in  sin;
-    int                 ret             = GEKKO_ERROR;
-    int                 auth_method     = 0;
-    const char         *fingerprint     = NULL;
-    char               *user_auth_list  = NULL;
-
-#ifdef GEKKO_DEBUG
-    int                 i;
-#endif
-
-    if (!grip) return GEKKO_ERROR;
-
-    ret = libssh2_init(0);
-    gko_error_return("libssh2 initialization failed");
-
-    sock = socket(AF_INET, SOCK_STREAM, 0);
-    gko_error_return("Socket creation failed");
-
-    sin.sin_family      = AF_INET;
-    sin.sin_port        = htons(grip->port);
-    sin.sin_addr.s_addr = inet_addr(grip->host);    // TODO: support IP and hostname
-    ret = connect(sock, (struct sockaddr*)&sin, sizeof(struct sockaddr_in));
-    gko_error_return("Socket connection failed");
-
-    session = libssh2_session_init();
-    ret = libssh2_session_handshake(session, sock);
-    gko_error_return("Cannot establish SSH session");
-
-    // check if fingerprint matches the saved ones
-    fingerprint = libssh2_hostkey_hash(session, LIBSSH2_HOSTKEY_HASH_SHA1);
-
-#ifdef GEKKO_DEBUG
-    printf("The fingerprint is: ");
-    for (i = 0; i < 20; i++) {
-        printf("%02x", (uint8_t)fingerprint[i]);
-    }
-    printf("\n");
-#endif
-
-    // TODO: check if fingerprint matches the saved ones
-
-    // check what authentication methods are available
-    user_auth_list = libssh2_userauth_list(session, grip->user, strlen(grip->user));
-
-#ifdef GEKKO_DEBUG
-    printf("Authentication methods: %s\n", user_auth_list);
-#endif
-
-    if (strstr(user_auth_list, "password")) {
-        auth_method |= AUTH_METHOD_PASSWORD;
-    }
-    if (strstr(user_auth_list, "keyboard-interactive")) {
-        auth_method |= AUTH_METHOD_KEYBOARD_INTERACTIVE;
-    }
-    if (strstr(user_auth_list, "publickey")) {
-        auth_method |= AUTH_METHOD_PUBLIC_KEY;
-    }
-
-    if (auth_method & AUTH_METHOD_PASSWORD) {
-        ret = libssh2_userauth_password(session, grip->user, grip->pass);
-        gko_error_return("Authentication failed: password");
-        printf("Authentication succeeded: password\n");
-
-    } else if (auth_method & AUTH_METHOD_KEYBOARD_INTERACTIVE) {
-        // TODO
-    } else if (auth_method & AUTH_METHOD_PUBLIC_KEY) {
-        // TODO
-    } else {
-        fprintf(stderr, "No supported authentication methods found.\n");
-        goto __error_no_auth;
-    }
-
-    return GEKKO_OK;
-
-__error_no_auth:
-    libssh2_session_disconnect(session, "Super Gekko Camouflage");
-    libssh2_session_free(session);
-    close(sock);
-
-    return GEKKO_ERROR;
-}
-/**********************************************************************************************************************
-    description:    Destroy instance
-    arguments:      -
-    return:         -
+    configuration file keys
 **********************************************************************************************************************/
-static void gko_instance_destroy(void)
-{
-    libssh2_session_disconnect(session, "Super Gekko Camouflage");
-    libssh2_session_free(session);
-    close(sock);
-}
+typedef struct {
+    char    debug[NAME_MAX];
+    char    grip_directory[PATH_MAX];
+} GKO_SETTINGS;
+
+static const GKO_CONFIG_FIELD gko_settings_fields[] = {
+    GKO_CONFIG_BIND("debug",            GKO_CONFIG_STRING,  GKO_SETTINGS,   debug),
+    GKO_CONFIG_BIND("grip_directory",   GKO_CONFIG_STRING,  GKO_SETTINGS,   grip_directory),
+};
 /**********************************************************************************************************************
     description:    Read configuration file
     arguments:      path:   configuration file path
@@ -228,272 +141,175 @@ static void gko_instance_destroy(void)
 **********************************************************************************************************************/
 static int gko_read_config(const char *path)
 {
-    char           *json            = NULL;
-    char           *value           = NULL;
-    char           *temp            = NULL;
-    FILE           *file            = NULL;
-    bool            error           = false;
-    size_t          file_length     = 0;
-    size_t          file_read       = 0;
-    int             count           = 0;
-    int             i               = 0;
-    jsmn_parser     p;
-    jsmntok_t       t[TOKEN_MAX];
+    GKO_SETTINGS    settings    = {0};
+    char           *temp        = NULL;
 
     if (!path) return GEKKO_ERROR;
 
-    file = fopen(path, "r");
-    if (!file) {
-        fprintf(stderr, "Cannot open file %s.\n", path);
+    if (gko_config_load(path, gko_settings_fields, sizeof(gko_settings_fields) / sizeof(gko_settings_fields[0]),
+                        &settings, true) != GEKKO_OK) {
         return GEKKO_ERROR;
     }
 
-    fseek(file, 0, SEEK_END);
-    file_length = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    json = (char *)zalloc(file_length);
-    if (!json) {
-        fprintf(stderr, "Insufficient memory.\n");
-        error = true;
-        goto __error_json_malloc;
-    }
-
-    file_read = fread(json, 1, file_length, file);
-
-    if (file_read != file_length) {
-        fprintf(stderr, "Failed to parse JSON %s (%d).\n", path, count);
-        error = true;
-        goto __error_file_read;
-    }
-
-    jsmn_init(&p);
-    count = jsmn_parse(&p, json, strlen(json), t, sizeof(t) / sizeof(t[0]));
-    if (count < 0) {
-        error = true;
-        goto __error_file_read;
-    }
-
-    if (count < 1 || t[0].type != JSMN_OBJECT) {
-        fprintf(stderr, "Invalid json file %s (%d).\n", path, count);
-        error = true;
-        goto __error_file_read;
+    if (!settings.grip_directory[0]) {
+        fprintf(stderr, "Grips directory is not specified.\n");
+        return GEKKO_ERROR;
     }
 
-    for (i = 1; i < count; i++) {
-        if (jsoneq(json, &t[i], "debug") == GEKKO_OK) {
-            value = strndup(json + t[i + 1].start, t[i + 1].end - t[i + 1].start);
-            printf("debug = %s\n", value);
-            i++;
-
-        } else if (jsoneq(json, &t[i], "grip_directory") == GEKKO_OK) {
-            value = strndup(json + t[i + 1].start, t[i + 1].end - t[i + 1].start);
-            printf("grip_directory = %s\n", value);
-
-            temp = value;
-            while (*temp++ != '\0') {
+    for (temp = settings.grip_directory; *temp != '\0'; temp++) {
 #ifdef WINDOWS
-                if (*temp == '/') *temp = '\\';
+        if (*temp == '/') *temp = '\\';
 #else
-                if (*temp == '\\') *temp = '/';
+        if (*temp == '\\') *temp = '/';
 #endif
-            }
+    }
 
-            grips_dir = (char *)zalloc(PATH_MAX);
-            if (!grips_dir) {
-                fprintf(stderr, "Insufficient memory.\n");
-                error = true;
-                goto __error_grips_dir_malloc;
-            }
+    grips_dir = (char *)zalloc(PATH_MAX);
+    if (!grips_dir) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
 
-            if (value[0] == '~') {
+    if (settings.grip_directory[0] == '~') {
 #ifdef WINDOWS
-                snprintf(grips_dir, PATH_MAX, "%s%s%s", getenv("HOMEDRIVE"),
-                         getenv("HOMEPATH"), &value[1]);
+        snprintf(grips_dir, PATH_MAX, "%s%s%s", getenv("HOMEDRIVE"),
+                 getenv("HOMEPATH"), &settings.grip_directory[1]);
 #else
-                snprintf(grips_dir, PATH_MAX, "%s%s", getenv("HOME"), &value[1]);
+        snprintf(grips_dir, PATH_MAX, "%s%s", getenv("HOME"), &settings.grip_directory[1]);
 #endif
-            }
-
-            i++;
-        }
-    }
-
-    if (!grips_dir) {
-        fprintf(stderr, "Grips directory is not specified.\n");
-        error = true;
-        goto __error_grips_dir_malloc;
+    } else {
+        snprintf(grips_dir, PATH_MAX, "%s", settings.grip_directory);
     }
 
     if (!gko_dir_exists(grips_dir)) {
         free(grips_dir);
         grips_dir = NULL;
         fprintf(stderr, "Grips directory does not exist.\n");
-        error = true;
+        return GEKKO_ERROR;
     }
 
-__error_grips_dir_malloc:
-    free(value);
-
-__error_file_read:
-    free(json);
-
-__error_json_malloc:
-    fclose(file);
-
-    return (error) ? GEKKO_ERROR : GEKKO_OK;
+    return GEKKO_OK;
 }
 /**********************************************************************************************************************
-    description:    Read configuration file
-    arguments:      name:   grip name
-                    grip:   grip instance to store
+    description:    Read default configuration file
+    arguments:      -
     return:         error code
 **********************************************************************************************************************/
-static int gko_read_grip(const char *name, GRIP *grip)
-{
-    DIR            *dir                 = NULL;
-    struct dirent  *ent                 = NULL;
-    char           *grip_path           = NULL;
-    char            filename[NAME_MAX]  = {0};
-    bool            error               = false;
-    char           *json                = NULL;
-    char           *value               = NULL;
-    FILE           *file                = NULL;
-    size_t          file_length         = 0;
-    size_t          file_read           = 0;
-    int             count               = 0;
-    int             i                   = 0;
-    jsmn_parser     p;
-    jsmntok_t       t[TOKEN_MAX];
-
-    if (!name) return GEKKO_ERROR;
-    if (!grip) return GEKKO_ERROR;
-    if (!grips_dir) return GEKKO_ERROR;
-
-    dir = opendir(grips_dir);
-    if (!dir) {
-        fprintf(stderr, "Cannot open directory: %s.\n", grips_dir);
-        return GEKKO_ERROR;
-    }
-
-    snprintf(filename, NAME_MAX, "%s.json", name);
+static int gko_load_config(void)
+{
+    char    config[PATH_MAX]    = {0};
 
-    while ((ent = readdir(dir))) {
-#ifndef WINDOWS
-        if (ent->d_type != DT_REG) continue;
+#ifdef WINDOWS
+    snprintf(config, PATH_MAX, "%s%s%s", getenv("HOMEDRIVE"),
+             getenv("HOMEPATH"), GEKKO_DEFAULT_CONFIG);
+#else
+    snprintf(config, PATH_MAX, "%s%s", getenv("HOME"), GEKKO_DEFAULT_CONFIG);
 #endif
-        if (strcmp(filename, ent->d_name) != GEKKO_OK) continue;
-
-        grip_path = (char *)zalloc(PATH_MAX);
-        if (!grip_path) {
-            fprintf(stderr, "Insufficient memory.\n");
-            closedir(dir);
-            return GEKKO_ERROR;
-        }
-        memset(grip_path, 0, PATH_MAX);
 
-        snprintf(grip_path, PATH_MAX, "%s%s%s", grips_dir, SEP, ent->d_name);
-        printf("grip_path: [%s]\n", grip_path);
-        break;
-    }
-
-    closedir(dir);
-
-    if (!grip_path) {
-        fprintf(stderr, "Grip \"%s\" cannot be found.\n", name);
+    if (!gko_file_exists(config)) {
+        fprintf(stderr, "Cannot access file %s.\n", config);
         return GEKKO_ERROR;
     }
 
-    file = fopen(grip_path, "r");
-    if (!file) {
-        fprintf(stderr, "Cannot open file %s.\n", grip_path);
-        error = true;
-        goto __error_grip_open;
+    if (gko_read_config(config) != GEKKO_OK) {
+        fprintf(stderr, "Cannot read configuration file %s.\n", config);
+        return GEKKO_ERROR;
     }
 
-    fseek(file, 0, SEEK_END);
-    file_length = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Read default configuration file and a grip
+    arguments:      name:   grip name
+                    grip:   grip instance to store
+    return:         error code
+**********************************************************************************************************************/
+static int gko_load_grip(const char *name, GRIP *grip)
+{
+    if (gko_load_config() != GEKKO_OK) return GEKKO_ERROR;
 
-    json = (char *)zalloc(file_length);
-    if (!json) {
-        fprintf(stderr, "Insufficient memory.\n");
-        error = true;
-        goto __error_json_malloc;
+    return gko_registry_lookup(grips_dir, name, grip);
+}
+/**********************************************************************************************************************
+    description:    Parse a connection string into a grip
+    arguments:      conn:   connection string, i.e. sftp://catboy@myserver.com:22
+                    grip:   grip instance to store host, user and port
+    return:         error code
+**********************************************************************************************************************/
+static int gko_parse_connection(const char *conn, GRIP *grip)
+{
+    const char *host    = NULL;
+    const char *at      = NULL;
+    const char *colon   = NULL;
+    const char *end     = NULL;
+    int         port    = 0;
+
+    if (strncmp(conn, "sftp://", 7) == GEKKO_OK) {
+        conn += 7;
+    } else if (strstr(conn, "://")) {
+        fprintf(stderr, "Unsupported connection: %s\n", conn);
+        return GEKKO_ERROR;
     }
 
-    file_read = fread(json, 1, file_length, file);
+    at = strchr(conn, '@');
+    host = (at) ? at + 1 : conn;
 
-    if (file_read != file_length) {
-        fprintf(stderr, "Failed to parse JSON %s (%d).\n", grip_path, count);
-        error = true;
-        goto __error_grip_read;
+    // [v6 address]:port keeps its colons inside the brackets
+    if (*host == '[') {
+        end = strchr(++host, ']');
+        if (!end) return GEKKO_ERROR;
+        colon = (end[1] == ':') ? end + 1 : NULL;
+    } else {
+        colon = strchr(host, ':');
+        end = (colon) ? colon : host + strlen(host);
     }
 
-    jsmn_init(&p);
-    count = jsmn_parse(&p, json, strlen(json), t, sizeof(t) / sizeof(t[0]));
-    if (count < 0) {
-        fprintf(stderr, "Failed to parse JSON %s (%d).\n", grip_path, count);
-        error = true;
-        goto __error_grip_read;
+    if (end == host || (size_t)(end - host) >= NAME_MAX) {
+        fprintf(stderr, "Invalid host in %s\n", conn);
+        return GEKKO_ERROR;
     }
 
-    if (count < 1 || t[0].type != JSMN_OBJECT) {
-        fprintf(stderr, "Invalid json file %s (%d).\n", grip_path, count);
-        error = true;
-        goto __error_grip_read;
-    }
-
-    for (i = 1; i < count; i++) {
-        if (jsoneq(json, &t[i], "host") == GEKKO_OK) {
-            value = strndup(json + t[i + 1].start, t[i + 1].end - t[i + 1].start);
-            printf("host = %s\n", value);
-            snprintf(grip->host, NAME_MAX, "%s", value);
-            i++;
-
-        } else if (jsoneq(json, &t[i], "port") == GEKKO_OK) {
-            value = strndup(json + t[i + 1].start, t[i + 1].end - t[i + 1].start);
-            printf("port = %s\n", value);
-            grip->port = (uint16_t)atoi(value);
-            i++;
-
-        } else if (jsoneq(json, &t[i], "user") == GEKKO_OK) {
-            value = strndup(json + t[i + 1].start, t[i + 1].end - t[i + 1].start);
-            printf("user = %s\n", value);
-            snprintf(grip->user, NAME_MAX, "%s", value);
-            i++;
-
-        } else if (jsoneq(json, &t[i], "auth") == GEKKO_OK) {
-            value = strndup(json + t[i + 1].start, t[i + 1].end - t[i + 1].start);
-            printf("auth = %s\n", value);
-
-            if (strcmp(value, "password") == GEKKO_OK) {
-                grip->auth = AUTH_METHOD_PASSWORD;
-            } else if (strcmp(value, "publickey") == GEKKO_OK) {
-                grip->auth = AUTH_METHOD_PUBLIC_KEY;
-            } else if (strcmp(value, "keyboard-interactive") == GEKKO_OK) {
-                grip->auth = AUTH_METHOD_KEYBOARD_INTERACTIVE;
-            } else {
-                fprintf(stderr, "Invalid authentication method: %s\n", value);
-                break;
-            }
-
-            i++;
+    if (colon) {
+        port = atoi(colon + 1);
+        if (port <= 0 || port > UINT16_MAX) {
+            fprintf(stderr, "Invalid port in %s\n", conn);
+            return GEKKO_ERROR;
         }
+        grip->port = (uint16_t)port;
+    } else if (!grip->port) {
+        grip->port = 22;
     }
 
-    free(value);
+    if (at) snprintf(grip->user, NAME_MAX, "%.*s", (int)(at - conn), conn);
+    snprintf(grip->host, NAME_MAX, "%.*s", (int)(end - host), host);
 
-__error_grip_read:
-    free(json);
-
-__error_json_malloc:
-    fclose(file);
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    File descriptor stream adapters
+    arguments:      ctx:    pointer to file descriptor
+                    data:   buffer
+                    len:    length
+    return:         error code / bytes read
+**********************************************************************************************************************/
+static int gko_fd_writer(void *ctx, const void *data, size_t len)
+{
+    const char *p   = (const char *)data;
+    ssize_t     n   = 0;
+
+    while (len) {
+        n = write(*(int *)ctx, p, len);
+        if (n <= 0) return GEKKO_ERROR;
+        p += n;
+        len -= (size_t)n;
+    }
 
-__error_grip_open:
-    free(grip_path);
+    return GEKKO_OK;
+}
 
-    return (error) ? GEKKO_ERROR : GEKKO_OK;
+static ssize_t gko_fd_reader(void *ctx, void *data, size_t len)
+{
+    return read(*(int *)ctx, data, len);
 }
 /**********************************************************************************************************************
     description:    Print general help
@@ -507,6 +323,12 @@ static void gko_help_main(void)
     printf("Commands:\n");
     printf("\tcamo\t\tspecify file or directory to ignore\n");
     printf("\tgrip\t\tadd a grip to remote host\n");
+    printf("\thash\t\tmeasure content hashing speed\n");
+    printf("\trate\t\tcheck the bandwidth limiter against a local throttled link\n");
+    printf("\tschedule\tsimulate transfer ordering policies over a file size distribution\n");
+    printf("\tsource\t\tcompare upload read strategies over a local file\n");
+    printf("\treadahead\tsend the small files of the current directory from a cold cache over a simulated link\n");
+    printf("\tagent\t\tkeep sessions open for later runs\n");
     printf("\trun\t\t\tstart synchronization\n\n");
 
     printf("Common usage:\n");
@@ -525,7 +347,14 @@ static void gko_help_main(void)
     printf("- Start synchronization:\n");
     printf("\tgekko run myserver /home/catboy/upload/ [-p password] [-k keyfile]\n");
     printf("- Check changes to apply:\n");
-    printf("\tgekko run -s myserver [-p password] [-k keyfile]\n\n");
+    printf("\tgekko run -s myserver /home/catboy/upload/ [-o plan] [-p password] [-k keyfile]\n");
+    printf("- Apply a plan exactly as it was shown:\n");
+    printf("\tgekko run --plan plan [-p password] [-k keyfile]\n\n");
+
+    printf("- Keep sessions warm for scripted runs:\n");
+    printf("\tgekko agent &\n");
+    printf("- Stop the agent:\n");
+    printf("\tgekko agent -k\n\n");
 }
 /**********************************************************************************************************************
     description:    Print camo help
@@ -534,10 +363,90 @@ static void gko_help_main(void)
 **********************************************************************************************************************/
 static void gko_help_camo(void)
 {
-    printf("Usage: gekko camo [-r] path\n\n");
+    printf("Usage: gekko camo [-r] path\n");
+    printf("       gekko camo -t path...\n");
+    printf("       gekko camo -b\n\n");
     printf("Arguments:\n");
     printf("\tpath\t\tadd file or directory to ignore\n");
     printf("\t-r\t\tremove path to ignore instead of adding\n");
+    printf("\t-t\t\ttell whether paths are ignored by the current rules\n");
+    printf("\t-b\t\tmeasure ignore matching speed over the current directory\n");
+}
+/**********************************************************************************************************************
+    description:    Print hash help
+    arguments:      -
+    return:         -
+**********************************************************************************************************************/
+static void gko_help_hash(void)
+{
+    printf("Usage: gekko hash [-j threads]\n");
+    printf("       gekko hash -b\n\n");
+    printf("Arguments:\n");
+    printf("\t-j threads\thash every file of the current directory with threads, default one per CPU\n");
+    printf("\t-b\t\tmeasure every hash kernel in memory, on one core and on all cores\n");
+}
+/**********************************************************************************************************************
+    description:    Print rate help
+    arguments:      -
+    return:         -
+**********************************************************************************************************************/
+static void gko_help_rate(void)
+{
+    printf("Usage: gekko rate [-l bytes] [-t seconds]\n\n");
+    printf("Arguments:\n");
+    printf("\t-l bytes\tlimit to hold per second, default %d\n", GEKKO_RATE_BENCH_LIMIT);
+    printf("\t-t seconds\tlength of every run, default %d\n", GEKKO_RATE_BENCH_S);
+}
+/**********************************************************************************************************************
+    description:    Print schedule help
+    arguments:      -
+    return:         -
+**********************************************************************************************************************/
+static void gko_help_schedule(void)
+{
+    printf("Usage: gekko schedule [-j sessions] [sizes]\n\n");
+    printf("Arguments:\n");
+    printf("\tsizes\t\tfile with one size in bytes per line, i.e. find -type f -printf '%%s\\n',\n");
+    printf("\t\t\tdefault the files of the current directory\n");
+    printf("\t-j sessions\tparallel sessions to simulate, default %d\n", GEKKO_POOL_SESSIONS);
+}
+/**********************************************************************************************************************
+    description:    Print source help
+    arguments:      -
+    return:         -
+**********************************************************************************************************************/
+static void gko_help_source(void)
+{
+    printf("Usage: gekko source [-w bytes] file\n\n");
+    printf("Arguments:\n");
+    printf("\tfile\t\tfile to read, a multi-GB one shows the difference\n");
+    printf("\t-w bytes\tbytes in flight, default %d\n", GEKKO_SOURCE_BENCH_WINDOW);
+}
+/**********************************************************************************************************************
+    description:    Print readahead help
+    arguments:      -
+    return:         -
+**********************************************************************************************************************/
+static void gko_help_readahead(void)
+{
+    printf("Usage: gekko readahead [-e engine] [-k depth] [-r bytes]\n\n");
+    printf("Arguments:\n");
+    printf("\t-e engine\tauto, uring or threads, default auto\n");
+    printf("\t-k depth\tfiles read ahead, default %d\n", GEKKO_PREFETCH_DEPTH);
+    printf("\t-r bytes\tsimulated link per second, default %.0f\n", GEKKO_PREFETCH_BENCH_RATE);
+}
+/**********************************************************************************************************************
+    description:    Print agent help
+    arguments:      -
+    return:         -
+**********************************************************************************************************************/
+static void gko_help_agent(void)
+{
+    printf("Usage: gekko agent [-t seconds]\n");
+    printf("       gekko agent -k\n\n");
+    printf("Arguments:\n");
+    printf("\t-t seconds\tclose the sessions of a grip unused for this long, default %d\n", GEKKO_AGENT_IDLE_S);
+    printf("\t-k\t\tstop the running agent\n");
 }
 /**********************************************************************************************************************
     description:    Print grip help
@@ -559,12 +468,219 @@ static void gko_help_grip(void)
 **********************************************************************************************************************/
 static void gko_help_run(void)
 {
-    printf("Usage: gekko run [-p password] [-k keyfile] remark path\n\n");
+    printf("Usage: gekko run [-p password] [-k keyfile] [-j threads] [-w] [-r] [-L] [-R] remark[,remark...] path\n");
+    printf("       gekko run -s [-o plan] [-j threads] [-r] remark path\n");
+    printf("       gekko run --plan plan [-p password] [-k keyfile]\n\n");
     printf("Arguments:\n");
     printf("\tremark\t\tremark for the remote connection\n");
     printf("\tpath\t\tremote path to sync with\n");
     printf("\t-p password\tspecify password for remote connection\n");
     printf("\t-k keyfile\tspecify SSH key file for SFTP connection\n");
+    printf("\t-j threads\tspecify local scanner and hashing threads, default one per CPU\n");
+    printf("\t-w, --watch\tkeep running and push every local change as it happens\n");
+    printf("\t-r, --rescan-remote\n\t\t\tlist the remote tree instead of trusting the cached snapshot\n");
+    printf("\t-L, --local\trun here even when an agent is listening\n");
+    printf("\t-R, --relay\tsend to the first grip only, each host passes the stream on to the next one\n");
+    printf("\t\t\tover ssh with its own keys while it arrives\n");
+    printf("\t-s, --show\tprint every create, update, rename, chmod and delete a run would do, send nothing\n");
+    printf("\t-o, --output plan\n\t\t\twrite what -s shows to a binary plan file\n");
+    printf("\t--plan plan\tcarry out a plan file exactly, refused if the tree or the snapshot moved since\n");
+    printf("\nA comma separated remark list, i.e. web1,web2,web3, reads the tree once and pushes it to every grip\n");
+    printf("at the same time.\n");
+}
+/**********************************************************************************************************************
+    description:    Time one rule set over a list of paths, compiled matcher against fnmatch over every rule
+    arguments:      label:      rule set name
+                    rules:      patterns
+                    count:      number of patterns
+                    scan:       paths to match
+    return:         error code
+**********************************************************************************************************************/
+static int gko_camo_bench_set(const char *label, const char **rules, size_t count, const GKO_SCAN *scan)
+{
+    GKO_IGNORE          ignore;
+    struct timespec     begin, end;
+    uint32_t           *scratch     = NULL;
+    const char         *base        = NULL;
+    const char         *pattern     = NULL;
+    double              compile     = 0;
+    double              elapsed     = 0;
+    size_t              rounds      = 0;
+    size_t              ignored     = 0;
+    size_t              matched     = 0;
+    size_t              i, j;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    if (gko_ignore_init(&ignore) != GEKKO_OK) return GEKKO_ERROR;
+    for (i = 0; i < count; i++) {
+        if (gko_ignore_add(&ignore, rules[i]) != GEKKO_OK) goto __error_bench;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    compile = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    scratch = (uint32_t *)malloc(2 * gko_ignore_width(&ignore) * sizeof(uint32_t));
+    if (!scratch) goto __error_bench;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    do {
+        for (i = 0, ignored = 0; i < scan->count; i++) {
+            ignored += gko_ignore_path(&ignore, scan->entries[i].path, S_ISDIR(scan->entries[i].mode), scratch);
+        }
+        rounds++;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    } while (elapsed < 0.5);
+
+    printf("%-10s %6lu rules, %5lu nodes, compiled in %.2f ms: %lu of %lu paths ignored, %.2f M matches/s\n",
+           label, (unsigned long)ignore.rules, (unsigned long)ignore.nodes_count, compile * 1e3,
+           (unsigned long)ignored, (unsigned long)scan->count, rounds * scan->count / elapsed / 1e6);
+
+    // what evaluating every rule against every path costs, for comparison
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (i = 0, rounds = 0; i < scan->count; i++, rounds++) {
+        base = strrchr(scan->entries[i].path, '/');
+        base = (base) ? base + 1 : scan->entries[i].path;
+
+        for (j = 0, matched = 0; j < count; j++) {
+            pattern = rules[j] + (rules[j][0] == '!');
+            if (strchr(pattern, '/')) {
+                matched |= (fnmatch(pattern + (pattern[0] == '/'), scan->entries[i].path, FNM_PATHNAME) == 0);
+            } else {
+                matched |= (fnmatch(pattern, base, 0) == 0);
+            }
+        }
+        (void)matched;
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+        if (elapsed > 0.5) break;
+    }
+
+    printf("%-10s %6lu rules, fnmatch per rule: %.2f M matches/s\n",
+           label, (unsigned long)count, (elapsed > 0) ? rounds / elapsed / 1e6 : 0.0);
+
+    free(scratch);
+    gko_ignore_free(&ignore);
+
+    return GEKKO_OK;
+
+__error_bench:
+    gko_ignore_free(&ignore);
+
+    return GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Measure ignore matching over the current directory with the current rules and stock rule sets
+    arguments:      root:   directory to take paths from
+    return:         error code
+**********************************************************************************************************************/
+static int gko_camo_bench(const char *root)
+{
+    static const char  *common[] = {
+        ".git/", ".svn/", ".hg/", ".DS_Store", "Thumbs.db", "*.swp", "*.swo", "*~", ".idea/", ".vscode/",
+        "*.o", "*.obj", "*.a", "*.so", "*.so.*", "*.dylib", "*.dll", "*.exe", "*.pyc", "__pycache__/",
+        "*.class", "*.jar", "node_modules/", "bower_components/", "dist/", "build/", "out/", "target/",
+        "/CMakeFiles/", "CMakeCache.txt", "cmake-build-*/", "*.log", "!important.log", "logs/**/*.gz",
+        "coverage/", ".cache/", "*.tmp", "tmp/", "*.bak", "*.orig", ".env", ".env.*", "!.env.example",
+        "**/generated/**", "vendor/bundle/", "*.min.js", "*.map", "[Dd]ebug/", "[Rr]elease/", "x64/",
+    };
+    GKO_SCAN            scan;
+    FILE               *file                            = NULL;
+    char                ign[PATH_MAX]                   = {0};
+    char                line[GEKKO_IGNORE_LINE_MAX]     = {0};
+    char              **owned                           = NULL;
+    const char        **rules                           = NULL;
+    size_t              ncommon                         = sizeof(common) / sizeof(common[0]);
+    size_t              nowned                          = 0;
+    size_t              nrules                          = 0;
+    size_t              i                               = 0;
+    int                 ret                             = GEKKO_ERROR;
+
+    if (gko_scan(root, 0, NULL, &scan) != GEKKO_OK) return GEKKO_ERROR;
+    printf("%lu paths under %s.\n", (unsigned long)scan.count, root);
+
+    owned = (char **)zalloc(GEKKO_CAMO_BENCH_RULES * sizeof(char *));
+    rules = (const char **)zalloc((ncommon + GEKKO_CAMO_BENCH_RULES) * sizeof(char *));
+    if (!owned || !rules) goto __error_bench;
+
+    // a monorepo sized rule set: many anchored directories, file types and generated globs
+    for (i = 0; i < ncommon; i++) rules[nrules++] = common[i];
+    for (nowned = 0; nowned < GEKKO_CAMO_BENCH_RULES; nowned++) {
+        snprintf(line, sizeof(line), (nowned % 4 == 0) ? "/services/svc%lu/build/" :
+                                     (nowned % 4 == 1) ? "*.gen%lu" :
+                                     (nowned % 4 == 2) ? "**/cache%lu/" : "fixture_%lu_*.json", (unsigned long)nowned);
+        owned[nowned] = strdup(line);
+        if (!owned[nowned]) goto __error_bench;
+        rules[nrules++] = owned[nowned];
+    }
+
+    if (gko_camo_bench_set("common", rules, ncommon, &scan) != GEKKO_OK) goto __error_bench;
+    if (gko_camo_bench_set("large", rules, nrules, &scan) != GEKKO_OK) goto __error_bench;
+
+    // the rules of this directory, if it has any
+    snprintf(ign, PATH_MAX, "%s%s%s", root, SEP, GEKKO_IGNORE_FILE);
+    file = fopen(ign, "rb");
+    if (file) {
+        for (i = 0; i < nowned; i++) free(owned[i]);
+        nowned = 0;
+        while (nowned < GEKKO_CAMO_BENCH_RULES && fgets(line, sizeof(line), file)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (!line[0] || line[0] == '#') continue;
+            owned[nowned] = strdup(line);
+            if (!owned[nowned]) goto __error_bench;
+            rules[nowned] = owned[nowned];
+            nowned++;
+        }
+        if (gko_camo_bench_set(GEKKO_IGNORE_FILE, rules, nowned, &scan) != GEKKO_OK) goto __error_bench;
+    }
+
+    ret = GEKKO_OK;
+
+__error_bench:
+    if (file) fclose(file);
+    for (i = 0; owned && i < nowned; i++) free(owned[i]);
+    free(owned);
+    free(rules);
+    gko_scan_free(&scan);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Tell whether paths are ignored by the rules in the current directory
+    arguments:      root:   sync root
+                    argc:   number of paths
+                    argv:   paths relative to root
+    return:         error code
+**********************************************************************************************************************/
+static int gko_camo_test(const char *root, int argc, char *argv[])
+{
+    GKO_IGNORE  ignore;
+    struct stat st;
+    char        ign[PATH_MAX]   = {0};
+    uint32_t   *scratch         = NULL;
+    int         i               = 0;
+
+    snprintf(ign, PATH_MAX, "%s%s%s", root, SEP, GEKKO_IGNORE_FILE);
+    if (gko_ignore_init(&ignore) != GEKKO_OK) return GEKKO_ERROR;
+    if (gko_ignore_load(&ignore, ign) != GEKKO_OK) goto __error_test;
+
+    scratch = (uint32_t *)malloc(2 * gko_ignore_width(&ignore) * sizeof(uint32_t));
+    if (!scratch) goto __error_test;
+
+    for (i = 0; i < argc; i++) {
+        printf("%s\t%s\n", gko_ignore_path(&ignore, argv[i], stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode),
+                                             scratch) ? "ignored" : "synced", argv[i]);
+    }
+
+    free(scratch);
+    gko_ignore_free(&ignore);
+
+    return GEKKO_OK;
+
+__error_test:
+    gko_ignore_free(&ignore);
+
+    return GEKKO_ERROR;
 }
 /**********************************************************************************************************************
     description:    Entry function of Gekko camouflage
@@ -574,21 +690,28 @@ static void gko_help_run(void)
 **********************************************************************************************************************/
 static int gko_camo(int argc, char *argv[])
 {
-    char    opt             = 0;
+    int     opt             = 0;
     bool    is_remove       = false;
     int     i               = 0;
     FILE   *file            = NULL;
     char    line[PATH_MAX]  = {0};
     char    ign[PATH_MAX]   = {0};
+    char    cwd[PATH_MAX]   = {0};
+    bool    is_bench        = false;
+    bool    is_test         = false;
 
     if (argc < 2) {
         gko_help_camo();
         return GEKKO_OK;
     }
 
-    while ((opt = getopt(argc, argv, "r")) != -1) {
+    while ((opt = getopt(argc, argv, "rbt")) != -1) {
         if (opt == 'r') {
             is_remove = true;
+        } else if (opt == 'b') {
+            is_bench = true;
+        } else if (opt == 't') {
+            is_test = true;
         }
     }
 
@@ -596,6 +719,10 @@ static int gko_camo(int argc, char *argv[])
         fprintf(stderr, "Failed to get current directory.\n");
         return GEKKO_ERROR;
     }
+    strcpy(cwd, ign);
+
+    if (is_bench) return gko_camo_bench(cwd);
+    if (is_test) return gko_camo_test(cwd, argc - optind, argv + optind);
     strcat(ign, SEP ".gkoignore"); // todo: dangerous
 
     if (!gko_file_exists(ign)) {
@@ -618,118 +745,1395 @@ static int gko_camo(int argc, char *argv[])
     return GEKKO_OK;
 }
 /**********************************************************************************************************************
-    description:    Entry function of Gekko grip
+    description:    Entry function of Gekko hash, hashes the current directory without any cache and reports throughput
     arguments:      argc:   Count of command line arguments
                     argv:   Values of command line arguments
     return:         error code
 **********************************************************************************************************************/
-static int gko_grip(int argc, char *argv[])
+static int gko_hash_tree(int argc, char *argv[])
 {
-    if (argc < 2) {
-        gko_help_grip();
-        return GEKKO_OK;
+    int                 opt             = 0;
+    int                 threads         = 0;
+    int                 rootfd          = -1;
+    int                 ret             = GEKKO_OK;
+    char                root[PATH_MAX]  = {0};
+    char                ign[PATH_MAX]   = {0};
+    size_t              hashed          = 0;
+    size_t              i               = 0;
+    uint64_t            bytes           = 0;
+    double              elapsed         = 0;
+    struct timespec     begin, end;
+    GKO_IGNORE          ignore;
+    GKO_SCAN            scan;
+
+    while ((opt = getopt(argc, argv, "j:bh")) != -1) {
+        if (opt == 'j') {
+            threads = atoi(optarg);
+        } else if (opt == 'b') {
+            return gko_hash_bench();
+        } else {
+            gko_help_hash();
+            return GEKKO_OK;
+        }
     }
 
-    return GEKKO_OK;
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > GEKKO_HASH_THREADS_MAX) threads = GEKKO_HASH_THREADS_MAX;
+
+    if (!getcwd(root, sizeof(root))) {
+        fprintf(stderr, "Failed to get current directory.\n");
+        return GEKKO_ERROR;
+    }
+
+    snprintf(ign, PATH_MAX, "%s%s%s", root, SEP, GEKKO_IGNORE_FILE);
+    if (gko_ignore_init(&ignore) != GEKKO_OK) return GEKKO_ERROR;
+    if (gko_ignore_load(&ignore, ign) != GEKKO_OK || gko_scan(root, threads, &ignore, &scan) != GEKKO_OK) {
+        fprintf(stderr, "Cannot scan %s.\n", root);
+        gko_ignore_free(&ignore);
+        return GEKKO_ERROR;
+    }
+
+    for (i = 0; i < scan.count; i++) {
+        scan.entries[i].flags |= GKO_ENTRY_STALE;
+        if (S_ISREG(scan.entries[i].mode)) bytes += scan.entries[i].size;
+    }
+
+    rootfd = open(root, O_RDONLY | O_DIRECTORY);
+    if (rootfd < 0) {
+        fprintf(stderr, "Cannot open directory: %s.\n", root);
+        ret = GEKKO_ERROR;
+        goto __error_open;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    ret = gko_hash_stale(rootfd, &scan, threads, NULL, &hashed, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    if (ret == GEKKO_OK) {
+        printf("Hashed %lu entries, %.1f MB in %.3f s with %d threads (%s): %.2f GB/s, %.2f GB/s per core.\n",
+               (unsigned long)hashed, bytes / 1e6, elapsed, threads, gko_hash_kernel(),
+               (elapsed > 0) ? bytes / elapsed / 1e9 : 0.0, (elapsed > 0) ? bytes / elapsed / 1e9 / threads : 0.0);
+    }
+
+    close(rootfd);
+
+__error_open:
+    gko_scan_free(&scan);
+    gko_ignore_free(&ignore);
+
+    return ret;
 }
 /**********************************************************************************************************************
-    description:    Entry function of Gekko run
+    description:    Entry function of Gekko rate, pushes metadata, small and bulk traffic through the limiter into a
+                    local stand-in server with a throttled link and reports how well the limit holds
     arguments:      argc:   Count of command line arguments
                     argv:   Values of command line arguments
     return:         error code
 **********************************************************************************************************************/
-static int gko_run(int argc, char *argv[])
+static int gko_rate_check(int argc, char *argv[])
 {
-    if (argc < 2) {
-        gko_help_run();
-        return GEKKO_OK;
+    int         opt     = 0;
+    int64_t     limit   = 0;
+    int         seconds = 0;
+
+    while ((opt = getopt(argc, argv, "l:t:h")) != -1) {
+        if (opt == 'l') {
+            limit = strtoll(optarg, NULL, 10);
+        } else if (opt == 't') {
+            seconds = atoi(optarg);
+        } else {
+            gko_help_rate();
+            return GEKKO_OK;
+        }
     }
 
-    return GEKKO_OK;
+    return gko_rate_bench(limit, seconds);
 }
 /**********************************************************************************************************************
-    description:    Entry function of Gekko
+    description:    Entry function of Gekko schedule, replays a recorded size distribution under every ordering policy
     arguments:      argc:   Count of command line arguments
                     argv:   Values of command line arguments
     return:         error code
 **********************************************************************************************************************/
-int main(int argc, char *argv[])
+static int gko_schedule_check(int argc, char *argv[])
 {
-    int     ret                 = GEKKO_ERROR;
-    bool    error               = false;
-    char    config[PATH_MAX]    = {0};
-    GRIP   *grip                = NULL;
+    int                 opt             = 0;
+    int                 sessions        = GEKKO_POOL_SESSIONS;
+    int                 ret             = GEKKO_ERROR;
+    char                root[PATH_MAX]  = {0};
+    char                ign[PATH_MAX]   = {0};
+    uint64_t           *sizes           = NULL;
+    size_t              count           = 0;
+    size_t              i               = 0;
+    GKO_IGNORE          ignore;
+    GKO_SCAN            scan;
+
+    while ((opt = getopt(argc, argv, "j:h")) != -1) {
+        if (opt == 'j') {
+            sessions = atoi(optarg);
+        } else {
+            gko_help_schedule();
+            return GEKKO_OK;
+        }
+    }
 
-#ifdef WINDOWS
-    snprintf(config, PATH_MAX, "%s%s%s", getenv("HOMEDRIVE"),
-             getenv("HOMEPATH"), GEKKO_DEFAULT_CONFIG);
-#else
-    snprintf(config, PATH_MAX, "%s%s", getenv("HOME"), GEKKO_DEFAULT_CONFIG);
-#endif
+    if (optind < argc) {
+        if (gko_schedule_load(argv[optind], &sizes, &count) != GEKKO_OK) return GEKKO_ERROR;
+        ret = gko_schedule_bench(sizes, count, sessions);
+        free(sizes);
+        return ret;
+    }
 
-    if (argc < 2) {
-        gko_help_main();
-        return GEKKO_OK;
+    if (!getcwd(root, sizeof(root))) {
+        fprintf(stderr, "Failed to get current directory.\n");
+        return GEKKO_ERROR;
+    }
 
+    snprintf(ign, PATH_MAX, "%s%s%s", root, SEP, GEKKO_IGNORE_FILE);
+    if (gko_ignore_init(&ignore) != GEKKO_OK) return GEKKO_ERROR;
+    if (gko_ignore_load(&ignore, ign) != GEKKO_OK ||
+        gko_scan(root, (int)sysconf(_SC_NPROCESSORS_ONLN), &ignore, &scan) != GEKKO_OK) {
+        fprintf(stderr, "Cannot scan %s.\n", root);
+        gko_ignore_free(&ignore);
+        return GEKKO_ERROR;
+    }
+
+    sizes = (uint64_t *)malloc((scan.count ? scan.count : 1) * sizeof(uint64_t));
+    if (sizes) {
+        for (i = 0; i < scan.count; i++) {
+            if (S_ISREG(scan.entries[i].mode)) sizes[count++] = scan.entries[i].size;
+        }
+        ret = gko_schedule_bench(sizes, count, sessions);
+        free(sizes);
     } else {
-        if (strcmp(argv[1], "camo") == GEKKO_OK) {
-            return gko_camo(argc - 1, &argv[1]);
+        fprintf(stderr, "Insufficient memory.\n");
+    }
 
-        } else if (strcmp(argv[1], "grip") == GEKKO_OK) {
-            return gko_grip(argc - 1, &argv[1]);
+    gko_scan_free(&scan);
+    gko_ignore_free(&ignore);
 
-        } else if (strcmp(argv[1], "run") == GEKKO_OK) {
-            return gko_run(argc - 1, &argv[1]);
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Entry function of Gekko source, reads a file the way uploads used to and the way they do now,
+                    reporting CPU time per GB and peak RSS of each
+    arguments:      argc:   Count of command line arguments
+                    argv:   Values of command line arguments
+    return:         error code
+**********************************************************************************************************************/
+static int gko_source_check(int argc, char *argv[])
+{
+    int         opt     = 0;
+    size_t      window  = GEKKO_SOURCE_BENCH_WINDOW;
 
+    while ((opt = getopt(argc, argv, "w:h")) != -1) {
+        if (opt == 'w') {
+            window = (size_t)strtoull(optarg, NULL, 10);
         } else {
-            printf("Invalid command: %s\n", argv[1]);
-            return GEKKO_ERROR;
+            gko_help_source();
+            return GEKKO_OK;
         }
     }
 
-    printf("Use default configuration file: %s\n", config);
+    if (optind >= argc) {
+        gko_help_source();
+        return GEKKO_ERROR;
+    }
 
-    if (!gko_file_exists(config)) {
-        fprintf(stderr, "Cannot access file (%d).\n", ret);
+    return gko_source_bench(argv[optind], window);
+}
+/**********************************************************************************************************************
+    description:    Entry function of Gekko readahead, sends the small files of the current directory over a
+                    simulated link from a cold page cache, with and without reading ahead
+    arguments:      argc:   Count of command line arguments
+                    argv:   Values of command line arguments
+    return:         error code
+**********************************************************************************************************************/
+static int gko_readahead_check(int argc, char *argv[])
+{
+    int                 opt             = 0;
+    int                 depth           = 0;
+    int                 rootfd          = -1;
+    int                 ret             = GEKKO_ERROR;
+    double              rate            = 0;
+    char                root[PATH_MAX]  = {0};
+    char                ign[PATH_MAX]   = {0};
+    GEKKO_READAHEAD     engine          = GEKKO_READAHEAD_AUTO;
+    GKO_IGNORE          ignore;
+    GKO_SCAN            scan;
+
+    while ((opt = getopt(argc, argv, "e:k:r:h")) != -1) {
+        if (opt == 'e' && gko_prefetch_engine(optarg, &engine) == GEKKO_OK) {
+            continue;
+        } else if (opt == 'k') {
+            depth = atoi(optarg);
+        } else if (opt == 'r') {
+            rate = strtod(optarg, NULL);
+        } else {
+            gko_help_readahead();
+            return GEKKO_OK;
+        }
+    }
+
+    if (!getcwd(root, sizeof(root))) {
+        fprintf(stderr, "Failed to get current directory.\n");
         return GEKKO_ERROR;
     }
 
-    ret = gko_read_config(config);
-    if (ret != GEKKO_OK) {
-        fprintf(stderr, "Cannot read configuration file (%d).\n", ret);
+    snprintf(ign, PATH_MAX, "%s%s%s", root, SEP, GEKKO_IGNORE_FILE);
+    if (gko_ignore_init(&ignore) != GEKKO_OK) return GEKKO_ERROR;
+    if (gko_ignore_load(&ignore, ign) != GEKKO_OK ||
+        gko_scan(root, (int)sysconf(_SC_NPROCESSORS_ONLN), &ignore, &scan) != GEKKO_OK) {
+        fprintf(stderr, "Cannot scan %s.\n", root);
+        gko_ignore_free(&ignore);
+        return GEKKO_ERROR;
+    }
+
+    rootfd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootfd >= 0) {
+        ret = gko_prefetch_bench(rootfd, &scan, engine, depth, rate);
+        close(rootfd);
+    } else {
+        fprintf(stderr, "Cannot open %s.\n", root);
+    }
+
+    gko_scan_free(&scan);
+    gko_ignore_free(&ignore);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Entry function of Gekko grip
+    arguments:      argc:   Count of command line arguments
+                    argv:   Values of command line arguments
+    return:         error code
+**********************************************************************************************************************/
+static int gko_grip(int argc, char *argv[])
+{
+    GKO_REGISTRY    reg;
+    GRIP           *grip            = NULL;
+    const char     *remark          = NULL;
+    char            path[PATH_MAX]  = {0};
+    bool            remove          = false;
+    int             ret             = GEKKO_ERROR;
+    int             opt             = 0;
+
+    while ((opt = getopt(argc, argv, "rh")) != -1) {
+        if (opt == 'r') {
+            remove = true;
+        } else {
+            gko_help_grip();
+            return GEKKO_OK;
+        }
+    }
+
+    if (optind >= argc || (!remove && optind + 2 > argc)) {
+        gko_help_grip();
+        return GEKKO_OK;
+    }
+
+    remark = argv[optind];
+    if (!remark[0] || remark[0] == '.' || strchr(remark, '/') || strchr(remark, '\\')) {
+        fprintf(stderr, "Invalid remark: %s\n", remark);
         return GEKKO_ERROR;
     }
 
+    if (gko_load_config() != GEKKO_OK) return GEKKO_ERROR;
+
+    snprintf(path, PATH_MAX, "%s%s%s%s", grips_dir, SEP, remark, GEKKO_REGISTRY_SUFFIX);
+
+    if (remove) {
+        ret = (unlink(path) == 0) ? GEKKO_OK : GEKKO_ERROR;
+        if (ret != GEKKO_OK) fprintf(stderr, "Grip \"%s\" cannot be found.\n", remark);
+    } else {
+        grip = (GRIP *)zalloc(sizeof(GRIP));
+        if (!grip) {
+            fprintf(stderr, "Insufficient memory.\n");
+            goto __error_grip;
+        }
+
+        // modifying keeps every setting but the connection
+        if (gko_file_exists(path) && gko_registry_read(path, grip, false) != GEKKO_OK) goto __error_grip;
+        if (gko_parse_connection(argv[optind + 1], grip) != GEKKO_OK) goto __error_grip;
+        if (!grip->auth) grip->auth = AUTH_METHOD_PASSWORD;
+
+        ret = gko_registry_save(path, grip);
+    }
+
+    if (ret == GEKKO_OK) {
+        if (gko_registry_open(grips_dir, &reg) != GEKKO_OK) memset(&reg, 0, sizeof(reg));
+        gko_registry_build(grips_dir, &reg);
+        gko_registry_close(&reg);
+        printf("Grip %s %s.\n", remark, (remove) ? "removed" : "saved");
+    }
+
+__error_grip:
+    free(grip);
+    free(grips_dir);
+    grips_dir = NULL;
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Watch mode of Gekko run, sessions stay open between pushes
+    arguments:      remark:     grip name
+                    remote:     remote sync root
+                    root:       local sync root
+                    idx:        index file path
+                    threads:    scanner threads
+                    ignore:     ignore rules
+                    pass:       password override, may be NULL
+                    key:        key file override, may be NULL
+    return:         error code
+**********************************************************************************************************************/
+static int gko_run_watch(const char *remark, const char *remote, const char *root, const char *idx,
+                         int threads, const GKO_IGNORE *ignore, const char *pass, const char *key)
+{
+    GKO_POOL    pool;
+    GRIP       *grip            = NULL;
+    char        snap[PATH_MAX]  = {0};
+    int         rootfd          = -1;
+    int         ret             = GEKKO_ERROR;
+
     grip = (GRIP *)zalloc(sizeof(GRIP));
     if (!grip) {
         fprintf(stderr, "Insufficient memory.\n");
-        error = true;
+        return GEKKO_ERROR;
+    }
+
+    if (gko_load_grip(remark, grip) != GEKKO_OK) goto __error_grip;
+    if (pass) snprintf(grip->pass, NAME_MAX, "%s", pass);
+    if (key) snprintf(grip->key, PATH_MAX, "%s", key);
+    if (gko_snapshot_path(snap, PATH_MAX, grips_dir, remark, remote) != GEKKO_OK) goto __error_grip;
+
+    rootfd = open(root, O_RDONLY | O_DIRECTORY);
+    if (rootfd < 0) {
+        fprintf(stderr, "Cannot open directory: %s.\n", root);
+        goto __error_grip;
+    }
+
+    ret = gko_pool_create(&pool, grip, grip->sessions);
+    if (ret != GEKKO_OK) {
+        fprintf(stderr, "Cannot create SSH instance (%d).\n", ret);
+        goto __error_pool;
+    }
+
+    ret = gko_watch(&pool, grip, remote, root, rootfd, idx, snap, threads, ignore);
+
+    gko_pool_destroy(&pool);
+
+__error_pool:
+    close(rootfd);
+
+__error_grip:
+    free(grip);
+    free(grips_dir);
+    grips_dir = NULL;
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Flag what moved since one fan-out host's last sync, on a copy of the shared scan
+    arguments:      h:          host, its paths set
+                    scan:       shared scan, left untouched
+                    ignore:     ignore rules
+    return:         error code
+**********************************************************************************************************************/
+static int gko_run_fanout_diff(GKO_RUN_HOST *h, const GKO_SCAN *scan, const GKO_IGNORE *ignore)
+{
+    h->scan.entries = (GKO_ENTRY *)malloc((scan->count ? scan->count : 1) * sizeof(GKO_ENTRY));
+    if (!h->scan.entries) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+    memcpy(h->scan.entries, scan->entries, scan->count * sizeof(GKO_ENTRY));
+    h->scan.count = scan->count;
+
+    if (gko_index_open(h->idx, &h->index) != GEKKO_OK) return GEKKO_ERROR;
+    if (gko_index_diff(&h->index, &h->scan, ignore, &h->deleted, &h->deleted_count) != GEKKO_OK) return GEKKO_ERROR;
+
+    // what left the remote is decided against the snapshot later
+    free(h->deleted);
+    h->deleted = NULL;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Hash the shared scan once for every host, reading what moved for any of them
+    arguments:      hosts:      hosts flagged by gko_run_fanout_diff(), the ready ones count
+                    count:      number of hosts
+                    rootfd:     local sync root
+                    scan:       shared scan, takes the digests
+                    cache:      hash cache path
+                    threads:    hashing threads
+    return:         error code
+**********************************************************************************************************************/
+static int gko_run_fanout_hash(const GKO_RUN_HOST *hosts, int count, int rootfd, GKO_SCAN *scan,
+                               const char *cache, int threads)
+{
+    GKO_HASH_CACHE  hcache;
+    GKO_ENTRY      *entry   = NULL;
+    size_t          hashed  = 0;
+    size_t          i       = 0;
+    int             ret     = GEKKO_ERROR;
+    int             h       = 0;
+
+    // an entry no host saw move carries the digest every index agrees on, the cache is written from those
+    for (i = 0; i < scan->count; i++) {
+        entry = &scan->entries[i];
+        entry->flags = 0;
+        entry->hash  = 0;
+        for (h = 0; h < count; h++) {
+            if (!hosts[h].ready) continue;
+            entry->flags |= hosts[h].scan.entries[i].flags & GKO_ENTRY_STALE;
+            entry->hash   = hosts[h].scan.entries[i].hash;
+        }
+    }
+
+    if (gko_hash_cache_open(cache, &hcache) != GEKKO_OK) fprintf(stderr, "Cannot open hash cache %s.\n", cache);
+    ret = gko_hash_stale(rootfd, scan, threads, &hcache, &hashed, NULL);
+    if (ret == GEKKO_OK && gko_hash_cache_changed(&hcache, scan, hashed)) gko_hash_cache_write(cache, scan);
+    gko_hash_cache_close(&hcache);
+    if (ret != GEKKO_OK) return GEKKO_ERROR;
+
+    printf("Hashed %lu entries once for %d hosts.\n", (unsigned long)hashed, count);
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Work out what one fan-out host is missing, once the shared scan is hashed
+    arguments:      h:          host, flagged by gko_run_fanout_diff()
+                    scan:       shared scan, hashed
+                    ignore:     ignore rules
+                    rescan:     list the remote tree instead of trusting the cached snapshot
+    return:         error code
+**********************************************************************************************************************/
+static int gko_run_fanout_prepare(GKO_RUN_HOST *h, const GKO_SCAN *scan, const GKO_IGNORE *ignore, bool rescan)
+{
+    GKO_SESSION     session;
+    int             ret     = GEKKO_ERROR;
+
+    gko_hash_take(&h->scan, scan, &h->dirty);
+
+    if (gko_index_open(h->snap, &h->snapshot) != GEKKO_OK) return GEKKO_ERROR;
+
+    if (rescan || !gko_file_exists(h->snap)) {
+        ret = gko_session_open(&session, &h->grip);
+        if (ret != GEKKO_OK) {
+            fprintf(stderr, "Cannot create SSH instance for %s (%d).\n", h->name, ret);
+            return GEKKO_ERROR;
+        }
+
+        ret = gko_snapshot_refresh(&session, h->remote, ignore, h->grip.list_window, &h->scan,
+                                   (h->snapshot.count) ? &h->snapshot : &h->index, h->snap);
+        gko_session_close(&session);
+        if (ret != GEKKO_OK) return GEKKO_ERROR;
+
+        gko_index_close(&h->snapshot);
+        if (gko_index_open(h->snap, &h->snapshot) != GEKKO_OK) return GEKKO_ERROR;
+    }
+
+    if (gko_snapshot_reconcile(&h->snapshot, &h->scan, ignore, &h->deleted, &h->deleted_count,
+                               &h->dirty) != GEKKO_OK) return GEKKO_ERROR;
+
+    printf("%s: %lu changed, %lu deleted.\n", h->name, (unsigned long)h->dirty, (unsigned long)h->deleted_count);
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Fan-out host thread, pushes through its own sessions and lets go of the shared buffers
+    arguments:      arg:    host
+    return:         NULL
+**********************************************************************************************************************/
+static void *gko_run_fanout_host(void *arg)
+{
+    GKO_RUN_HOST   *h   = (GKO_RUN_HOST *)arg;
+
+    h->ret = gko_sync(NULL, &h->grip, h->remote, h->rootfd, &h->scan, &h->snapshot, h->deleted, h->deleted_count,
+                      h->fanout, h->number);
+    gko_fanout_done(h->fanout, h->number);
+
+    return NULL;
+}
+/**********************************************************************************************************************
+    description:    Relay mode of a fan-out, the tree goes to the first host once and every host passes it on to
+                    the next. What any host misses is sent to all of them, a copy that is already there is
+                    replaced by the same bytes. Removals are not shared, every host only drops what its own
+                    snapshot lost.
+    arguments:      hosts:      prepared hosts in chain order, their results are stored
+                    count:      number of hosts
+                    remote:     remote sync root, the same on every host
+                    rootfd:     local sync root
+                    scan:       shared scan
+    return:         error code
+**********************************************************************************************************************/
+static int gko_run_relay(GKO_RUN_HOST *hosts, int count, const char *remote, int rootfd, const GKO_SCAN *scan)
+{
+    GKO_RELAY_RESULT    results[GEKKO_FANOUT_HOSTS_MAX];
+    GKO_TRANSFER        xfer;
+    GKO_SESSION         session;
+    GKO_SCAN            all;
+    char                hops[GEKKO_FANOUT_HOSTS_MAX][NAME_MAX * 2 + 16];
+    const char         *next[GEKKO_FANOUT_HOSTS_MAX];
+    char                key[NAME_MAX + 8]   = {0};
+    const char        **paths               = NULL;
+    const char        **removed[GEKKO_FANOUT_HOSTS_MAX];
+    size_t              removed_count[GEKKO_FANOUT_HOSTS_MAX];
+    const GRIP         *head                = &hosts[0].grip;
+    size_t              dirty               = 0;
+    size_t              total               = 0;
+    size_t              i                   = 0;
+    size_t              k                   = 0;
+    int                 ret                 = GEKKO_ERROR;
+    int                 h                   = 0;
+
+    for (h = 0; h < count; h++) hosts[h].ret = GEKKO_ERROR;
+
+    for (h = 0; h < count; h++) {
+        if (!hosts[h].ready) {
+            fprintf(stderr, "Relay needs every host of the chain, %s is not ready.\n", hosts[h].name);
+            return GEKKO_ERROR;
+        }
+        total += hosts[h].deleted_count;
+    }
+
+    all.entries = (GKO_ENTRY *)malloc((scan->count ? scan->count : 1) * sizeof(GKO_ENTRY));
+    paths = (const char **)malloc((total ? total : 1) * sizeof(char *));
+    if (!all.entries || !paths) {
+        fprintf(stderr, "Insufficient memory.\n");
+        goto __error_malloc;
+    }
+    memcpy(all.entries, scan->entries, scan->count * sizeof(GKO_ENTRY));
+    all.count = scan->count;
+
+    for (i = 0; i < all.count; i++) {
+        all.entries[i].flags = 0;
+        for (h = 0; h < count; h++) all.entries[i].flags |= hosts[h].scan.entries[i].flags & GKO_ENTRY_DIRTY;
+        if (all.entries[i].flags) dirty++;
+    }
+
+    // snapshot order backwards puts the deepest paths first, directories are empty by the time they go
+    for (h = 0, i = 0; h < count; h++) {
+        removed[h] = paths + i;
+        removed_count[h] = hosts[h].deleted_count;
+        for (k = hosts[h].deleted_count; k-- > 0; ) {
+            paths[i++] = gko_index_path(&hosts[h].snapshot, hosts[h].deleted[k]);
+        }
+    }
+
+    if (!dirty && !total) {
+        for (h = 0; h < count; h++) hosts[h].ret = GEKKO_OK;
+        ret = GEKKO_OK;
         goto __error_malloc;
     }
 
-    ret = gko_read_grip("aliyun", grip);
+    for (h = 1; h < count; h++) {
+        if (gko_relay_hop(hops[h - 1], sizeof(hops[h - 1]), hosts[h].grip.user, hosts[h].grip.host,
+                          hosts[h].grip.port) != GEKKO_OK) goto __error_malloc;
+        next[h - 1] = hops[h - 1];
+    }
+
+    ret = gko_session_open(&session, head);
     if (ret != GEKKO_OK) {
-        fprintf(stderr, "Cannot read grip (%d).\n", ret);
+        fprintf(stderr, "Cannot create SSH instance for %s (%d).\n", hosts[0].name, ret);
+        ret = GEKKO_ERROR;
+        goto __error_malloc;
+    }
+
+    memset(&xfer, 0, sizeof(xfer));
+    snprintf(key, sizeof(key), "%s:%u", head->host, head->port);
+    xfer.session = session.session;
+    xfer.sftp    = session.sftp;
+    xfer.sock    = session.sock;
+    xfer.rootfd  = rootfd;
+    xfer.remote  = remote;
+    xfer.gekko   = (head->gekko[0]) ? head->gekko : GEKKO_REMOTE_GEKKO;
+    xfer.rate    = gko_rate_get(key, head->rate_limit);
+
+    ret = gko_relay_push(&xfer, &all, next, count - 1, removed, removed_count, results);
+    gko_session_close(&session);
+
+    for (h = 0; h < count; h++) {
+        hosts[h].ret = (results[h].done) ? GEKKO_OK : GEKKO_ERROR;
+        if (!results[h].done) continue;
+        printf("%s: stored %llu files, %llu bytes, removed %llu.\n", hosts[h].name,
+               (unsigned long long)results[h].files, (unsigned long long)results[h].bytes,
+               (unsigned long long)results[h].removed);
+    }
+
+__error_malloc:
+    free(all.entries);
+    free(paths);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Fan-out mode of Gekko run, the tree is scanned and hashed once and every file is read once
+                    for all the grips it goes to, each host pushes over its own sessions at its own pace
+    arguments:      list:       comma separated grip names
+                    remote:     remote sync root, the same on every host
+                    root:       local sync root
+                    threads:    scanner and hashing threads
+                    ignore:     ignore rules
+                    pass:       password override, may be NULL
+                    key:        key file override, may be NULL
+                    rescan:     list the remote trees instead of trusting the cached snapshots
+                    relay:      chain the hosts in list order instead, only the first one is sent to
+    return:         error code
+**********************************************************************************************************************/
+static int gko_run_fanout(const char *list, const char *remote, const char *root, int threads,
+                          const GKO_IGNORE *ignore, const char *pass, const char *key, bool rescan, bool relay)
+{
+    GKO_RUN_HOST   *hosts           = NULL;
+    GKO_RUN_HOST   *h               = NULL;
+    GKO_FANOUT      fanout;
+    GKO_SCAN        scan;
+    char            cache[PATH_MAX] = {0};
+    char           *names           = NULL;
+    char           *name            = NULL;
+    char           *comma           = NULL;
+    int             rootfd          = -1;
+    int             count           = 0;
+    int             i               = 0;
+    int             j               = 0;
+    bool            error           = false;
+    int             ret             = GEKKO_ERROR;
+
+    names = strdup(list);
+    hosts = (GKO_RUN_HOST *)zalloc(GEKKO_FANOUT_HOSTS_MAX * sizeof(GKO_RUN_HOST));
+    if (!names || !hosts) {
+        fprintf(stderr, "Insufficient memory.\n");
+        goto __error_malloc;
+    }
+
+    for (name = names; name; name = (comma) ? comma + 1 : NULL) {
+        comma = strchr(name, GEKKO_FANOUT_SEP[0]);
+        if (comma) *comma = '\0';
+        if (!name[0]) continue;
+
+        if (count == GEKKO_FANOUT_HOSTS_MAX) {
+            fprintf(stderr, "Too many grips, at most %d.\n", GEKKO_FANOUT_HOSTS_MAX);
+            goto __error_malloc;
+        }
+        for (j = 0; j < count; j++) {
+            if (strcmp(hosts[j].name, name) == 0) break;
+        }
+        if (j < count) {
+            fprintf(stderr, "Grip %s is listed twice.\n", name);
+            goto __error_malloc;
+        }
+
+        hosts[count].name = name;
+        hosts[count].number = count;
+        count++;
+    }
+
+    if (!count) {
+        fprintf(stderr, "No grip given.\n");
+        goto __error_malloc;
+    }
+
+    if (gko_load_config() != GEKKO_OK) goto __error_grips;
+
+    for (i = 0; i < count; i++) {
+        h = &hosts[i];
+        h->remote = remote;
+        snprintf(h->idx, PATH_MAX, "%s%s%s%s%s%s", root, SEP, GEKKO_INDEX_DIR, SEP, h->name, GEKKO_INDEX_SUFFIX);
+        if (gko_registry_lookup(grips_dir, h->name, &h->grip) != GEKKO_OK) goto __error_grips;
+        if (gko_snapshot_path(h->snap, PATH_MAX, grips_dir, h->name, remote) != GEKKO_OK) goto __error_grips;
+        if (pass) snprintf(h->grip.pass, NAME_MAX, "%s", pass);
+        if (key) snprintf(h->grip.key, PATH_MAX, "%s", key);
+    }
+    free(grips_dir);
+    grips_dir = NULL;
+
+    snprintf(cache, PATH_MAX, "%s%s%s%s%s", root, SEP, GEKKO_INDEX_DIR, SEP, GEKKO_HASH_CACHE_FILE);
+
+    rootfd = open(root, O_RDONLY | O_DIRECTORY);
+    if (rootfd < 0) {
+        fprintf(stderr, "Cannot open directory: %s.\n", root);
+        goto __error_malloc;
+    }
+
+    if (gko_scan(root, threads, ignore, &scan) != GEKKO_OK) {
+        fprintf(stderr, "Cannot scan %s.\n", root);
+        goto __error_scan;
+    }
+
+    printf("Scanned %lu entries in %.3f s with %d threads (%.0f entries/s), %lu ignored by %u rules.\n",
+           (unsigned long)scan.count, scan.elapsed, scan.threads,
+           (scan.elapsed > 0) ? scan.count / scan.elapsed : 0.0,
+           (unsigned long)scan.ignored, ignore->rules);
+
+    // a relay reads every file once for the first host alone, nothing is shared between senders
+    if (!relay && gko_fanout_init(&fanout, rootfd, &scan, count, 0) != GEKKO_OK) goto __error_fanout;
+
+    // one host that cannot be reached or read leaves the others to go on
+    for (i = 0; i < count; i++) {
+        h = &hosts[i];
+        h->rootfd = rootfd;
+        h->fanout = (relay) ? NULL : &fanout;
+        h->ready  = (gko_run_fanout_diff(h, &scan, ignore) == GEKKO_OK);
+        if (!h->ready) error = true;
+    }
+
+    // the tree is read and the cache written once, whatever the number of hosts
+    if (gko_run_fanout_hash(hosts, count, rootfd, &scan, cache, threads) != GEKKO_OK) {
+        for (i = 0; i < count; i++) hosts[i].ready = false;
         error = true;
-        goto __error_read_grip;
     }
 
-    return GEKKO_OK;
+    for (i = 0; i < count; i++) {
+        h = &hosts[i];
+        if (!h->ready) continue;
+        h->ready = (gko_run_fanout_prepare(h, &scan, ignore, rescan) == GEKKO_OK);
+        if (!h->ready) error = true;
+        if (!relay && h->ready && gko_fanout_want(&fanout, h->number, &h->scan) != GEKKO_OK) error = true;
+    }
+
+    if (relay && gko_run_relay(hosts, count, remote, rootfd, &scan) != GEKKO_OK) error = true;
 
-    ret = gko_instance_create(grip);
-    gko_error_return("Cannot create SSH instance");
+    for (i = 0; !relay && i < count; i++) {
+        h = &hosts[i];
+        if (!h->ready || (!h->dirty && !h->deleted_count)) continue;
+        h->started = (pthread_create(&h->thread, NULL, gko_run_fanout_host, h) == 0);
+    }
 
-    gko_instance_destroy();
-    printf("Connection closed.");
+    for (i = 0; i < count; i++) {
+        if (hosts[i].started) pthread_join(hosts[i].thread, NULL);
+    }
 
-__error_read_grip:
-    free(grip);
+    // a host whose thread could not start goes last, from here, its buffers are all that is left
+    for (i = 0; !relay && i < count; i++) {
+        h = &hosts[i];
+        if (h->ready && (h->dirty || h->deleted_count) && !h->started) gko_run_fanout_host(h);
+    }
+
+    // the index and snapshot of a host describe its remote as of its last complete sync
+    for (i = 0; i < count; i++) {
+        h = &hosts[i];
+        if (!h->ready) continue;
+        if (h->ret != GEKKO_OK) {
+            fprintf(stderr, "%s: sync failed.\n", h->name);
+            error = true;
+            continue;
+        }
+
+        gko_index_close(&h->index);
+        if (gko_index_write(h->idx, &h->scan) != GEKKO_OK || gko_snapshot_commit(h->idx, h->snap) != GEKKO_OK) {
+            error = true;
+        }
+    }
+
+    if (!relay) {
+        printf("fanout: %d hosts, %llu files read once (%llu bytes), %llu sends shared, %llu read by the sender, "
+               "%.1f MB buffered at peak.\n", count, (unsigned long long)fanout.reads,
+               (unsigned long long)fanout.read_bytes, (unsigned long long)fanout.shared,
+               (unsigned long long)fanout.bypassed, fanout.peak / 1e6);
+    }
+
+    ret = (error) ? GEKKO_ERROR : GEKKO_OK;
+
+    for (i = 0; i < count; i++) {
+        gko_index_close(&hosts[i].snapshot);
+        gko_index_close(&hosts[i].index);
+        free(hosts[i].deleted);
+        free(hosts[i].scan.entries);
+    }
+    if (!relay) gko_fanout_free(&fanout);
+
+__error_fanout:
+    gko_scan_free(&scan);
+
+__error_scan:
+    close(rootfd);
+    goto __error_malloc;
+
+__error_grips:
+    free(grips_dir);
+    grips_dir = NULL;
 
 __error_malloc:
+    free(hosts);
+    free(names);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Carry out a plan file written by gekko run -s -o, nothing is scanned, hashed or listed
+    arguments:      path:   plan file path
+                    pass:   password override, may be NULL
+                    key:    key file override, may be NULL
+    return:         error code
+**********************************************************************************************************************/
+static int gko_run_plan(const char *path, const char *pass, const char *key)
+{
+    GKO_PLAN    plan;
+    GKO_INDEX   snapshot;
+    GRIP       *grip            = NULL;
+    const char *remark          = NULL;
+    const char *remote          = NULL;
+    const char *root            = NULL;
+    char        snap[PATH_MAX]  = {0};
+    int         rootfd          = -1;
+    int         ret             = GEKKO_ERROR;
+
+    if (gko_plan_open(path, &plan) != GEKKO_OK) return GEKKO_ERROR;
+
+    remark = gko_plan_string(&plan, plan.header->grip);
+    remote = gko_plan_string(&plan, plan.header->remote);
+    root   = gko_plan_string(&plan, plan.header->root);
+
+    grip = (GRIP *)zalloc(sizeof(GRIP));
+    if (!grip) {
+        fprintf(stderr, "Insufficient memory.\n");
+        goto __error_grip;
+    }
+
+    ret = gko_load_grip(remark, grip);
+    if (ret == GEKKO_OK) ret = gko_snapshot_path(snap, PATH_MAX, grips_dir, remark, remote);
     free(grips_dir);
     grips_dir = NULL;
+    if (ret != GEKKO_OK) goto __error_grip;
+
+    if (pass) snprintf(grip->pass, NAME_MAX, "%s", pass);
+    if (key) snprintf(grip->key, PATH_MAX, "%s", key);
+
+    rootfd = open(root, O_RDONLY | O_DIRECTORY);
+    if (rootfd < 0) {
+        fprintf(stderr, "Cannot open directory: %s.\n", root);
+        ret = GEKKO_ERROR;
+        goto __error_grip;
+    }
+
+    ret = gko_plan_check(&plan, snap, rootfd);
+    if (ret != GEKKO_OK) goto __error_root;
+
+    if (!plan.count) {
+        printf("Plan %s has nothing to do.\n", path);
+        goto __error_root;
+    }
+
+    ret = gko_index_open(snap, &snapshot);
+    if (ret != GEKKO_OK) goto __error_root;
+
+    printf("Plan %s: %lu operations for %s:%s from %s.\n", path, (unsigned long)plan.count, remark, remote, root);
+    ret = gko_plan_run(&plan, grip, rootfd, &snapshot, snap);
+
+    gko_index_close(&snapshot);
+
+__error_root:
+    close(rootfd);
+
+__error_grip:
+    free(grip);
+    gko_plan_close(&plan);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Entry function of Gekko run
+    arguments:      argc:   Count of command line arguments
+                    argv:   Values of command line arguments
+                    agent:  agent running this command on behalf of a client, NULL when run directly
+    return:         error code
+**********************************************************************************************************************/
+static int gko_run(int argc, char *argv[], GKO_AGENT *agent)
+{
+    int         opt             = 0;
+    int         threads         = 0;
+    int         rootfd          = -1;
+    int         ret             = GEKKO_OK;
+    char        root[PATH_MAX]  = {0};
+    char        idx[PATH_MAX]   = {0};
+    char        ign[PATH_MAX]   = {0};
+    char        snap[PATH_MAX]  = {0};
+    char        cache[PATH_MAX] = {0};
+    size_t     *deleted         = NULL;
+    size_t      deleted_count   = 0;
+    size_t      dirty           = 0;
+    size_t      hashed          = 0;
+    size_t      i               = 0;
+    char       *pass            = NULL;
+    char       *key             = NULL;
+    GRIP       *grip            = NULL;
+    bool        watch           = false;
+    bool        rescan          = false;
+    bool        local           = false;
+    bool        fanout          = false;
+    bool        relay           = false;
+    bool        show            = false;
+    bool        touched         = false;
+    char       *output          = NULL;
+    char       *planfile        = NULL;
+    GKO_POOL   *pool            = NULL;
+    GKO_SESSION session;
+    GKO_HASH_CACHE hcache;
+    GKO_IGNORE  ignore;
+    GKO_SCAN    scan;
+    GKO_INDEX   index;
+    GKO_INDEX   snapshot;
+    GKO_PLAN_LIST plan;
+
+    static const struct option options[] = {
+        {"watch",           no_argument,        NULL,   'w'},
+        {"rescan-remote",   no_argument,        NULL,   'r'},
+        {"local",           no_argument,        NULL,   'L'},
+        {"relay",           no_argument,        NULL,   'R'},
+        {"show",            no_argument,        NULL,   's'},
+        {"output",          required_argument,  NULL,   'o'},
+        {"plan",            required_argument,  NULL,   'P'},
+        {NULL,              0,                  NULL,   0},
+    };
+
+    if (argc < 2) {
+        gko_help_run();
+        return GEKKO_OK;
+    }
+
+    while ((opt = getopt_long(argc, argv, "p:k:j:wrLRso:P:", options, NULL)) != -1) {
+        if (opt == 'p') {
+            pass = optarg;
+        } else if (opt == 'k') {
+            key = optarg;
+        } else if (opt == 'j') {
+            threads = atoi(optarg);
+        } else if (opt == 'w') {
+            watch = true;
+        } else if (opt == 'r') {
+            rescan = true;
+        } else if (opt == 'L') {
+            local = true;
+        } else if (opt == 'R') {
+            relay = true;
+        } else if (opt == 's') {
+            show = true;
+        } else if (opt == 'o') {
+            output = optarg;
+        } else if (opt == 'P') {
+            planfile = optarg;
+        }
+    }
+
+    if (planfile) return gko_run_plan(planfile, pass, key);
+
+    if (optind + 1 >= argc) {
+        gko_help_run();
+        return GEKKO_ERROR;
+    }
+
+    fanout = relay || (strstr(argv[optind], GEKKO_FANOUT_SEP) != NULL);
+    if (fanout && watch) {
+        fprintf(stderr, "Watch mode takes one grip and no relay.\n");
+        return GEKKO_ERROR;
+    }
+    if (show && (fanout || watch)) {
+        fprintf(stderr, "A plan takes one grip, no watch mode and no relay.\n");
+        return GEKKO_ERROR;
+    }
+    if (output && !show) {
+        fprintf(stderr, "A plan file is written with -s only.\n");
+        return GEKKO_ERROR;
+    }
+
+    // a running agent skips connecting and authenticating, watch mode keeps its own sessions anyway,
+    // a fan-out opens sessions to every host at once, a plan is worked out against the cached snapshot
+    if (!agent && !watch && !fanout && !show && !local && gko_agent_forward(argc, argv, &ret) == GEKKO_OK) return ret;
+
+    if (!getcwd(root, sizeof(root))) {
+        fprintf(stderr, "Failed to get current directory.\n");
+        return GEKKO_ERROR;
+    }
+
+    snprintf(idx, PATH_MAX, "%s%s%s", root, SEP, GEKKO_INDEX_DIR);
+    if (!gko_dir_exists(idx) && mkdir(idx, 0755) != GEKKO_OK) {
+        fprintf(stderr, "Cannot create directory %s.\n", idx);
+        return GEKKO_ERROR;
+    }
+    snprintf(idx, PATH_MAX, "%s%s%s%s%s%s", root, SEP, GEKKO_INDEX_DIR, SEP, argv[optind], GEKKO_INDEX_SUFFIX);
+    snprintf(cache, PATH_MAX, "%s%s%s%s%s", root, SEP, GEKKO_INDEX_DIR, SEP, GEKKO_HASH_CACHE_FILE);
+
+    snprintf(ign, PATH_MAX, "%s%s%s", root, SEP, GEKKO_IGNORE_FILE);
+    if (gko_ignore_init(&ignore) != GEKKO_OK) return GEKKO_ERROR;
+    if (gko_ignore_load(&ignore, ign) != GEKKO_OK) {
+        ret = GEKKO_ERROR;
+        goto __error_scan;
+    }
+
+    if (watch) {
+        ret = gko_run_watch(argv[optind], argv[optind + 1], root, idx, threads, &ignore, pass, key);
+        goto __error_scan;
+    }
+
+    if (fanout) {
+        ret = gko_run_fanout(argv[optind], argv[optind + 1], root, threads, &ignore, pass, key, rescan, relay);
+        goto __error_scan;
+    }
+
+    grip = (GRIP *)zalloc(sizeof(GRIP));
+    if (!grip) {
+        fprintf(stderr, "Insufficient memory.\n");
+        ret = GEKKO_ERROR;
+        goto __error_scan;
+    }
+
+    ret = gko_load_grip(argv[optind], grip);
+    if (ret == GEKKO_OK) ret = gko_snapshot_path(snap, PATH_MAX, grips_dir, argv[optind], argv[optind + 1]);
+    free(grips_dir);
+    grips_dir = NULL;
+    if (ret != GEKKO_OK) goto __error_grip;
+
+    if (pass) snprintf(grip->pass, NAME_MAX, "%s", pass);
+    if (key) snprintf(grip->key, PATH_MAX, "%s", key);
+
+    if (gko_scan(root, threads, &ignore, &scan) != GEKKO_OK) {
+        fprintf(stderr, "Cannot scan %s.\n", root);
+        ret = GEKKO_ERROR;
+        goto __error_grip;
+    }
+
+    printf("Scanned %lu entries in %.3f s with %d threads (%.0f entries/s), %lu ignored by %u rules.\n",
+           (unsigned long)scan.count, scan.elapsed, scan.threads,
+           (scan.elapsed > 0) ? scan.count / scan.elapsed : 0.0,
+           (unsigned long)scan.ignored, ignore.rules);
+
+    if (gko_index_open(idx, &index) != GEKKO_OK) {
+        ret = GEKKO_ERROR;
+        goto __error_index_open;
+    }
+
+    if (gko_index_diff(&index, &scan, &ignore, &deleted, &deleted_count) != GEKKO_OK) {
+        ret = GEKKO_ERROR;
+        goto __error_index_diff;
+    }
 
-    return (error) ? GEKKO_ERROR : GEKKO_OK;
+    // an index whose records all still match the tree has nothing to record
+    touched = (deleted_count != 0);
+    for (i = 0; !touched && i < scan.count; i++) touched = (scan.entries[i].flags != 0);
+
+    // what left the remote is decided against the snapshot below
+    free(deleted);
+    deleted = NULL;
+
+    rootfd = open(root, O_RDONLY | O_DIRECTORY);
+    if (rootfd < 0) {
+        fprintf(stderr, "Cannot open directory: %s.\n", root);
+        ret = GEKKO_ERROR;
+        goto __error_index_diff;
+    }
+
+    // digests already known for an unchanged stat tuple are reused, whichever grip computed them
+    if (gko_hash_cache_open(cache, &hcache) != GEKKO_OK) fprintf(stderr, "Cannot open hash cache %s.\n", cache);
+    ret = gko_hash_stale(rootfd, &scan, threads, &hcache, &hashed, &dirty);
+    if (ret == GEKKO_OK && gko_hash_cache_changed(&hcache, &scan, hashed)) gko_hash_cache_write(cache, &scan);
+    gko_hash_cache_close(&hcache);
+    if (ret != GEKKO_OK) goto __error_hash;
+
+    // the snapshot is trusted as is, the remote is only listed the first time or when asked to
+    if (gko_index_open(snap, &snapshot) != GEKKO_OK) {
+        ret = GEKKO_ERROR;
+        goto __error_hash;
+    }
+
+    if (rescan || !gko_file_exists(snap)) {
+        touched = true;
+        if (agent) {
+            pool = gko_agent_pool(agent, argv[optind], grip);
+            ret = (pool) ? GEKKO_OK : GEKKO_ERROR;
+            if (pool) session = pool->sessions[0];
+        } else {
+            ret = gko_session_open(&session, grip);
+        }
+        if (ret != GEKKO_OK) {
+            fprintf(stderr, "Cannot create SSH instance (%d).\n", ret);
+            goto __error_snapshot;
+        }
+
+        ret = gko_snapshot_refresh(&session, argv[optind + 1], &ignore, grip->list_window, &scan,
+                                   (snapshot.count) ? &snapshot : &index, snap);
+        if (!agent) gko_session_close(&session);
+        if (ret != GEKKO_OK) goto __error_snapshot;
+
+        gko_index_close(&snapshot);
+        if (gko_index_open(snap, &snapshot) != GEKKO_OK) {
+            ret = GEKKO_ERROR;
+            goto __error_hash;
+        }
+    }
+
+    if (gko_snapshot_reconcile(&snapshot, &scan, &ignore, &deleted, &deleted_count, &dirty) != GEKKO_OK) {
+        ret = GEKKO_ERROR;
+        goto __error_snapshot;
+    }
+
+    printf("Hashed %lu entries, %lu changed, %lu deleted.\n",
+           (unsigned long)hashed, (unsigned long)dirty, (unsigned long)deleted_count);
+
+    // nothing is sent and the index stays put, the next run still sees every change the plan lists
+    if (show) {
+        ret = gko_plan_build(&scan, &snapshot, deleted, deleted_count, &plan);
+        if (ret != GEKKO_OK) goto __error_snapshot;
+
+        gko_plan_print(&plan, &scan, &snapshot);
+        if (output) {
+            ret = gko_plan_write(output, &plan, &scan, &snapshot, argv[optind], argv[optind + 1], root, snap);
+            if (ret == GEKKO_OK) printf("Plan written to %s.\n", output);
+        }
+        gko_plan_free(&plan);
+        goto __error_snapshot;
+    }
+
+    if (dirty || deleted_count) {
+        if (agent && !pool) pool = gko_agent_pool(agent, argv[optind], grip);
+        if (agent && !pool) {
+            ret = GEKKO_ERROR;
+            goto __error_snapshot;
+        }
+
+        ret = gko_sync(pool, grip, argv[optind + 1], rootfd, &scan, &snapshot, deleted, deleted_count, NULL, 0);
+
+        // the index and snapshot describe the remote as of the last complete sync, keep the old ones otherwise
+        if (ret != GEKKO_OK) goto __error_snapshot;
+    }
+
+    // nothing changed on either side, the index and snapshot on disk already say so
+    if (!touched && !dirty && !deleted_count) goto __error_snapshot;
+
+    gko_index_close(&index);
+    ret = gko_index_write(idx, &scan);
+    if (ret == GEKKO_OK) ret = gko_snapshot_commit(idx, snap);
+
+__error_snapshot:
+    gko_index_close(&snapshot);
+
+__error_hash:
+    close(rootfd);
+    free(deleted);
+
+__error_index_diff:
+    gko_index_close(&index);
+
+__error_index_open:
+    gko_scan_free(&scan);
+
+__error_grip:
+    if (agent) gko_agent_release(agent, pool, ret);
+    free(grip);
+
+__error_scan:
+    gko_ignore_free(&ignore);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Run a command line forwarded to the agent
+    arguments:      argc:   Count of command line arguments
+                    argv:   Values of command line arguments
+                    agent:  agent
+    return:         error code
+**********************************************************************************************************************/
+static int gko_agent_handle(int argc, char *argv[], GKO_AGENT *agent)
+{
+    if (strcmp(argv[0], "run") == GEKKO_OK) return gko_run(argc, argv, agent);
+
+    fprintf(stderr, "The agent cannot run %s.\n", argv[0]);
+
+    return GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Entry function of Gekko agent
+    arguments:      argc:   Count of command line arguments
+                    argv:   Values of command line arguments
+    return:         error code
+**********************************************************************************************************************/
+static int gko_agent(int argc, char *argv[])
+{
+    int     opt             = 0;
+    int     idle            = 0;
+    int     status          = GEKKO_ERROR;
+    char   *stop[]          = {"stop"};
+
+    while ((opt = getopt(argc, argv, "t:kh")) != -1) {
+        if (opt == 't') {
+            idle = atoi(optarg);
+        } else if (opt == 'k') {
+            if (gko_agent_forward(1, stop, &status) != GEKKO_OK) {
+                fprintf(stderr, "No agent is running.\n");
+                return GEKKO_ERROR;
+            }
+            return status;
+        } else {
+            gko_help_agent();
+            return GEKKO_OK;
+        }
+    }
+
+    return gko_agent_serve(idle, gko_agent_handle);
+}
+/**********************************************************************************************************************
+    description:    Entry function of Gekko remote helper, run by the local gekko over an exec channel
+    arguments:      argc:   Count of command line arguments
+                    argv:   Values of command line arguments
+    return:         error code
+**********************************************************************************************************************/
+static int gko_remote(int argc, char *argv[])
+{
+    GKO_SIGNATURE       sig;
+    GKO_DELTA_STATS     stats;
+    struct stat         st;
+    char                temp[PATH_MAX]  = {0};
+    uint8_t            *data            = NULL;
+    int                 in              = STDIN_FILENO;
+    int                 out             = STDOUT_FILENO;
+    int                 fd              = -1;
+    int                 tmp             = -1;
+    int                 ret             = GEKKO_ERROR;
+    int                 level           = 0;
+    uint64_t            wire            = 0;
+    double              entropy         = 0;
+    clock_t             begin           = 0;
+    GKO_CLASS           cls             = GKO_CLASS_MAX;
+
+    if (argc < 3) return GEKKO_ERROR;
+
+    if (strcmp(argv[1], "sig") == GEKKO_OK && argc == 4) {
+        fd = open(argv[3], O_RDONLY);
+        if (fd < 0) return GEKKO_ERROR;
+
+        ret = gko_delta_signature(fd, (uint32_t)atoi(argv[2]), gko_fd_writer, &out);
+        close(fd);
+
+    } else if (strcmp(argv[1], "patch") == GEKKO_OK && argc == 4) {
+        fd = open(argv[3], O_RDONLY);
+        if (fd < 0) return GEKKO_ERROR;
+
+        snprintf(temp, PATH_MAX, "%s.gekko-XXXXXX", argv[3]);
+        tmp = mkstemp(temp);
+        if (tmp < 0) {
+            close(fd);
+            return GEKKO_ERROR;
+        }
+
+        ret = gko_delta_patch(fd, gko_fd_reader, &in, tmp);
+        if (ret == GEKKO_OK) {
+            fchmod(tmp, (mode_t)strtol(argv[2], NULL, 8));
+            if (fsync(tmp) != GEKKO_OK) ret = GEKKO_ERROR;
+        }
+
+        close(tmp);
+        close(fd);
+
+        if (ret == GEKKO_OK && rename(temp, argv[3]) != GEKKO_OK) ret = GEKKO_ERROR;
+        if (ret != GEKKO_OK) unlink(temp);
+
+    } else if (strcmp(argv[1], "unzstd") == GEKKO_OK && argc == 4) {
+        snprintf(temp, PATH_MAX, "%s.gekko-XXXXXX", argv[3]);
+        tmp = mkstemp(temp);
+        if (tmp < 0) return GEKKO_ERROR;
+
+        ret = gko_compress_decode(gko_fd_reader, &in, tmp);
+        if (ret == GEKKO_OK) {
+            fchmod(tmp, (mode_t)strtol(argv[2], NULL, 8));
+            if (fsync(tmp) != GEKKO_OK) ret = GEKKO_ERROR;
+        }
+
+        close(tmp);
+
+        if (ret == GEKKO_OK && rename(temp, argv[3]) != GEKKO_OK) ret = GEKKO_ERROR;
+        if (ret != GEKKO_OK) unlink(temp);
+
+    } else if (strcmp(argv[1], "relay") == GEKKO_OK && argc >= 4) {
+        ret = gko_relay_serve(in, out, argv[2], argv[3], &argv[4], argc - 4);
+
+    } else if (strcmp(argv[1], "zstd") == GEKKO_OK && argc == 3) {
+        // local counterpart of unzstd, shows what the sniff decides for a file: zstd | unzstd
+        fd = open(argv[2], O_RDONLY);
+        if (fd < 0 || fstat(fd, &st) != GEKKO_OK) return GEKKO_ERROR;
+
+        begin = clock();
+        cls = gko_compress_sniff(fd, &entropy);
+        level = gko_compress_level(cls, 0);
+        ret = gko_compress_encode(fd, level ? level : 1, gko_fd_writer, &out, &wire);
+        fprintf(stderr, "%llu bytes: %s, %.2f bits/byte, level %d, %llu compressed (%.1f%%) in %.3f s CPU.\n",
+                (unsigned long long)st.st_size, gko_compress_class_name(cls), entropy, level,
+                (unsigned long long)wire, st.st_size ? 100.0 * wire / st.st_size : 0.0,
+                (double)(clock() - begin) / CLOCKS_PER_SEC);
+        close(fd);
+
+    } else if (strcmp(argv[1], "delta") == GEKKO_OK) {
+        // local counterpart of patch, useful to measure delta size of an edit: sig | delta | patch
+        fd = open(argv[2], O_RDONLY);
+        if (fd < 0 || fstat(fd, &st) != GEKKO_OK) return GEKKO_ERROR;
+
+        data = (uint8_t *)mmap(NULL, st.st_size ? (size_t)st.st_size : 1, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) return GEKKO_ERROR;
+
+        if (gko_delta_signature_read(gko_fd_reader, &in, &sig) == GEKKO_OK) {
+            ret = gko_delta_encode(data, (size_t)st.st_size, &sig, gko_fd_writer, &out, &stats);
+            fprintf(stderr, "%llu bytes: %llu matched, %llu literal, %llu on the wire (%.1f%%).\n",
+                    (unsigned long long)st.st_size, (unsigned long long)stats.matched,
+                    (unsigned long long)stats.literal, (unsigned long long)stats.wire,
+                    st.st_size ? 100.0 * stats.wire / st.st_size : 0.0);
+            gko_delta_signature_free(&sig);
+        }
+
+        munmap(data, st.st_size ? (size_t)st.st_size : 1);
+    }
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Entry function of Gekko
+    arguments:      argc:   Count of command line arguments
+                    argv:   Values of command line arguments
+    return:         error code
+**********************************************************************************************************************/
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        gko_help_main();
+        return GEKKO_OK;
+
+    } else {
+        if (strcmp(argv[1], "camo") == GEKKO_OK) {
+            return gko_camo(argc - 1, &argv[1]);
+
+        } else if (strcmp(argv[1], "grip") == GEKKO_OK) {
+            return gko_grip(argc - 1, &argv[1]);
+
+        } else if (strcmp(argv[1], "hash") == GEKKO_OK) {
+            return gko_hash_tree(argc - 1, &argv[1]);
+
+        } else if (strcmp(argv[1], "rate") == GEKKO_OK) {
+            return gko_rate_check(argc - 1, &argv[1]);
+
+        } else if (strcmp(argv[1], "schedule") == GEKKO_OK) {
+            return gko_schedule_check(argc - 1, &argv[1]);
+
+        } else if (strcmp(argv[1], "source") == GEKKO_OK) {
+            return gko_source_check(argc - 1, &argv[1]);
+
+        } else if (strcmp(argv[1], "readahead") == GEKKO_OK) {
+            return gko_readahead_check(argc - 1, &argv[1]);
+
+        } else if (strcmp(argv[1], "run") == GEKKO_OK) {
+            return gko_run(argc - 1, &argv[1], NULL);
+
+        } else if (strcmp(argv[1], "agent") == GEKKO_OK) {
+            return gko_agent(argc - 1, &argv[1]);
+
+        } else if (strcmp(argv[1], "remote") == GEKKO_OK) {
+            return gko_remote(argc - 1, &argv[1]);
+
+        } else {
+            printf("Invalid command: %s\n", argv[1]);
+            return GEKKO_ERROR;
+        }
+    }
+
+    return GEKKO_OK;
 }
 /**********************************************************************************************************************
     end
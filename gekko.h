@@ -16,7 +16,7 @@
 #define NAME_MAX                        (255)
 #endif
 #ifndef TOKEN_MAX
-#define TOKEN_MAX                       (32)
+#define TOKEN_MAX                       (128)       // json tokens parsed on the stack, more grow on the heap
 #endif
 /**********************************************************************************************************************
     gekko defaults
@@ -43,6 +43,32 @@ typedef enum {
     AUTH_METHOD_KEYBOARD_INTERACTIVE   = (1 << 1),
     AUTH_METHOD_PUBLIC_KEY             = (1 << 2),
 } AUTH_METHOD;
+/**********************************************************************************************************************
+    transfer engines
+**********************************************************************************************************************/
+typedef enum {
+    GEKKO_ENGINE_THREADS    = 0,
+    GEKKO_ENGINE_EVENTS     = 1,
+} GEKKO_ENGINE;
+/**********************************************************************************************************************
+    transfer ordering policies
+**********************************************************************************************************************/
+typedef enum {
+    GEKKO_SCHEDULE_LPT      = 0,        // longest first, small files fill the gaps at the end
+    GEKKO_SCHEDULE_PATH     = 1,        // path order, as scanned
+    GEKKO_SCHEDULE_SPLIT    = 2,        // longest first, files bigger than a fair share cut into ranges
+    GEKKO_SCHEDULE_MAX,
+} GEKKO_SCHEDULE;
+/**********************************************************************************************************************
+    read-ahead engines
+**********************************************************************************************************************/
+typedef enum {
+    GEKKO_READAHEAD_AUTO    = 0,        // io_uring where the kernel allows it, pread threads elsewhere
+    GEKKO_READAHEAD_URING   = 1,
+    GEKKO_READAHEAD_THREADS = 2,
+    GEKKO_READAHEAD_OFF     = 3,
+    GEKKO_READAHEAD_MAX,
+} GEKKO_READAHEAD;
 /**********************************************************************************************************************
     gekko grip type
 **********************************************************************************************************************/
@@ -53,7 +79,30 @@ typedef struct {
     char            user[NAME_MAX];
     char            pass[NAME_MAX];
     char            key[PATH_MAX];
+    char            gekko[PATH_MAX];
+    int             sessions;
+    int             window;
+    int64_t         bulk_threshold;
+    char            bulk_command[PATH_MAX];
+    GEKKO_ENGINE    engine;
+    GEKKO_SCHEDULE  schedule;
+    int             ops;
+    int             list_window;
+    int             compress;
+    int64_t         rate_limit;     // bytes per second over every session to the host, 0 for no limit
+    GEKKO_READAHEAD readahead;
+    int             readahead_depth;
 } GRIP;
+/**********************************************************************************************************************
+    shared helpers
+**********************************************************************************************************************/
+#define gko_error_return(prompt)                    \
+    if (ret != GEKKO_OK) {                          \
+        fprintf(stderr, prompt " (%d).\n", ret);    \
+        return GEKKO_ERROR;                         \
+    }
+
+void *zalloc(size_t size);
 
 #endif  // __GEKKO_H
 /**********************************************************************************************************************
@@ -0,0 +1,975 @@
+/**********************************************************************************************************************
+    file:           hash.c
+    description:    Content hashing of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "gekko.h"
+#include "hash.h"
+/**********************************************************************************************************************
+    hash constants, borrowed from xxHash
+**********************************************************************************************************************/
+#define P32_1                           (2654435761U)
+#define P32_2                           (2246822519U)
+#define P32_5                           (374761393U)
+#define P64_1                           (11400714785074694791ULL)
+#define P64_2                           (14029467366897019727ULL)
+#define P64_3                           (1609587929392839161ULL)
+#define P64_4                           (9650029242287828579ULL)
+#define P64_5                           (2870177450012600261ULL)
+
+#define gko_rotl32(x, r)                (((x) << (r)) | ((x) >> (32 - (r))))
+#define gko_rotl64(x, r)                (((x) << (r)) | ((x) >> (64 - (r))))
+/**********************************************************************************************************************
+    hash types
+**********************************************************************************************************************/
+typedef struct {
+    const char     *name;
+    void          (*stripes)(uint32_t *lanes, const uint8_t *p, size_t n);
+    int           (*supported)(void);
+} GKO_HASH_KERNEL;
+
+typedef struct {
+    size_t          entry;
+    uint64_t        chunk;          // GKO_HASH_WHOLE for a file hashed in one go
+    uint64_t        hash;
+} GKO_HASH_JOB;
+
+typedef struct {
+    pthread_t       thread;
+    bool            started;
+    int             rootfd;
+    const GKO_SCAN *scan;
+    GKO_HASH_JOB   *jobs;
+    size_t          count;
+    size_t         *next;
+    int            *error;
+} GKO_HASH_WORKER;
+
+typedef struct {
+    const uint8_t  *data;
+    size_t          len;
+    uint64_t        hash;
+} GKO_HASH_SLICE;
+
+#define GKO_HASH_WHOLE                  (UINT64_MAX)
+/**********************************************************************************************************************
+    description:    Read little endian 32-bit value
+    arguments:      p:      source bytes
+    return:         value
+**********************************************************************************************************************/
+static uint32_t gko_read32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+/**********************************************************************************************************************
+    description:    Consume whole stripes, portable kernel
+    arguments:      lanes:  lane accumulators
+                    p:      input
+                    n:      number of stripes
+    return:         -
+**********************************************************************************************************************/
+static void gko_hash_stripes_scalar(uint32_t *lanes, const uint8_t *p, size_t n)
+{
+    uint32_t    v;
+    int         i;
+
+    while (n--) {
+        for (i = 0; i < GEKKO_HASH_LANES; i++) {
+            v = lanes[i] + gko_read32(p + 4 * i) * P32_2;
+            lanes[i] = gko_rotl32(v, 13) * P32_1;
+        }
+        p += GEKKO_HASH_STRIPE;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/**********************************************************************************************************************
+    description:    Consume whole stripes, one 256-bit register holds all 8 lanes
+    arguments:      lanes:  lane accumulators
+                    p:      input
+                    n:      number of stripes
+    return:         -
+**********************************************************************************************************************/
+__attribute__((target("avx2")))
+static void gko_hash_stripes_avx2(uint32_t *lanes, const uint8_t *p, size_t n)
+{
+    const __m256i   prime1  = _mm256_set1_epi32((int)P32_1);
+    const __m256i   prime2  = _mm256_set1_epi32((int)P32_2);
+    __m256i         acc     = _mm256_loadu_si256((const __m256i *)lanes);
+    __m256i         v;
+
+    while (n--) {
+        v = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)p), prime2);
+        acc = _mm256_add_epi32(acc, v);
+        acc = _mm256_or_si256(_mm256_slli_epi32(acc, 13), _mm256_srli_epi32(acc, 19));
+        acc = _mm256_mullo_epi32(acc, prime1);
+        p += GEKKO_HASH_STRIPE;
+    }
+
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+}
+/**********************************************************************************************************************
+    description:    Consume whole stripes, two 128-bit registers of 4 lanes each
+    arguments:      lanes:  lane accumulators
+                    p:      input
+                    n:      number of stripes
+    return:         -
+**********************************************************************************************************************/
+__attribute__((target("sse4.1")))
+static void gko_hash_stripes_sse41(uint32_t *lanes, const uint8_t *p, size_t n)
+{
+    const __m128i   prime1  = _mm_set1_epi32((int)P32_1);
+    const __m128i   prime2  = _mm_set1_epi32((int)P32_2);
+    __m128i         lo      = _mm_loadu_si128((const __m128i *)lanes);
+    __m128i         hi      = _mm_loadu_si128((const __m128i *)(lanes + 4));
+    __m128i         a, b;
+
+    while (n--) {
+        a = _mm_add_epi32(lo, _mm_mullo_epi32(_mm_loadu_si128((const __m128i *)p), prime2));
+        b = _mm_add_epi32(hi, _mm_mullo_epi32(_mm_loadu_si128((const __m128i *)(p + 16)), prime2));
+        lo = _mm_mullo_epi32(_mm_or_si128(_mm_slli_epi32(a, 13), _mm_srli_epi32(a, 19)), prime1);
+        hi = _mm_mullo_epi32(_mm_or_si128(_mm_slli_epi32(b, 13), _mm_srli_epi32(b, 19)), prime1);
+        p += GEKKO_HASH_STRIPE;
+    }
+
+    _mm_storeu_si128((__m128i *)lanes, lo);
+    _mm_storeu_si128((__m128i *)(lanes + 4), hi);
+}
+
+static int gko_hash_has_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static int gko_hash_has_sse41(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.1");
+}
+#endif
+
+#if defined(__aarch64__) && !defined(__ARM_BIG_ENDIAN)
+/**********************************************************************************************************************
+    description:    Consume whole stripes, two NEON registers of 4 lanes each
+    arguments:      lanes:  lane accumulators
+                    p:      input
+                    n:      number of stripes
+    return:         -
+**********************************************************************************************************************/
+static void gko_hash_stripes_neon(uint32_t *lanes, const uint8_t *p, size_t n)
+{
+    const uint32x4_t    prime1  = vdupq_n_u32(P32_1);
+    const uint32x4_t    prime2  = vdupq_n_u32(P32_2);
+    uint32x4_t          lo      = vld1q_u32(lanes);
+    uint32x4_t          hi      = vld1q_u32(lanes + 4);
+    uint32x4_t          a, b;
+
+    while (n--) {
+        a = vmlaq_u32(lo, vreinterpretq_u32_u8(vld1q_u8(p)), prime2);
+        b = vmlaq_u32(hi, vreinterpretq_u32_u8(vld1q_u8(p + 16)), prime2);
+        lo = vmulq_u32(vsriq_n_u32(vshlq_n_u32(a, 13), a, 19), prime1);
+        hi = vmulq_u32(vsriq_n_u32(vshlq_n_u32(b, 13), b, 19), prime1);
+        p += GEKKO_HASH_STRIPE;
+    }
+
+    vst1q_u32(lanes, lo);
+    vst1q_u32(lanes + 4, hi);
+}
+
+static int gko_hash_has_neon(void)
+{
+    return 1;
+}
+#endif
+
+static int gko_hash_has_scalar(void)
+{
+    return 1;
+}
+/**********************************************************************************************************************
+    stripe kernels, best first, all of them compute the very same lanes
+**********************************************************************************************************************/
+static const GKO_HASH_KERNEL gko_hash_kernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    {"avx2",    gko_hash_stripes_avx2,      gko_hash_has_avx2},
+    {"sse4.1",  gko_hash_stripes_sse41,     gko_hash_has_sse41},
+#endif
+#if defined(__aarch64__) && !defined(__ARM_BIG_ENDIAN)
+    {"neon",    gko_hash_stripes_neon,      gko_hash_has_neon},
+#endif
+    {"scalar",  gko_hash_stripes_scalar,    gko_hash_has_scalar},
+};
+
+static const GKO_HASH_KERNEL   *gko_hash_active = NULL;
+/**********************************************************************************************************************
+    description:    Pick the best stripe kernel the CPU runs, once
+    arguments:      -
+    return:         kernel
+**********************************************************************************************************************/
+static const GKO_HASH_KERNEL *gko_hash_pick(void)
+{
+    const GKO_HASH_KERNEL  *kernel  = __atomic_load_n(&gko_hash_active, __ATOMIC_ACQUIRE);
+    size_t                  i       = 0;
+
+    if (kernel) return kernel;
+
+    for (i = 0; i < sizeof(gko_hash_kernels) / sizeof(gko_hash_kernels[0]); i++) {
+        if (gko_hash_kernels[i].supported()) break;
+    }
+
+    // every thread that races here picks the same kernel
+    kernel = &gko_hash_kernels[i];
+    __atomic_store_n(&gko_hash_active, kernel, __ATOMIC_RELEASE);
+
+    return kernel;
+}
+/**********************************************************************************************************************
+    description:    Name of the stripe kernel in use
+    arguments:      -
+    return:         kernel name
+**********************************************************************************************************************/
+const char *gko_hash_kernel(void)
+{
+    return gko_hash_pick()->name;
+}
+/**********************************************************************************************************************
+    description:    Initialize hash state
+    arguments:      state:  hash state
+    return:         -
+**********************************************************************************************************************/
+void gko_hash_init(GKO_HASH *state)
+{
+    int i;
+
+    memset(state, 0, sizeof(GKO_HASH));
+    for (i = 0; i < GEKKO_HASH_LANES; i++) {
+        state->lanes[i] = P32_5 + (uint32_t)i * P32_1;
+    }
+}
+/**********************************************************************************************************************
+    description:    Feed data to hash state
+    arguments:      state:  hash state
+                    data:   input
+                    len:    input length
+    return:         -
+**********************************************************************************************************************/
+void gko_hash_update(GKO_HASH *state, const void *data, size_t len)
+{
+    const uint8_t  *p   = (const uint8_t *)data;
+    size_t          n   = 0;
+
+    state->length += len;
+
+    if (state->buffered) {
+        n = GEKKO_HASH_STRIPE - state->buffered;
+        if (n > len) n = len;
+        memcpy(state->buffer + state->buffered, p, n);
+        state->buffered += n;
+        p += n;
+        len -= n;
+
+        if (state->buffered < GEKKO_HASH_STRIPE) return;
+
+        gko_hash_pick()->stripes(state->lanes, state->buffer, 1);
+        state->buffered = 0;
+    }
+
+    n = len / GEKKO_HASH_STRIPE;
+    gko_hash_pick()->stripes(state->lanes, p, n);
+    p += n * GEKKO_HASH_STRIPE;
+    len -= n * GEKKO_HASH_STRIPE;
+
+    memcpy(state->buffer, p, len);
+    state->buffered = len;
+}
+/**********************************************************************************************************************
+    description:    Finish hash
+    arguments:      state:  hash state
+    return:         64-bit digest
+**********************************************************************************************************************/
+uint64_t gko_hash_final(GKO_HASH *state)
+{
+    uint64_t    h   = state->length * P64_5;
+    size_t      i   = 0;
+
+    for (i = 0; i < GEKKO_HASH_LANES; i++) {
+        h ^= (uint64_t)state->lanes[i] * P64_2;
+        h = gko_rotl64(h, 27) * P64_1 + P64_4;
+    }
+
+    for (i = 0; i < state->buffered; i++) {
+        h ^= state->buffer[i] * P64_5;
+        h = gko_rotl64(h, 11) * P64_1;
+    }
+
+    h ^= h >> 33;
+    h *= P64_2;
+    h ^= h >> 29;
+    h *= P64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+/**********************************************************************************************************************
+    description:    Hash a memory block
+    arguments:      data:   input
+                    len:    input length
+    return:         64-bit digest
+**********************************************************************************************************************/
+uint64_t gko_hash(const void *data, size_t len)
+{
+    GKO_HASH state;
+
+    gko_hash_init(&state);
+    gko_hash_update(&state, data, len);
+
+    return gko_hash_final(&state);
+}
+/**********************************************************************************************************************
+    description:    Hash one chunk of a large file
+    arguments:      fd:     open file
+                    offset: chunk offset
+                    len:    chunk length
+                    buffer: GEKKO_HASH_BUFFER bytes of scratch
+                    hash:   digest to store
+    return:         error code
+**********************************************************************************************************************/
+static int gko_hash_chunk(int fd, uint64_t offset, uint64_t len, uint8_t *buffer, uint64_t *hash)
+{
+    GKO_HASH    state;
+    ssize_t     n       = 0;
+
+    gko_hash_init(&state);
+
+    while (len) {
+        n = pread(fd, buffer, (len < GEKKO_HASH_BUFFER) ? (size_t)len : GEKKO_HASH_BUFFER, (off_t)offset);
+        if (n < 0) return GEKKO_ERROR;
+        if (n == 0) break;
+
+        gko_hash_update(&state, buffer, (size_t)n);
+        offset += (uint64_t)n;
+        len -= (uint64_t)n;
+    }
+
+    *hash = gko_hash_final(&state);
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Hash file content into a caller provided buffer
+    arguments:      dirfd:  directory the path is relative to, AT_FDCWD for current directory
+                    path:   file path
+                    mode:   file mode from stat
+                    buffer: GEKKO_HASH_BUFFER bytes of scratch
+                    hash:   digest to store
+    return:         error code
+**********************************************************************************************************************/
+static int gko_hash_read(int dirfd, const char *path, uint32_t mode, uint8_t *buffer, uint64_t *hash)
+{
+    GKO_HASH    state;
+    struct stat st;
+    uint64_t    chunk   = 0;
+    uint64_t    offset  = 0;
+    ssize_t     n       = 0;
+    int         fd      = -1;
+    int         ret     = GEKKO_OK;
+
+    *hash = 0;
+    if (S_ISDIR(mode)) return GEKKO_OK;
+
+    gko_hash_init(&state);
+
+    if (S_ISLNK(mode)) {
+        n = readlinkat(dirfd, path, (char *)buffer, GEKKO_HASH_BUFFER);
+        if (n < 0) return GEKKO_ERROR;
+        gko_hash_update(&state, buffer, (size_t)n);
+        *hash = gko_hash_final(&state);
+        return GEKKO_OK;
+    }
+
+    fd = openat(dirfd, path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return GEKKO_ERROR;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return GEKKO_ERROR;
+    }
+
+    if ((uint64_t)st.st_size >= GEKKO_HASH_CHUNKED_MIN) {
+        // the digest of a large file is the hash of its chunk digests, chunks may be hashed on any core
+        for (offset = 0; offset < (uint64_t)st.st_size && ret == GEKKO_OK; offset += GEKKO_HASH_CHUNK) {
+            ret = gko_hash_chunk(fd, offset, GEKKO_HASH_CHUNK, buffer, &chunk);
+            gko_hash_update(&state, &chunk, sizeof(chunk));
+        }
+    } else {
+        while ((n = read(fd, buffer, GEKKO_HASH_BUFFER)) > 0) {
+            gko_hash_update(&state, buffer, (size_t)n);
+        }
+        if (n < 0) ret = GEKKO_ERROR;
+    }
+
+    close(fd);
+    if (ret == GEKKO_OK) *hash = gko_hash_final(&state);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Hash file content, or link target for symbolic links
+    arguments:      dirfd:  directory the path is relative to, AT_FDCWD for current directory
+                    path:   file path
+                    mode:   file mode from stat
+                    hash:   digest to store
+    return:         error code
+**********************************************************************************************************************/
+int gko_hash_file(int dirfd, const char *path, uint32_t mode, uint64_t *hash)
+{
+    uint8_t    *buffer  = NULL;
+    int         ret     = GEKKO_OK;
+
+    if (!path) return GEKKO_ERROR;
+    if (!hash) return GEKKO_ERROR;
+
+    buffer = (uint8_t *)malloc(GEKKO_HASH_BUFFER);
+    if (!buffer) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    ret = gko_hash_read(dirfd, path, mode, buffer, hash);
+    if (ret != GEKKO_OK) fprintf(stderr, "Cannot read %s.\n", path);
+    free(buffer);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Hashing worker, takes whole files and chunks of large files until none is left
+    arguments:      arg:    worker
+    return:         NULL
+**********************************************************************************************************************/
+static void *gko_hash_worker(void *arg)
+{
+    GKO_HASH_WORKER    *worker  = (GKO_HASH_WORKER *)arg;
+    const GKO_ENTRY    *entry   = NULL;
+    GKO_HASH_JOB       *job     = NULL;
+    uint8_t            *buffer  = NULL;
+    size_t              i       = 0;
+    int                 fd      = -1;
+    int                 ret     = GEKKO_OK;
+
+    buffer = (uint8_t *)malloc(GEKKO_HASH_BUFFER);
+    if (!buffer) {
+        fprintf(stderr, "Insufficient memory.\n");
+        __atomic_store_n(worker->error, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    while ((i = __atomic_fetch_add(worker->next, 1, __ATOMIC_RELAXED)) < worker->count) {
+        job = &worker->jobs[i];
+        entry = &worker->scan->entries[job->entry];
+
+        if (job->chunk == GKO_HASH_WHOLE) {
+            ret = gko_hash_read(worker->rootfd, entry->path, entry->mode, buffer, &job->hash);
+        } else {
+            fd = openat(worker->rootfd, entry->path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+            ret = (fd < 0) ? GEKKO_ERROR : gko_hash_chunk(fd, job->chunk * GEKKO_HASH_CHUNK, GEKKO_HASH_CHUNK,
+                                                           buffer, &job->hash);
+            if (fd >= 0) close(fd);
+        }
+
+        if (ret != GEKKO_OK) {
+            fprintf(stderr, "Cannot read %s.\n", entry->path);
+            __atomic_store_n(worker->error, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    free(buffer);
+
+    return NULL;
+}
+/**********************************************************************************************************************
+    description:    Find the cached digest of an entry
+    arguments:      cache:  hash cache
+                    entry:  scanned entry
+                    hash:   digest to store
+    return:         true if the cache holds the entry with the same stat tuple
+**********************************************************************************************************************/
+static bool gko_hash_cached(const GKO_HASH_CACHE *cache, const GKO_ENTRY *entry, uint64_t *hash)
+{
+    const GKO_HASH_RECORD  *rec     = NULL;
+    size_t                  lo      = 0;
+    size_t                  hi      = cache->count;
+    size_t                  mid     = 0;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        rec = &cache->records[mid];
+        if (rec->dev < entry->dev || (rec->dev == entry->dev && rec->inode < entry->inode)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo == cache->count) return false;
+
+    rec = &cache->records[lo];
+    if (rec->dev != entry->dev || rec->inode != entry->inode || rec->size != entry->size ||
+        rec->mtime_ns != entry->mtime_ns || rec->ctime_ns != entry->ctime_ns) return false;
+
+    *hash = rec->hash;
+
+    return true;
+}
+/**********************************************************************************************************************
+    description:    Settle the digest of an entry and flag it dirty if its content moved
+    arguments:      entry:  scanned entry
+                    hash:   fresh digest
+    return:         -
+**********************************************************************************************************************/
+static void gko_hash_settle(GKO_ENTRY *entry, uint64_t hash)
+{
+    if (hash != entry->hash) entry->flags |= GKO_ENTRY_DIRTY;
+    entry->hash = hash;
+}
+/**********************************************************************************************************************
+    description:    Hash entries whose stat tuple moved on every core, flag the ones whose content did change
+    arguments:      rootfd:     directory the scan paths are relative to
+                    scan:       scan flagged by the index, hashes are updated in place
+                    threads:    hashing threads, 0 for one per CPU
+                    cache:      digests known by stat tuple, NULL for none
+                    hashed:     number of entries read, may be NULL
+                    dirty:      number of dirty entries afterwards, may be NULL
+    return:         error code
+**********************************************************************************************************************/
+int gko_hash_stale(int rootfd, GKO_SCAN *scan, int threads, const GKO_HASH_CACHE *cache,
+                   size_t *hashed, size_t *dirty)
+{
+    GKO_HASH_WORKER    *workers = NULL;
+    GKO_HASH_JOB       *jobs    = NULL;
+    GKO_ENTRY          *entry   = NULL;
+    GKO_HASH            state;
+    uint64_t            hash    = 0;
+    uint64_t            chunks  = 0;
+    uint64_t            c       = 0;
+    size_t              count   = 0;
+    size_t              large   = 0;
+    size_t              next    = 0;
+    size_t              nhashed = 0;
+    size_t              ndirty  = 0;
+    size_t              i, j;
+    int                 error   = 0;
+    int                 n       = 0;
+
+    if (!scan) return GEKKO_ERROR;
+
+    // only entries whose stat tuple moved get read, a touched but identical file is not dirty
+    for (i = 0; i < scan->count; i++) {
+        entry = &scan->entries[i];
+        if (!(entry->flags & GKO_ENTRY_STALE)) continue;
+
+        if (S_ISDIR(entry->mode)) {
+            gko_hash_settle(entry, 0);
+        } else if (cache && cache->count && gko_hash_cached(cache, entry, &hash)) {
+            gko_hash_settle(entry, hash);
+        } else if (S_ISREG(entry->mode) && entry->size >= GEKKO_HASH_CHUNKED_MIN) {
+            count += (size_t)((entry->size + GEKKO_HASH_CHUNK - 1) / GEKKO_HASH_CHUNK);
+        } else {
+            count++;
+        }
+    }
+
+    if (count) {
+        jobs = (GKO_HASH_JOB *)malloc(count * sizeof(GKO_HASH_JOB));
+        if (!jobs) {
+            fprintf(stderr, "Insufficient memory.\n");
+            return GEKKO_ERROR;
+        }
+
+        // chunks of large files go first so the longest work starts early, small files fill in behind
+        for (i = 0, j = 0; i < scan->count; i++) {
+            entry = &scan->entries[i];
+            if (!(entry->flags & GKO_ENTRY_STALE) || S_ISDIR(entry->mode)) continue;
+            if (cache && cache->count && gko_hash_cached(cache, entry, &hash)) continue;
+
+            if (S_ISREG(entry->mode) && entry->size >= GEKKO_HASH_CHUNKED_MIN) {
+                chunks = (entry->size + GEKKO_HASH_CHUNK - 1) / GEKKO_HASH_CHUNK;
+                for (c = 0; c < chunks; c++) {
+                    jobs[large].entry = i;
+                    jobs[large].chunk = c;
+                    large++;
+                }
+            } else {
+                jobs[count - 1 - j].entry = i;
+                jobs[count - 1 - j].chunk = GKO_HASH_WHOLE;
+                j++;
+            }
+        }
+
+        if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads > GEKKO_HASH_THREADS_MAX) threads = GEKKO_HASH_THREADS_MAX;
+        if ((size_t)threads > count) threads = (int)count;
+        if (threads <= 0) threads = 1;
+
+        workers = (GKO_HASH_WORKER *)zalloc(threads * sizeof(GKO_HASH_WORKER));
+        if (!workers) {
+            fprintf(stderr, "Insufficient memory.\n");
+            free(jobs);
+            return GEKKO_ERROR;
+        }
+
+        for (n = 0; n < threads; n++) {
+            workers[n].rootfd = rootfd;
+            workers[n].scan   = scan;
+            workers[n].jobs   = jobs;
+            workers[n].count  = count;
+            workers[n].next   = &next;
+            workers[n].error  = &error;
+            workers[n].started = (n > 0 && pthread_create(&workers[n].thread, NULL, gko_hash_worker,
+                                                          &workers[n]) == 0);
+        }
+
+        // the calling thread works too, and covers for any thread that could not start
+        gko_hash_worker(&workers[0]);
+        for (n = 1; n < threads; n++) {
+            if (workers[n].started) pthread_join(workers[n].thread, NULL);
+        }
+        free(workers);
+
+        if (error) {
+            free(jobs);
+            return GEKKO_ERROR;
+        }
+
+        for (i = 0; i < count; i = j) {
+            entry = &scan->entries[jobs[i].entry];
+
+            if (jobs[i].chunk == GKO_HASH_WHOLE) {
+                gko_hash_settle(entry, jobs[i].hash);
+                j = i + 1;
+            } else {
+                gko_hash_init(&state);
+                for (j = i; j < count && jobs[j].entry == jobs[i].entry && jobs[j].chunk != GKO_HASH_WHOLE; j++) {
+                    gko_hash_update(&state, &jobs[j].hash, sizeof(jobs[j].hash));
+                }
+                gko_hash_settle(entry, gko_hash_final(&state));
+            }
+            nhashed++;
+        }
+
+        free(jobs);
+    }
+
+    for (i = 0; i < scan->count; i++) {
+        if (scan->entries[i].flags & GKO_ENTRY_DIRTY) ndirty++;
+    }
+
+    if (hashed) *hashed = nhashed;
+    if (dirty) *dirty = ndirty;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Take the digests of stale entries from a copy of the scan hashed already, flag the ones whose
+                    content did change
+    arguments:      scan:       scan flagged by the index, a copy of the hashed one entry for entry
+                    hashed:     scan gko_hash_stale() went over with at least the same entries stale
+                    dirty:      number of dirty entries afterwards, may be NULL
+    return:         -
+**********************************************************************************************************************/
+void gko_hash_take(GKO_SCAN *scan, const GKO_SCAN *hashed, size_t *dirty)
+{
+    size_t  ndirty  = 0;
+    size_t  i       = 0;
+
+    for (i = 0; i < scan->count; i++) {
+        if (scan->entries[i].flags & GKO_ENTRY_STALE) gko_hash_settle(&scan->entries[i], hashed->entries[i].hash);
+        if (scan->entries[i].flags & GKO_ENTRY_DIRTY) ndirty++;
+    }
+
+    if (dirty) *dirty = ndirty;
+}
+/**********************************************************************************************************************
+    description:    Map hash cache file, a missing or foreign file yields an empty cache
+    arguments:      path:   cache file path
+                    cache:  cache to fill, release with gko_hash_cache_close()
+    return:         error code
+**********************************************************************************************************************/
+int gko_hash_cache_open(const char *path, GKO_HASH_CACHE *cache)
+{
+    const GKO_HASH_HEADER  *header  = NULL;
+    struct stat             st;
+    int                     fd      = -1;
+
+    if (!path) return GEKKO_ERROR;
+    if (!cache) return GEKKO_ERROR;
+
+    memset(cache, 0, sizeof(GKO_HASH_CACHE));
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return (errno == ENOENT) ? GEKKO_OK : GEKKO_ERROR;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(GKO_HASH_HEADER)) {
+        close(fd);
+        return GEKKO_OK;
+    }
+
+    cache->length = (size_t)st.st_size;
+    cache->map = mmap(NULL, cache->length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (cache->map == MAP_FAILED) {
+        memset(cache, 0, sizeof(GKO_HASH_CACHE));
+        return GEKKO_ERROR;
+    }
+
+    header = (const GKO_HASH_HEADER *)cache->map;
+    if (memcmp(header->magic, GEKKO_HASH_CACHE_MAGIC, sizeof(header->magic)) != GEKKO_OK ||
+        header->version != GEKKO_HASH_CACHE_VERSION ||
+        header->record_size != sizeof(GKO_HASH_RECORD) ||
+        header->count > (cache->length - sizeof(GKO_HASH_HEADER)) / sizeof(GKO_HASH_RECORD)) {
+        fprintf(stderr, "Invalid hash cache %s, ignored.\n", path);
+        gko_hash_cache_close(cache);
+        return GEKKO_OK;
+    }
+
+    cache->records = (const GKO_HASH_RECORD *)((const char *)cache->map + sizeof(GKO_HASH_HEADER));
+    cache->count   = (size_t)header->count;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Unmap hash cache
+    arguments:      cache:  hash cache
+    return:         -
+**********************************************************************************************************************/
+void gko_hash_cache_close(GKO_HASH_CACHE *cache)
+{
+    if (!cache) return;
+
+    if (cache->map) munmap(cache->map, cache->length);
+    memset(cache, 0, sizeof(GKO_HASH_CACHE));
+}
+/**********************************************************************************************************************
+    description:    Tell whether a hash pass left the cache behind the scan
+    arguments:      cache:  cache the pass looked digests up in
+                    scan:   hashed scan
+                    hashed: entries the pass hashed
+    return:         true if the cache is worth writing again
+**********************************************************************************************************************/
+bool gko_hash_cache_changed(const GKO_HASH_CACHE *cache, const GKO_SCAN *scan, size_t hashed)
+{
+    size_t  files   = 0;
+    size_t  i       = 0;
+
+    if (hashed) return true;
+
+    // nothing new was hashed, every file is in the cache already unless some left the tree or it was lost
+    for (i = 0; i < scan->count; i++) {
+        if (!S_ISDIR(scan->entries[i].mode)) files++;
+    }
+
+    return files != cache->count;
+}
+/**********************************************************************************************************************
+    description:    Compare two cache records by device and inode
+    arguments:      a:      record
+                    b:      record
+    return:         order
+**********************************************************************************************************************/
+static int gko_hash_record_cmp(const void *a, const void *b)
+{
+    const GKO_HASH_RECORD  *x   = (const GKO_HASH_RECORD *)a;
+    const GKO_HASH_RECORD  *y   = (const GKO_HASH_RECORD *)b;
+
+    if (x->dev != y->dev) return (x->dev < y->dev) ? -1 : 1;
+    if (x->inode != y->inode) return (x->inode < y->inode) ? -1 : 1;
+
+    return 0;
+}
+/**********************************************************************************************************************
+    description:    Write the digests of a hashed scan as the new cache, atomically replacing the old one
+    arguments:      path:   cache file path
+                    scan:   scan with hashes of every entry
+    return:         error code
+**********************************************************************************************************************/
+int gko_hash_cache_write(const char *path, const GKO_SCAN *scan)
+{
+    GKO_HASH_HEADER     header;
+    GKO_HASH_RECORD    *records         = NULL;
+    FILE               *file            = NULL;
+    char                temp[PATH_MAX]  = {0};
+    size_t              count           = 0;
+    size_t              i               = 0;
+    bool                error           = false;
+
+    if (!path) return GEKKO_ERROR;
+    if (!scan) return GEKKO_ERROR;
+
+    records = (GKO_HASH_RECORD *)malloc((scan->count + 1) * sizeof(GKO_HASH_RECORD));
+    if (!records) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    for (i = 0; i < scan->count; i++) {
+        if (S_ISDIR(scan->entries[i].mode)) continue;
+
+        records[count].dev      = scan->entries[i].dev;
+        records[count].inode    = scan->entries[i].inode;
+        records[count].size     = scan->entries[i].size;
+        records[count].mtime_ns = scan->entries[i].mtime_ns;
+        records[count].ctime_ns = scan->entries[i].ctime_ns;
+        records[count].hash     = scan->entries[i].hash;
+        count++;
+    }
+    qsort(records, count, sizeof(GKO_HASH_RECORD), gko_hash_record_cmp);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GEKKO_HASH_CACHE_MAGIC, sizeof(GEKKO_HASH_CACHE_MAGIC));
+    header.version     = GEKKO_HASH_CACHE_VERSION;
+    header.record_size = sizeof(GKO_HASH_RECORD);
+    header.count       = count;
+
+    // grips of the same tree may run side by side, each writes its own temporary file
+    snprintf(temp, PATH_MAX, "%s.%ld.tmp", path, (long)getpid());
+
+    file = fopen(temp, "wb");
+    if (!file) {
+        fprintf(stderr, "Cannot open file %s.\n", temp);
+        free(records);
+        return GEKKO_ERROR;
+    }
+
+    error |= (fwrite(&header, sizeof(header), 1, file) != 1);
+    if (count) error |= (fwrite(records, sizeof(GKO_HASH_RECORD), count, file) != count);
+    error |= (fflush(file) != 0);
+    error |= (fsync(fileno(file)) != 0);
+    error |= (fclose(file) != 0);
+    free(records);
+
+    if (error || rename(temp, path) != 0) {
+        fprintf(stderr, "Cannot write hash cache %s.\n", path);
+        unlink(temp);
+        return GEKKO_ERROR;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Bench thread, hashes its own slice of the bench buffer
+    arguments:      arg:    slice
+    return:         NULL
+**********************************************************************************************************************/
+static void *gko_hash_bench_worker(void *arg)
+{
+    GKO_HASH_SLICE *slice   = (GKO_HASH_SLICE *)arg;
+
+    slice->hash = gko_hash(slice->data, slice->len);
+
+    return NULL;
+}
+/**********************************************************************************************************************
+    description:    Measure every stripe kernel the CPU runs on one core, then the best one on all cores
+    arguments:      -
+    return:         error code
+**********************************************************************************************************************/
+int gko_hash_bench(void)
+{
+    GKO_HASH_SLICE      slices[GEKKO_HASH_THREADS_MAX];
+    pthread_t           threads[GEKKO_HASH_THREADS_MAX];
+    bool                started[GEKKO_HASH_THREADS_MAX];
+    struct timespec     begin, end;
+    uint32_t            lanes[GEKKO_HASH_LANES];
+    uint32_t            expect[GEKKO_HASH_LANES];
+    uint8_t            *data    = NULL;
+    uint64_t            x       = P64_1;
+    double              elapsed = 0;
+    size_t              slice   = 0;
+    size_t              i       = 0;
+    int                 cores   = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int                 n       = 0;
+    int                 j       = 0;
+    bool                first   = true;
+
+    data = (uint8_t *)malloc(GEKKO_HASH_BENCH_SIZE);
+    if (!data) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    for (i = 0; i < GEKKO_HASH_BENCH_SIZE; i += 8) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        memcpy(data + i, &x, 8);
+    }
+
+    for (i = 0; i < sizeof(gko_hash_kernels) / sizeof(gko_hash_kernels[0]); i++) {
+        if (!gko_hash_kernels[i].supported()) continue;
+
+        for (j = 0; j < GEKKO_HASH_LANES; j++) lanes[j] = P32_5 + (uint32_t)j * P32_1;
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        gko_hash_kernels[i].stripes(lanes, data, GEKKO_HASH_BENCH_SIZE / GEKKO_HASH_STRIPE);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+        // every kernel has to agree with the first one, bit for bit
+        if (first) memcpy(expect, lanes, sizeof(expect));
+        printf("%-8s %6.2f GB/s on one core%s%s\n", gko_hash_kernels[i].name,
+               (elapsed > 0) ? GEKKO_HASH_BENCH_SIZE / elapsed / 1e9 : 0.0,
+               (gko_hash_pick() == &gko_hash_kernels[i]) ? ", in use" : "",
+               (memcmp(expect, lanes, sizeof(expect)) != GEKKO_OK) ? ", MISMATCH" : "");
+        first = false;
+    }
+
+    if (cores > GEKKO_HASH_THREADS_MAX) cores = GEKKO_HASH_THREADS_MAX;
+    if (cores < 1) cores = 1;
+    slice = (GEKKO_HASH_BENCH_SIZE / cores) & ~(size_t)(GEKKO_HASH_STRIPE - 1);
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (n = 0; n < cores; n++) {
+        slices[n].data = data + n * slice;
+        slices[n].len  = slice;
+        started[n] = (pthread_create(&threads[n], NULL, gko_hash_bench_worker, &slices[n]) == 0);
+        if (!started[n]) gko_hash_bench_worker(&slices[n]);
+    }
+    for (n = 0; n < cores; n++) {
+        if (started[n]) pthread_join(threads[n], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    printf("%-8s %6.2f GB/s on %d cores, %.2f GB/s per core\n", gko_hash_kernel(),
+           (elapsed > 0) ? slice * cores / elapsed / 1e9 : 0.0, cores,
+           (elapsed > 0) ? slice / elapsed / 1e9 : 0.0);
+
+    free(data);
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
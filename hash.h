@@ -0,0 +1,83 @@
+/**********************************************************************************************************************
+    file:           hash.h
+    description:    Content hashing of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_HASH_H
+#define __GEKKO_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "scan.h"
+/**********************************************************************************************************************
+    hash defaults
+**********************************************************************************************************************/
+#define GEKKO_HASH_LANES                (8)
+#define GEKKO_HASH_STRIPE               (GEKKO_HASH_LANES * 4)
+#define GEKKO_HASH_BUFFER               (1 << 20)
+#define GEKKO_HASH_CHUNK                (4 << 20)               // large files hash as a list of chunk digests
+#define GEKKO_HASH_CHUNKED_MIN          (2 * GEKKO_HASH_CHUNK)
+#define GEKKO_HASH_THREADS_MAX          (64)
+#define GEKKO_HASH_CACHE_FILE           "hash.cache"
+#define GEKKO_HASH_CACHE_MAGIC          "GKOHASH"
+#define GEKKO_HASH_CACHE_VERSION        (1)
+#define GEKKO_HASH_BENCH_SIZE           (256 << 20)
+/**********************************************************************************************************************
+    streaming hash state, 8 independent 32-bit lanes folded into 64 bits at the end
+**********************************************************************************************************************/
+typedef struct {
+    uint32_t        lanes[GEKKO_HASH_LANES];
+    uint8_t         buffer[GEKKO_HASH_STRIPE];
+    size_t          buffered;
+    uint64_t        length;
+} GKO_HASH;
+/**********************************************************************************************************************
+    hash cache: digests of local files keyed by what stat says about them, shared by every grip of a tree
+**********************************************************************************************************************/
+typedef struct {
+    char            magic[8];
+    uint32_t        version;
+    uint32_t        record_size;
+    uint64_t        count;
+} GKO_HASH_HEADER;
+
+typedef struct {
+    uint64_t        dev;
+    uint64_t        inode;
+    uint64_t        size;
+    int64_t         mtime_ns;
+    int64_t         ctime_ns;
+    uint64_t        hash;
+} GKO_HASH_RECORD;
+
+typedef struct {
+    void                   *map;
+    size_t                  length;
+    const GKO_HASH_RECORD  *records;
+    size_t                  count;
+} GKO_HASH_CACHE;
+/**********************************************************************************************************************
+    hash functions
+**********************************************************************************************************************/
+void        gko_hash_init(GKO_HASH *state);
+void        gko_hash_update(GKO_HASH *state, const void *data, size_t len);
+uint64_t    gko_hash_final(GKO_HASH *state);
+uint64_t    gko_hash(const void *data, size_t len);
+const char *gko_hash_kernel(void);
+int         gko_hash_file(int dirfd, const char *path, uint32_t mode, uint64_t *hash);
+int         gko_hash_stale(int rootfd, GKO_SCAN *scan, int threads, const GKO_HASH_CACHE *cache,
+                           size_t *hashed, size_t *dirty);
+void        gko_hash_take(GKO_SCAN *scan, const GKO_SCAN *hashed, size_t *dirty);
+int         gko_hash_cache_open(const char *path, GKO_HASH_CACHE *cache);
+void        gko_hash_cache_close(GKO_HASH_CACHE *cache);
+bool        gko_hash_cache_changed(const GKO_HASH_CACHE *cache, const GKO_SCAN *scan, size_t hashed);
+int         gko_hash_cache_write(const char *path, const GKO_SCAN *scan);
+int         gko_hash_bench(void);
+
+#endif  // __GEKKO_HASH_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
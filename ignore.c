@@ -0,0 +1,666 @@
+/**********************************************************************************************************************
+    file:           ignore.c
+    description:    Ignore rules of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <errno.h>
+#include <stdbool.h>
+
+#include "gekko.h"
+#include "ignore.h"
+/**********************************************************************************************************************
+    description:    Grow an array to hold at least one more element
+    arguments:      array:  array to grow
+                    size:   allocated elements
+                    count:  used elements
+                    elem:   element size
+    return:         error code
+**********************************************************************************************************************/
+static int gko_ignore_grow(void **array, uint32_t *size, uint32_t count, size_t elem)
+{
+    void       *grown   = NULL;
+    uint32_t    cap     = 0;
+
+    if (count < *size) return GEKKO_OK;
+
+    cap = (*size) ? *size * 2 : 64;
+    grown = realloc(*array, (size_t)cap * elem);
+    if (!grown) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    *array = grown;
+    *size = cap;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Add a segment node
+    arguments:      ig:     rule set
+                    loop:   node matches any number of segments
+    return:         node number, 0 if out of memory
+**********************************************************************************************************************/
+static uint32_t gko_ignore_node_new(GKO_IGNORE *ig, bool loop)
+{
+    GKO_IGNORE_NODE    *node    = NULL;
+
+    if (gko_ignore_grow((void **)&ig->nodes, &ig->nodes_size, ig->nodes_count,
+                        sizeof(GKO_IGNORE_NODE)) != GEKKO_OK) return 0;
+
+    node = &ig->nodes[ig->nodes_count];
+    memset(node, 0, sizeof(GKO_IGNORE_NODE));
+    node->loop     = loop;
+    node->rule_any = -1;
+    node->rule_dir = -1;
+
+    return ig->nodes_count++;
+}
+/**********************************************************************************************************************
+    description:    Add a byte trie state
+    arguments:      ig:     rule set
+    return:         state number, 0 if out of memory
+**********************************************************************************************************************/
+static uint32_t gko_ignore_state_new(GKO_IGNORE *ig)
+{
+    if (gko_ignore_grow((void **)&ig->states, &ig->states_size, ig->states_count,
+                        sizeof(GKO_IGNORE_STATE)) != GEKKO_OK) return 0;
+
+    ig->states[ig->states_count].target = 0;
+    ig->states[ig->states_count].globs  = 0;
+
+    return ig->states_count++;
+}
+/**********************************************************************************************************************
+    description:    Slot of a byte trie edge in the edge table
+    arguments:      edges:  edge table
+                    size:   table size, a power of two
+                    key:    edge key
+    return:         slot, either holding key or free
+**********************************************************************************************************************/
+static uint32_t gko_ignore_slot(const GKO_IGNORE_EDGE *edges, uint32_t size, uint64_t key)
+{
+    uint32_t    slot    = (uint32_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & (size - 1);
+
+    while (edges[slot].key && edges[slot].key != key) slot = (slot + 1) & (size - 1);
+
+    return slot;
+}
+/**********************************************************************************************************************
+    description:    Follow a byte trie edge
+    arguments:      ig:     rule set
+                    state:  byte trie state
+                    byte:   next byte
+    return:         next state, 0 if there is none
+**********************************************************************************************************************/
+static inline uint32_t gko_ignore_edge(const GKO_IGNORE *ig, uint32_t state, uint8_t byte)
+{
+    uint64_t    key     = (((uint64_t)state << 8) | byte) + 1;
+    uint32_t    slot    = 0;
+
+    if (!ig->edges_size) return 0;
+
+    slot = gko_ignore_slot(ig->edges, ig->edges_size, key);
+
+    return (ig->edges[slot].key) ? ig->edges[slot].value : 0;
+}
+/**********************************************************************************************************************
+    description:    Follow a byte trie edge, adding it if missing
+    arguments:      ig:     rule set
+                    state:  byte trie state
+                    byte:   next byte
+    return:         next state, 0 if out of memory
+**********************************************************************************************************************/
+static uint32_t gko_ignore_edge_add(GKO_IGNORE *ig, uint32_t state, uint8_t byte)
+{
+    GKO_IGNORE_EDGE    *edges   = NULL;
+    uint64_t            key     = (((uint64_t)state << 8) | byte) + 1;
+    uint32_t            size    = 0;
+    uint32_t            slot    = 0;
+    uint32_t            next    = 0;
+    uint32_t            i       = 0;
+
+    next = gko_ignore_edge(ig, state, byte);
+    if (next) return next;
+
+    // keep the table at most half full, probes stay short
+    if ((ig->edges_count + 1) * 2 > ig->edges_size) {
+        size = (ig->edges_size) ? ig->edges_size * 2 : 1024;
+        edges = (GKO_IGNORE_EDGE *)zalloc((size_t)size * sizeof(GKO_IGNORE_EDGE));
+        if (!edges) {
+            fprintf(stderr, "Insufficient memory.\n");
+            return 0;
+        }
+
+        for (i = 0; i < ig->edges_size; i++) {
+            if (!ig->edges[i].key) continue;
+            edges[gko_ignore_slot(edges, size, ig->edges[i].key)] = ig->edges[i];
+        }
+
+        free(ig->edges);
+        ig->edges = edges;
+        ig->edges_size = size;
+    }
+
+    next = gko_ignore_state_new(ig);
+    if (!next) return 0;
+
+    slot = gko_ignore_slot(ig->edges, ig->edges_size, key);
+    ig->edges[slot].key = key;
+    ig->edges[slot].value = next;
+    ig->edges_count++;
+
+    return next;
+}
+/**********************************************************************************************************************
+    description:    Insert a string into a byte trie
+    arguments:      ig:         rule set
+                    root:       byte trie root of a node, 0 if the trie does not exist yet
+                    str:        string
+                    len:        string length
+                    reverse:    insert the bytes last to first
+    return:         state reached by the string, 0 if out of memory
+**********************************************************************************************************************/
+static uint32_t gko_ignore_trie(GKO_IGNORE *ig, uint32_t *root, const char *str, size_t len, bool reverse)
+{
+    uint32_t    state   = *root;
+    size_t      i       = 0;
+
+    if (!state) {
+        state = gko_ignore_state_new(ig);
+        if (!state) return 0;
+        *root = state;
+    }
+
+    for (i = 0; i < len && state; i++) {
+        state = gko_ignore_edge_add(ig, state, (uint8_t)str[(reverse) ? len - 1 - i : i]);
+    }
+
+    return state;
+}
+/**********************************************************************************************************************
+    description:    Match a name against a glob, '*' and '?' do not cross segments as names hold none
+    arguments:      pattern:    NUL terminated glob
+                    name:       name
+                    len:        name length
+    return:         true if the name matches
+**********************************************************************************************************************/
+static bool gko_ignore_glob(const char *pattern, const char *name, size_t len)
+{
+    const char *p       = pattern;
+    const char *q       = NULL;
+    const char *star    = NULL;
+    size_t      i       = 0;
+    size_t      mark    = 0;
+    bool        negate  = false;
+    bool        found   = false;
+    char        lo, hi;
+
+    while (i < len) {
+        if (*p == '*') {
+            star = ++p;
+            mark = i;
+            continue;
+        }
+
+        if (*p == '?') {
+            p++;
+            i++;
+            continue;
+        }
+
+        if (*p == '[') {
+            q = p + 1;
+            negate = (*q == '!' || *q == '^');
+            if (negate) q++;
+
+            found = false;
+            do {
+                if (*q == '\\' && q[1]) q++;
+                lo = hi = *q++;
+                if (*q == '-' && q[1] && q[1] != ']') {
+                    q++;
+                    if (*q == '\\' && q[1]) q++;
+                    hi = *q++;
+                }
+                if ((unsigned char)name[i] >= (unsigned char)lo && (unsigned char)name[i] <= (unsigned char)hi) {
+                    found = true;
+                }
+            } while (*q && *q != ']');
+
+            // an unterminated class is a literal '['
+            if (*q == ']' && found != negate) {
+                p = q + 1;
+                i++;
+                continue;
+            }
+            if (*q != ']' && name[i] == '[') {
+                p++;
+                i++;
+                continue;
+            }
+
+        } else {
+            if (*p == '\\' && p[1]) p++;
+            if (*p && *p == name[i]) {
+                p++;
+                i++;
+                continue;
+            }
+        }
+
+        if (!star) return false;
+        p = star;
+        i = ++mark;
+    }
+
+    while (*p == '*') p++;
+
+    return *p == '\0';
+}
+/**********************************************************************************************************************
+    description:    Child node of a segment pattern, created if missing
+    arguments:      ig:     rule set
+                    node:   parent node
+                    seg:    segment pattern
+                    len:    segment pattern length
+    return:         child node, 0 if out of memory
+**********************************************************************************************************************/
+static uint32_t gko_ignore_child(GKO_IGNORE *ig, uint32_t node, const char *seg, size_t len)
+{
+    GKO_IGNORE_GLOB    *glob    = NULL;
+    uint32_t           *head    = NULL;
+    uint32_t            state   = 0;
+    uint32_t            child   = 0;
+    uint32_t            i       = 0;
+    size_t              special = strcspn(seg, "*?[\\");
+
+    if (special > len) special = len;
+
+    if (special == len) {
+        state = gko_ignore_trie(ig, &ig->nodes[node].lit, seg, len, false);
+    } else if (special == len - 1 && seg[special] == '*') {
+        state = gko_ignore_trie(ig, &ig->nodes[node].pre, seg, len - 1, false);
+    } else if (special == 0 && seg[0] == '*' && strcspn(seg + 1, "*?[\\") >= len - 1) {
+        state = gko_ignore_trie(ig, &ig->nodes[node].suf, seg + 1, len - 1, true);
+    } else {
+        // anything else is tried name by name, hung off the "prefix*" state of its literal head so only globs whose
+        // head matches the name are tried, share it when the same glob shows up again
+        head = &ig->nodes[node].globs;
+        if (special) {
+            state = gko_ignore_trie(ig, &ig->nodes[node].pre, seg, special, false);
+            if (!state) return 0;
+            head = &ig->states[state].globs;
+        }
+
+        for (i = *head; i; i = ig->globs[i - 1].next) {
+            glob = &ig->globs[i - 1];
+            if (strlen(glob->pattern) == len && strncmp(glob->pattern, seg, len) == GEKKO_OK) return glob->node;
+        }
+
+        child = gko_ignore_node_new(ig, false);
+        if (!child) return 0;
+        if (gko_ignore_grow((void **)&ig->globs, &ig->globs_size, ig->globs_count,
+                            sizeof(GKO_IGNORE_GLOB)) != GEKKO_OK) return 0;
+
+        // the trie may have moved while growing
+        head = (special) ? &ig->states[state].globs : &ig->nodes[node].globs;
+
+        glob = &ig->globs[ig->globs_count];
+        glob->pattern = strndup(seg, len);
+        glob->skip    = (uint32_t)special;
+        glob->node    = child;
+        glob->next    = *head;
+        if (!glob->pattern) return 0;
+
+        *head = ++ig->globs_count;
+
+        return child;
+    }
+
+    if (!state) return 0;
+
+    if (!ig->states[state].target) {
+        child = gko_ignore_node_new(ig, false);
+        if (!child) return 0;
+        ig->states[state].target = child;
+    }
+
+    return ig->states[state].target;
+}
+/**********************************************************************************************************************
+    description:    "**" child of a node, created if missing
+    arguments:      ig:     rule set
+                    node:   parent node
+    return:         child node, 0 if out of memory
+**********************************************************************************************************************/
+static uint32_t gko_ignore_dstar(GKO_IGNORE *ig, uint32_t node)
+{
+    uint32_t    child   = 0;
+
+    // "**/**" is the same as "**"
+    if (ig->nodes[node].loop) return node;
+    if (ig->nodes[node].dstar) return ig->nodes[node].dstar;
+
+    child = gko_ignore_node_new(ig, true);
+    if (child) ig->nodes[node].dstar = child;
+
+    return child;
+}
+/**********************************************************************************************************************
+    description:    Initialize an empty rule set
+    arguments:      ig:     rule set, release with gko_ignore_free()
+    return:         error code
+**********************************************************************************************************************/
+int gko_ignore_init(GKO_IGNORE *ig)
+{
+    if (!ig) return GEKKO_ERROR;
+
+    memset(ig, 0, sizeof(GKO_IGNORE));
+
+    // node and state 0 stand for none, the root is node 1
+    ig->nodes_count = 1;
+    ig->states_count = 1;
+    if (gko_ignore_grow((void **)&ig->states, &ig->states_size, 0, sizeof(GKO_IGNORE_STATE)) != GEKKO_OK ||
+        gko_ignore_grow((void **)&ig->nodes, &ig->nodes_size, 0, sizeof(GKO_IGNORE_NODE)) != GEKKO_OK ||
+        gko_ignore_node_new(ig, false) != 1) {
+        gko_ignore_free(ig);
+        return GEKKO_ERROR;
+    }
+
+    memset(&ig->nodes[0], 0, sizeof(GKO_IGNORE_NODE));
+    memset(&ig->states[0], 0, sizeof(GKO_IGNORE_STATE));
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Release a rule set
+    arguments:      ig:     rule set
+    return:         -
+**********************************************************************************************************************/
+void gko_ignore_free(GKO_IGNORE *ig)
+{
+    uint32_t i;
+
+    if (!ig) return;
+
+    for (i = 0; i < ig->globs_count; i++) free(ig->globs[i].pattern);
+
+    free(ig->globs);
+    free(ig->nodes);
+    free(ig->states);
+    free(ig->edges);
+    free(ig->negate);
+    memset(ig, 0, sizeof(GKO_IGNORE));
+}
+/**********************************************************************************************************************
+    description:    Compile one gitignore line, later rules win over earlier ones
+    arguments:      ig:     rule set
+                    line:   pattern line, blank lines and comments are skipped
+    return:         error code
+**********************************************************************************************************************/
+int gko_ignore_add(GKO_IGNORE *ig, const char *line)
+{
+    const char *seg         = NULL;
+    const char *end         = NULL;
+    const char *slash       = NULL;
+    size_t      len         = 0;
+    size_t      seglen      = 0;
+    uint32_t    node        = 1;
+    bool        negate      = false;
+    bool        dir         = false;
+    bool        anchored    = false;
+
+    if (!ig || !ig->nodes) return GEKKO_ERROR;
+    if (!line) return GEKKO_ERROR;
+
+    len = strcspn(line, "\r\n");
+    while (len && line[len - 1] == ' ' && (len < 2 || line[len - 2] != '\\')) len--;
+
+    if (!len || line[0] == '#') return GEKKO_OK;
+
+    if (line[0] == '!') {
+        negate = true;
+        line++;
+        len--;
+    }
+
+    if (len && line[len - 1] == '/') {
+        dir = true;
+        len--;
+    }
+
+    // a slash anywhere but at the end anchors the pattern to the root
+    anchored = (memchr(line, '/', len) != NULL);
+    while (len && line[0] == '/') {
+        line++;
+        len--;
+    }
+    if (!len) return GEKKO_OK;
+
+    if (!anchored) node = gko_ignore_dstar(ig, node);
+
+    for (seg = line, end = line + len; node && seg < end; seg += seglen + 1) {
+        slash = (const char *)memchr(seg, '/', (size_t)(end - seg));
+        seglen = (size_t)(((slash) ? slash : end) - seg);
+        if (!seglen) continue;
+
+        if (seglen == 2 && seg[0] == '*' && seg[1] == '*') {
+            // a trailing "**" is everything inside, which a single "*" level already prunes
+            node = (seg + seglen < end) ? gko_ignore_dstar(ig, node) : gko_ignore_child(ig, node, "*", 1);
+            continue;
+        }
+
+        node = gko_ignore_child(ig, node, seg, seglen);
+    }
+
+    if (!node) return GEKKO_ERROR;
+
+    if (gko_ignore_grow((void **)&ig->negate, &ig->rules_size, ig->rules, sizeof(uint8_t)) != GEKKO_OK) {
+        return GEKKO_ERROR;
+    }
+    ig->negate[ig->rules] = negate;
+
+    if (dir) {
+        ig->nodes[node].rule_dir = (int32_t)ig->rules;
+    } else {
+        ig->nodes[node].rule_any = (int32_t)ig->rules;
+    }
+    ig->rules++;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Compile an ignore file, a missing file is an empty rule set
+    arguments:      ig:     rule set, initialized
+                    path:   ignore file path
+    return:         error code
+**********************************************************************************************************************/
+int gko_ignore_load(GKO_IGNORE *ig, const char *path)
+{
+    FILE   *file                            = NULL;
+    char    line[GEKKO_IGNORE_LINE_MAX]     = {0};
+    int     ret                             = GEKKO_OK;
+
+    if (!ig) return GEKKO_ERROR;
+    if (!path) return GEKKO_ERROR;
+
+    file = fopen(path, "rb");
+    if (!file) {
+        if (errno == ENOENT) return GEKKO_OK;
+        fprintf(stderr, "Cannot open %s.\n", path);
+        return GEKKO_ERROR;
+    }
+
+    while (ret == GEKKO_OK && fgets(line, sizeof(line), file)) {
+        ret = gko_ignore_add(ig, line);
+    }
+
+    fclose(file);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Largest number of live nodes, size of a state buffer
+    arguments:      ig:     rule set
+    return:         number of states
+**********************************************************************************************************************/
+size_t gko_ignore_width(const GKO_IGNORE *ig)
+{
+    return (ig) ? ig->nodes_count : 0;
+}
+/**********************************************************************************************************************
+    description:    Make a node live, together with the "**" below it which may match no segment at all
+    arguments:      ig:     rule set
+                    node:   node
+                    states: live nodes
+                    count:  number of live nodes
+    return:         -
+**********************************************************************************************************************/
+static inline void gko_ignore_enter(const GKO_IGNORE *ig, uint32_t node, uint32_t *states, size_t *count)
+{
+    size_t  i;
+
+    for (i = 0; i < *count; i++) {
+        if (states[i] == node) break;
+    }
+    if (i == *count) states[(*count)++] = node;
+
+    node = ig->nodes[node].dstar;
+    if (!node) return;
+
+    for (i = 0; i < *count; i++) {
+        if (states[i] == node) return;
+    }
+    states[(*count)++] = node;
+}
+/**********************************************************************************************************************
+    description:    Live nodes of the sync root
+    arguments:      ig:     rule set
+                    states: buffer of gko_ignore_width() states
+    return:         number of live nodes
+**********************************************************************************************************************/
+size_t gko_ignore_root(const GKO_IGNORE *ig, uint32_t *states)
+{
+    size_t  count   = 0;
+
+    if (!ig || !ig->nodes || !states) return 0;
+
+    gko_ignore_enter(ig, 1, states, &count);
+
+    return count;
+}
+/**********************************************************************************************************************
+    description:    Step from the live nodes of a directory to one of its entries
+    arguments:      ig:         rule set
+                    states:     live nodes of the directory
+                    count:      number of live nodes
+                    name:       entry name
+                    len:        entry name length
+                    dir:        entry is a directory
+                    next:       buffer of gko_ignore_width() states, live nodes of the entry
+                    next_count: number of live nodes of the entry
+    return:         true if the entry is ignored
+**********************************************************************************************************************/
+bool gko_ignore_next(const GKO_IGNORE *ig, const uint32_t *states, size_t count, const char *name,
+                     size_t len, bool dir, uint32_t *next, size_t *next_count)
+{
+    const GKO_IGNORE_NODE  *node    = NULL;
+    const GKO_IGNORE_GLOB  *glob    = NULL;
+    uint32_t                state   = 0;
+    size_t                  n       = 0;
+    size_t                  i, j, k;
+    int32_t                 best    = -1;
+
+    for (i = 0; i < count; i++) {
+        node = &ig->nodes[states[i]];
+
+        if (node->loop) gko_ignore_enter(ig, states[i], next, &n);
+
+        if (node->lit) {
+            for (j = 0, state = node->lit; j < len && state; j++) {
+                state = gko_ignore_edge(ig, state, (uint8_t)name[j]);
+            }
+            if (state && ig->states[state].target) gko_ignore_enter(ig, ig->states[state].target, next, &n);
+        }
+
+        for (j = 0, state = node->pre; state; state = (j < len) ? gko_ignore_edge(ig, state, (uint8_t)name[j++]) : 0) {
+            if (ig->states[state].target) gko_ignore_enter(ig, ig->states[state].target, next, &n);
+            for (k = ig->states[state].globs; k; k = glob->next) {
+                glob = &ig->globs[k - 1];
+                if (gko_ignore_glob(glob->pattern + glob->skip, name + j, len - j)) {
+                    gko_ignore_enter(ig, glob->node, next, &n);
+                }
+            }
+        }
+
+        if (node->suf) {
+            state = node->suf;
+            if (ig->states[state].target) gko_ignore_enter(ig, ig->states[state].target, next, &n);
+            for (j = len; j > 0 && state; j--) {
+                state = gko_ignore_edge(ig, state, (uint8_t)name[j - 1]);
+                if (state && ig->states[state].target) gko_ignore_enter(ig, ig->states[state].target, next, &n);
+            }
+        }
+
+        for (j = node->globs; j; j = glob->next) {
+            glob = &ig->globs[j - 1];
+            if (gko_ignore_glob(glob->pattern, name, len)) gko_ignore_enter(ig, glob->node, next, &n);
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        node = &ig->nodes[next[i]];
+        if (node->rule_any > best) best = node->rule_any;
+        if (dir && node->rule_dir > best) best = node->rule_dir;
+    }
+
+    *next_count = n;
+
+    return best >= 0 && !ig->negate[best];
+}
+/**********************************************************************************************************************
+    description:    Check a whole path, an entry inside an ignored directory is ignored as well
+    arguments:      ig:         rule set
+                    path:       path relative to sync root, '/' separated
+                    dir:        path is a directory
+                    scratch:    buffer of 2 * gko_ignore_width() states
+    return:         true if the path is ignored
+**********************************************************************************************************************/
+bool gko_ignore_path(const GKO_IGNORE *ig, const char *path, bool dir, uint32_t *scratch)
+{
+    const char *seg     = path;
+    const char *slash   = NULL;
+    uint32_t   *cur     = scratch;
+    uint32_t   *next    = NULL;
+    uint32_t   *swap    = NULL;
+    size_t      count   = 0;
+    size_t      len     = 0;
+
+    if (!ig || !ig->rules || !path || !scratch) return false;
+
+    next = scratch + gko_ignore_width(ig);
+    count = gko_ignore_root(ig, cur);
+
+    for (;;) {
+        slash = strchr(seg, '/');
+        len = (slash) ? (size_t)(slash - seg) : strlen(seg);
+
+        if (gko_ignore_next(ig, cur, count, seg, len, (slash) ? true : dir, next, &count)) return true;
+        if (!slash) return false;
+
+        swap = cur;
+        cur = next;
+        next = swap;
+        seg = slash + 1;
+    }
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,88 @@
+/**********************************************************************************************************************
+    file:           ignore.h
+    description:    Ignore rules of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_IGNORE_H
+#define __GEKKO_IGNORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+/**********************************************************************************************************************
+    ignore defaults
+**********************************************************************************************************************/
+#define GEKKO_IGNORE_FILE               ".gkoignore"
+#define GEKKO_IGNORE_LINE_MAX           (4096)
+/**********************************************************************************************************************
+    compiled rule set
+
+    Every rule is a chain of path segments in a trie shared by all rules, a leading or inner "**" becomes a node that
+    loops on any segment. The children of a node are looked up through byte tries: exact names, "prefix*" and
+    "*suffix" cost one step per byte of the name whatever the number of rules, other globs hang off the "prefix*"
+    trie by their literal head and are only tried one by one once the head matched.
+    Matching keeps the set of live nodes per directory, a name costs one step from its parent directory's set.
+**********************************************************************************************************************/
+typedef struct {
+    uint32_t        lit;            // byte trie of exact names
+    uint32_t        pre;            // byte trie of "prefix*"
+    uint32_t        suf;            // byte trie of "*suffix", bytes in reverse
+    uint32_t        globs;          // first other glob, 1-based
+    uint32_t        dstar;          // "**" child
+    uint32_t        loop;           // matches any number of segments
+    int32_t         rule_any;       // last rule ending here, -1 for none
+    int32_t         rule_dir;       // last directory-only rule ending here, -1 for none
+} GKO_IGNORE_NODE;
+
+typedef struct {
+    char           *pattern;
+    uint32_t        skip;           // literal head already matched by the byte trie
+    uint32_t        node;
+    uint32_t        next;
+} GKO_IGNORE_GLOB;
+
+typedef struct {
+    uint32_t        target;         // segment node reached by the byte trie state
+    uint32_t        globs;          // first glob whose literal head ends here, 1-based
+} GKO_IGNORE_STATE;
+
+typedef struct {
+    uint64_t        key;            // state << 8 | byte, plus one so zero is free
+    uint32_t        value;
+} GKO_IGNORE_EDGE;
+
+typedef struct {
+    GKO_IGNORE_NODE    *nodes;
+    uint32_t            nodes_count;
+    uint32_t            nodes_size;
+    GKO_IGNORE_STATE   *states;
+    uint32_t            states_count;
+    uint32_t            states_size;
+    GKO_IGNORE_EDGE    *edges;
+    uint32_t            edges_count;
+    uint32_t            edges_size;
+    GKO_IGNORE_GLOB    *globs;
+    uint32_t            globs_count;
+    uint32_t            globs_size;
+    uint8_t            *negate;         // per rule
+    uint32_t            rules;
+    uint32_t            rules_size;
+} GKO_IGNORE;
+/**********************************************************************************************************************
+    ignore functions
+**********************************************************************************************************************/
+int      gko_ignore_init(GKO_IGNORE *ig);
+void     gko_ignore_free(GKO_IGNORE *ig);
+int      gko_ignore_add(GKO_IGNORE *ig, const char *line);
+int      gko_ignore_load(GKO_IGNORE *ig, const char *path);
+size_t   gko_ignore_width(const GKO_IGNORE *ig);
+size_t   gko_ignore_root(const GKO_IGNORE *ig, uint32_t *states);
+bool     gko_ignore_next(const GKO_IGNORE *ig, const uint32_t *states, size_t count, const char *name,
+                         size_t len, bool dir, uint32_t *next, size_t *next_count);
+bool     gko_ignore_path(const GKO_IGNORE *ig, const char *path, bool dir, uint32_t *scratch);
+
+#endif  // __GEKKO_IGNORE_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
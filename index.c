@@ -0,0 +1,415 @@
+/**********************************************************************************************************************
+    file:           index.c
+    description:    Persistent local index of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gekko.h"
+#include "index.h"
+/**********************************************************************************************************************
+    description:    Map index file, a missing file yields an empty index
+    arguments:      path:   index file path
+                    index:  index to fill, release with gko_index_close()
+    return:         error code
+**********************************************************************************************************************/
+int gko_index_open(const char *path, GKO_INDEX *index)
+{
+    const GKO_INDEX_HEADER     *header  = NULL;
+    struct stat                 st;
+    int                         fd      = -1;
+
+    if (!path) return GEKKO_ERROR;
+    if (!index) return GEKKO_ERROR;
+
+    memset(index, 0, sizeof(GKO_INDEX));
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) return GEKKO_OK;
+        fprintf(stderr, "Cannot open file %s.\n", path);
+        return GEKKO_ERROR;
+    }
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(GKO_INDEX_HEADER)) {
+        fprintf(stderr, "Invalid index file %s, ignored.\n", path);
+        close(fd);
+        return GEKKO_OK;
+    }
+
+    index->length = (size_t)st.st_size;
+    index->map = mmap(NULL, index->length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (index->map == MAP_FAILED) {
+        fprintf(stderr, "Cannot map file %s.\n", path);
+        memset(index, 0, sizeof(GKO_INDEX));
+        return GEKKO_ERROR;
+    }
+
+    header = (const GKO_INDEX_HEADER *)index->map;
+    if (memcmp(header->magic, GEKKO_INDEX_MAGIC, sizeof(header->magic)) != GEKKO_OK ||
+        header->version != GEKKO_INDEX_VERSION ||
+        header->record_size != sizeof(GKO_INDEX_RECORD) ||
+        header->length != index->length ||
+        header->count > (index->length - sizeof(GKO_INDEX_HEADER)) / sizeof(GKO_INDEX_RECORD) ||
+        header->strings != sizeof(GKO_INDEX_HEADER) + header->count * sizeof(GKO_INDEX_RECORD) ||
+        header->strings > header->length ||
+        ((const char *)index->map)[index->length - 1] != '\0') {
+        goto __error_index;
+    }
+
+    index->records = (const GKO_INDEX_RECORD *)((const char *)index->map + sizeof(GKO_INDEX_HEADER));
+    index->count   = (size_t)header->count;
+    index->strings = (const char *)index->map + header->strings;
+    index->span    = index->length - (size_t)header->strings;
+
+    return GEKKO_OK;
+
+__error_index:
+    fprintf(stderr, "Invalid index file %s, ignored.\n", path);
+    gko_index_close(index);
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Unmap index
+    arguments:      index:  index
+    return:         -
+**********************************************************************************************************************/
+void gko_index_close(GKO_INDEX *index)
+{
+    if (!index) return;
+
+    if (index->map) munmap(index->map, index->length);
+    memset(index, 0, sizeof(GKO_INDEX));
+}
+/**********************************************************************************************************************
+    description:    Flag an entry against its index record and carry the known hash over
+    arguments:      entry:  scanned entry
+                    rec:    index record of the same path
+    return:         -
+**********************************************************************************************************************/
+static void gko_index_flag(GKO_ENTRY *entry, const GKO_INDEX_RECORD *rec)
+{
+    entry->hash = rec->hash;
+
+    if (entry->mode != rec->mode) {
+        entry->flags = GKO_ENTRY_STALE | GKO_ENTRY_DIRTY;
+    } else if (S_ISDIR(entry->mode)) {
+        entry->flags = 0;
+    } else if (entry->size != rec->size || entry->mtime_ns != rec->mtime_ns ||
+               entry->ctime_ns != rec->ctime_ns || entry->inode != rec->inode) {
+        entry->flags = GKO_ENTRY_STALE;
+    } else {
+        entry->flags = 0;
+    }
+}
+/**********************************************************************************************************************
+    description:    Find the first record not sorting before path
+    arguments:      index:  index
+                    path:   path relative to sync root
+    return:         record number, index->count if every record sorts before path
+**********************************************************************************************************************/
+size_t gko_index_lower(const GKO_INDEX *index, const char *path)
+{
+    size_t  lo  = 0;
+    size_t  hi  = 0;
+    size_t  mid = 0;
+
+    if (!index || !path) return 0;
+
+    hi = index->count;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (strcmp(gko_index_path(index, mid), path) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+/**********************************************************************************************************************
+    description:    Find the record of a path
+    arguments:      index:  index
+                    path:   path relative to sync root
+    return:         record number, index->count if not found
+**********************************************************************************************************************/
+size_t gko_index_find(const GKO_INDEX *index, const char *path)
+{
+    size_t  i   = 0;
+
+    if (!index || !path) return 0;
+
+    i = gko_index_lower(index, path);
+    if (i < index->count && strcmp(gko_index_path(index, i), path) == GEKKO_OK) return i;
+
+    return index->count;
+}
+/**********************************************************************************************************************
+    description:    Compare scan against index, flagging entries and collecting records gone from the tree
+    arguments:      index:          index of the last sync
+                    scan:           fresh scan, entries get GKO_ENTRY_* flags and known hashes
+                    ignore:         ignore rules the scan was taken with, NULL for none
+                    deleted:        record numbers not in scan, release with free()
+                    deleted_count:  number of deleted records
+    return:         error code
+**********************************************************************************************************************/
+int gko_index_diff(const GKO_INDEX *index, GKO_SCAN *scan, const GKO_IGNORE *ignore,
+                   size_t **deleted, size_t *deleted_count)
+{
+    GKO_ENTRY                  *entry   = NULL;
+    size_t                     *gone    = NULL;
+    uint32_t                   *scratch = NULL;
+    size_t                      ngone   = 0;
+    size_t                      i       = 0;
+    size_t                      j       = 0;
+    int                         cmp     = 0;
+
+    if (!index) return GEKKO_ERROR;
+    if (!scan) return GEKKO_ERROR;
+    if (!deleted) return GEKKO_ERROR;
+    if (!deleted_count) return GEKKO_ERROR;
+
+    *deleted = NULL;
+    *deleted_count = 0;
+
+    if (ignore && !ignore->rules) ignore = NULL;
+
+    if (index->count) {
+        gone = (size_t *)malloc(index->count * sizeof(size_t));
+        if (ignore) scratch = (uint32_t *)malloc(2 * gko_ignore_width(ignore) * sizeof(uint32_t));
+        if (!gone || (ignore && !scratch)) {
+            fprintf(stderr, "Insufficient memory.\n");
+            free(gone);
+            free(scratch);
+            return GEKKO_ERROR;
+        }
+    }
+
+    while (i < scan->count || j < index->count) {
+        if (i == scan->count) {
+            cmp = 1;
+        } else if (j == index->count) {
+            cmp = -1;
+        } else {
+            cmp = strcmp(scan->entries[i].path, gko_index_path(index, j));
+        }
+
+        if (cmp > 0) {
+            // newly ignored paths drop out of the index, the remote keeps its copy
+            if (!ignore || !gko_ignore_path(ignore, gko_index_path(index, j), S_ISDIR(index->records[j].mode),
+                                            scratch)) gone[ngone++] = j;
+            j++;
+            continue;
+        }
+
+        entry = &scan->entries[i++];
+
+        if (cmp < 0) {
+            entry->flags = GKO_ENTRY_NEW | GKO_ENTRY_STALE | GKO_ENTRY_DIRTY;
+            continue;
+        }
+
+        gko_index_flag(entry, &index->records[j++]);
+    }
+
+    free(scratch);
+    *deleted = gone;
+    *deleted_count = ngone;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Flag a partial scan against index, entries outside the scan are left alone
+    arguments:      index:  index of the last sync
+                    scan:   entries of some paths only, sorted, get GKO_ENTRY_* flags and known hashes
+    return:         error code
+**********************************************************************************************************************/
+int gko_index_lookup(const GKO_INDEX *index, GKO_SCAN *scan)
+{
+    size_t  i   = 0;
+    size_t  j   = 0;
+
+    if (!index) return GEKKO_ERROR;
+    if (!scan) return GEKKO_ERROR;
+
+    for (i = 0; i < scan->count; i++) {
+        j = gko_index_find(index, scan->entries[i].path);
+        if (j == index->count) {
+            scan->entries[i].flags = GKO_ENTRY_NEW | GKO_ENTRY_STALE | GKO_ENTRY_DIRTY;
+        } else {
+            gko_index_flag(&scan->entries[i], &index->records[j]);
+        }
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Write scan as the new index, atomically replacing the old one
+    arguments:      path:   index file path
+                    scan:   scan with hashes of every entry
+    return:         error code
+**********************************************************************************************************************/
+int gko_index_write(const char *path, const GKO_SCAN *scan)
+{
+    GKO_INDEX_HEADER    header;
+    GKO_INDEX_RECORD    rec;
+    FILE               *file            = NULL;
+    char                temp[PATH_MAX]  = {0};
+    uint64_t            offset          = 0;
+    size_t              len             = 0;
+    size_t              i               = 0;
+    bool                error           = false;
+
+    if (!path) return GEKKO_ERROR;
+    if (!scan) return GEKKO_ERROR;
+
+    snprintf(temp, PATH_MAX, "%s.%ld.tmp", path, (long)getpid());
+
+    file = fopen(temp, "wb");
+    if (!file) {
+        fprintf(stderr, "Cannot open file %s.\n", temp);
+        return GEKKO_ERROR;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GEKKO_INDEX_MAGIC, sizeof(header.magic));
+    header.version      = GEKKO_INDEX_VERSION;
+    header.record_size  = sizeof(GKO_INDEX_RECORD);
+    header.count        = scan->count;
+    header.strings      = sizeof(GKO_INDEX_HEADER) + scan->count * sizeof(GKO_INDEX_RECORD);
+
+    for (i = 0; i < scan->count; i++) offset += strlen(scan->entries[i].path) + 1;
+    header.length = header.strings + (offset ? offset : 1);
+
+    error |= (fwrite(&header, sizeof(header), 1, file) != 1);
+
+    memset(&rec, 0, sizeof(rec));
+    for (i = 0, offset = 0; i < scan->count && !error; i++) {
+        len = strlen(scan->entries[i].path);
+
+        rec.path     = offset;
+        rec.path_len = (uint32_t)len;
+        rec.mode     = scan->entries[i].mode;
+        rec.size     = scan->entries[i].size;
+        rec.mtime_ns = scan->entries[i].mtime_ns;
+        rec.ctime_ns = scan->entries[i].ctime_ns;
+        rec.inode    = scan->entries[i].inode;
+        rec.hash     = scan->entries[i].hash;
+
+        error |= (fwrite(&rec, sizeof(rec), 1, file) != 1);
+        offset += len + 1;
+    }
+
+    for (i = 0; i < scan->count && !error; i++) {
+        error |= (fwrite(scan->entries[i].path, strlen(scan->entries[i].path) + 1, 1, file) != 1);
+    }
+
+    // keep the string table non-empty so the trailing NUL check holds
+    if (!scan->count && !error) error |= (fputc('\0', file) == EOF);
+
+    error |= (fflush(file) != 0);
+    error |= (fsync(fileno(file)) != 0);
+    error |= (fclose(file) != 0);
+
+    if (error || rename(temp, path) != 0) {
+        fprintf(stderr, "Cannot write index %s.\n", path);
+        unlink(temp);
+        return GEKKO_ERROR;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Write index updated by a partial scan, atomically replacing the old one
+    arguments:      path:           index file path
+                    index:          index of the last sync
+                    scan:           entries of some paths only, sorted, with hashes
+                    deleted:        record numbers gone from the tree
+                    deleted_count:  number of deleted records
+    return:         error code
+**********************************************************************************************************************/
+int gko_index_merge(const char *path, const GKO_INDEX *index, const GKO_SCAN *scan,
+                    const size_t *deleted, size_t deleted_count)
+{
+    const GKO_INDEX_RECORD     *rec     = NULL;
+    GKO_SCAN                    merged;
+    bool                       *gone    = NULL;
+    size_t                      i       = 0;
+    size_t                      j       = 0;
+    int                         cmp     = 0;
+    int                         ret     = GEKKO_ERROR;
+
+    if (!path) return GEKKO_ERROR;
+    if (!index) return GEKKO_ERROR;
+    if (!scan) return GEKKO_ERROR;
+
+    memset(&merged, 0, sizeof(merged));
+    merged.entries = (GKO_ENTRY *)malloc((index->count + scan->count + 1) * sizeof(GKO_ENTRY));
+    gone = (bool *)zalloc((index->count + 1) * sizeof(bool));
+    if (!merged.entries || !gone) {
+        fprintf(stderr, "Insufficient memory.\n");
+        free(merged.entries);
+        free(gone);
+        return GEKKO_ERROR;
+    }
+
+    for (i = 0; i < deleted_count; i++) {
+        if (deleted[i] < index->count) gone[deleted[i]] = true;
+    }
+
+    // entry paths borrow the mapped string table and the scan, both outlive the write
+    for (i = 0, j = 0; i < scan->count || j < index->count; ) {
+        if (i == scan->count) {
+            cmp = 1;
+        } else if (j == index->count) {
+            cmp = -1;
+        } else {
+            cmp = strcmp(scan->entries[i].path, gko_index_path(index, j));
+        }
+
+        if (cmp <= 0) {
+            merged.entries[merged.count++] = scan->entries[i++];
+            if (cmp == 0) j++;
+            continue;
+        }
+
+        if (!gone[j]) {
+            rec = &index->records[j];
+            memset(&merged.entries[merged.count], 0, sizeof(GKO_ENTRY));
+            merged.entries[merged.count].path     = gko_index_path(index, j);
+            merged.entries[merged.count].size     = rec->size;
+            merged.entries[merged.count].mtime_ns = rec->mtime_ns;
+            merged.entries[merged.count].ctime_ns = rec->ctime_ns;
+            merged.entries[merged.count].mode     = rec->mode;
+            merged.entries[merged.count].inode    = rec->inode;
+            merged.entries[merged.count].hash     = rec->hash;
+            merged.count++;
+        }
+        j++;
+    }
+
+    ret = gko_index_write(path, &merged);
+
+    free(merged.entries);
+    free(gone);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,75 @@
+/**********************************************************************************************************************
+    file:           index.h
+    description:    Persistent local index of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_INDEX_H
+#define __GEKKO_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "scan.h"
+/**********************************************************************************************************************
+    index defaults
+**********************************************************************************************************************/
+#define GEKKO_INDEX_DIR                 ".gekko"
+#define GEKKO_INDEX_SUFFIX              ".index"
+#define GEKKO_INDEX_MAGIC               "GKOINDEX"
+#define GEKKO_INDEX_VERSION             (1)
+/**********************************************************************************************************************
+    on-disk layout: header, records sorted by path, then NUL terminated paths
+**********************************************************************************************************************/
+typedef struct {
+    char            magic[8];
+    uint32_t        version;
+    uint32_t        record_size;
+    uint64_t        count;
+    uint64_t        strings;
+    uint64_t        length;
+} GKO_INDEX_HEADER;
+
+typedef struct {
+    uint64_t        path;
+    uint32_t        path_len;
+    uint32_t        mode;
+    uint64_t        size;
+    int64_t         mtime_ns;
+    int64_t         ctime_ns;
+    uint64_t        inode;
+    uint64_t        hash;
+} GKO_INDEX_RECORD;
+/**********************************************************************************************************************
+    mapped index
+**********************************************************************************************************************/
+typedef struct {
+    void                       *map;
+    size_t                      length;
+    const GKO_INDEX_RECORD     *records;
+    size_t                      count;
+    const char                 *strings;
+    size_t                      span;           // bytes of the string area, the last one is a NUL
+} GKO_INDEX;
+
+// records are not checked on open, an offset past the string area reads as an empty path
+#define gko_index_path(index, i)        (((index)->records[i].path < (index)->span) ? \
+                                         (index)->strings + (index)->records[i].path : "")
+/**********************************************************************************************************************
+    index functions
+**********************************************************************************************************************/
+int    gko_index_open(const char *path, GKO_INDEX *index);
+void   gko_index_close(GKO_INDEX *index);
+int    gko_index_diff(const GKO_INDEX *index, GKO_SCAN *scan, const GKO_IGNORE *ignore,
+                      size_t **deleted, size_t *deleted_count);
+size_t gko_index_lower(const GKO_INDEX *index, const char *path);
+size_t gko_index_find(const GKO_INDEX *index, const char *path);
+int    gko_index_lookup(const GKO_INDEX *index, GKO_SCAN *scan);
+int    gko_index_write(const char *path, const GKO_SCAN *scan);
+int    gko_index_merge(const char *path, const GKO_INDEX *index, const GKO_SCAN *scan,
+                       const size_t *deleted, size_t deleted_count);
+
+#endif  // __GEKKO_INDEX_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
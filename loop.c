@@ -0,0 +1,776 @@
+/**********************************************************************************************************************
+    file:           loop.c
+    description:    Non-blocking transfer engine of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#ifdef LINUX
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+#include "gekko.h"
+#include "pool.h"
+#include "compress.h"
+#include "source.h"
+#include "index.h"
+#include "loop.h"
+/**********************************************************************************************************************
+    loop types
+**********************************************************************************************************************/
+typedef enum {
+    GKO_OP_IDLE     = 0,
+    GKO_OP_OPEN     = 1,            // sftp upload
+    GKO_OP_WRITE    = 2,
+    GKO_OP_CLOSE    = 3,
+    GKO_OP_EXEC     = 4,            // compressed stream on an exec channel
+    GKO_OP_PUMP     = 5,
+    GKO_OP_FINISH   = 6,
+    GKO_OP_REMOVE   = 7,            // sftp metadata
+    GKO_OP_READ     = 8,            // sftp upload waiting for its read-ahead
+} GKO_OP_STATE;
+
+typedef struct {
+    GKO_OP_STATE            state;
+    const GKO_ENTRY        *entry;
+    LIBSSH2_SFTP_HANDLE    *handle;
+    LIBSSH2_CHANNEL        *channel;
+    GKO_COMPRESSOR          comp;
+    GKO_CLASS               cls;        // GKO_CLASS_MAX when the file was not sniffed
+    GKO_RATE_CLASS          priority;
+    int                     level;
+    int                     stage;      // step within the channel setup and teardown
+    double                  cpu;
+    int                     fd;
+    GKO_SOURCE              src;        // plain uploads read the file in place
+    char                   *buffer;
+    size_t                  size;
+    size_t                  head;
+    size_t                  tail;
+    bool                    eof;
+    bool                    failed;
+    char                    remote[PATH_MAX];
+} GKO_OP;
+
+typedef struct {
+    GKO_TRANSFER           *xfer;
+    GKO_OP                 *ops;
+    uint8_t               **scratch;    // pread buffer of every slot, allocated on first use and kept
+    int                     opening;    // slot inside the sftp open state machine
+    int                     channeling; // slot inside the session channel open state machine
+    int                     removing;   // slot inside the sftp unlink state machine
+    int                     removes;
+    int                     events;
+    double                  pause;      // shortest wait for the bandwidth limit this round, 0 for none
+} GKO_LOOP_SESSION;
+
+#define GKO_STEP_BLOCKED                (0)
+#define GKO_STEP_PROGRESS               (1)
+/**********************************************************************************************************************
+    description:    Thread CPU clock in seconds
+    arguments:      -
+    return:         seconds
+**********************************************************************************************************************/
+static double gko_loop_cpu(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+/**********************************************************************************************************************
+    description:    Ask the bandwidth limit for bytes, noting how long to wait when there are none
+    arguments:      ls:     loop session
+                    want:   bytes wanted
+                    cls:    priority class
+    return:         bytes granted, 0 to wait
+**********************************************************************************************************************/
+static size_t gko_loop_take(GKO_LOOP_SESSION *ls, size_t want, GKO_RATE_CLASS cls)
+{
+    double  delay   = 0;
+    size_t  grant   = gko_rate_take(ls->xfer->rate, want, cls, &delay);
+
+    if (!grant && (ls->pause == 0 || delay < ls->pause)) ls->pause = delay;
+
+    return grant;
+}
+/**********************************************************************************************************************
+    description:    Release local resources of a finished operation and account it
+    arguments:      ls:     loop session
+                    op:     operation
+    return:         -
+**********************************************************************************************************************/
+static void gko_op_finish(GKO_LOOP_SESSION *ls, GKO_OP *op)
+{
+    GKO_COMPRESS_STATS *stats   = NULL;
+
+    gko_source_close(&op->src);
+    if (op->fd >= 0) close(op->fd);
+    gko_compressor_free(&op->comp);
+    free(op->buffer);
+    if (op->entry) gko_prefetch_release(ls->xfer->prefetch, op->entry);
+    if (op->entry) gko_fanout_release(ls->xfer->fanout, ls->xfer->host, op->entry);
+
+    if (op->state == GKO_OP_REMOVE) {
+        ls->removes--;
+        if (op->failed) fprintf(stderr, "Cannot remove remote %s.\n", op->remote);
+    } else if (op->failed) {
+        fprintf(stderr, "Failed to upload %s.\n", op->entry->path);
+    } else {
+        ls->xfer->files++;
+        ls->xfer->bytes += op->entry->size;
+
+        if (op->cls != GKO_CLASS_MAX) {
+            stats = &ls->xfer->classes[op->cls];
+            stats->files++;
+            stats->bytes += op->entry->size;
+            stats->wire  += (op->state == GKO_OP_FINISH) ? op->comp.wire : op->entry->size;
+            stats->cpu   += op->cpu;
+        }
+    }
+
+    op->fd      = -1;
+    op->buffer  = NULL;
+    op->handle  = NULL;
+    op->channel = NULL;
+    op->state   = GKO_OP_IDLE;
+}
+/**********************************************************************************************************************
+    description:    Give a failed compressed stream a second chance as a plain sftp upload
+    arguments:      op:     operation
+    return:         -
+**********************************************************************************************************************/
+static void gko_op_fallback(GKO_OP *op)
+{
+    printf("zstd %s: not available, uploading whole file.\n", op->entry->path);
+
+    if (op->fd >= 0) close(op->fd);
+    gko_compressor_free(&op->comp);
+    free(op->buffer);
+
+    op->fd      = -1;
+    op->buffer  = NULL;
+    op->channel = NULL;
+    op->head    = 0;
+    op->tail    = 0;
+    op->eof     = false;
+    op->failed  = false;
+    op->state   = GKO_OP_OPEN;
+}
+/**********************************************************************************************************************
+    description:    Start an operation on a file, dense or small files go over sftp, the rest through zstd
+    arguments:      ls:     loop session
+                    op:     idle operation
+                    entry:  file to upload
+    return:         -
+**********************************************************************************************************************/
+static void gko_op_start(GKO_LOOP_SESSION *ls, GKO_OP *op, const GKO_ENTRY *entry)
+{
+    GKO_TRANSFER   *xfer    = ls->xfer;
+    double          cpu     = 0;
+
+    memset(op, 0, sizeof(GKO_OP));
+    op->entry    = entry;
+    op->fd       = -1;
+    op->cls      = GKO_CLASS_MAX;
+    op->priority = gko_rate_class(entry->size);
+    op->state    = GKO_OP_OPEN;
+    snprintf(op->remote, PATH_MAX, "%s/%s", xfer->remote, entry->path);
+
+    if (!gko_transfer_wants_compress(entry, xfer->compress)) return;
+
+    op->fd = openat(xfer->rootfd, entry->path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (op->fd < 0) return;
+
+    cpu = gko_loop_cpu();
+    op->cls = gko_compress_sniff(op->fd, NULL);
+    op->level = gko_compress_level(op->cls, xfer->compress);
+    op->cpu = gko_loop_cpu() - cpu;
+
+    if (op->level > 0 && gko_compressor_init(&op->comp, op->fd, op->level) == GEKKO_OK) {
+        op->size   = GEKKO_COMPRESS_BUFFER;
+        op->buffer = (char *)malloc(op->size);
+        if (op->buffer) {
+            // zstd reads the file itself, the read-ahead has at least left it in the page cache
+            gko_prefetch_release(xfer->prefetch, entry);
+            op->state = GKO_OP_EXEC;
+            return;
+        }
+        gko_compressor_free(&op->comp);
+    }
+
+    // sent as is, the upload opens the file again
+    close(op->fd);
+    op->fd = -1;
+}
+/**********************************************************************************************************************
+    description:    Advance a compressed stream: open and exec a channel, pump zstd output, then close it
+    arguments:      ls:     loop session
+                    slot:   operation slot
+    return:         GKO_STEP_PROGRESS or GKO_STEP_BLOCKED
+**********************************************************************************************************************/
+static int gko_op_stream(GKO_LOOP_SESSION *ls, int slot)
+{
+    GKO_OP         *op                                  = &ls->ops[slot];
+    GKO_TRANSFER   *xfer                                = ls->xfer;
+    char            gekko[PATH_MAX * 2]                 = {0};
+    char            quoted[PATH_MAX * 2]                = {0};
+    char            command[GEKKO_TRANSFER_COMMAND_MAX] = {0};
+    double          cpu                                 = 0;
+    bool            moved                               = false;
+    size_t          grant                               = 0;
+    ssize_t         n                                   = 0;
+    int             rc                                  = 0;
+
+    switch (op->state) {
+    case GKO_OP_EXEC:
+        if (op->stage == 0) {
+            // the channel open state machine lives in the session, one open at a time per session
+            if (ls->channeling >= 0 && ls->channeling != slot) return GKO_STEP_BLOCKED;
+
+            op->channel = libssh2_channel_open_session(xfer->session);
+            if (!op->channel) {
+                if (libssh2_session_last_errno(xfer->session) == LIBSSH2_ERROR_EAGAIN) {
+                    ls->channeling = slot;
+                    return GKO_STEP_BLOCKED;
+                }
+                ls->channeling = -1;
+                gko_op_fallback(op);
+                return GKO_STEP_PROGRESS;
+            }
+            ls->channeling = -1;
+            op->stage = 1;
+        }
+
+        if (op->stage == 1) {
+            rc = libssh2_channel_handle_extended_data2(op->channel, LIBSSH2_CHANNEL_EXTENDED_DATA_IGNORE);
+            if (rc == LIBSSH2_ERROR_EAGAIN) return GKO_STEP_BLOCKED;
+            op->stage = 2;
+        }
+
+        // a command cut short would run on the wrong path, the op fails instead
+        if (gko_shell_quote(gekko, sizeof(gekko), xfer->gekko) != GEKKO_OK ||
+            gko_shell_quote(quoted, sizeof(quoted), op->remote) != GEKKO_OK ||
+            snprintf(command, sizeof(command), "%s remote unzstd %o %s",
+                     gekko, op->entry->mode & 0777, quoted) >= (int)sizeof(command)) {
+            op->failed = true;
+            op->state = GKO_OP_FINISH;
+            op->stage = 0;
+            return GKO_STEP_PROGRESS;
+        }
+
+        rc = libssh2_channel_exec(op->channel, command);
+        if (rc == LIBSSH2_ERROR_EAGAIN) return GKO_STEP_BLOCKED;
+
+        op->failed = (rc != GEKKO_OK);
+        op->state = (op->failed) ? GKO_OP_FINISH : GKO_OP_PUMP;
+        op->stage = 0;
+        return GKO_STEP_PROGRESS;
+
+    case GKO_OP_PUMP:
+        if (op->head == op->tail) {
+            cpu = gko_loop_cpu();
+            n = gko_compressor_read(&op->comp, op->buffer, op->size);
+            op->cpu += gko_loop_cpu() - cpu;
+
+            if (n <= 0) {
+                op->failed = (n < 0);
+                op->state = GKO_OP_FINISH;
+                return GKO_STEP_PROGRESS;
+            }
+
+            op->head = 0;
+            op->tail = (size_t)n;
+            moved = true;
+        }
+
+        // a quantum per round, so no single stream keeps the others and the metadata waiting
+        grant = gko_loop_take(ls, (op->tail - op->head < GEKKO_LOOP_QUANTUM) ? op->tail - op->head
+                                                                            : GEKKO_LOOP_QUANTUM, op->priority);
+        if (!grant) return (moved) ? GKO_STEP_PROGRESS : GKO_STEP_BLOCKED;
+
+        n = libssh2_channel_write(op->channel, op->buffer + op->head, grant);
+        gko_rate_refund(xfer->rate, (n > 0) ? grant - (size_t)n : grant, op->priority);
+        if (n == LIBSSH2_ERROR_EAGAIN) return (moved) ? GKO_STEP_PROGRESS : GKO_STEP_BLOCKED;
+        if (n < 0) {
+            op->failed = true;
+            op->state = GKO_OP_FINISH;
+            return GKO_STEP_PROGRESS;
+        }
+
+        op->head += (size_t)n;
+        xfer->sent += (uint64_t)n;
+        return GKO_STEP_PROGRESS;
+
+    case GKO_OP_FINISH:
+        // eof, wait for the remote to rebuild and exit, then tear the channel down
+        if (op->channel && op->stage == 0) {
+            if (libssh2_channel_send_eof(op->channel) == LIBSSH2_ERROR_EAGAIN) return GKO_STEP_BLOCKED;
+            op->stage = 1;
+        }
+        if (op->channel && op->stage == 1) {
+            if (libssh2_channel_wait_eof(op->channel) == LIBSSH2_ERROR_EAGAIN) return GKO_STEP_BLOCKED;
+            op->stage = 2;
+        }
+        if (op->channel && op->stage == 2) {
+            if (libssh2_channel_close(op->channel) == LIBSSH2_ERROR_EAGAIN) return GKO_STEP_BLOCKED;
+            op->stage = 3;
+        }
+        if (op->channel && op->stage == 3) {
+            if (libssh2_channel_wait_closed(op->channel) == LIBSSH2_ERROR_EAGAIN) return GKO_STEP_BLOCKED;
+            if (libssh2_channel_get_exit_status(op->channel) != GEKKO_OK) op->failed = true;
+            op->stage = 4;
+        }
+        if (op->channel && op->stage == 4) {
+            if (libssh2_channel_free(op->channel) == LIBSSH2_ERROR_EAGAIN) return GKO_STEP_BLOCKED;
+            op->channel = NULL;
+        }
+
+        if (op->failed) {
+            gko_op_fallback(op);
+        } else {
+            gko_op_finish(ls, op);
+        }
+        return GKO_STEP_PROGRESS;
+
+    default:
+        return GKO_STEP_BLOCKED;
+    }
+}
+/**********************************************************************************************************************
+    description:    Advance a remote removal
+    arguments:      ls:     loop session
+                    slot:   operation slot
+    return:         GKO_STEP_PROGRESS or GKO_STEP_BLOCKED
+**********************************************************************************************************************/
+static int gko_op_remove(GKO_LOOP_SESSION *ls, int slot)
+{
+    GKO_OP         *op      = &ls->ops[slot];
+    GKO_TRANSFER   *xfer    = ls->xfer;
+    int             rc      = 0;
+
+    if (ls->removing >= 0 && ls->removing != slot) return GKO_STEP_BLOCKED;
+    if (ls->removing != slot && !gko_loop_take(ls, GEKKO_RATE_META_BYTES, GKO_RATE_META)) return GKO_STEP_BLOCKED;
+
+    rc = libssh2_sftp_unlink(xfer->sftp, op->remote);
+    if (rc == LIBSSH2_ERROR_EAGAIN) {
+        ls->removing = slot;
+        return GKO_STEP_BLOCKED;
+    }
+    ls->removing = -1;
+
+    op->failed = (rc != GEKKO_OK && libssh2_sftp_last_error(xfer->sftp) != LIBSSH2_FX_NO_SUCH_FILE);
+    gko_op_finish(ls, op);
+
+    return GKO_STEP_PROGRESS;
+}
+/**********************************************************************************************************************
+    description:    Find where the bytes of an sftp upload come from: its read-ahead once it has landed, else the
+                    file itself, a read still under way parks the operation until it lands
+    arguments:      ls:     loop session
+                    slot:   operation slot
+    return:         GKO_STEP_PROGRESS or GKO_STEP_BLOCKED
+**********************************************************************************************************************/
+static int gko_op_source(GKO_LOOP_SESSION *ls, int slot)
+{
+    GKO_OP             *op      = &ls->ops[slot];
+    GKO_TRANSFER       *xfer    = ls->xfer;
+    GKO_PREFETCH_STATE  state   = GKO_PREFETCH_FAILED;
+    const uint8_t      *data    = NULL;
+    size_t              length  = 0;
+
+    op->size = (size_t)((xfer->window > 0) ? xfer->window : GEKKO_TRANSFER_WINDOW) * GEKKO_TRANSFER_CHUNK;
+
+    state = gko_prefetch_take(xfer->prefetch, op->entry, false, &data, &length);
+    if (state == GKO_PREFETCH_WAITING || state == GKO_PREFETCH_READING) {
+        op->state = GKO_OP_READ;
+        return GKO_STEP_BLOCKED;
+    }
+
+    if (state == GKO_PREFETCH_READY) {
+        gko_source_memory(&op->src, data, 0, length, op->size);
+        op->state = GKO_OP_WRITE;
+        return GKO_STEP_PROGRESS;
+    }
+
+    if (gko_fanout_take(xfer->fanout, xfer->host, op->entry, false, &data, &length)) {
+        gko_source_memory(&op->src, data, 0, length, op->size);
+        op->state = GKO_OP_WRITE;
+        return GKO_STEP_PROGRESS;
+    }
+
+    if (!ls->scratch[slot]) ls->scratch[slot] = (uint8_t *)gko_source_buffer(op->size);
+
+    op->fd     = openat(xfer->rootfd, op->entry->path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    op->failed = (!ls->scratch[slot] || op->fd < 0 ||
+                  gko_source_open(&op->src, op->fd, 0, 0, ls->scratch[slot], op->size) != GEKKO_OK);
+    op->src.keep = (xfer->fanout != NULL);
+    op->state  = (op->failed) ? GKO_OP_CLOSE : GKO_OP_WRITE;
+
+    return GKO_STEP_PROGRESS;
+}
+/**********************************************************************************************************************
+    description:    Advance one operation as far as it goes without blocking
+    arguments:      ls:     loop session
+                    slot:   operation slot
+    return:         GKO_STEP_PROGRESS or GKO_STEP_BLOCKED
+**********************************************************************************************************************/
+static int gko_op_step(GKO_LOOP_SESSION *ls, int slot)
+{
+    GKO_OP         *op      = &ls->ops[slot];
+    GKO_TRANSFER   *xfer    = ls->xfer;
+    bool            moved   = false;
+    ssize_t         n       = 0;
+    size_t          grant   = 0;
+
+    switch (op->state) {
+    case GKO_OP_OPEN:
+        // the open state machine lives in the sftp instance, one open at a time per session
+        if (ls->opening >= 0 && ls->opening != slot) return GKO_STEP_BLOCKED;
+
+        op->handle = libssh2_sftp_open(xfer->sftp, op->remote,
+                                       LIBSSH2_FXF_WRITE | LIBSSH2_FXF_CREAT | LIBSSH2_FXF_TRUNC,
+                                       op->entry->mode & 0777);
+        if (!op->handle) {
+            if (libssh2_session_last_errno(xfer->session) == LIBSSH2_ERROR_EAGAIN) {
+                ls->opening = slot;
+                return GKO_STEP_BLOCKED;
+            }
+            ls->opening = -1;
+            op->failed = true;
+            gko_op_finish(ls, op);
+            return GKO_STEP_PROGRESS;
+        }
+        ls->opening = -1;
+
+        gko_op_source(ls, slot);
+        return GKO_STEP_PROGRESS;
+
+    case GKO_OP_READ:
+        return gko_op_source(ls, slot);
+
+    case GKO_OP_WRITE:
+        // bytes are charged to the limit as they become pending, re-offered ones are already paid for
+        if (!op->eof && gko_source_pending(&op->src) < op->size &&
+            (grant = gko_loop_take(ls, op->size - gko_source_pending(&op->src), op->priority))) {
+            n = gko_source_fill(&op->src, grant);
+            gko_rate_refund(xfer->rate, (n > 0) ? grant - (size_t)n : grant, op->priority);
+            if (n < 0) {
+                op->failed = true;
+                op->state = GKO_OP_CLOSE;
+                return GKO_STEP_PROGRESS;
+            }
+            if (n == 0) op->eof = true;
+            moved = true;
+        }
+
+        if (!gko_source_pending(&op->src)) {
+            if (!op->eof) return (moved) ? GKO_STEP_PROGRESS : GKO_STEP_BLOCKED;
+            op->state = GKO_OP_CLOSE;
+            return GKO_STEP_PROGRESS;
+        }
+
+        // same contract as the blocking path, unacknowledged bytes are offered again next time
+        n = libssh2_sftp_write(op->handle, (const char *)gko_source_data(&op->src), gko_source_pending(&op->src));
+        if (n == LIBSSH2_ERROR_EAGAIN) return (moved) ? GKO_STEP_PROGRESS : GKO_STEP_BLOCKED;
+        if (n < 0) {
+            op->failed = true;
+            op->state = GKO_OP_CLOSE;
+            return GKO_STEP_PROGRESS;
+        }
+
+        gko_source_consume(&op->src, (size_t)n);
+        xfer->sent += (uint64_t)n;
+        return GKO_STEP_PROGRESS;
+
+    case GKO_OP_CLOSE:
+        if (op->handle) {
+            n = libssh2_sftp_close(op->handle);
+            if (n == LIBSSH2_ERROR_EAGAIN) return GKO_STEP_BLOCKED;
+            if (n != GEKKO_OK) op->failed = true;
+        }
+        gko_op_finish(ls, op);
+        return GKO_STEP_PROGRESS;
+
+    case GKO_OP_EXEC:
+    case GKO_OP_PUMP:
+    case GKO_OP_FINISH:
+        return gko_op_stream(ls, slot);
+
+    case GKO_OP_REMOVE:
+        return gko_op_remove(ls, slot);
+
+    default:
+        return GKO_STEP_BLOCKED;
+    }
+}
+/**********************************************************************************************************************
+    description:    Step an operation and account it once it is done
+    arguments:      ls:     loop session
+                    slot:   operation slot
+                    active: operations in flight
+                    error:  set if the operation failed
+    return:         GKO_STEP_PROGRESS or GKO_STEP_BLOCKED
+**********************************************************************************************************************/
+static int gko_loop_advance(GKO_LOOP_SESSION *ls, int slot, size_t *active, bool *error)
+{
+    GKO_OP *op  = &ls->ops[slot];
+    int     ret = gko_op_step(ls, slot);
+
+    if (op->state == GKO_OP_IDLE) {
+        (*active)--;
+        if (op->failed) *error = true;
+    }
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Sleep until a socket is ready in the direction its session is waiting for, or until the
+                    bandwidth limit has bytes again
+    arguments:      loop:       loop sessions
+                    sessions:   number of sessions
+                    epfd:       epoll instance, unused without epoll
+    return:         -
+**********************************************************************************************************************/
+static void gko_loop_wait(GKO_LOOP_SESSION *loop, int sessions, int epfd)
+{
+    int                 timeout = GEKKO_LOOP_TIMEOUT_MS;
+    int                 pause   = 0;
+    int                 dirs    = 0;
+    int                 events  = 0;
+    int                 i       = 0;
+#ifdef LINUX
+    struct epoll_event  ev;
+    struct epoll_event  ready[GEKKO_POOL_SESSIONS_MAX + 1];
+#else
+    struct pollfd       fds[GEKKO_POOL_SESSIONS_MAX + 1];
+    int                 nfds    = sessions;
+#endif
+
+    // a throttled operation is woken by the clock, not by its socket
+    for (i = 0; i < sessions; i++) {
+        if (loop[i].pause <= 0) continue;
+        pause = (int)(loop[i].pause * 1000) + 1;
+        if (pause < timeout) timeout = pause;
+    }
+
+#ifdef LINUX
+    for (i = 0; i < sessions; i++) {
+        dirs = libssh2_session_block_directions(loop[i].xfer->session);
+        events = 0;
+        if (dirs & LIBSSH2_SESSION_BLOCK_INBOUND) events |= EPOLLIN;
+        if (dirs & LIBSSH2_SESSION_BLOCK_OUTBOUND) events |= EPOLLOUT;
+        if (!events) events = EPOLLIN;
+
+        if (events == loop[i].events) continue;
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = (uint32_t)events;
+        ev.data.u32 = (uint32_t)i;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, loop[i].xfer->sock, &ev);
+        loop[i].events = events;
+    }
+
+    epoll_wait(epfd, ready, GEKKO_POOL_SESSIONS_MAX + 1, timeout);
+#else
+    (void)epfd;
+    for (i = 0; i < sessions; i++) {
+        dirs = libssh2_session_block_directions(loop[i].xfer->session);
+        events = 0;
+        if (dirs & LIBSSH2_SESSION_BLOCK_INBOUND) events |= POLLIN;
+        if (dirs & LIBSSH2_SESSION_BLOCK_OUTBOUND) events |= POLLOUT;
+
+        fds[i].fd      = loop[i].xfer->sock;
+        fds[i].events  = (short)(events ? events : POLLIN);
+        fds[i].revents = 0;
+    }
+
+    // a landed read-ahead wakes the uploads waiting for it
+    if (gko_prefetch_fd(loop[0].xfer->prefetch) >= 0) {
+        fds[nfds].fd      = gko_prefetch_fd(loop[0].xfer->prefetch);
+        fds[nfds].events  = POLLIN;
+        fds[nfds].revents = 0;
+        nfds++;
+    }
+
+    poll(fds, (nfds_t)nfds, timeout);
+#endif
+
+    gko_prefetch_ack(loop[0].xfer->prefetch);
+}
+/**********************************************************************************************************************
+    description:    Upload files and remove deleted ones over all sessions from a single thread, many operations of
+                    mixed kinds in flight per session: sftp uploads, compressed streams on exec channels and sftp
+                    removals, the removals are served first so metadata never queues behind bulk data
+    arguments:      xfers:          transfer context of each session
+                    sessions:       number of sessions
+                    scan:           local scan
+                    files:          scan entries to upload
+                    count:          number of entries
+                    index:          index of the last sync, may be NULL without removals
+                    removed:        index records of files to remove, directories stay with the caller
+                    removed_count:  number of records
+                    ops:            concurrent operations per session, 0 for default
+    return:         error code
+**********************************************************************************************************************/
+int gko_loop_sync(GKO_TRANSFER **xfers, int sessions, const GKO_SCAN *scan, const size_t *files, size_t count,
+                  const GKO_INDEX *index, const size_t *removed, size_t removed_count, int ops)
+{
+    GKO_LOOP_SESSION   *loop        = NULL;
+    GKO_LOOP_SESSION   *ls          = NULL;
+    GKO_OP             *op          = NULL;
+    size_t              next        = 0;
+    size_t              gone        = 0;
+    size_t              active      = 0;
+    bool                progress    = false;
+    bool                hold        = false;
+    bool                error       = false;
+    int                 epfd        = -1;
+    int                 i, j;
+#ifdef LINUX
+    struct epoll_event  ev;
+#endif
+
+    if (!xfers || sessions <= 0) return GEKKO_ERROR;
+    if (!scan) return GEKKO_ERROR;
+    if (!files) count = 0;
+    if (!index || !removed) removed_count = 0;
+    if (!count && !removed_count) return GEKKO_OK;
+
+    if (sessions > GEKKO_POOL_SESSIONS_MAX) sessions = GEKKO_POOL_SESSIONS_MAX;
+    if (ops <= 0) ops = GEKKO_LOOP_OPS;
+    if (ops > GEKKO_LOOP_OPS_MAX) ops = GEKKO_LOOP_OPS_MAX;
+
+    loop = (GKO_LOOP_SESSION *)zalloc(sessions * sizeof(GKO_LOOP_SESSION));
+    if (!loop) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+#ifdef LINUX
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        fprintf(stderr, "Cannot create epoll instance.\n");
+        free(loop);
+        return GEKKO_ERROR;
+    }
+#endif
+
+    for (i = 0; i < sessions; i++) {
+        loop[i].xfer       = xfers[i];
+        loop[i].opening    = -1;
+        loop[i].channeling = -1;
+        loop[i].removing   = -1;
+#ifdef LINUX
+        loop[i].events     = EPOLLIN;
+#endif
+        loop[i].ops        = (GKO_OP *)zalloc(ops * sizeof(GKO_OP));
+        loop[i].scratch    = (uint8_t **)zalloc(ops * sizeof(uint8_t *));
+        if (!loop[i].ops || !loop[i].scratch) {
+            fprintf(stderr, "Insufficient memory.\n");
+            error = true;
+            goto __error_malloc;
+        }
+
+#ifdef LINUX
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = (uint32_t)i;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, xfers[i]->sock, &ev);
+#endif
+        libssh2_session_set_blocking(xfers[i]->session, 0);
+    }
+
+#ifdef LINUX
+    // every session shares the read-ahead of the plan, its reads land on one descriptor
+    if (gko_prefetch_fd(xfers[0]->prefetch) >= 0) {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = (uint32_t)sessions;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, gko_prefetch_fd(xfers[0]->prefetch), &ev);
+    }
+#endif
+
+    for (;;) {
+        progress = false;
+
+        for (i = 0; i < sessions; i++) {
+            ls = &loop[i];
+            ls->pause = 0;
+            hold = false;
+
+            // removals first, one slot per session, a removal stuck on a full socket holds the bulk writers back
+            for (j = 0; j < ops; j++) {
+                op = &ls->ops[j];
+
+                if (op->state == GKO_OP_IDLE && gone < removed_count && !ls->removes) {
+                    memset(op, 0, sizeof(GKO_OP));
+                    op->fd       = -1;
+                    op->cls      = GKO_CLASS_MAX;
+                    op->priority = GKO_RATE_META;
+                    op->state    = GKO_OP_REMOVE;
+                    snprintf(op->remote, PATH_MAX, "%s/%s", ls->xfer->remote,
+                             gko_index_path(index, removed[gone]));
+                    gone++;
+                    ls->removes++;
+                    active++;
+                }
+
+                if (op->state != GKO_OP_REMOVE) continue;
+
+                if (gko_loop_advance(ls, j, &active, &error) == GKO_STEP_PROGRESS) {
+                    progress = true;
+                } else if (libssh2_session_block_directions(ls->xfer->session) & LIBSSH2_SESSION_BLOCK_OUTBOUND) {
+                    hold = true;
+                }
+            }
+
+            for (j = 0; j < ops; j++) {
+                op = &ls->ops[j];
+
+                if (op->state == GKO_OP_IDLE) {
+                    if (next == count) continue;
+
+                    gko_op_start(ls, op, &scan->entries[files[next++]]);
+                    active++;
+                }
+
+                if (op->state == GKO_OP_REMOVE) continue;
+                if (hold && (op->state == GKO_OP_WRITE || op->state == GKO_OP_PUMP)) continue;
+
+                if (gko_loop_advance(ls, j, &active, &error) == GKO_STEP_PROGRESS) progress = true;
+            }
+        }
+
+        if (!active && next == count && gone == removed_count) break;
+        if (!progress) gko_loop_wait(loop, sessions, epfd);
+    }
+
+__error_malloc:
+    for (i = 0; i < sessions; i++) {
+        libssh2_session_set_blocking(xfers[i]->session, 1);
+        for (j = 0; loop[i].scratch && j < ops; j++) free(loop[i].scratch[j]);
+        free(loop[i].scratch);
+        free(loop[i].ops);
+    }
+    if (epfd >= 0) close(epfd);
+    free(loop);
+
+    return (error) ? GEKKO_ERROR : GEKKO_OK;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,32 @@
+/**********************************************************************************************************************
+    file:           loop.h
+    description:    Non-blocking transfer engine of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_LOOP_H
+#define __GEKKO_LOOP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "scan.h"
+#include "index.h"
+#include "transfer.h"
+/**********************************************************************************************************************
+    loop defaults
+**********************************************************************************************************************/
+#define GEKKO_LOOP_OPS                  (32)
+#define GEKKO_LOOP_OPS_MAX              (4096)
+#define GEKKO_LOOP_TIMEOUT_MS           (1000)
+#define GEKKO_LOOP_QUANTUM              (256 * 1024)    // bytes one stream may push per round
+/**********************************************************************************************************************
+    loop functions
+**********************************************************************************************************************/
+int gko_loop_sync(GKO_TRANSFER **xfers, int sessions, const GKO_SCAN *scan, const size_t *files, size_t count,
+                  const GKO_INDEX *index, const size_t *removed, size_t removed_count, int ops);
+
+#endif  // __GEKKO_LOOP_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,749 @@
+/**********************************************************************************************************************
+    file:           plan.c
+    description:    Sync plans of Gekko, worked out offline and carried out later exactly as shown
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <libssh2.h>
+#include <libssh2_sftp.h>
+
+#include "gekko.h"
+#include "plan.h"
+#include "pool.h"
+#include "sync.h"
+/**********************************************************************************************************************
+    description:    Name of an operation as the plan listing shows it
+    arguments:      op:     operation
+    return:         name
+**********************************************************************************************************************/
+const char *gko_plan_name(uint32_t op)
+{
+    static const char  *names[GKO_PLAN_OPS] = {"create", "update", "rename", "chmod", "delete"};
+
+    return (op < GKO_PLAN_OPS) ? names[op] : "unknown";
+}
+/**********************************************************************************************************************
+    description:    Phase an operation runs in, creates and updates share one so directories come before their files
+    arguments:      op:     operation
+    return:         phase
+**********************************************************************************************************************/
+static uint32_t gko_plan_phase(uint32_t op)
+{
+    return (op <= GKO_PLAN_UPDATE) ? 0 : op - GKO_PLAN_UPDATE;
+}
+/**********************************************************************************************************************
+    description:    Slot of a content key in the rename table
+    arguments:      hash:   content hash
+                    size:   file size
+                    mask:   table size - 1
+    return:         first slot to probe
+**********************************************************************************************************************/
+static size_t gko_plan_slot(uint64_t hash, uint64_t size, size_t mask)
+{
+    uint64_t    key = hash ^ (size * 0x9E3779B97F4A7C15ULL);
+
+    return (size_t)(key ^ (key >> 29)) & mask;
+}
+/**********************************************************************************************************************
+    description:    Work out every operation that brings the remote in line with the scan, nothing is sent. Creates
+                    and updates come in path order, renames and chmods follow, deletes come last, deepest first.
+                    A new file whose content a deleted remote file already holds is renamed there instead of sent.
+    arguments:      scan:           reconciled scan, flags tell what differs from the snapshot
+                    snapshot:       remote state the scan was reconciled against
+                    deleted:        snapshot records gone locally, in snapshot order
+                    deleted_count:  number of deleted records
+                    list:           plan, release with gko_plan_free()
+    return:         error code
+**********************************************************************************************************************/
+int gko_plan_build(const GKO_SCAN *scan, const GKO_INDEX *snapshot, const size_t *deleted, size_t deleted_count,
+                   GKO_PLAN_LIST *list)
+{
+    const GKO_INDEX_RECORD     *rec     = NULL;
+    const GKO_ENTRY            *entry   = NULL;
+    GKO_PLAN_ITEM              *items   = NULL;
+    size_t                     *table   = NULL;    // deleted[] position + 1 of every renameable file, 0 when empty
+    bool                       *moved   = NULL;
+    struct timespec             begin, end;
+    size_t                      start[GKO_PLAN_OPS];
+    size_t                      mask    = 0;
+    size_t                      slot    = 0;
+    size_t                      count   = 0;
+    size_t                      i       = 0;
+    size_t                      j       = 0;
+    uint32_t                    op      = 0;
+
+    if (!scan) return GEKKO_ERROR;
+    if (!snapshot) return GEKKO_ERROR;
+    if (!list) return GEKKO_ERROR;
+    if (deleted_count && !deleted) return GEKKO_ERROR;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    memset(list, 0, sizeof(GKO_PLAN_LIST));
+
+    items = (GKO_PLAN_ITEM *)malloc((scan->count + deleted_count + 1) * sizeof(GKO_PLAN_ITEM));
+    list->items = (GKO_PLAN_ITEM *)malloc((scan->count + deleted_count + 1) * sizeof(GKO_PLAN_ITEM));
+    moved = (bool *)zalloc((deleted_count + 1) * sizeof(bool));
+    if (deleted_count) {
+        for (mask = 1; mask < deleted_count * 2; mask <<= 1);
+        table = (size_t *)zalloc(mask * sizeof(size_t));
+        mask--;
+    }
+    if (!items || !list->items || !moved || (deleted_count && !table)) {
+        fprintf(stderr, "Insufficient memory.\n");
+        goto __error_build;
+    }
+
+    // only content we pushed ourselves carries a hash, a listed file is never assumed to match
+    for (i = 0; i < deleted_count; i++) {
+        rec = &snapshot->records[deleted[i]];
+        if (!S_ISREG(rec->mode) || !rec->hash) continue;
+        for (slot = gko_plan_slot(rec->hash, rec->size, mask); table[slot]; slot = (slot + 1) & mask);
+        table[slot] = i + 1;
+    }
+
+    for (i = 0; i < scan->count; i++) {
+        entry = &scan->entries[i];
+        if (!(entry->flags & GKO_ENTRY_DIRTY)) continue;
+        if (!S_ISREG(entry->mode) && !S_ISDIR(entry->mode)) continue;
+
+        items[count].entry  = i;
+        items[count].record = SIZE_MAX;
+
+        if (entry->flags & GKO_ENTRY_NEW) {
+            items[count].op = GKO_PLAN_CREATE;
+            if (table && S_ISREG(entry->mode) && entry->hash) {
+                for (slot = gko_plan_slot(entry->hash, entry->size, mask); table[slot]; slot = (slot + 1) & mask) {
+                    rec = &snapshot->records[deleted[table[slot] - 1]];
+                    if (moved[table[slot] - 1] || rec->hash != entry->hash || rec->size != entry->size) continue;
+                    moved[table[slot] - 1] = true;
+                    items[count].op     = GKO_PLAN_RENAME;
+                    items[count].record = deleted[table[slot] - 1];
+                    break;
+                }
+            }
+            count++;
+            continue;
+        }
+
+        // both sides are sorted, the snapshot cursor only moves forward; same kind and content, only the
+        // permission bits moved makes a chmod
+        items[count].op = GKO_PLAN_UPDATE;
+        while (j < snapshot->count && strcmp(gko_index_path(snapshot, j), entry->path) < 0) j++;
+        if (j < snapshot->count && strcmp(gko_index_path(snapshot, j), entry->path) == GEKKO_OK) {
+            rec = &snapshot->records[j];
+            if ((rec->mode & S_IFMT) == (entry->mode & S_IFMT) && rec->mode != entry->mode &&
+                (S_ISDIR(entry->mode) || (rec->hash && rec->hash == entry->hash && rec->size == entry->size))) {
+                items[count].op     = GKO_PLAN_CHMOD;
+                items[count].record = j;
+            }
+        }
+        count++;
+    }
+
+    for (i = deleted_count; i-- > 0; ) {
+        if (moved[i]) continue;
+        items[count].op     = GKO_PLAN_DELETE;
+        items[count].entry  = SIZE_MAX;
+        items[count].record = deleted[i];
+        count++;
+    }
+
+    // stable pass into execution order, every phase keeps the order it was found in
+    memset(start, 0, sizeof(start));
+    for (i = 0; i < count; i++) {
+        list->ops[items[i].op]++;
+        if (gko_plan_phase(items[i].op) + 1 < GKO_PLAN_OPS) start[gko_plan_phase(items[i].op) + 1]++;
+        if (items[i].op <= GKO_PLAN_UPDATE && S_ISREG(scan->entries[items[i].entry].mode)) {
+            list->bytes += scan->entries[items[i].entry].size;
+        }
+    }
+    for (op = 1; op < GKO_PLAN_OPS; op++) start[op] += start[op - 1];
+    for (i = 0; i < count; i++) list->items[start[gko_plan_phase(items[i].op)]++] = items[i];
+    list->count = count;
+
+    free(items);
+    free(table);
+    free(moved);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    list->elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    return GEKKO_OK;
+
+__error_build:
+    free(items);
+    free(table);
+    free(moved);
+    gko_plan_free(list);
+
+    return GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Path an item leaves behind on the remote
+    arguments:      item:       planned item
+                    scan:       scan the plan was built from
+                    snapshot:   snapshot the plan was built against
+    return:         path relative to the sync root
+**********************************************************************************************************************/
+static const char *gko_plan_item_path(const GKO_PLAN_ITEM *item, const GKO_SCAN *scan, const GKO_INDEX *snapshot)
+{
+    return (item->entry != SIZE_MAX) ? scan->entries[item->entry].path : gko_index_path(snapshot, item->record);
+}
+/**********************************************************************************************************************
+    description:    Print a plan, one operation per line in execution order and a summary
+    arguments:      list:       plan
+                    scan:       scan the plan was built from
+                    snapshot:   snapshot the plan was built against
+    return:         -
+**********************************************************************************************************************/
+void gko_plan_print(const GKO_PLAN_LIST *list, const GKO_SCAN *scan, const GKO_INDEX *snapshot)
+{
+    const GKO_PLAN_ITEM    *item    = NULL;
+    const GKO_ENTRY        *entry   = NULL;
+    size_t                  i       = 0;
+
+    if (!list || !scan || !snapshot) return;
+
+    for (i = 0; i < list->count; i++) {
+        item = &list->items[i];
+        entry = (item->entry != SIZE_MAX) ? &scan->entries[item->entry] : NULL;
+
+        if (item->op == GKO_PLAN_RENAME && (snapshot->records[item->record].mode & 07777) != (entry->mode & 07777)) {
+            printf("rename  %s -> %s %04o -> %04o\n", gko_index_path(snapshot, item->record), entry->path,
+                   (unsigned int)(snapshot->records[item->record].mode & 07777), (unsigned int)(entry->mode & 07777));
+        } else if (item->op == GKO_PLAN_RENAME) {
+            printf("rename  %s -> %s\n", gko_index_path(snapshot, item->record), entry->path);
+        } else if (item->op == GKO_PLAN_CHMOD) {
+            printf("chmod   %s %04o -> %04o\n", entry->path,
+                   (unsigned int)(snapshot->records[item->record].mode & 07777), (unsigned int)(entry->mode & 07777));
+        } else if (item->op == GKO_PLAN_DELETE) {
+            printf("delete  %s%s\n", gko_index_path(snapshot, item->record),
+                   S_ISDIR(snapshot->records[item->record].mode) ? "/" : "");
+        } else if (S_ISDIR(entry->mode)) {
+            printf("%-7s %s/\n", gko_plan_name(item->op), entry->path);
+        } else {
+            printf("%-7s %s (%llu bytes)\n", gko_plan_name(item->op), entry->path, (unsigned long long)entry->size);
+        }
+    }
+
+    printf("Plan: %llu create, %llu update, %llu rename, %llu chmod, %llu delete, %llu bytes to send, "
+           "worked out in %.3f s.\n",
+           (unsigned long long)list->ops[GKO_PLAN_CREATE], (unsigned long long)list->ops[GKO_PLAN_UPDATE],
+           (unsigned long long)list->ops[GKO_PLAN_RENAME], (unsigned long long)list->ops[GKO_PLAN_CHMOD],
+           (unsigned long long)list->ops[GKO_PLAN_DELETE], (unsigned long long)list->bytes, list->elapsed);
+}
+/**********************************************************************************************************************
+    description:    Stat tuple of a snapshot file, a missing one stamps as zeros
+    arguments:      snap:       snapshot path
+                    inode:      inode to store
+                    size:       size to store
+                    mtime_ns:   modification time to store
+    return:         -
+**********************************************************************************************************************/
+static void gko_plan_stamp(const char *snap, uint64_t *inode, uint64_t *size, int64_t *mtime_ns)
+{
+    struct stat st;
+
+    *inode = 0;
+    *size = 0;
+    *mtime_ns = 0;
+
+    if (!snap || stat(snap, &st) != 0) return;
+
+    *inode = (uint64_t)st.st_ino;
+    *size = (uint64_t)st.st_size;
+    *mtime_ns = GKO_STAT_MTIME_NS(&st);
+}
+/**********************************************************************************************************************
+    description:    Write a plan file, gko_plan_run() carries it out later without scanning or listing anything
+    arguments:      path:       plan file path
+                    list:       plan
+                    scan:       scan the plan was built from
+                    snapshot:   snapshot the plan was built against
+                    grip:       grip name
+                    remote:     remote sync root
+                    root:       local sync root
+                    snap:       snapshot file path, its stat tuple is stamped into the plan
+    return:         error code
+**********************************************************************************************************************/
+int gko_plan_write(const char *path, const GKO_PLAN_LIST *list, const GKO_SCAN *scan, const GKO_INDEX *snapshot,
+                   const char *grip, const char *remote, const char *root, const char *snap)
+{
+    GKO_PLAN_HEADER         header;
+    GKO_PLAN_RECORD         rec;
+    const GKO_PLAN_ITEM    *item            = NULL;
+    const GKO_ENTRY        *entry           = NULL;
+    const GKO_INDEX_RECORD *old             = NULL;
+    FILE                   *file            = NULL;
+    char                    temp[PATH_MAX]  = {0};
+    uint64_t                offset          = 0;
+    size_t                  i               = 0;
+    bool                    error           = false;
+
+    if (!path || !list || !scan || !snapshot) return GEKKO_ERROR;
+    if (!grip || !remote || !root) return GEKKO_ERROR;
+
+    snprintf(temp, PATH_MAX, "%s.tmp", path);
+
+    file = fopen(temp, "wb");
+    if (!file) {
+        fprintf(stderr, "Cannot open file %s.\n", temp);
+        return GEKKO_ERROR;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GEKKO_PLAN_MAGIC, sizeof(header.magic));
+    header.version      = GEKKO_PLAN_VERSION;
+    header.record_size  = sizeof(GKO_PLAN_RECORD);
+    header.count        = list->count;
+    header.strings      = sizeof(GKO_PLAN_HEADER) + list->count * sizeof(GKO_PLAN_RECORD);
+    header.bytes        = list->bytes;
+    memcpy(header.ops, list->ops, sizeof(header.ops));
+    gko_plan_stamp(snap, &header.snap_inode, &header.snap_size, &header.snap_mtime_ns);
+
+    header.grip   = offset;
+    offset += strlen(grip) + 1;
+    header.remote = offset;
+    offset += strlen(remote) + 1;
+    header.root   = offset;
+    offset += strlen(root) + 1;
+    for (i = 0; i < list->count; i++) {
+        offset += strlen(gko_plan_item_path(&list->items[i], scan, snapshot)) + 1;
+        if (list->items[i].op == GKO_PLAN_RENAME) offset += strlen(gko_index_path(snapshot, list->items[i].record)) + 1;
+    }
+    header.length = header.strings + offset;
+
+    error |= (fwrite(&header, sizeof(header), 1, file) != 1);
+
+    offset = header.root + strlen(root) + 1;
+    for (i = 0; i < list->count && !error; i++) {
+        item  = &list->items[i];
+        entry = (item->entry != SIZE_MAX) ? &scan->entries[item->entry] : NULL;
+        old   = (item->record != SIZE_MAX) ? &snapshot->records[item->record] : NULL;
+
+        memset(&rec, 0, sizeof(rec));
+        rec.op     = item->op;
+        rec.path   = offset;
+        rec.from   = GEKKO_PLAN_NONE;
+        rec.record = GEKKO_PLAN_NONE;
+        offset += strlen(gko_plan_item_path(item, scan, snapshot)) + 1;
+
+        if (entry) {
+            rec.mode     = entry->mode;
+            rec.size     = entry->size;
+            rec.mtime_ns = entry->mtime_ns;
+            rec.ctime_ns = entry->ctime_ns;
+            rec.inode    = entry->inode;
+            rec.hash     = entry->hash;
+        } else {
+            rec.mode     = old->mode;
+            rec.size     = old->size;
+            rec.mtime_ns = old->mtime_ns;
+            rec.ctime_ns = old->ctime_ns;
+            rec.inode    = old->inode;
+            rec.hash     = old->hash;
+        }
+
+        if (old) rec.old_mode = old->mode;
+        if (item->op == GKO_PLAN_DELETE || item->op == GKO_PLAN_RENAME) rec.record = item->record;
+        if (item->op == GKO_PLAN_RENAME) {
+            rec.from = offset;
+            offset += strlen(gko_index_path(snapshot, item->record)) + 1;
+        }
+
+        error |= (fwrite(&rec, sizeof(rec), 1, file) != 1);
+    }
+
+    error |= (fwrite(grip, strlen(grip) + 1, 1, file) != 1);
+    error |= (fwrite(remote, strlen(remote) + 1, 1, file) != 1);
+    error |= (fwrite(root, strlen(root) + 1, 1, file) != 1);
+    for (i = 0; i < list->count && !error; i++) {
+        item = &list->items[i];
+        error |= (fputs(gko_plan_item_path(item, scan, snapshot), file) == EOF || fputc('\0', file) == EOF);
+        if (item->op == GKO_PLAN_RENAME) {
+            error |= (fputs(gko_index_path(snapshot, item->record), file) == EOF || fputc('\0', file) == EOF);
+        }
+    }
+
+    error |= (fflush(file) != 0);
+    error |= (fsync(fileno(file)) != 0);
+    error |= (fclose(file) != 0);
+
+    if (error || rename(temp, path) != 0) {
+        fprintf(stderr, "Cannot write plan %s.\n", path);
+        unlink(temp);
+        return GEKKO_ERROR;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Release a plan that was built
+    arguments:      list:   plan
+    return:         -
+**********************************************************************************************************************/
+void gko_plan_free(GKO_PLAN_LIST *list)
+{
+    if (!list) return;
+
+    free(list->items);
+    memset(list, 0, sizeof(GKO_PLAN_LIST));
+}
+/**********************************************************************************************************************
+    description:    Map a plan file, every offset in it is checked before anything trusts it
+    arguments:      path:   plan file path
+                    plan:   mapped plan, release with gko_plan_close()
+    return:         error code
+**********************************************************************************************************************/
+int gko_plan_open(const char *path, GKO_PLAN *plan)
+{
+    const GKO_PLAN_HEADER  *header  = NULL;
+    const GKO_PLAN_RECORD  *rec     = NULL;
+    struct stat             st;
+    uint64_t                span    = 0;
+    size_t                  i       = 0;
+    int                     fd      = -1;
+
+    if (!path) return GEKKO_ERROR;
+    if (!plan) return GEKKO_ERROR;
+
+    memset(plan, 0, sizeof(GKO_PLAN));
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open file %s.\n", path);
+        return GEKKO_ERROR;
+    }
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size <= sizeof(GKO_PLAN_HEADER)) {
+        fprintf(stderr, "Invalid plan file %s.\n", path);
+        close(fd);
+        return GEKKO_ERROR;
+    }
+
+    plan->length = (size_t)st.st_size;
+    plan->map = mmap(NULL, plan->length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (plan->map == MAP_FAILED) {
+        fprintf(stderr, "Cannot map file %s.\n", path);
+        memset(plan, 0, sizeof(GKO_PLAN));
+        return GEKKO_ERROR;
+    }
+
+    header = (const GKO_PLAN_HEADER *)plan->map;
+    if (memcmp(header->magic, GEKKO_PLAN_MAGIC, sizeof(header->magic)) != GEKKO_OK ||
+        header->version != GEKKO_PLAN_VERSION ||
+        header->record_size != sizeof(GKO_PLAN_RECORD) ||
+        header->length != plan->length ||
+        header->count > (plan->length - sizeof(GKO_PLAN_HEADER)) / sizeof(GKO_PLAN_RECORD) ||
+        header->strings != sizeof(GKO_PLAN_HEADER) + header->count * sizeof(GKO_PLAN_RECORD) ||
+        header->strings >= header->length ||
+        ((const char *)plan->map)[plan->length - 1] != '\0') {
+        goto __error_plan;
+    }
+
+    span = header->length - header->strings;
+    if (header->grip >= span || header->remote >= span || header->root >= span) goto __error_plan;
+
+    plan->header  = header;
+    plan->records = (const GKO_PLAN_RECORD *)((const char *)plan->map + sizeof(GKO_PLAN_HEADER));
+    plan->count   = (size_t)header->count;
+    plan->strings = (const char *)plan->map + header->strings;
+
+    // execution relies on the phase order, a plan put together any other way is refused
+    for (i = 0; i < plan->count; i++) {
+        rec = &plan->records[i];
+        if (rec->op >= GKO_PLAN_OPS || rec->path >= span) goto __error_plan;
+        if (rec->op == GKO_PLAN_RENAME && (rec->from >= span || rec->record == GEKKO_PLAN_NONE)) goto __error_plan;
+        if (rec->op == GKO_PLAN_DELETE && rec->record == GEKKO_PLAN_NONE) goto __error_plan;
+        if (i && gko_plan_phase(rec->op) < gko_plan_phase(plan->records[i - 1].op)) goto __error_plan;
+    }
+
+    return GEKKO_OK;
+
+__error_plan:
+    fprintf(stderr, "Invalid plan file %s.\n", path);
+    gko_plan_close(plan);
+
+    return GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Unmap a plan file
+    arguments:      plan:   mapped plan
+    return:         -
+**********************************************************************************************************************/
+void gko_plan_close(GKO_PLAN *plan)
+{
+    if (!plan) return;
+
+    if (plan->map && plan->map != MAP_FAILED) munmap(plan->map, plan->length);
+    memset(plan, 0, sizeof(GKO_PLAN));
+}
+/**********************************************************************************************************************
+    description:    Check that neither side moved since the plan was made: the snapshot is the one it was worked out
+                    against and every local entry it sends or stamps still has the stat tuple it had then
+    arguments:      plan:   mapped plan
+                    snap:   snapshot file path
+                    rootfd: local sync root
+    return:         error code
+**********************************************************************************************************************/
+int gko_plan_check(const GKO_PLAN *plan, const char *snap, int rootfd)
+{
+    const GKO_PLAN_RECORD  *rec     = NULL;
+    const char             *path    = NULL;
+    struct stat             st;
+    uint64_t                inode   = 0;
+    uint64_t                size    = 0;
+    int64_t                 mtime   = 0;
+    size_t                  changed = 0;
+    size_t                  i       = 0;
+
+    if (!plan || !plan->header) return GEKKO_ERROR;
+    if (!snap) return GEKKO_ERROR;
+
+    gko_plan_stamp(snap, &inode, &size, &mtime);
+    if (inode != plan->header->snap_inode || size != plan->header->snap_size ||
+        mtime != plan->header->snap_mtime_ns) {
+        fprintf(stderr, "The remote snapshot changed since the plan was made, plan again.\n");
+        return GEKKO_ERROR;
+    }
+
+    for (i = 0; i < plan->count; i++) {
+        rec = &plan->records[i];
+        if (rec->op == GKO_PLAN_DELETE) continue;
+
+        path = gko_plan_string(plan, rec->path);
+        if (fstatat(rootfd, path, &st, AT_SYMLINK_NOFOLLOW) != 0 || (uint32_t)st.st_mode != rec->mode ||
+            (S_ISREG(st.st_mode) && ((uint64_t)st.st_size != rec->size || (uint64_t)st.st_ino != rec->inode ||
+                                     GKO_STAT_MTIME_NS(&st) != rec->mtime_ns ||
+                                     GKO_STAT_CTIME_NS(&st) != rec->ctime_ns))) {
+            fprintf(stderr, "%s changed since the plan was made.\n", path);
+            changed++;
+        }
+    }
+
+    if (changed) {
+        fprintf(stderr, "%lu entries changed locally, plan again.\n", (unsigned long)changed);
+        return GEKKO_ERROR;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Order snapshot record numbers
+    arguments:      a:  record number
+                    b:  record number
+    return:         comparison result
+**********************************************************************************************************************/
+static int gko_plan_order(const void *a, const void *b)
+{
+    size_t  x   = *(const size_t *)a;
+    size_t  y   = *(const size_t *)b;
+
+    return (x > y) - (x < y);
+}
+/**********************************************************************************************************************
+    description:    Scan entry of a plan record, its path borrows the mapped string table
+    arguments:      plan:   mapped plan
+                    rec:    record
+                    entry:  entry to fill
+                    flags:  GKO_ENTRY_* flags
+    return:         -
+**********************************************************************************************************************/
+static void gko_plan_entry(const GKO_PLAN *plan, const GKO_PLAN_RECORD *rec, GKO_ENTRY *entry, uint32_t flags)
+{
+    memset(entry, 0, sizeof(GKO_ENTRY));
+    entry->path     = gko_plan_string(plan, rec->path);
+    entry->size     = rec->size;
+    entry->mtime_ns = rec->mtime_ns;
+    entry->ctime_ns = rec->ctime_ns;
+    entry->mode     = rec->mode;
+    entry->flags    = flags;
+    entry->inode    = rec->inode;
+    entry->hash     = rec->hash;
+}
+/**********************************************************************************************************************
+    description:    Carry out a checked plan: creates and updates go through the usual sync, renames and chmods are
+                    single sftp requests, deletes go last. A rename the server refuses sends the file instead. The
+                    snapshot takes in the plan once every operation went through and stays as it was otherwise.
+    arguments:      plan:       mapped plan, gko_plan_check() passed on it
+                    grip:       grip
+                    rootfd:     local sync root
+                    snapshot:   snapshot the plan was built against
+                    snap:       snapshot file path
+    return:         error code
+**********************************************************************************************************************/
+int gko_plan_run(const GKO_PLAN *plan, const GRIP *grip, int rootfd, const GKO_INDEX *snapshot, const char *snap)
+{
+    LIBSSH2_SFTP_ATTRIBUTES     attrs;
+    const GKO_PLAN_RECORD      *rec                 = NULL;
+    const char                 *remote              = NULL;
+    GKO_POOL                    pool;
+    GKO_SCAN                    sent;
+    GKO_SCAN                    retry;
+    GKO_SCAN                    merged;
+    size_t                     *gone                = NULL;     // snapshot records the plan removes
+    size_t                     *removed             = NULL;     // the ones of them deleted on the remote
+    size_t                     *early               = NULL;     // held by a directory that became a file
+    size_t                      ngone               = 0;
+    size_t                      nremoved            = 0;
+    size_t                      nearly              = 0;
+    size_t                      len                 = 0;
+    size_t                      i                   = 0;
+    size_t                      j                   = 0;
+    size_t                      k                   = 0;
+    char                        from[PATH_MAX]      = {0};
+    char                        to[PATH_MAX]        = {0};
+    bool                        error               = false;
+    int                         ret                 = GEKKO_ERROR;
+
+    if (!plan || !plan->header) return GEKKO_ERROR;
+    if (!grip) return GEKKO_ERROR;
+    if (!snapshot) return GEKKO_ERROR;
+    if (!snap) return GEKKO_ERROR;
+
+    remote = gko_plan_string(plan, plan->header->remote);
+
+    memset(&sent, 0, sizeof(sent));
+    memset(&retry, 0, sizeof(retry));
+    memset(&merged, 0, sizeof(merged));
+
+    sent.entries = (GKO_ENTRY *)malloc((plan->count + 1) * sizeof(GKO_ENTRY));
+    retry.entries = (GKO_ENTRY *)malloc((plan->count + 1) * sizeof(GKO_ENTRY));
+    gone = (size_t *)malloc((plan->count + 1) * sizeof(size_t));
+    removed = (size_t *)malloc((plan->count + 1) * sizeof(size_t));
+    early = (size_t *)malloc((plan->count + 1) * sizeof(size_t));
+    if (!sent.entries || !retry.entries || !gone || !removed || !early) {
+        fprintf(stderr, "Insufficient memory.\n");
+        goto __error_malloc;
+    }
+
+    // a record must name the snapshot entry it was planned against, or the plan belongs to another snapshot
+    for (i = 0; i < plan->count; i++) {
+        rec = &plan->records[i];
+        if (rec->op == GKO_PLAN_CREATE || rec->op == GKO_PLAN_UPDATE) {
+            gko_plan_entry(plan, rec, &sent.entries[sent.count++],
+                           GKO_ENTRY_DIRTY | ((rec->op == GKO_PLAN_CREATE) ? GKO_ENTRY_NEW : 0));
+            continue;
+        }
+        if (rec->op == GKO_PLAN_CHMOD) continue;
+
+        if (rec->record >= snapshot->count ||
+            strcmp(gko_index_path(snapshot, rec->record),
+                   gko_plan_string(plan, (rec->op == GKO_PLAN_RENAME) ? rec->from : rec->path)) != GEKKO_OK) {
+            fprintf(stderr, "The plan does not match the remote snapshot, plan again.\n");
+            goto __error_malloc;
+        }
+
+        gone[ngone++] = (size_t)rec->record;
+        if (rec->op == GKO_PLAN_DELETE) removed[nremoved++] = (size_t)rec->record;
+    }
+
+    // a directory that became a file has to be empty before the file goes up, gko_sync() clears it first
+    for (i = 0; i < plan->count; i++) {
+        rec = &plan->records[i];
+        if (rec->op != GKO_PLAN_UPDATE) continue;
+
+        j = gko_index_find(snapshot, gko_plan_string(plan, rec->path));
+        if (j == snapshot->count || (snapshot->records[j].mode & S_IFMT) == (rec->mode & S_IFMT)) continue;
+
+        len = strlen(gko_plan_string(plan, rec->path));
+        for (k = 0; k < nremoved; ) {
+            if (strncmp(gko_index_path(snapshot, removed[k]), gko_plan_string(plan, rec->path), len) == GEKKO_OK &&
+                gko_index_path(snapshot, removed[k])[len] == '/') {
+                early[nearly++] = removed[k];
+                removed[k] = removed[--nremoved];
+                continue;
+            }
+            k++;
+        }
+    }
+    qsort(early, nearly, sizeof(size_t), gko_plan_order);
+
+    ret = gko_pool_create(&pool, grip, grip->sessions);
+    if (ret != GEKKO_OK) {
+        fprintf(stderr, "Cannot create SSH instance (%d).\n", ret);
+        ret = GEKKO_ERROR;
+        goto __error_malloc;
+    }
+
+    if (sent.count && gko_sync(&pool, grip, remote, rootfd, &sent, snapshot, early, nearly, NULL, 0) != GEKKO_OK) {
+        error = true;
+        goto __error_pool;
+    }
+
+    for (i = 0; i < plan->count; i++) {
+        rec = &plan->records[i];
+        if (rec->op != GKO_PLAN_RENAME && rec->op != GKO_PLAN_CHMOD) continue;
+
+        snprintf(to, PATH_MAX, "%s/%s", remote, gko_plan_string(plan, rec->path));
+        if (rec->op == GKO_PLAN_RENAME) {
+            snprintf(from, PATH_MAX, "%s/%s", remote, gko_plan_string(plan, rec->from));
+            if (libssh2_sftp_rename(pool.sessions[0].sftp, from, to) != GEKKO_OK) {
+                printf("rename %s: not available, uploading whole file.\n", gko_plan_string(plan, rec->path));
+                gko_plan_entry(plan, rec, &retry.entries[retry.count++], GKO_ENTRY_NEW | GKO_ENTRY_DIRTY);
+                removed[nremoved++] = (size_t)rec->record;
+                continue;
+            }
+
+            // the moved copy keeps the permissions of its old path, they are brought in line like a chmod
+            if ((rec->old_mode & 07777) == (rec->mode & 07777)) continue;
+        }
+
+        memset(&attrs, 0, sizeof(attrs));
+        attrs.flags = LIBSSH2_SFTP_ATTR_PERMISSIONS;
+        attrs.permissions = rec->mode & 07777;
+        if (libssh2_sftp_setstat(pool.sessions[0].sftp, to, &attrs) != GEKKO_OK) {
+            fprintf(stderr, "Cannot change mode of remote %s.\n", to);
+            error = true;
+        }
+    }
+
+    if (error) goto __error_pool;
+
+    // deletes run in snapshot order, deepest last, the way gko_sync() expects them
+    qsort(removed, nremoved, sizeof(size_t), gko_plan_order);
+    if ((retry.count || nremoved) &&
+        gko_sync(&pool, grip, remote, rootfd, &retry, snapshot, removed, nremoved, NULL, 0) != GEKKO_OK) {
+        error = true;
+        goto __error_pool;
+    }
+
+    // every entry the plan leaves behind, renamed ones included, in path order for the merge
+    merged.entries = sent.entries;
+    for (i = 0, merged.count = 0; i < plan->count; i++) {
+        rec = &plan->records[i];
+        if (rec->op != GKO_PLAN_DELETE) gko_plan_entry(plan, rec, &merged.entries[merged.count++], 0);
+    }
+    gko_scan_sort(&merged);
+
+    if (gko_index_merge(snap, snapshot, &merged, gone, ngone) != GEKKO_OK) error = true;
+
+__error_pool:
+    gko_pool_destroy(&pool);
+    ret = (error) ? GEKKO_ERROR : GEKKO_OK;
+
+__error_malloc:
+    free(sent.entries);
+    free(retry.entries);
+    free(gone);
+    free(removed);
+    free(early);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
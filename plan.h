@@ -0,0 +1,115 @@
+/**********************************************************************************************************************
+    file:           plan.h
+    description:    Sync plans of Gekko, worked out offline and carried out later exactly as shown
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_PLAN_H
+#define __GEKKO_PLAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gekko.h"
+#include "scan.h"
+#include "index.h"
+/**********************************************************************************************************************
+    plan defaults
+**********************************************************************************************************************/
+#define GEKKO_PLAN_MAGIC                "GKOPLAN1"
+#define GEKKO_PLAN_VERSION              (1)
+#define GEKKO_PLAN_NONE                 (UINT64_MAX)    // record field that does not apply to the operation
+/**********************************************************************************************************************
+    operations, a plan file lists them in the order they are carried out
+**********************************************************************************************************************/
+typedef enum {
+    GKO_PLAN_CREATE = 0,
+    GKO_PLAN_UPDATE,
+    GKO_PLAN_RENAME,                    // remote copy of a deleted file moved to a new path with the same content
+    GKO_PLAN_CHMOD,
+    GKO_PLAN_DELETE,
+    GKO_PLAN_OPS,
+} GKO_PLAN_OP;
+/**********************************************************************************************************************
+    what was planned, before it is written out: scan entry and snapshot record an operation applies to
+**********************************************************************************************************************/
+typedef struct {
+    uint32_t            op;
+    size_t              entry;          // scan index, SIZE_MAX for a delete
+    size_t              record;         // snapshot index of the old copy, SIZE_MAX for a create or an update
+} GKO_PLAN_ITEM;
+
+typedef struct {
+    GKO_PLAN_ITEM      *items;
+    size_t              count;
+    uint64_t            ops[GKO_PLAN_OPS];
+    uint64_t            bytes;          // file bytes creates and updates send at most
+    double              elapsed;
+} GKO_PLAN_LIST;
+/**********************************************************************************************************************
+    on-disk layout: header, records in execution order, then NUL terminated strings. The snapshot stamp ties a plan
+    to the remote state it was worked out against, a plan whose snapshot moved on is refused.
+**********************************************************************************************************************/
+typedef struct {
+    char            magic[8];
+    uint32_t        version;
+    uint32_t        record_size;
+    uint64_t        count;
+    uint64_t        strings;
+    uint64_t        length;
+    uint64_t        grip;           // string offsets
+    uint64_t        remote;
+    uint64_t        root;
+    uint64_t        snap_inode;
+    uint64_t        snap_size;
+    int64_t         snap_mtime_ns;
+    uint64_t        ops[GKO_PLAN_OPS];
+    uint64_t        bytes;
+} GKO_PLAN_HEADER;
+
+typedef struct {
+    uint32_t        op;
+    uint32_t        mode;           // local mode, the remote one for a delete
+    uint32_t        old_mode;       // remote mode before a chmod or a rename
+    uint32_t        reserved;
+    uint64_t        path;           // string offset of the path the operation leaves behind
+    uint64_t        from;           // string offset of the old path of a rename
+    uint64_t        record;         // snapshot record removed by a delete or a rename
+    uint64_t        size;
+    int64_t         mtime_ns;
+    int64_t         ctime_ns;
+    uint64_t        inode;
+    uint64_t        hash;
+} GKO_PLAN_RECORD;
+/**********************************************************************************************************************
+    mapped plan
+**********************************************************************************************************************/
+typedef struct {
+    void                       *map;
+    size_t                      length;
+    const GKO_PLAN_HEADER      *header;
+    const GKO_PLAN_RECORD      *records;
+    size_t                      count;
+    const char                 *strings;
+} GKO_PLAN;
+
+#define gko_plan_string(plan, offset)   ((plan)->strings + (offset))
+/**********************************************************************************************************************
+    plan functions
+**********************************************************************************************************************/
+const char *gko_plan_name(uint32_t op);
+int  gko_plan_build(const GKO_SCAN *scan, const GKO_INDEX *snapshot, const size_t *deleted, size_t deleted_count,
+                    GKO_PLAN_LIST *list);
+void gko_plan_print(const GKO_PLAN_LIST *list, const GKO_SCAN *scan, const GKO_INDEX *snapshot);
+int  gko_plan_write(const char *path, const GKO_PLAN_LIST *list, const GKO_SCAN *scan, const GKO_INDEX *snapshot,
+                    const char *grip, const char *remote, const char *root, const char *snap);
+void gko_plan_free(GKO_PLAN_LIST *list);
+int  gko_plan_open(const char *path, GKO_PLAN *plan);
+void gko_plan_close(GKO_PLAN *plan);
+int  gko_plan_check(const GKO_PLAN *plan, const char *snap, int rootfd);
+int  gko_plan_run(const GKO_PLAN *plan, const GRIP *grip, int rootfd, const GKO_INDEX *snapshot, const char *snap);
+
+#endif  // __GEKKO_PLAN_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,289 @@
+/**********************************************************************************************************************
+    file:           pool.c
+    description:    SSH session pool of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "gekko.h"
+#include "pool.h"
+
+#ifdef DARWIN
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#endif
+
+#ifdef WINDOWS
+#include <winsock.h>
+#endif
+
+#ifdef LINUX
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#endif
+/**********************************************************************************************************************
+    process-wide libssh2 users
+**********************************************************************************************************************/
+static pthread_mutex_t gko_pool_lock = PTHREAD_MUTEX_INITIALIZER;    // libssh2 counts its users unlocked
+/**********************************************************************************************************************
+    pool types
+**********************************************************************************************************************/
+typedef struct {
+    GKO_SESSION    *session;
+    const GRIP     *grip;
+    pthread_t       thread;
+    bool            started;
+    int             ret;
+} GKO_POOL_OPENER;
+/**********************************************************************************************************************
+    description:    Connect and authenticate one session
+    arguments:      s:      session to fill
+                    grip:   grip instance
+    return:         error code
+**********************************************************************************************************************/
+int gko_session_open(GKO_SESSION *s, const GRIP *grip)
+{
+    struct sockaddr_in  sin;
+    int                 ret             = GEKKO_ERROR;
+    int                 auth_method     = 0;
+    const char         *fingerprint     = NULL;
+    char               *user_auth_list  = NULL;
+
+#ifdef GEKKO_DEBUG
+    int                 i;
+#endif
+
+    if (!s) return GEKKO_ERROR;
+    if (!grip) return GEKKO_ERROR;
+
+    memset(s, 0, sizeof(GKO_SESSION));
+
+    s->sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (s->sock < 0) {
+        fprintf(stderr, "Socket creation failed.\n");
+        return GEKKO_ERROR;
+    }
+
+    sin.sin_family      = AF_INET;
+    sin.sin_port        = htons(grip->port);
+    sin.sin_addr.s_addr = inet_addr(grip->host);    // TODO: support IP and hostname
+    ret = connect(s->sock, (struct sockaddr*)&sin, sizeof(struct sockaddr_in));
+    if (ret != GEKKO_OK) {
+        fprintf(stderr, "Socket connection failed (%d).\n", ret);
+        goto __error_connect;
+    }
+
+    s->session = libssh2_session_init();
+    if (!s->session) {
+        fprintf(stderr, "Insufficient memory.\n");
+        goto __error_connect;
+    }
+
+    ret = libssh2_session_handshake(s->session, s->sock);
+    if (ret != GEKKO_OK) {
+        fprintf(stderr, "Cannot establish SSH session (%d).\n", ret);
+        goto __error_session;
+    }
+
+    // check if fingerprint matches the saved ones
+    fingerprint = libssh2_hostkey_hash(s->session, LIBSSH2_HOSTKEY_HASH_SHA1);
+
+#ifdef GEKKO_DEBUG
+    printf("The fingerprint is: ");
+    for (i = 0; i < 20; i++) {
+        printf("%02x", (uint8_t)fingerprint[i]);
+    }
+    printf("\n");
+#else
+    (void)fingerprint;
+#endif
+
+    // TODO: check if fingerprint matches the saved ones
+
+    // check what authentication methods are available
+    user_auth_list = libssh2_userauth_list(s->session, grip->user, strlen(grip->user));
+    if (!user_auth_list) user_auth_list = "";
+
+#ifdef GEKKO_DEBUG
+    printf("Authentication methods: %s\n", user_auth_list);
+#endif
+
+    if (strstr(user_auth_list, "password")) {
+        auth_method |= AUTH_METHOD_PASSWORD;
+    }
+    if (strstr(user_auth_list, "keyboard-interactive")) {
+        auth_method |= AUTH_METHOD_KEYBOARD_INTERACTIVE;
+    }
+    if (strstr(user_auth_list, "publickey")) {
+        auth_method |= AUTH_METHOD_PUBLIC_KEY;
+    }
+
+    if (auth_method & AUTH_METHOD_PASSWORD) {
+        ret = libssh2_userauth_password(s->session, grip->user, grip->pass);
+        if (ret != GEKKO_OK) {
+            fprintf(stderr, "Authentication failed: password (%d).\n", ret);
+            goto __error_auth;
+        }
+        printf("Authentication succeeded: password\n");
+
+    } else if (auth_method & AUTH_METHOD_KEYBOARD_INTERACTIVE) {
+        // TODO
+    } else if (auth_method & AUTH_METHOD_PUBLIC_KEY) {
+        // TODO
+    } else {
+        fprintf(stderr, "No supported authentication methods found.\n");
+        goto __error_auth;
+    }
+
+    s->sftp = libssh2_sftp_init(s->session);
+    if (!s->sftp) {
+        fprintf(stderr, "Cannot start SFTP session.\n");
+        goto __error_auth;
+    }
+
+    return GEKKO_OK;
+
+__error_auth:
+    libssh2_session_disconnect(s->session, "Super Gekko Camouflage");
+
+__error_session:
+    libssh2_session_free(s->session);
+    s->session = NULL;
+
+__error_connect:
+    close(s->sock);
+    s->sock = -1;
+
+    return GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Close one session
+    arguments:      s:      session
+    return:         -
+**********************************************************************************************************************/
+void gko_session_close(GKO_SESSION *s)
+{
+    if (!s || !s->session) return;
+
+    if (s->sftp) libssh2_sftp_shutdown(s->sftp);
+    libssh2_session_disconnect(s->session, "Super Gekko Camouflage");
+    libssh2_session_free(s->session);
+    close(s->sock);
+
+    memset(s, 0, sizeof(GKO_SESSION));
+    s->sock = -1;
+}
+/**********************************************************************************************************************
+    description:    Session opener thread, handshakes of all sessions overlap
+    arguments:      arg:    opener
+    return:         NULL
+**********************************************************************************************************************/
+static void *gko_pool_opener(void *arg)
+{
+    GKO_POOL_OPENER *opener = (GKO_POOL_OPENER *)arg;
+
+    opener->ret = gko_session_open(opener->session, opener->grip);
+
+    return NULL;
+}
+/**********************************************************************************************************************
+    description:    Open a pool of authenticated sessions to a grip
+    arguments:      pool:   pool to fill, release with gko_pool_destroy()
+                    grip:   grip instance
+                    count:  number of sessions wanted
+    return:         error code, OK as long as one session could be opened
+**********************************************************************************************************************/
+int gko_pool_create(GKO_POOL *pool, const GRIP *grip, int count)
+{
+    GKO_POOL_OPENER    *openers = NULL;
+    int                 opened  = 0;
+    int                 ret     = GEKKO_ERROR;
+    int                 i       = 0;
+
+    if (!pool) return GEKKO_ERROR;
+    if (!grip) return GEKKO_ERROR;
+
+    memset(pool, 0, sizeof(GKO_POOL));
+    if (count <= 0) count = GEKKO_POOL_SESSIONS;
+    if (count > GEKKO_POOL_SESSIONS_MAX) count = GEKKO_POOL_SESSIONS_MAX;
+
+    pthread_mutex_lock(&gko_pool_lock);
+    ret = libssh2_init(0);
+    pthread_mutex_unlock(&gko_pool_lock);
+    gko_error_return("libssh2 initialization failed");
+
+    pool->sessions = (GKO_SESSION *)zalloc(count * sizeof(GKO_SESSION));
+    openers = (GKO_POOL_OPENER *)zalloc(count * sizeof(GKO_POOL_OPENER));
+    if (!pool->sessions || !openers) {
+        fprintf(stderr, "Insufficient memory.\n");
+        free(pool->sessions);
+        free(openers);
+        pool->sessions = NULL;
+        pthread_mutex_lock(&gko_pool_lock);
+        libssh2_exit();
+        pthread_mutex_unlock(&gko_pool_lock);
+        return GEKKO_ERROR;
+    }
+
+    for (i = 0; i < count; i++) {
+        openers[i].session = &pool->sessions[i];
+        openers[i].grip    = grip;
+        openers[i].ret     = GEKKO_ERROR;
+        openers[i].started = (pthread_create(&openers[i].thread, NULL, gko_pool_opener, &openers[i]) == 0);
+        if (!openers[i].started) gko_pool_opener(&openers[i]);
+    }
+
+    for (i = 0; i < count; i++) {
+        if (openers[i].started) pthread_join(openers[i].thread, NULL);
+    }
+
+    // keep opened sessions packed at the front
+    for (i = 0; i < count; i++) {
+        if (openers[i].ret != GEKKO_OK) continue;
+        pool->sessions[opened++] = pool->sessions[i];
+    }
+
+    free(openers);
+    pool->count = opened;
+
+    if (!opened) {
+        gko_pool_destroy(pool);
+        return GEKKO_ERROR;
+    }
+
+    if (opened < count) printf("Opened %d of %d sessions.\n", opened, count);
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Close every session of a pool
+    arguments:      pool:   pool
+    return:         -
+**********************************************************************************************************************/
+void gko_pool_destroy(GKO_POOL *pool)
+{
+    int i;
+
+    if (!pool || !pool->sessions) return;
+
+    for (i = 0; i < pool->count; i++) {
+        gko_session_close(&pool->sessions[i]);
+    }
+
+    free(pool->sessions);
+    memset(pool, 0, sizeof(GKO_POOL));
+    pthread_mutex_lock(&gko_pool_lock);
+    libssh2_exit();
+    pthread_mutex_unlock(&gko_pool_lock);
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,46 @@
+/**********************************************************************************************************************
+    file:           pool.h
+    description:    SSH session pool of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_POOL_H
+#define __GEKKO_POOL_H
+
+#include <stdint.h>
+#include <libssh2.h>
+#include <libssh2_sftp.h>
+
+#include "gekko.h"
+/**********************************************************************************************************************
+    pool defaults
+**********************************************************************************************************************/
+#define GEKKO_POOL_SESSIONS             (4)
+#define GEKKO_POOL_SESSIONS_MAX         (64)
+/**********************************************************************************************************************
+    one authenticated ssh connection with its sftp subsystem
+**********************************************************************************************************************/
+typedef struct {
+    int                 sock;
+    LIBSSH2_SESSION    *session;
+    LIBSSH2_SFTP       *sftp;
+} GKO_SESSION;
+/**********************************************************************************************************************
+    session pool
+**********************************************************************************************************************/
+typedef struct {
+    GKO_SESSION        *sessions;
+    int                 count;
+} GKO_POOL;
+/**********************************************************************************************************************
+    pool functions
+**********************************************************************************************************************/
+int  gko_session_open(GKO_SESSION *s, const GRIP *grip);
+void gko_session_close(GKO_SESSION *s);
+int  gko_pool_create(GKO_POOL *pool, const GRIP *grip, int count);
+void gko_pool_destroy(GKO_POOL *pool);
+
+#endif  // __GEKKO_POOL_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
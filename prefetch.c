@@ -0,0 +1,848 @@
+/**********************************************************************************************************************
+    file:           prefetch.c
+    description:    Read-ahead stage of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#ifdef GEKKO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "gekko.h"
+#include "prefetch.h"
+/**********************************************************************************************************************
+    io_uring driven through the raw system calls, one submission queue owned by the reader thread
+**********************************************************************************************************************/
+#ifdef GEKKO_URING
+typedef struct {
+    int                     fd;
+    unsigned               *sq_head;
+    unsigned               *sq_tail;
+    unsigned               *sq_mask;
+    unsigned               *sq_array;
+    unsigned               *cq_head;
+    unsigned               *cq_tail;
+    unsigned               *cq_mask;
+    struct io_uring_sqe    *sqes;
+    struct io_uring_cqe    *cqes;
+    void                   *sq_ring;
+    size_t                  sq_size;
+    void                   *cq_ring;
+    size_t                  cq_size;
+    size_t                  sqe_size;
+    unsigned                entries;
+    unsigned                queued;     // prepared and not submitted
+    unsigned                inflight;   // submitted and not completed
+} GKO_URING;
+/**********************************************************************************************************************
+    description:    Release a ring
+    arguments:      ring:   ring
+    return:         -
+**********************************************************************************************************************/
+static void gko_uring_free(GKO_URING *ring)
+{
+    if (!ring) return;
+
+    if (ring->sqes) munmap(ring->sqes, ring->sqe_size);
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_size);
+    if (ring->sq_ring) munmap(ring->sq_ring, ring->sq_size);
+    if (ring->fd >= 0) close(ring->fd);
+    free(ring);
+}
+/**********************************************************************************************************************
+    description:    Set up a ring, fails where the kernel is too old or io_uring is disabled
+    arguments:      entries:    submission queue entries
+    return:         ring, NULL on error
+**********************************************************************************************************************/
+static GKO_URING *gko_uring_init(unsigned entries)
+{
+    struct io_uring_params  p;
+    GKO_URING              *ring    = NULL;
+    uint8_t                *sq      = NULL;
+    uint8_t                *cq      = NULL;
+
+    ring = (GKO_URING *)zalloc(sizeof(GKO_URING));
+    if (!ring) return NULL;
+
+    memset(&p, 0, sizeof(p));
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (ring->fd < 0) {
+        free(ring);
+        return NULL;
+    }
+
+    ring->entries  = p.sq_entries;
+    ring->sq_size  = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_size  = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqe_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    if ((p.features & IORING_FEAT_SINGLE_MMAP) && ring->cq_size > ring->sq_size) ring->sq_size = ring->cq_size;
+
+    sq = (uint8_t *)mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) goto __error;
+    ring->sq_ring = sq;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        cq = sq;
+    } else {
+        cq = (uint8_t *)mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                             IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) goto __error;
+    }
+    ring->cq_ring = cq;
+
+    ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqe_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                             ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        goto __error;
+    }
+
+    ring->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    return ring;
+
+__error:
+    gko_uring_free(ring);
+
+    return NULL;
+}
+/**********************************************************************************************************************
+    description:    Queue a read, the caller keeps queued plus in flight within the ring size
+    arguments:      ring:   ring
+                    fd:     file
+                    buffer: destination
+                    length: bytes
+                    offset: file offset
+                    user:   handed back with the completion
+    return:         -
+**********************************************************************************************************************/
+static void gko_uring_read(GKO_URING *ring, int fd, void *buffer, size_t length, uint64_t offset, uint64_t user)
+{
+    unsigned                tail    = *ring->sq_tail;
+    unsigned                slot    = tail & *ring->sq_mask;
+    struct io_uring_sqe    *sqe     = &ring->sqes[slot];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode    = IORING_OP_READ;
+    sqe->fd        = fd;
+    sqe->addr      = (uint64_t)(uintptr_t)buffer;
+    sqe->len       = (uint32_t)length;
+    sqe->off       = offset;
+    sqe->user_data = user;
+
+    ring->sq_array[slot] = slot;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->queued++;
+}
+/**********************************************************************************************************************
+    description:    Submit what is queued and wait for at least one completion
+    arguments:      ring:   ring
+    return:         error code
+**********************************************************************************************************************/
+static int gko_uring_submit(GKO_URING *ring)
+{
+    long n = 0;
+
+    do {
+        n = syscall(__NR_io_uring_enter, ring->fd, ring->queued, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    } while (n < 0 && errno == EINTR);
+
+    // the completion queue is full, reap it and come back
+    if (n < 0 && (errno == EAGAIN || errno == EBUSY)) n = 0;
+    if (n < 0) return GEKKO_ERROR;
+
+    ring->inflight += (unsigned)n;
+    ring->queued -= (unsigned)n;
+
+    return GEKKO_OK;
+}
+#endif
+/**********************************************************************************************************************
+    description:    Parse an engine name
+    arguments:      name:   auto, uring, threads or off
+                    engine: engine to store
+    return:         error code
+**********************************************************************************************************************/
+int gko_prefetch_engine(const char *name, GEKKO_READAHEAD *engine)
+{
+    int e = 0;
+
+    if (!name) return GEKKO_ERROR;
+    if (!engine) return GEKKO_ERROR;
+
+    for (e = 0; e < GEKKO_READAHEAD_MAX; e++) {
+        if (strcmp(name, gko_prefetch_name((GEKKO_READAHEAD)e)) == GEKKO_OK) {
+            *engine = (GEKKO_READAHEAD)e;
+            return GEKKO_OK;
+        }
+    }
+
+    return GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Name of an engine
+    arguments:      engine: engine
+    return:         name
+**********************************************************************************************************************/
+const char *gko_prefetch_name(GEKKO_READAHEAD engine)
+{
+    switch (engine) {
+    case GEKKO_READAHEAD_AUTO:      return "auto";
+    case GEKKO_READAHEAD_URING:     return "uring";
+    case GEKKO_READAHEAD_THREADS:   return "threads";
+    case GEKKO_READAHEAD_OFF:       return "off";
+    default:                        return "unknown";
+    }
+}
+/**********************************************************************************************************************
+    description:    Claim the next item to read, in plan order and within depth and memory, with the lock held
+    arguments:      pf:     read-ahead
+    return:         item, NULL when there is nothing to read now
+**********************************************************************************************************************/
+static GKO_PREFETCH_ITEM *gko_prefetch_next(GKO_PREFETCH *pf)
+{
+    GKO_PREFETCH_ITEM *item = NULL;
+
+    while (pf->next < pf->count && pf->items[pf->next].state == GKO_PREFETCH_RELEASED) pf->next++;
+    if (pf->next == pf->count) return NULL;
+
+    item = &pf->items[pf->next];
+    if (pf->held >= pf->depth) return NULL;
+    if (pf->held && pf->bytes + item->length > GEKKO_PREFETCH_BYTES) return NULL;
+
+    item->state = GKO_PREFETCH_READING;
+    pf->held++;
+    pf->bytes += item->length;
+    pf->next++;
+
+    return item;
+}
+/**********************************************************************************************************************
+    description:    Let go of the buffer of an item, with the lock held
+    arguments:      pf:     read-ahead
+                    item:   item
+                    state:  state to leave it in
+    return:         -
+**********************************************************************************************************************/
+static void gko_prefetch_drop(GKO_PREFETCH *pf, GKO_PREFETCH_ITEM *item, GKO_PREFETCH_STATE state)
+{
+    if (item->fd >= 0) close(item->fd);
+    free(item->buffer);
+
+    item->fd     = -1;
+    item->buffer = NULL;
+    item->state  = state;
+    pf->bytes   -= item->length;
+    pf->held--;
+
+    pthread_cond_broadcast(&pf->cond);
+}
+/**********************************************************************************************************************
+    description:    Settle a finished read and wake whoever waits for it, with the lock held
+    arguments:      pf:     read-ahead
+                    item:   item
+                    ok:     the whole file is in
+    return:         -
+**********************************************************************************************************************/
+static void gko_prefetch_finish(GKO_PREFETCH *pf, GKO_PREFETCH_ITEM *item, bool ok)
+{
+    char byte = 0;
+
+    if (item->abandoned) {
+        gko_prefetch_drop(pf, item, GKO_PREFETCH_RELEASED);
+    } else if (!ok) {
+        gko_prefetch_drop(pf, item, GKO_PREFETCH_FAILED);
+    } else {
+        close(item->fd);
+        item->fd = -1;
+        item->state = GKO_PREFETCH_READY;
+        pthread_cond_broadcast(&pf->cond);
+    }
+
+    // a full pipe already wakes the loop
+    if (write(pf->notify[1], &byte, 1) < 0) {}
+}
+/**********************************************************************************************************************
+    description:    Open the file of an item and give it a buffer, without the lock, the item is the reader's
+    arguments:      pf:     read-ahead
+                    item:   item being read
+    return:         error code
+**********************************************************************************************************************/
+static int gko_prefetch_open(GKO_PREFETCH *pf, GKO_PREFETCH_ITEM *item)
+{
+    item->fd = openat(pf->rootfd, pf->scan->entries[item->entry].path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (item->fd < 0) return GEKKO_ERROR;
+
+    item->buffer = (uint8_t *)malloc(item->length);
+    if (!item->buffer) return GEKKO_ERROR;
+
+#ifdef LINUX
+    posix_fadvise(item->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Reader thread of the pread engine, several of them keep several reads outstanding
+    arguments:      arg:    read-ahead
+    return:         NULL
+**********************************************************************************************************************/
+static void *gko_prefetch_thread(void *arg)
+{
+    GKO_PREFETCH       *pf      = (GKO_PREFETCH *)arg;
+    GKO_PREFETCH_ITEM  *item    = NULL;
+    ssize_t             n       = 0;
+    bool                ok      = false;
+
+    pthread_mutex_lock(&pf->lock);
+
+    for (;;) {
+        while (!pf->stop && !(item = gko_prefetch_next(pf))) {
+            if (pf->next == pf->count) break;
+            pthread_cond_wait(&pf->cond, &pf->lock);
+        }
+        if (pf->stop || !item) break;
+
+        pthread_mutex_unlock(&pf->lock);
+
+        ok = (gko_prefetch_open(pf, item) == GEKKO_OK);
+        while (ok && item->done < item->length) {
+            n = pread(item->fd, item->buffer + item->done, item->length - item->done, (off_t)item->done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            item->done += (size_t)n;
+        }
+        // a file that shrank since the scan is sent as it is now
+        ok = ok && n >= 0;
+
+        pthread_mutex_lock(&pf->lock);
+        gko_prefetch_finish(pf, item, ok);
+    }
+
+    pthread_mutex_unlock(&pf->lock);
+
+    return NULL;
+}
+/**********************************************************************************************************************
+    description:    Reader thread of the io_uring engine, one thread keeps up to depth reads queued in the kernel,
+                    which is free to reorder them for the disk
+    arguments:      arg:    read-ahead
+    return:         NULL
+**********************************************************************************************************************/
+#ifdef GEKKO_URING
+static void *gko_prefetch_uring(void *arg)
+{
+    GKO_PREFETCH       *pf      = (GKO_PREFETCH *)arg;
+    GKO_URING          *ring    = (GKO_URING *)pf->uring;
+    GKO_PREFETCH_ITEM  *item    = NULL;
+    struct io_uring_cqe cqe;
+    unsigned            head    = 0;
+
+    pthread_mutex_lock(&pf->lock);
+
+    for (;;) {
+        while (!pf->stop && ring->queued + ring->inflight < ring->entries && (item = gko_prefetch_next(pf))) {
+            pthread_mutex_unlock(&pf->lock);
+
+            if (gko_prefetch_open(pf, item) == GEKKO_OK) {
+                gko_uring_read(ring, item->fd, item->buffer, item->length, 0, (uint64_t)(item - pf->items));
+                pthread_mutex_lock(&pf->lock);
+            } else {
+                pthread_mutex_lock(&pf->lock);
+                gko_prefetch_finish(pf, item, false);
+            }
+        }
+
+        if (!ring->queued && !ring->inflight) {
+            if (pf->stop || pf->next == pf->count) break;
+            pthread_cond_wait(&pf->cond, &pf->lock);
+            continue;
+        }
+
+        pthread_mutex_unlock(&pf->lock);
+
+        if (gko_uring_submit(ring) != GEKKO_OK) {
+            // nothing in flight can be trusted to land, fail everything still queued
+            pthread_mutex_lock(&pf->lock);
+            for (item = pf->items; item < pf->items + pf->next; item++) {
+                if (item->state == GKO_PREFETCH_READING) gko_prefetch_finish(pf, item, false);
+            }
+            ring->queued = ring->inflight = 0;
+            continue;
+        }
+
+        pthread_mutex_lock(&pf->lock);
+
+        head = *ring->cq_head;
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            cqe = ring->cqes[head & *ring->cq_mask];
+            head++;
+            ring->inflight--;
+
+            item = &pf->items[cqe.user_data];
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                gko_uring_read(ring, item->fd, item->buffer + item->done, item->length - item->done, item->done,
+                               cqe.user_data);
+                continue;
+            }
+            if (cqe.res > 0) item->done += (size_t)cqe.res;
+
+            // short reads are resumed, the queue always has room for the read that just left it
+            if (cqe.res > 0 && item->done < item->length && !item->abandoned) {
+                gko_uring_read(ring, item->fd, item->buffer + item->done, item->length - item->done, item->done,
+                               cqe.user_data);
+                continue;
+            }
+
+            gko_prefetch_finish(pf, item, cqe.res >= 0);
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&pf->lock);
+
+    return NULL;
+}
+#endif
+/**********************************************************************************************************************
+    description:    Start reading the files of a transfer plan ahead of the senders. Only small regular files are
+                    read into buffers, larger ones are mapped by the senders and read ahead by the kernel
+    arguments:      pf:     read-ahead to set up, release with gko_prefetch_stop()
+                    engine: engine, GEKKO_READAHEAD_AUTO picks io_uring when it can
+                    depth:  files read ahead, 0 for default
+                    rootfd: directory the paths are relative to
+                    scan:   scan the plan refers to
+                    plan:   scan indexes in the order the senders take them
+                    count:  number of plan entries
+    return:         error code, the senders then read on their own
+**********************************************************************************************************************/
+int gko_prefetch_start(GKO_PREFETCH *pf, GEKKO_READAHEAD engine, int depth, int rootfd,
+                       const GKO_SCAN *scan, const size_t *plan, size_t count)
+{
+    const GKO_ENTRY    *entry   = NULL;
+    size_t              i       = 0;
+    int                 t       = 0;
+
+    if (!pf) return GEKKO_ERROR;
+
+    memset(pf, 0, sizeof(GKO_PREFETCH));
+    pf->notify[0] = pf->notify[1] = -1;
+
+    if (!scan || !plan || engine == GEKKO_READAHEAD_OFF) return GEKKO_ERROR;
+
+    if (depth <= 0) depth = GEKKO_PREFETCH_DEPTH;
+    if (depth > GEKKO_PREFETCH_DEPTH_MAX) depth = GEKKO_PREFETCH_DEPTH_MAX;
+
+    pf->rootfd   = rootfd;
+    pf->scan     = scan;
+    pf->depth    = (size_t)depth;
+    pf->items    = (GKO_PREFETCH_ITEM *)zalloc((count ? count : 1) * sizeof(GKO_PREFETCH_ITEM));
+    pf->position = (size_t *)zalloc((scan->count ? scan->count : 1) * sizeof(size_t));
+    if (!pf->items || !pf->position) goto __error_malloc;
+
+    for (i = 0; i < count; i++) {
+        entry = &scan->entries[plan[i]];
+        if (!S_ISREG(entry->mode) || !entry->size || entry->size >= GEKKO_PREFETCH_FILE_MAX) continue;
+        if (pf->position[plan[i]]) continue;
+
+        pf->items[pf->count].entry  = plan[i];
+        pf->items[pf->count].fd     = -1;
+        pf->items[pf->count].length = (size_t)entry->size;
+        pf->position[plan[i]] = ++pf->count;
+    }
+    if (!pf->count) goto __error_malloc;
+
+    if (pipe(pf->notify) != 0) goto __error_malloc;
+    fcntl(pf->notify[0], F_SETFL, O_NONBLOCK);
+    fcntl(pf->notify[1], F_SETFL, O_NONBLOCK);
+    fcntl(pf->notify[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pf->notify[1], F_SETFD, FD_CLOEXEC);
+
+    pthread_mutex_init(&pf->lock, NULL);
+    pthread_cond_init(&pf->cond, NULL);
+
+#ifdef GEKKO_URING
+    if (engine != GEKKO_READAHEAD_THREADS) pf->uring = gko_uring_init((unsigned)depth);
+    if (pf->uring) {
+        pf->engine = GEKKO_READAHEAD_URING;
+        if (pthread_create(&pf->threads[0], NULL, gko_prefetch_uring, pf) == 0) pf->nthreads = 1;
+    }
+#endif
+
+    if (!pf->uring) {
+        pf->engine = GEKKO_READAHEAD_THREADS;
+        for (t = 0; t < GEKKO_PREFETCH_THREADS && t < depth; t++) {
+            if (pthread_create(&pf->threads[pf->nthreads], NULL, gko_prefetch_thread, pf) == 0) pf->nthreads++;
+        }
+    }
+
+    if (pf->nthreads) return GEKKO_OK;
+
+    gko_prefetch_stop(pf);
+    return GEKKO_ERROR;
+
+__error_malloc:
+    free(pf->items);
+    free(pf->position);
+    memset(pf, 0, sizeof(GKO_PREFETCH));
+    pf->notify[0] = pf->notify[1] = -1;
+
+    return GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Look up the read-ahead of a file, with the lock held
+    arguments:      pf:     read-ahead
+                    entry:  scan entry
+    return:         item, NULL when the file is not planned
+**********************************************************************************************************************/
+static GKO_PREFETCH_ITEM *gko_prefetch_item(GKO_PREFETCH *pf, const GKO_ENTRY *entry)
+{
+    size_t index = 0;
+
+    if (!pf->items || entry < pf->scan->entries || entry >= pf->scan->entries + pf->scan->count) return NULL;
+
+    index = (size_t)(entry - pf->scan->entries);
+    if (!pf->position[index]) return NULL;
+
+    return &pf->items[pf->position[index] - 1];
+}
+/**********************************************************************************************************************
+    description:    Take the contents of a file read ahead, they stay valid until gko_prefetch_release()
+    arguments:      pf:     read-ahead, NULL for none
+                    entry:  scan entry
+                    wait:   block until the read lands, an event loop polls instead
+                    data:   contents to store
+                    length: bytes to store
+    return:         GKO_PREFETCH_READY with the contents, GKO_PREFETCH_FAILED when the caller has to read the file
+                    itself, GKO_PREFETCH_WAITING or GKO_PREFETCH_READING when not waiting and not there yet
+**********************************************************************************************************************/
+GKO_PREFETCH_STATE gko_prefetch_take(GKO_PREFETCH *pf, const GKO_ENTRY *entry, bool wait, const uint8_t **data,
+                                     size_t *length)
+{
+    GKO_PREFETCH_ITEM  *item    = NULL;
+    GKO_PREFETCH_STATE  state   = GKO_PREFETCH_FAILED;
+
+    if (!pf || !pf->nthreads) return GKO_PREFETCH_FAILED;
+
+    pthread_mutex_lock(&pf->lock);
+
+    item = gko_prefetch_item(pf, entry);
+    while (item && wait && (item->state == GKO_PREFETCH_WAITING || item->state == GKO_PREFETCH_READING)) {
+        pthread_cond_wait(&pf->cond, &pf->lock);
+    }
+
+    if (item) state = item->state;
+    if (state == GKO_PREFETCH_RELEASED) state = GKO_PREFETCH_FAILED;
+
+    if (state == GKO_PREFETCH_READY) {
+        *data = item->buffer;
+        *length = item->done;
+        pf->hits++;
+    } else if (state == GKO_PREFETCH_FAILED) {
+        pf->misses++;
+    }
+
+    pthread_mutex_unlock(&pf->lock);
+
+    return state;
+}
+/**********************************************************************************************************************
+    description:    Done with a file, whether its contents were taken or not, every planned file must be released
+                    or the read-ahead stalls once depth files are held
+    arguments:      pf:     read-ahead, NULL for none
+                    entry:  scan entry
+    return:         -
+**********************************************************************************************************************/
+void gko_prefetch_release(GKO_PREFETCH *pf, const GKO_ENTRY *entry)
+{
+    GKO_PREFETCH_ITEM *item = NULL;
+
+    if (!pf || !pf->nthreads) return;
+
+    pthread_mutex_lock(&pf->lock);
+
+    item = gko_prefetch_item(pf, entry);
+    if (item) {
+        switch (item->state) {
+        case GKO_PREFETCH_WAITING:  item->state = GKO_PREFETCH_RELEASED;                break;
+        case GKO_PREFETCH_READING:  item->abandoned = true;                             break;
+        case GKO_PREFETCH_READY:    gko_prefetch_drop(pf, item, GKO_PREFETCH_RELEASED); break;
+        case GKO_PREFETCH_FAILED:   item->state = GKO_PREFETCH_RELEASED;                break;
+        default:                                                                        break;
+        }
+    }
+
+    pthread_mutex_unlock(&pf->lock);
+}
+/**********************************************************************************************************************
+    description:    Descriptor readable whenever a read lands, for event loops
+    arguments:      pf:     read-ahead, NULL for none
+    return:         descriptor, negative for none
+**********************************************************************************************************************/
+int gko_prefetch_fd(const GKO_PREFETCH *pf)
+{
+    if (!pf || !pf->nthreads) return -1;
+
+    return pf->notify[0];
+}
+/**********************************************************************************************************************
+    description:    Drain the descriptor of gko_prefetch_fd() after waking on it
+    arguments:      pf:     read-ahead, NULL for none
+    return:         -
+**********************************************************************************************************************/
+void gko_prefetch_ack(GKO_PREFETCH *pf)
+{
+    char drain[256];
+
+    if (!pf || pf->notify[0] < 0) return;
+
+    while (read(pf->notify[0], drain, sizeof(drain)) > 0) {}
+}
+/**********************************************************************************************************************
+    description:    Stop reading ahead and release everything still held
+    arguments:      pf:     read-ahead
+    return:         -
+**********************************************************************************************************************/
+void gko_prefetch_stop(GKO_PREFETCH *pf)
+{
+    size_t  i   = 0;
+    int     t   = 0;
+
+    if (!pf || !pf->items) return;
+
+    pthread_mutex_lock(&pf->lock);
+    pf->stop = true;
+    pthread_cond_broadcast(&pf->cond);
+    pthread_mutex_unlock(&pf->lock);
+
+    for (t = 0; t < pf->nthreads; t++) pthread_join(pf->threads[t], NULL);
+
+    for (i = 0; i < pf->count; i++) {
+        if (pf->items[i].fd >= 0) close(pf->items[i].fd);
+        free(pf->items[i].buffer);
+    }
+
+#ifdef GEKKO_URING
+    gko_uring_free((GKO_URING *)pf->uring);
+#endif
+    if (pf->notify[0] >= 0) close(pf->notify[0]);
+    if (pf->notify[1] >= 0) close(pf->notify[1]);
+
+    pthread_mutex_destroy(&pf->lock);
+    pthread_cond_destroy(&pf->cond);
+    free(pf->items);
+    free(pf->position);
+
+    memset(pf, 0, sizeof(GKO_PREFETCH));
+    pf->notify[0] = pf->notify[1] = -1;
+}
+/**********************************************************************************************************************
+    description:    Seconds on the monotonic clock
+    arguments:      -
+    return:         seconds
+**********************************************************************************************************************/
+static double gko_prefetch_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+/**********************************************************************************************************************
+    description:    Push bytes through the simulated link, which is busy until the previous bytes are through
+    arguments:      busy:   time the link frees up, advanced
+                    bytes:  bytes to send
+                    rate:   bytes per second
+    return:         -
+**********************************************************************************************************************/
+static void gko_prefetch_send(double *busy, size_t bytes, double rate)
+{
+    struct timespec ts;
+    double          now     = gko_prefetch_now();
+    double          left    = 0;
+
+    if (*busy < now) *busy = now;
+    *busy += bytes / rate;
+
+    // the sender blocks like sftp does once its window is full, one window ahead of the wire
+    left = *busy - now - (double)(2 << 20) / rate;
+    if (left <= 0) return;
+
+    ts.tv_sec = (time_t)left;
+    ts.tv_nsec = (long)((left - ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+}
+/**********************************************************************************************************************
+    description:    Evict files from the page cache so the next pass reads from the disk
+    arguments:      rootfd: directory the paths are relative to
+                    scan:   scan
+                    plan:   scan indexes
+                    count:  number of plan entries
+    return:         -
+**********************************************************************************************************************/
+static void gko_prefetch_evict(int rootfd, const GKO_SCAN *scan, const size_t *plan, size_t count)
+{
+    size_t  i   = 0;
+    int     fd  = -1;
+
+    for (i = 0; i < count; i++) {
+        fd = openat(rootfd, scan->entries[plan[i]].path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0) continue;
+#ifdef LINUX
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+        close(fd);
+    }
+}
+/**********************************************************************************************************************
+    description:    Read a file the way a sender without read-ahead does
+    arguments:      rootfd: directory the paths are relative to
+                    entry:  file
+                    buffer: buffer of at least GEKKO_PREFETCH_FILE_MAX bytes
+    return:         bytes read
+**********************************************************************************************************************/
+static size_t gko_prefetch_read(int rootfd, const GKO_ENTRY *entry, uint8_t *buffer)
+{
+    size_t  done    = 0;
+    ssize_t n       = 0;
+    int     fd      = -1;
+
+    fd = openat(rootfd, entry->path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return 0;
+
+    while (done < entry->size && (n = pread(fd, buffer + done, (size_t)entry->size - done, (off_t)done)) > 0) {
+        done += (size_t)n;
+    }
+    close(fd);
+
+    return done;
+}
+/**********************************************************************************************************************
+    description:    Send the small files of a tree over a simulated link from a cold page cache: reading only,
+                    sending only, reading then sending each file, and sending while the read-ahead runs
+    arguments:      rootfd: directory the paths are relative to
+                    scan:   scan of the tree
+                    engine: read-ahead engine
+                    depth:  files read ahead, 0 for default
+                    rate:   link bytes per second, 0 for default
+    return:         error code
+**********************************************************************************************************************/
+int gko_prefetch_bench(int rootfd, const GKO_SCAN *scan, GEKKO_READAHEAD engine, int depth, double rate)
+{
+    GKO_PREFETCH        pf;
+    const uint8_t      *data    = NULL;
+    uint8_t            *buffer  = NULL;
+    size_t             *plan    = NULL;
+    size_t              count   = 0;
+    size_t              length  = 0;
+    uint64_t            total   = 0;
+    double              begin   = 0;
+    double              busy    = 0;
+    double              disk    = 0;
+    double              net     = 0;
+    double              serial  = 0;
+    double              ahead   = 0;
+    size_t              i       = 0;
+    int                 ret     = GEKKO_ERROR;
+
+    if (!scan) return GEKKO_ERROR;
+    if (rate <= 0) rate = GEKKO_PREFETCH_BENCH_RATE;
+
+    plan = (size_t *)malloc((scan->count ? scan->count : 1) * sizeof(size_t));
+    buffer = (uint8_t *)malloc(GEKKO_PREFETCH_FILE_MAX);
+    if (!plan || !buffer) {
+        fprintf(stderr, "Insufficient memory.\n");
+        goto __error;
+    }
+
+    for (i = 0; i < scan->count; i++) {
+        if (!S_ISREG(scan->entries[i].mode) || !scan->entries[i].size) continue;
+        if (scan->entries[i].size >= GEKKO_PREFETCH_FILE_MAX) continue;
+
+        plan[count++] = i;
+        total += scan->entries[i].size;
+    }
+
+    if (!count) {
+        fprintf(stderr, "No files under %d bytes to read.\n", GEKKO_PREFETCH_FILE_MAX);
+        goto __error;
+    }
+
+    printf("%lu files, %.1f MB, link %.0f MB/s, cold page cache for every pass.\n", (unsigned long)count,
+           total / 1e6, rate / 1e6);
+
+    gko_prefetch_evict(rootfd, scan, plan, count);
+    begin = gko_prefetch_now();
+    for (i = 0; i < count; i++) gko_prefetch_read(rootfd, &scan->entries[plan[i]], buffer);
+    disk = gko_prefetch_now() - begin;
+
+    busy = begin = gko_prefetch_now();
+    for (i = 0; i < count; i++) gko_prefetch_send(&busy, (size_t)scan->entries[plan[i]].size, rate);
+    net = ((busy > gko_prefetch_now()) ? busy : gko_prefetch_now()) - begin;
+
+    gko_prefetch_evict(rootfd, scan, plan, count);
+    busy = begin = gko_prefetch_now();
+    for (i = 0; i < count; i++) {
+        gko_prefetch_send(&busy, gko_prefetch_read(rootfd, &scan->entries[plan[i]], buffer), rate);
+    }
+    serial = ((busy > gko_prefetch_now()) ? busy : gko_prefetch_now()) - begin;
+
+    gko_prefetch_evict(rootfd, scan, plan, count);
+    busy = begin = gko_prefetch_now();
+    if (gko_prefetch_start(&pf, engine, depth, rootfd, scan, plan, count) != GEKKO_OK) {
+        fprintf(stderr, "Cannot start read-ahead.\n");
+        goto __error;
+    }
+    for (i = 0; i < count; i++) {
+        if (gko_prefetch_take(&pf, &scan->entries[plan[i]], true, &data, &length) != GKO_PREFETCH_READY) {
+            length = gko_prefetch_read(rootfd, &scan->entries[plan[i]], buffer);
+        }
+        gko_prefetch_send(&busy, length, rate);
+        gko_prefetch_release(&pf, &scan->entries[plan[i]]);
+    }
+    ahead = ((busy > gko_prefetch_now()) ? busy : gko_prefetch_now()) - begin;
+
+    printf("\tdisk only       %.3f s\n", disk);
+    printf("\tlink only       %.3f s\n", net);
+    printf("\tread then send  %.3f s (%.2fx max, sum %.3f s)\n", serial,
+           serial / ((disk > net) ? disk : net), disk + net);
+    printf("\tread-ahead      %.3f s (%.2fx max), %s, depth %lu, %llu hits, %llu misses\n", ahead,
+           ahead / ((disk > net) ? disk : net), gko_prefetch_name(pf.engine), (unsigned long)pf.depth,
+           (unsigned long long)pf.hits, (unsigned long long)pf.misses);
+
+    gko_prefetch_stop(&pf);
+    ret = GEKKO_OK;
+
+__error:
+    free(plan);
+    free(buffer);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,89 @@
+/**********************************************************************************************************************
+    file:           prefetch.h
+    description:    Read-ahead stage of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_PREFETCH_H
+#define __GEKKO_PREFETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "gekko.h"
+#include "scan.h"
+/**********************************************************************************************************************
+    prefetch defaults
+**********************************************************************************************************************/
+#define GEKKO_PREFETCH_DEPTH            (32)        // files read ahead of the senders
+#define GEKKO_PREFETCH_DEPTH_MAX        (1024)
+#define GEKKO_PREFETCH_BYTES            (64 << 20)  // read-ahead buffers held at once
+#define GEKKO_PREFETCH_FILE_MAX         (4 << 20)   // larger files are mapped and left to kernel read-ahead
+#define GEKKO_PREFETCH_THREADS          (4)         // pread workers without io_uring
+#define GEKKO_PREFETCH_BENCH_RATE       (100e6)     // simulated link, bytes per second
+/**********************************************************************************************************************
+    state of one planned file
+**********************************************************************************************************************/
+typedef enum {
+    GKO_PREFETCH_WAITING = 0,           // not read yet
+    GKO_PREFETCH_READING,
+    GKO_PREFETCH_READY,
+    GKO_PREFETCH_FAILED,
+    GKO_PREFETCH_RELEASED,
+} GKO_PREFETCH_STATE;
+
+typedef struct {
+    size_t              entry;          // index into the scan
+    int                 fd;
+    uint8_t            *buffer;
+    size_t              length;
+    size_t              done;
+    GKO_PREFETCH_STATE  state;
+    bool                abandoned;      // released while reading, freed once the read lands
+} GKO_PREFETCH_ITEM;
+/**********************************************************************************************************************
+    read-ahead over the files of a transfer plan, in plan order
+**********************************************************************************************************************/
+typedef struct {
+    GEKKO_READAHEAD     engine;         // GEKKO_READAHEAD_URING or GEKKO_READAHEAD_THREADS once started
+    int                 rootfd;
+    const GKO_SCAN     *scan;
+    GKO_PREFETCH_ITEM  *items;
+    size_t              count;
+    size_t             *position;       // plan position + 1 of every scan entry, 0 when not planned
+    size_t              next;           // next item to read
+    size_t              held;           // items read or being read and not released
+    size_t              bytes;          // buffer bytes held
+    size_t              depth;
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    pthread_t           threads[GEKKO_PREFETCH_THREADS];
+    int                 nthreads;
+    int                 notify[2];      // a byte on notify[0] per finished read, for event loops
+    void               *uring;
+    bool                stop;
+    uint64_t            hits;
+    uint64_t            misses;
+} GKO_PREFETCH;
+/**********************************************************************************************************************
+    prefetch functions
+**********************************************************************************************************************/
+int                gko_prefetch_engine(const char *name, GEKKO_READAHEAD *engine);
+const char        *gko_prefetch_name(GEKKO_READAHEAD engine);
+int                gko_prefetch_start(GKO_PREFETCH *pf, GEKKO_READAHEAD engine, int depth, int rootfd,
+                                      const GKO_SCAN *scan, const size_t *plan, size_t count);
+GKO_PREFETCH_STATE gko_prefetch_take(GKO_PREFETCH *pf, const GKO_ENTRY *entry, bool wait, const uint8_t **data,
+                                     size_t *length);
+void               gko_prefetch_release(GKO_PREFETCH *pf, const GKO_ENTRY *entry);
+int                gko_prefetch_fd(const GKO_PREFETCH *pf);
+void               gko_prefetch_ack(GKO_PREFETCH *pf);
+void               gko_prefetch_stop(GKO_PREFETCH *pf);
+int                gko_prefetch_bench(int rootfd, const GKO_SCAN *scan, GEKKO_READAHEAD engine, int depth,
+                                      double rate);
+
+#endif  // __GEKKO_PREFETCH_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,485 @@
+/**********************************************************************************************************************
+    file:           rate.c
+    description:    Bandwidth limiter of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "gekko.h"
+#include "rate.h"
+/**********************************************************************************************************************
+    bench types
+**********************************************************************************************************************/
+typedef struct {
+    GKO_RATE           *rate;               // NULL to push unlimited
+    GKO_RATE_CLASS      cls;
+    int                 fd;
+    size_t              chunk;
+    long                pause_us;           // between two chunks, models how often such work shows up
+    double              end;
+} GKO_RATE_SOURCE;
+
+typedef struct {
+    int                 fds[GKO_RATE_CLASSES];
+    int64_t             link;               // bytes per second the stand-in server drains
+    double              begin;
+    int                 seconds;
+    uint64_t           *windows;            // seconds x GKO_RATE_CLASSES bytes received
+    uint64_t            total;
+} GKO_RATE_SINK;
+/**********************************************************************************************************************
+    process-wide buckets
+**********************************************************************************************************************/
+static pthread_mutex_t  gko_rate_lock                           = PTHREAD_MUTEX_INITIALIZER;
+static GKO_RATE         gko_rate_buckets[GEKKO_RATE_BUCKETS_MAX];
+static int              gko_rate_count                          = 0;
+/**********************************************************************************************************************
+    description:    Monotonic clock in seconds
+    arguments:      -
+    return:         seconds
+**********************************************************************************************************************/
+static double gko_rate_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+/**********************************************************************************************************************
+    description:    Sleep for a while
+    arguments:      seconds:    how long
+    return:         -
+**********************************************************************************************************************/
+static void gko_rate_sleep(double seconds)
+{
+    struct timespec ts;
+
+    if (seconds <= 0) return;
+
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+}
+/**********************************************************************************************************************
+    description:    Set a bucket up, full
+    arguments:      rate:   bucket
+                    key:    what the bucket is shared by
+                    limit:  bytes per second
+    return:         error code
+**********************************************************************************************************************/
+int gko_rate_init(GKO_RATE *rate, const char *key, int64_t limit)
+{
+    if (!rate) return GEKKO_ERROR;
+    if (limit <= 0) return GEKKO_ERROR;
+
+    memset(rate, 0, sizeof(GKO_RATE));
+    snprintf(rate->key, NAME_MAX, "%s", (key) ? key : "");
+    pthread_mutex_init(&rate->lock, NULL);
+
+    rate->limit  = limit;
+    rate->burst  = limit * GEKKO_RATE_BURST_S;
+    if (rate->burst < GEKKO_RATE_QUANTUM) rate->burst = GEKKO_RATE_QUANTUM;
+    rate->tokens = rate->burst;
+    rate->last   = gko_rate_now();
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Find or create the process-wide bucket of a key, every session and grip asking for the same key
+                    draws from it, the latest limit wins
+    arguments:      key:    what the bucket is shared by, i.e. host:port
+                    limit:  bytes per second, 0 or less for no limit
+    return:         bucket, NULL when unlimited
+**********************************************************************************************************************/
+GKO_RATE *gko_rate_get(const char *key, int64_t limit)
+{
+    GKO_RATE   *rate    = NULL;
+    int         i       = 0;
+
+    if (!key) return NULL;
+    if (limit <= 0) return NULL;
+
+    pthread_mutex_lock(&gko_rate_lock);
+
+    for (i = 0; i < gko_rate_count; i++) {
+        if (strcmp(gko_rate_buckets[i].key, key) != GEKKO_OK) continue;
+
+        rate = &gko_rate_buckets[i];
+        pthread_mutex_lock(&rate->lock);
+        if (rate->limit != limit) {
+            rate->limit = limit;
+            rate->burst = limit * GEKKO_RATE_BURST_S;
+            if (rate->burst < GEKKO_RATE_QUANTUM) rate->burst = GEKKO_RATE_QUANTUM;
+            if (rate->tokens > rate->burst) rate->tokens = rate->burst;
+        }
+        pthread_mutex_unlock(&rate->lock);
+        break;
+    }
+
+    if (!rate && gko_rate_count < GEKKO_RATE_BUCKETS_MAX) {
+        rate = &gko_rate_buckets[gko_rate_count];
+        if (gko_rate_init(rate, key, limit) == GEKKO_OK) {
+            gko_rate_count++;
+        } else {
+            rate = NULL;
+        }
+    }
+
+    pthread_mutex_unlock(&gko_rate_lock);
+
+    if (!rate) fprintf(stderr, "Too many rate limits, %s goes unlimited.\n", key);
+
+    return rate;
+}
+/**********************************************************************************************************************
+    description:    Ask for bytes without blocking. Metadata may run the bucket into debt, small files may take it to
+                    empty, bulk has to leave most of a burst for the others. A grant never exceeds one burst, so the
+                    debt stays bounded and any 1 s window lands within a few percent of the limit
+    arguments:      rate:   bucket, NULL for no limit
+                    want:   bytes wanted
+                    cls:    priority class
+                    delay:  seconds to wait before asking again when nothing is granted, may be NULL
+    return:         bytes granted, 0 to wait
+**********************************************************************************************************************/
+size_t gko_rate_take(GKO_RATE *rate, size_t want, GKO_RATE_CLASS cls, double *delay)
+{
+    double  now     = 0;
+    double  floor   = 0;
+    size_t  grant   = 0;
+
+    if (delay) *delay = 0;
+    if (!rate || !want) return want;
+
+    pthread_mutex_lock(&rate->lock);
+
+    switch (cls) {
+    case GKO_RATE_META:     floor = -rate->burst;           break;
+    case GKO_RATE_SMALL:    floor = 0;                      break;
+    default:                floor = rate->burst * 3 / 4;    break;
+    }
+
+    now = gko_rate_now();
+    rate->tokens += (now - rate->last) * rate->limit;
+    if (rate->tokens > rate->burst) rate->tokens = rate->burst;
+    rate->last = now;
+
+    if (rate->tokens >= floor) {
+        grant = (want < (size_t)rate->burst) ? want : (size_t)rate->burst;
+        rate->tokens -= grant;
+        rate->bytes[cls] += grant;
+    } else if (delay) {
+        *delay = (floor - rate->tokens) / rate->limit;
+    }
+
+    pthread_mutex_unlock(&rate->lock);
+
+    return grant;
+}
+/**********************************************************************************************************************
+    description:    Ask for bytes, sleeping until some are granted
+    arguments:      rate:   bucket, NULL for no limit
+                    want:   bytes wanted
+                    cls:    priority class
+    return:         bytes granted, at least one unless want is 0
+**********************************************************************************************************************/
+size_t gko_rate_wait(GKO_RATE *rate, size_t want, GKO_RATE_CLASS cls)
+{
+    double  delay   = 0;
+    double  begin   = 0;
+    size_t  grant   = 0;
+
+    if (!rate || !want) return want;
+
+    while (!(grant = gko_rate_take(rate, want, cls, &delay))) {
+        if (!begin) begin = gko_rate_now();
+        gko_rate_sleep((delay > 0.0005) ? delay : 0.0005);
+    }
+
+    if (begin) {
+        pthread_mutex_lock(&rate->lock);
+        rate->waited[cls] += gko_rate_now() - begin;
+        pthread_mutex_unlock(&rate->lock);
+    }
+
+    return grant;
+}
+/**********************************************************************************************************************
+    description:    Give back granted bytes that were never sent, i.e. a read hit the end of the file
+    arguments:      rate:   bucket, NULL for no limit
+                    bytes:  unused bytes
+                    cls:    priority class they were granted to
+    return:         -
+**********************************************************************************************************************/
+void gko_rate_refund(GKO_RATE *rate, size_t bytes, GKO_RATE_CLASS cls)
+{
+    if (!rate || !bytes) return;
+
+    pthread_mutex_lock(&rate->lock);
+    rate->tokens += bytes;
+    if (rate->tokens > rate->burst) rate->tokens = rate->burst;
+    rate->bytes[cls] -= (bytes < rate->bytes[cls]) ? bytes : rate->bytes[cls];
+    pthread_mutex_unlock(&rate->lock);
+}
+/**********************************************************************************************************************
+    description:    Priority class of a file upload
+    arguments:      size:   file size
+    return:         class
+**********************************************************************************************************************/
+GKO_RATE_CLASS gko_rate_class(uint64_t size)
+{
+    return (size <= GEKKO_RATE_SMALL_MAX) ? GKO_RATE_SMALL : GKO_RATE_BULK;
+}
+/**********************************************************************************************************************
+    description:    Name of a priority class
+    arguments:      cls:    class
+    return:         name
+**********************************************************************************************************************/
+const char *gko_rate_class_name(GKO_RATE_CLASS cls)
+{
+    switch (cls) {
+    case GKO_RATE_META:     return "meta";
+    case GKO_RATE_SMALL:    return "small";
+    case GKO_RATE_BULK:     return "bulk";
+    default:                return "unknown";
+    }
+}
+/**********************************************************************************************************************
+    description:    Bench source, pushes one class of traffic through the limiter until the deadline
+    arguments:      arg:    GKO_RATE_SOURCE
+    return:         NULL
+**********************************************************************************************************************/
+static void *gko_rate_source(void *arg)
+{
+    GKO_RATE_SOURCE    *src     = (GKO_RATE_SOURCE *)arg;
+    char               *buffer  = NULL;
+    size_t              grant   = 0;
+    size_t              done    = 0;
+    ssize_t             n       = 0;
+
+    buffer = (char *)zalloc(src->chunk);
+
+    while (buffer && gko_rate_now() < src->end) {
+        grant = gko_rate_wait(src->rate, src->chunk, src->cls);
+
+        for (done = 0; done < grant; done += (size_t)n) {
+            n = write(src->fd, buffer + done, grant - done);
+            if (n <= 0) goto __error_write;
+        }
+
+        if (src->pause_us) usleep((useconds_t)src->pause_us);
+    }
+
+__error_write:
+    free(buffer);
+    close(src->fd);
+
+    return NULL;
+}
+/**********************************************************************************************************************
+    description:    Bench sink, a stand-in server draining every source no faster than its link allows and counting
+                    bytes per class and per second
+    arguments:      arg:    GKO_RATE_SINK
+    return:         NULL
+**********************************************************************************************************************/
+static void *gko_rate_sink(void *arg)
+{
+    GKO_RATE_SINK  *sink    = (GKO_RATE_SINK *)arg;
+    struct pollfd   fds[GKO_RATE_CLASSES];
+    char            buffer[GEKKO_RATE_QUANTUM];
+    double          ahead   = 0;
+    ssize_t         n       = 0;
+    long            second  = 0;
+    int             open    = GKO_RATE_CLASSES;
+    int             c       = 0;
+
+    for (c = 0; c < GKO_RATE_CLASSES; c++) {
+        fds[c].fd = sink->fds[c];
+        fds[c].events = POLLIN;
+    }
+
+    while (open) {
+        if (poll(fds, GKO_RATE_CLASSES, 1000) <= 0) continue;
+
+        for (c = 0; c < GKO_RATE_CLASSES; c++) {
+            if (!fds[c].revents) continue;
+
+            n = read(fds[c].fd, buffer, sizeof(buffer));
+            if (n <= 0) {
+                fds[c].fd = -1;
+                open--;
+                continue;
+            }
+
+            second = (long)(gko_rate_now() - sink->begin);
+            if (second < sink->seconds) sink->windows[second * GKO_RATE_CLASSES + c] += (uint64_t)n;
+            sink->total += (uint64_t)n;
+        }
+
+        // the link is the bottleneck, never drain faster than it would
+        ahead = (double)sink->total / sink->link - (gko_rate_now() - sink->begin);
+        gko_rate_sleep(ahead);
+    }
+
+    return NULL;
+}
+/**********************************************************************************************************************
+    description:    Run every class of traffic through a bucket into a throttled sink
+    arguments:      rate:       bucket, NULL for no limit
+                    link:       sink speed
+                    seconds:    how long
+                    windows:    seconds x GKO_RATE_CLASSES bytes received
+                    total:      bytes received to store
+    return:         error code
+**********************************************************************************************************************/
+static int gko_rate_bench_run(GKO_RATE *rate, int64_t link, int seconds, uint64_t *windows, uint64_t *total)
+{
+    GKO_RATE_SOURCE     src[GKO_RATE_CLASSES];
+    GKO_RATE_SINK       sink;
+    pthread_t           threads[GKO_RATE_CLASSES];
+    pthread_t           drain;
+    int                 pair[2];
+    int                 c       = 0;
+    int                 started = 0;
+
+    static const size_t chunks[GKO_RATE_CLASSES] = {GEKKO_RATE_META_BYTES, 32768, 262144};
+    static const long   pauses[GKO_RATE_CLASSES] = {1000, 10000, 0};
+
+    memset(&sink, 0, sizeof(sink));
+    memset(windows, 0, seconds * GKO_RATE_CLASSES * sizeof(uint64_t));
+    sink.link = link;
+    sink.seconds = seconds;
+    sink.windows = windows;
+    sink.begin = gko_rate_now();
+
+    for (c = 0; c < GKO_RATE_CLASSES; c++) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+            fprintf(stderr, "Cannot create socket pair.\n");
+            break;
+        }
+
+        sink.fds[c]        = pair[0];
+        src[c].rate        = rate;
+        src[c].cls         = (GKO_RATE_CLASS)c;
+        src[c].fd          = pair[1];
+        src[c].chunk       = chunks[c];
+        src[c].pause_us    = pauses[c];
+        src[c].end         = sink.begin + seconds;
+    }
+
+    if (c < GKO_RATE_CLASSES) {
+        while (c-- > 0) {
+            close(sink.fds[c]);
+            close(src[c].fd);
+        }
+        return GEKKO_ERROR;
+    }
+
+    if (pthread_create(&drain, NULL, gko_rate_sink, &sink) != 0) {
+        for (c = 0; c < GKO_RATE_CLASSES; c++) {
+            close(sink.fds[c]);
+            close(src[c].fd);
+        }
+        fprintf(stderr, "Cannot start bench threads.\n");
+        return GEKKO_ERROR;
+    }
+
+    for (c = 0; c < GKO_RATE_CLASSES; c++) {
+        if (pthread_create(&threads[c], NULL, gko_rate_source, &src[c]) != 0) {
+            close(src[c].fd);
+            continue;
+        }
+        started |= 1 << c;
+    }
+
+    for (c = 0; c < GKO_RATE_CLASSES; c++) {
+        if (started & (1 << c)) pthread_join(threads[c], NULL);
+    }
+    pthread_join(drain, NULL);
+
+    for (c = 0; c < GKO_RATE_CLASSES; c++) close(sink.fds[c]);
+
+    *total = sink.total;
+
+    return (started == (1 << GKO_RATE_CLASSES) - 1) ? GEKKO_OK : GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Measure the limiter against a local stand-in server with a throttled link: how close every 1 s
+                    window stays to the limit, how each class fares, and what the limiter costs with headroom left
+    arguments:      limit:      bytes per second, 0 for default
+                    seconds:    seconds per run, 0 for default
+    return:         error code
+**********************************************************************************************************************/
+int gko_rate_bench(int64_t limit, int seconds)
+{
+    GKO_RATE    rate;
+    uint64_t   *windows     = NULL;
+    uint64_t   *w           = NULL;
+    uint64_t    total       = 0;
+    uint64_t    free_total  = 0;
+    uint64_t    sum         = 0;
+    int64_t     link        = 0;
+    double      off         = 0;
+    double      worst       = 0;
+    int         ret         = GEKKO_ERROR;
+    int         s           = 0;
+
+    if (limit <= 0) limit = GEKKO_RATE_BENCH_LIMIT;
+    if (seconds <= 0) seconds = GEKKO_RATE_BENCH_S;
+    link = limit * 4;
+
+    windows = (uint64_t *)zalloc(seconds * GKO_RATE_CLASSES * sizeof(uint64_t));
+    if (!windows) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    // limited below the link: every window should sit on the limit, small and meta traffic unhurt
+    gko_rate_init(&rate, "bench", limit);
+    if (gko_rate_bench_run(&rate, link, seconds, windows, &total) != GEKKO_OK) goto __error_run;
+
+    printf("Limited to %.2f MB/s over a %.2f MB/s link:\n", limit / 1e6, link / 1e6);
+    for (s = 0; s < seconds; s++) {
+        w = &windows[s * GKO_RATE_CLASSES];
+        sum = w[GKO_RATE_META] + w[GKO_RATE_SMALL] + w[GKO_RATE_BULK];
+        off = 100.0 * ((double)sum - limit) / limit;
+        if (off < 0 ? -off > worst : off > worst) worst = (off < 0) ? -off : off;
+
+        printf("\t%ds: %.3f MB/s (%+.1f%%), meta %.3f, small %.3f, bulk %.3f MB/s\n", s + 1, sum / 1e6, off,
+               w[GKO_RATE_META] / 1e6, w[GKO_RATE_SMALL] / 1e6, w[GKO_RATE_BULK] / 1e6);
+    }
+    printf("Worst 1 s window %.1f%% off the limit, throttled meta %.3f s, small %.3f s, bulk %.3f s.\n", worst,
+           rate.waited[GKO_RATE_META], rate.waited[GKO_RATE_SMALL], rate.waited[GKO_RATE_BULK]);
+    pthread_mutex_destroy(&rate.lock);
+
+    // headroom: a limit above the link should not cost anything against no limit at all
+    if (gko_rate_bench_run(NULL, link, seconds, windows, &free_total) != GEKKO_OK) goto __error_run;
+
+    gko_rate_init(&rate, "bench", link * 2);
+    if (gko_rate_bench_run(&rate, link, seconds, windows, &total) != GEKKO_OK) goto __error_run;
+    pthread_mutex_destroy(&rate.lock);
+
+    printf("Headroom: %.2f MB/s without a limit, %.2f MB/s limited to %.2f MB/s (%.1f%%).\n",
+           free_total / 1e6 / seconds, total / 1e6 / seconds, link * 2 / 1e6,
+           free_total ? 100.0 * total / free_total : 0.0);
+
+    ret = GEKKO_OK;
+
+__error_run:
+    free(windows);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
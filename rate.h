@@ -0,0 +1,61 @@
+/**********************************************************************************************************************
+    file:           rate.h
+    description:    Bandwidth limiter of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_RATE_H
+#define __GEKKO_RATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+/**********************************************************************************************************************
+    rate defaults
+**********************************************************************************************************************/
+#define GEKKO_RATE_BURST_S              (0.02)      // bucket depth, keeps any 1 s window within a few percent
+#define GEKKO_RATE_QUANTUM              (16384)     // smallest bucket depth, one grant never needs less
+#define GEKKO_RATE_SMALL_MAX            (1 << 20)   // files up to this size ride the small class
+#define GEKKO_RATE_META_BYTES           (256)       // charged for one metadata request
+#define GEKKO_RATE_BUCKETS_MAX          (64)
+#define GEKKO_RATE_BENCH_LIMIT          (8 << 20)
+#define GEKKO_RATE_BENCH_S              (3)
+/**********************************************************************************************************************
+    priority classes, a lower class may dig deeper into the bucket
+**********************************************************************************************************************/
+typedef enum {
+    GKO_RATE_META = 0,                  // sftp requests without payload: removals, directories
+    GKO_RATE_SMALL,                     // small files and the bulk archive carrying them
+    GKO_RATE_BULK,                      // large files, compressed streams, deltas
+    GKO_RATE_CLASSES
+} GKO_RATE_CLASS;
+/**********************************************************************************************************************
+    token bucket shared by every session of the grips pointing at one host
+**********************************************************************************************************************/
+typedef struct {
+    char                key[NAME_MAX];
+    pthread_mutex_t     lock;
+    int64_t             limit;                      // bytes per second
+    double              tokens;
+    double              burst;
+    double              last;
+    uint64_t            bytes[GKO_RATE_CLASSES];
+    double              waited[GKO_RATE_CLASSES];   // seconds callers spent throttled
+} GKO_RATE;
+/**********************************************************************************************************************
+    rate functions
+**********************************************************************************************************************/
+int            gko_rate_init(GKO_RATE *rate, const char *key, int64_t limit);
+GKO_RATE      *gko_rate_get(const char *key, int64_t limit);
+size_t         gko_rate_take(GKO_RATE *rate, size_t want, GKO_RATE_CLASS cls, double *delay);
+size_t         gko_rate_wait(GKO_RATE *rate, size_t want, GKO_RATE_CLASS cls);
+void           gko_rate_refund(GKO_RATE *rate, size_t bytes, GKO_RATE_CLASS cls);
+GKO_RATE_CLASS gko_rate_class(uint64_t size);
+const char    *gko_rate_class_name(GKO_RATE_CLASS cls);
+int            gko_rate_bench(int64_t limit, int seconds);
+
+#endif  // __GEKKO_RATE_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,658 @@
+/**********************************************************************************************************************
+    file:           registry.c
+    description:    Indexed grip store of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gekko.h"
+#include "scan.h"
+#include "hash.h"
+#include "config.h"
+#include "schedule.h"
+#include "prefetch.h"
+#include "registry.h"
+/**********************************************************************************************************************
+    registry being built
+**********************************************************************************************************************/
+typedef struct {
+    GKO_REGISTRY_RECORD    *records;
+    size_t                  count;
+    size_t                  capacity;
+    char                   *strings;
+    size_t                  length;
+    size_t                  size;
+} GKO_REGISTRY_BUILD;
+/**********************************************************************************************************************
+    description:    Parse an authentication method name
+    arguments:      value:  method name
+                    field:  AUTH_METHOD to store
+    return:         error code
+**********************************************************************************************************************/
+static int gko_registry_parse_auth(const char *value, void *field)
+{
+    AUTH_METHOD *auth = (AUTH_METHOD *)field;
+
+    if (strcmp(value, "password") == GEKKO_OK) {
+        *auth = AUTH_METHOD_PASSWORD;
+    } else if (strcmp(value, "publickey") == GEKKO_OK) {
+        *auth = AUTH_METHOD_PUBLIC_KEY;
+    } else if (strcmp(value, "keyboard-interactive") == GEKKO_OK) {
+        *auth = AUTH_METHOD_KEYBOARD_INTERACTIVE;
+    } else {
+        return GEKKO_ERROR;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Name of an authentication method
+    arguments:      field:  AUTH_METHOD
+    return:         name, NULL if not set
+**********************************************************************************************************************/
+static const char *gko_registry_name_auth(const void *field)
+{
+    switch (*(const AUTH_METHOD *)field) {
+    case AUTH_METHOD_PASSWORD:              return "password";
+    case AUTH_METHOD_PUBLIC_KEY:            return "publickey";
+    case AUTH_METHOD_KEYBOARD_INTERACTIVE:  return "keyboard-interactive";
+    default:                                return NULL;
+    }
+}
+/**********************************************************************************************************************
+    description:    Parse a transfer engine name
+    arguments:      value:  engine name
+                    field:  GEKKO_ENGINE to store
+    return:         error code
+**********************************************************************************************************************/
+static int gko_registry_parse_engine(const char *value, void *field)
+{
+    GEKKO_ENGINE *engine = (GEKKO_ENGINE *)field;
+
+    if (strcmp(value, "threads") == GEKKO_OK) {
+        *engine = GEKKO_ENGINE_THREADS;
+    } else if (strcmp(value, "events") == GEKKO_OK) {
+        *engine = GEKKO_ENGINE_EVENTS;
+    } else {
+        return GEKKO_ERROR;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Name of a transfer engine
+    arguments:      field:  GEKKO_ENGINE
+    return:         name
+**********************************************************************************************************************/
+static const char *gko_registry_name_engine(const void *field)
+{
+    return (*(const GEKKO_ENGINE *)field == GEKKO_ENGINE_EVENTS) ? "events" : "threads";
+}
+/**********************************************************************************************************************
+    description:    Parse a schedule policy name
+    arguments:      value:  policy name
+                    field:  GEKKO_SCHEDULE to store
+    return:         error code
+**********************************************************************************************************************/
+static int gko_registry_parse_schedule(const char *value, void *field)
+{
+    return gko_schedule_policy(value, (GEKKO_SCHEDULE *)field);
+}
+/**********************************************************************************************************************
+    description:    Name of a schedule policy
+    arguments:      field:  GEKKO_SCHEDULE
+    return:         name
+**********************************************************************************************************************/
+static const char *gko_registry_name_schedule(const void *field)
+{
+    return gko_schedule_name(*(const GEKKO_SCHEDULE *)field);
+}
+/**********************************************************************************************************************
+    description:    Parse a read-ahead engine name
+    arguments:      value:  engine name
+                    field:  GEKKO_READAHEAD to store
+    return:         error code
+**********************************************************************************************************************/
+static int gko_registry_parse_readahead(const char *value, void *field)
+{
+    return gko_prefetch_engine(value, (GEKKO_READAHEAD *)field);
+}
+/**********************************************************************************************************************
+    description:    Name of a read-ahead engine
+    arguments:      field:  GEKKO_READAHEAD
+    return:         name
+**********************************************************************************************************************/
+static const char *gko_registry_name_readahead(const void *field)
+{
+    return gko_prefetch_name(*(const GEKKO_READAHEAD *)field);
+}
+/**********************************************************************************************************************
+    grip file keys
+**********************************************************************************************************************/
+static const GKO_CONFIG_FIELD gko_grip_fields[] = {
+    GKO_CONFIG_BIND("host",             GKO_CONFIG_STRING,  GRIP,   host),
+    GKO_CONFIG_BIND("port",             GKO_CONFIG_PORT,    GRIP,   port),
+    GKO_CONFIG_BIND("user",             GKO_CONFIG_STRING,  GRIP,   user),
+    GKO_CONFIG_ENUM("auth",             GRIP,   auth, gko_registry_parse_auth, gko_registry_name_auth),
+    GKO_CONFIG_BIND("sessions",         GKO_CONFIG_INT,     GRIP,   sessions),
+    GKO_CONFIG_BIND("window",           GKO_CONFIG_INT,     GRIP,   window),
+    GKO_CONFIG_BIND("bulk_threshold",   GKO_CONFIG_INT64,   GRIP,   bulk_threshold),
+    GKO_CONFIG_BIND("bulk_command",     GKO_CONFIG_STRING,  GRIP,   bulk_command),
+    GKO_CONFIG_ENUM("engine",           GRIP,   engine, gko_registry_parse_engine, gko_registry_name_engine),
+    GKO_CONFIG_ENUM("schedule",         GRIP,   schedule, gko_registry_parse_schedule, gko_registry_name_schedule),
+    GKO_CONFIG_BIND("ops",              GKO_CONFIG_INT,     GRIP,   ops),
+    GKO_CONFIG_BIND("list_window",      GKO_CONFIG_INT,     GRIP,   list_window),
+    GKO_CONFIG_BIND("compress",         GKO_CONFIG_INT,     GRIP,   compress),
+    GKO_CONFIG_BIND("rate_limit",       GKO_CONFIG_INT64,   GRIP,   rate_limit),
+    GKO_CONFIG_ENUM("readahead",        GRIP,   readahead, gko_registry_parse_readahead, gko_registry_name_readahead),
+    GKO_CONFIG_BIND("readahead_depth",  GKO_CONFIG_INT,     GRIP,   readahead_depth),
+    GKO_CONFIG_BIND("gekko",            GKO_CONFIG_STRING,  GRIP,   gekko),
+};
+/**********************************************************************************************************************
+    description:    Parse one grip file
+    arguments:      path:       grip file path
+                    grip:       grip instance to store
+                    verbose:    print every key
+    return:         error code
+**********************************************************************************************************************/
+int gko_registry_read(const char *path, GRIP *grip, bool verbose)
+{
+    return gko_config_load(path, gko_grip_fields, sizeof(gko_grip_fields) / sizeof(gko_grip_fields[0]), grip,
+                           verbose);
+}
+/**********************************************************************************************************************
+    description:    Write one grip file
+    arguments:      path:   grip file path
+                    grip:   grip to write
+    return:         error code
+**********************************************************************************************************************/
+int gko_registry_save(const char *path, const GRIP *grip)
+{
+    return gko_config_save(path, gko_grip_fields, sizeof(gko_grip_fields) / sizeof(gko_grip_fields[0]), grip);
+}
+/**********************************************************************************************************************
+    description:    Modification time of a directory
+    arguments:      dir:    directory path
+    return:         nanoseconds, -1 on error
+**********************************************************************************************************************/
+static int64_t gko_registry_mtime(const char *dir)
+{
+    struct stat st;
+
+    if (stat(dir, &st) != 0) return -1;
+
+    return GKO_STAT_MTIME_NS(&st);
+}
+/**********************************************************************************************************************
+    description:    Map the registry of a grips directory, a missing or invalid file yields an empty registry
+    arguments:      dir:    grips directory
+                    reg:    registry to fill, release with gko_registry_close()
+    return:         error code
+**********************************************************************************************************************/
+int gko_registry_open(const char *dir, GKO_REGISTRY *reg)
+{
+    const GKO_REGISTRY_HEADER  *header          = NULL;
+    struct stat                 st;
+    char                        path[PATH_MAX]  = {0};
+    int                         fd              = -1;
+
+    if (!dir) return GEKKO_ERROR;
+    if (!reg) return GEKKO_ERROR;
+
+    memset(reg, 0, sizeof(GKO_REGISTRY));
+    snprintf(path, PATH_MAX, "%s%s%s", dir, SEP, GEKKO_REGISTRY_FILE);
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return (errno == ENOENT) ? GEKKO_OK : GEKKO_ERROR;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(GKO_REGISTRY_HEADER) + 1) {
+        close(fd);
+        return GEKKO_OK;
+    }
+
+    reg->length = (size_t)st.st_size;
+    reg->map = mmap(NULL, reg->length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (reg->map == MAP_FAILED) {
+        memset(reg, 0, sizeof(GKO_REGISTRY));
+        return GEKKO_ERROR;
+    }
+
+    header = (const GKO_REGISTRY_HEADER *)reg->map;
+    if (memcmp(header->magic, GEKKO_REGISTRY_MAGIC, sizeof(header->magic)) != GEKKO_OK ||
+        header->version != GEKKO_REGISTRY_VERSION ||
+        header->record_size != sizeof(GKO_REGISTRY_RECORD) ||
+        header->length != reg->length ||
+        header->slots < GEKKO_REGISTRY_SLOTS_MIN || (header->slots & (header->slots - 1)) ||
+        header->slots < 2 * header->count ||
+        header->records != sizeof(GKO_REGISTRY_HEADER) + header->slots * sizeof(uint32_t) ||
+        header->strings != header->records + header->count * sizeof(GKO_REGISTRY_RECORD) ||
+        header->strings >= header->length ||
+        ((const char *)reg->map)[reg->length - 1] != '\0') {
+        fprintf(stderr, "Invalid registry %s, rebuilding.\n", path);
+        gko_registry_close(reg);
+        return GEKKO_OK;
+    }
+
+    reg->header         = header;
+    reg->slots          = (const uint32_t *)((const char *)reg->map + sizeof(GKO_REGISTRY_HEADER));
+    reg->records        = (const GKO_REGISTRY_RECORD *)((const char *)reg->map + header->records);
+    reg->count          = (size_t)header->count;
+    reg->strings        = (const char *)reg->map + header->strings;
+    reg->strings_length = (size_t)(header->length - header->strings);
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Unmap registry
+    arguments:      reg:    registry
+    return:         -
+**********************************************************************************************************************/
+void gko_registry_close(GKO_REGISTRY *reg)
+{
+    if (!reg) return;
+
+    if (reg->map) munmap(reg->map, reg->length);
+    memset(reg, 0, sizeof(GKO_REGISTRY));
+}
+/**********************************************************************************************************************
+    description:    String of a record, bounded by the mapping
+    arguments:      reg:    registry
+                    offset: string offset
+    return:         string, "" when out of range
+**********************************************************************************************************************/
+static const char *gko_registry_string(const GKO_REGISTRY *reg, uint64_t offset)
+{
+    return (offset < reg->strings_length) ? reg->strings + offset : "";
+}
+/**********************************************************************************************************************
+    description:    Find the record of a grip, one slot probe unless names collide
+    arguments:      reg:    registry
+                    name:   grip name
+    return:         record, NULL if not found
+**********************************************************************************************************************/
+const GKO_REGISTRY_RECORD *gko_registry_find(const GKO_REGISTRY *reg, const char *name)
+{
+    const GKO_REGISTRY_RECORD  *rec     = NULL;
+    uint64_t                    hash    = 0;
+    uint64_t                    mask    = 0;
+    uint64_t                    i       = 0;
+    uint64_t                    n       = 0;
+    uint32_t                    slot    = 0;
+
+    if (!reg || !name || !reg->header || !reg->count) return NULL;
+
+    hash = gko_hash(name, strlen(name));
+    mask = reg->header->slots - 1;
+
+    for (i = hash & mask, n = 0; n < reg->header->slots; i = (i + 1) & mask, n++) {
+        slot = reg->slots[i];
+        if (!slot) return NULL;
+        if (slot > reg->count) return NULL;
+
+        rec = &reg->records[slot - 1];
+        if (rec->hash == hash && strcmp(gko_registry_string(reg, rec->name), name) == GEKKO_OK) return rec;
+    }
+
+    return NULL;
+}
+/**********************************************************************************************************************
+    description:    Append a string to the string table of a build
+    arguments:      build:  registry being built
+                    s:      string
+                    offset: string offset to store
+    return:         error code
+**********************************************************************************************************************/
+static int gko_registry_intern(GKO_REGISTRY_BUILD *build, const char *s, uint64_t *offset)
+{
+    char   *grown   = NULL;
+    size_t  len     = strlen(s) + 1;
+    size_t  size    = 0;
+
+    if (len == 1) {
+        *offset = 0;
+        return GEKKO_OK;
+    }
+
+    if (build->length + len > build->size) {
+        size = build->size;
+        while (build->length + len > size) size *= 2;
+
+        grown = (char *)realloc(build->strings, size);
+        if (!grown) return GEKKO_ERROR;
+
+        build->strings = grown;
+        build->size = size;
+    }
+
+    memcpy(build->strings + build->length, s, len);
+    *offset = build->length;
+    build->length += len;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Append a grip to a build
+    arguments:      build:  registry being built
+                    name:   grip name
+                    st:     stat of the grip file
+                    grip:   parsed grip
+    return:         error code
+**********************************************************************************************************************/
+static int gko_registry_add(GKO_REGISTRY_BUILD *build, const char *name, const struct stat *st, const GRIP *grip)
+{
+    GKO_REGISTRY_RECORD    *rec         = NULL;
+    GKO_REGISTRY_RECORD    *grown       = NULL;
+    size_t                  capacity    = 0;
+    int                     ret         = GEKKO_OK;
+
+    if (build->count == build->capacity) {
+        capacity = (build->capacity) ? build->capacity * 2 : 256;
+
+        grown = (GKO_REGISTRY_RECORD *)realloc(build->records, capacity * sizeof(GKO_REGISTRY_RECORD));
+        if (!grown) return GEKKO_ERROR;
+
+        build->records = grown;
+        build->capacity = capacity;
+    }
+
+    rec = &build->records[build->count];
+    memset(rec, 0, sizeof(GKO_REGISTRY_RECORD));
+
+    ret |= gko_registry_intern(build, name, &rec->name);
+    ret |= gko_registry_intern(build, grip->host, &rec->host);
+    ret |= gko_registry_intern(build, grip->user, &rec->user);
+    ret |= gko_registry_intern(build, grip->gekko, &rec->gekko);
+    ret |= gko_registry_intern(build, grip->bulk_command, &rec->bulk_command);
+    if (ret != GEKKO_OK) return GEKKO_ERROR;
+
+    rec->hash               = gko_hash(name, strlen(name));
+    rec->mtime_ns           = GKO_STAT_MTIME_NS(st);
+    rec->size               = (uint64_t)st->st_size;
+    rec->inode              = (uint64_t)st->st_ino;
+    rec->bulk_threshold     = grip->bulk_threshold;
+    rec->rate_limit         = grip->rate_limit;
+    rec->auth               = (uint32_t)grip->auth;
+    rec->engine             = (uint32_t)grip->engine;
+    rec->schedule           = (uint32_t)grip->schedule;
+    rec->readahead          = (uint32_t)grip->readahead;
+    rec->sessions           = grip->sessions;
+    rec->window             = grip->window;
+    rec->ops                = grip->ops;
+    rec->list_window        = grip->list_window;
+    rec->compress           = grip->compress;
+    rec->readahead_depth    = grip->readahead_depth;
+    rec->port               = grip->port;
+
+    build->count++;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Unpack a record into a grip
+    arguments:      reg:    registry
+                    rec:    record
+                    grip:   grip instance to store
+    return:         -
+**********************************************************************************************************************/
+static void gko_registry_unpack(const GKO_REGISTRY *reg, const GKO_REGISTRY_RECORD *rec, GRIP *grip)
+{
+    snprintf(grip->host, NAME_MAX, "%s", gko_registry_string(reg, rec->host));
+    snprintf(grip->user, NAME_MAX, "%s", gko_registry_string(reg, rec->user));
+    snprintf(grip->gekko, PATH_MAX, "%s", gko_registry_string(reg, rec->gekko));
+    snprintf(grip->bulk_command, PATH_MAX, "%s", gko_registry_string(reg, rec->bulk_command));
+
+    grip->port              = rec->port;
+    grip->auth              = (AUTH_METHOD)rec->auth;
+    grip->sessions          = rec->sessions;
+    grip->window            = rec->window;
+    grip->bulk_threshold    = rec->bulk_threshold;
+    grip->engine            = (GEKKO_ENGINE)rec->engine;
+    grip->schedule          = (GEKKO_SCHEDULE)rec->schedule;
+    grip->ops               = rec->ops;
+    grip->list_window       = rec->list_window;
+    grip->compress          = rec->compress;
+    grip->rate_limit        = rec->rate_limit;
+    grip->readahead         = (GEKKO_READAHEAD)rec->readahead;
+    grip->readahead_depth   = rec->readahead_depth;
+}
+/**********************************************************************************************************************
+    description:    Check a record against the stat of its grip file
+    arguments:      rec:    record
+                    st:     stat of the grip file
+    return:         boolean
+**********************************************************************************************************************/
+static bool gko_registry_fresh(const GKO_REGISTRY_RECORD *rec, const struct stat *st)
+{
+    return rec->mtime_ns == GKO_STAT_MTIME_NS(st) && rec->size == (uint64_t)st->st_size &&
+           rec->inode == (uint64_t)st->st_ino;
+}
+/**********************************************************************************************************************
+    description:    Write a build as the registry, atomically replacing the old one
+    arguments:      dir:    grips directory
+                    build:  registry built
+    return:         error code
+**********************************************************************************************************************/
+static int gko_registry_write(const char *dir, const GKO_REGISTRY_BUILD *build)
+{
+    GKO_REGISTRY_HEADER     header;
+    uint32_t               *slots           = NULL;
+    FILE                   *file            = NULL;
+    char                    path[PATH_MAX]  = {0};
+    char                    temp[PATH_MAX]  = {0};
+    uint64_t                count           = GEKKO_REGISTRY_SLOTS_MIN;
+    uint64_t                i               = 0;
+    uint64_t                j               = 0;
+    int64_t                 mtime           = 0;
+    bool                    error           = false;
+    int                     fd              = -1;
+
+    while (count < 2 * build->count) count *= 2;
+
+    slots = (uint32_t *)zalloc(count * sizeof(uint32_t));
+    if (!slots) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    // linear probing at most half full, a name mostly lands in its home slot
+    for (i = 0; i < build->count; i++) {
+        for (j = build->records[i].hash & (count - 1); slots[j]; j = (j + 1) & (count - 1));
+        slots[j] = (uint32_t)(i + 1);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GEKKO_REGISTRY_MAGIC, sizeof(header.magic));
+    header.version      = GEKKO_REGISTRY_VERSION;
+    header.record_size  = sizeof(GKO_REGISTRY_RECORD);
+    header.count        = build->count;
+    header.slots        = count;
+    header.records      = sizeof(GKO_REGISTRY_HEADER) + count * sizeof(uint32_t);
+    header.strings      = header.records + build->count * sizeof(GKO_REGISTRY_RECORD);
+    header.length       = header.strings + build->length;
+
+    snprintf(path, PATH_MAX, "%s%s%s", dir, SEP, GEKKO_REGISTRY_FILE);
+    snprintf(temp, PATH_MAX, "%s.%ld.tmp", path, (long)getpid());
+
+    file = fopen(temp, "wb");
+    if (!file) {
+        fprintf(stderr, "Cannot open file %s.\n", temp);
+        free(slots);
+        return GEKKO_ERROR;
+    }
+
+    error |= (fwrite(&header, sizeof(header), 1, file) != 1);
+    error |= (fwrite(slots, sizeof(uint32_t), count, file) != count);
+    if (build->count) {
+        error |= (fwrite(build->records, sizeof(GKO_REGISTRY_RECORD), build->count, file) != build->count);
+    }
+    error |= (fwrite(build->strings, 1, build->length, file) != build->length);
+    error |= (fflush(file) != 0);
+    error |= (fclose(file) != 0);
+    free(slots);
+
+    if (error || rename(temp, path) != 0) {
+        fprintf(stderr, "Cannot write registry %s.\n", path);
+        unlink(temp);
+        return GEKKO_ERROR;
+    }
+
+    // the rename itself moves the directory mtime, the registry is stamped with the time after it
+    mtime = gko_registry_mtime(dir);
+    fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return GEKKO_ERROR;
+    error = (pwrite(fd, &mtime, sizeof(mtime), offsetof(GKO_REGISTRY_HEADER, dir_mtime_ns)) != sizeof(mtime));
+    close(fd);
+
+    return (error) ? GEKKO_ERROR : GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Rebuild the registry of a grips directory. Grip files whose stat matches the old registry are
+                    copied over, only new and changed files are parsed.
+    arguments:      dir:    grips directory
+                    old:    current registry, may be NULL
+    return:         error code
+**********************************************************************************************************************/
+int gko_registry_build(const char *dir, const GKO_REGISTRY *old)
+{
+    GKO_REGISTRY_BUILD          build;
+    const GKO_REGISTRY_RECORD  *rec                 = NULL;
+    GRIP                       *grip                = NULL;
+    DIR                        *d                   = NULL;
+    struct dirent              *ent                 = NULL;
+    struct stat                 st;
+    char                        name[NAME_MAX]      = {0};
+    char                        path[PATH_MAX]      = {0};
+    size_t                      len                 = 0;
+    size_t                      suffix              = strlen(GEKKO_REGISTRY_SUFFIX);
+    int                         ret                 = GEKKO_ERROR;
+
+    if (!dir) return GEKKO_ERROR;
+
+    memset(&build, 0, sizeof(build));
+
+    // offset 0 holds the empty string every unset field shares
+    grip = (GRIP *)malloc(sizeof(GRIP));
+    build.strings = (char *)zalloc(4096);
+    if (!grip || !build.strings) {
+        fprintf(stderr, "Insufficient memory.\n");
+        goto __error_build;
+    }
+    build.size = 4096;
+    build.length = 1;
+
+    d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "Cannot open directory: %s.\n", dir);
+        goto __error_build;
+    }
+
+    while ((ent = readdir(d))) {
+        len = strlen(ent->d_name);
+        if (len <= suffix || len - suffix >= NAME_MAX) continue;
+        if (strcmp(ent->d_name + len - suffix, GEKKO_REGISTRY_SUFFIX) != GEKKO_OK) continue;
+
+        snprintf(path, PATH_MAX, "%s%s%s", dir, SEP, ent->d_name);
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+
+        memcpy(name, ent->d_name, len - suffix);
+        name[len - suffix] = '\0';
+
+        rec = gko_registry_find(old, name);
+        memset(grip, 0, sizeof(GRIP));
+
+        if (rec && gko_registry_fresh(rec, &st)) {
+            gko_registry_unpack(old, rec, grip);
+        } else if (gko_registry_read(path, grip, false) != GEKKO_OK) {
+            fprintf(stderr, "Invalid grip %s, skipped.\n", path);
+            continue;
+        }
+
+        if (gko_registry_add(&build, name, &st, grip) != GEKKO_OK) {
+            fprintf(stderr, "Insufficient memory.\n");
+            goto __error_dir;
+        }
+    }
+
+    ret = gko_registry_write(dir, &build);
+
+__error_dir:
+    closedir(d);
+
+__error_build:
+    free(grip);
+    free(build.records);
+    free(build.strings);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Load a grip through the registry of its directory. A record is trusted while the stat of its grip
+                    file matches; a missing or outdated record rebuilds the registry, unless the directory is unchanged
+                    since the build, which means the file was skipped as invalid. A directory the registry cannot be
+                    written to falls back to parsing the grip file.
+    arguments:      dir:    grips directory
+                    name:   grip name
+                    grip:   grip instance to store
+    return:         error code
+**********************************************************************************************************************/
+int gko_registry_lookup(const char *dir, const char *name, GRIP *grip)
+{
+    GKO_REGISTRY                reg;
+    const GKO_REGISTRY_RECORD  *rec             = NULL;
+    struct stat                 st;
+    char                        path[PATH_MAX]  = {0};
+    bool                        rebuilt         = false;
+
+    if (!dir) return GEKKO_ERROR;
+    if (!name) return GEKKO_ERROR;
+    if (!grip) return GEKKO_ERROR;
+
+    snprintf(path, PATH_MAX, "%s%s%s%s", dir, SEP, name, GEKKO_REGISTRY_SUFFIX);
+    if (strchr(name, '/') || stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "Grip \"%s\" cannot be found.\n", name);
+        return GEKKO_ERROR;
+    }
+
+    printf("grip_path: [%s]\n", path);
+
+    if (gko_registry_open(dir, &reg) != GEKKO_OK) memset(&reg, 0, sizeof(reg));
+
+    // snapshots share the directory, its mtime alone moves on every run and is no reason to rebuild
+    for (;;) {
+        rec = gko_registry_find(&reg, name);
+        if (rec && gko_registry_fresh(rec, &st)) {
+            gko_registry_unpack(&reg, rec, grip);
+            gko_registry_close(&reg);
+            return GEKKO_OK;
+        }
+
+        if (rebuilt) break;
+        if (!rec && reg.header && reg.header->dir_mtime_ns == gko_registry_mtime(dir)) break;
+        rebuilt = true;
+
+        if (gko_registry_build(dir, &reg) != GEKKO_OK) break;
+        gko_registry_close(&reg);
+        if (gko_registry_open(dir, &reg) != GEKKO_OK) break;
+    }
+
+    gko_registry_close(&reg);
+
+    return gko_registry_read(path, grip, true);
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
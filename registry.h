@@ -0,0 +1,90 @@
+/**********************************************************************************************************************
+    file:           registry.h
+    description:    Indexed grip store of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_REGISTRY_H
+#define __GEKKO_REGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gekko.h"
+/**********************************************************************************************************************
+    registry defaults
+**********************************************************************************************************************/
+#define GEKKO_REGISTRY_FILE             ".grips"    // inside the grips directory, next to the grip files
+#define GEKKO_REGISTRY_MAGIC            "GKOGRIPS"
+#define GEKKO_REGISTRY_VERSION          (1)
+#define GEKKO_REGISTRY_SUFFIX           ".json"
+#define GEKKO_REGISTRY_SLOTS_MIN        (16)
+/**********************************************************************************************************************
+    on-disk layout: header, hash slots, records, then NUL terminated strings
+**********************************************************************************************************************/
+typedef struct {
+    char            magic[8];
+    uint32_t        version;
+    uint32_t        record_size;
+    uint64_t        count;
+    uint64_t        slots;          // power of two, at most half full
+    uint64_t        records;        // offset of the records
+    uint64_t        strings;        // offset of the strings
+    uint64_t        length;
+    int64_t         dir_mtime_ns;   // grips directory as of the build
+} GKO_REGISTRY_HEADER;
+
+typedef struct {
+    uint64_t        hash;           // of the name
+    uint64_t        name;           // string offsets
+    uint64_t        host;
+    uint64_t        user;
+    uint64_t        gekko;
+    uint64_t        bulk_command;
+    int64_t         mtime_ns;       // grip file as of the build
+    uint64_t        size;
+    uint64_t        inode;
+    int64_t         bulk_threshold;
+    int64_t         rate_limit;
+    uint32_t        auth;
+    uint32_t        engine;
+    uint32_t        schedule;
+    uint32_t        readahead;
+    int32_t         sessions;
+    int32_t         window;
+    int32_t         ops;
+    int32_t         list_window;
+    int32_t         compress;
+    int32_t         readahead_depth;
+    uint16_t        port;
+    uint16_t        reserved[3];
+} GKO_REGISTRY_RECORD;
+/**********************************************************************************************************************
+    mapped registry
+**********************************************************************************************************************/
+typedef struct {
+    void                           *map;
+    size_t                          length;
+    const GKO_REGISTRY_HEADER      *header;
+    const uint32_t                 *slots;      // record + 1, 0 for an empty slot
+    const GKO_REGISTRY_RECORD      *records;
+    size_t                          count;
+    const char                     *strings;
+    size_t                          strings_length;
+} GKO_REGISTRY;
+/**********************************************************************************************************************
+    registry functions
+**********************************************************************************************************************/
+int                         gko_registry_read(const char *path, GRIP *grip, bool verbose);
+int                         gko_registry_save(const char *path, const GRIP *grip);
+int                         gko_registry_open(const char *dir, GKO_REGISTRY *reg);
+void                        gko_registry_close(GKO_REGISTRY *reg);
+int                         gko_registry_build(const char *dir, const GKO_REGISTRY *old);
+const GKO_REGISTRY_RECORD  *gko_registry_find(const GKO_REGISTRY *reg, const char *name);
+int                         gko_registry_lookup(const char *dir, const char *name, GRIP *grip);
+
+#endif  // __GEKKO_REGISTRY_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
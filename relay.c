@@ -0,0 +1,796 @@
+/**********************************************************************************************************************
+    file:           relay.c
+    description:    Chained replication, every host stores the stream and passes it on while it arrives
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "gekko.h"
+#include "bulk.h"
+#include "relay.h"
+/**********************************************************************************************************************
+    relay types
+**********************************************************************************************************************/
+typedef struct {
+    const char         *root;
+    char                header[GEKKO_TAR_BLOCK];
+    size_t              fill;               // header bytes gathered
+    uint64_t            left;               // member data still to come
+    size_t              pad;                // padding after the member data
+    int                 fd;                 // file being written, -1 to drop the data
+    bool                list;               // the data is the removal list of this host
+    int                 rest;               // hosts after this one, names the removal list meant for it
+    uint32_t            mode;
+    char                path[PATH_MAX];
+    char                full[PATH_MAX];     // path below the root
+    char                temp[PATH_MAX];
+    char               *names;
+    size_t              names_length;
+    size_t              names_capacity;
+    bool                ended;              // two zero blocks seen
+    bool                failed;
+    uint64_t            files;
+    uint64_t            bytes;
+    uint64_t            removed;
+} GKO_RELAY_SINK;
+/**********************************************************************************************************************
+    description:    Make a hop argument out of a grip connection
+    arguments:      hop:    buffer to store user@host:port
+                    size:   buffer size
+                    user:   user name
+                    host:   host name or address
+                    port:   port
+    return:         error code
+**********************************************************************************************************************/
+int gko_relay_hop(char *hop, size_t size, const char *user, const char *host, unsigned int port)
+{
+    int n = 0;
+
+    if (!hop || !user || !host) return GEKKO_ERROR;
+
+    // an IPv6 address keeps its colons apart from the port the way a connection string does
+    n = snprintf(hop, size, strchr(host, ':') ? "%s@[%s]:%u" : "%s@%s:%u", user, host, port);
+
+    return (n > 0 && (size_t)n < size) ? GEKKO_OK : GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Split a hop argument into an ssh destination and a port
+    arguments:      hop:    user@host:port
+                    target: buffer to store user@host
+                    size:   buffer size
+                    port:   port to store
+    return:         error code
+**********************************************************************************************************************/
+static int gko_relay_target(const char *hop, char *target, size_t size, unsigned int *port)
+{
+    const char *at      = strchr(hop, '@');
+    const char *host    = (at) ? at + 1 : hop;
+    const char *colon   = strrchr(hop, ':');
+    const char *end     = NULL;
+
+    if (!at || !colon || colon < host) return GEKKO_ERROR;
+
+    *port = (unsigned int)strtoul(colon + 1, NULL, 10);
+    if (!*port || *port > 65535) return GEKKO_ERROR;
+
+    if (*host == '[') {
+        end = strchr(host, ']');
+        if (!end || end + 1 != colon) return GEKKO_ERROR;
+        if (snprintf(target, size, "%.*s%.*s", (int)(host - hop), hop, (int)(end - host - 1), host + 1) >= (int)size) {
+            return GEKKO_ERROR;
+        }
+        return GEKKO_OK;
+    }
+
+    if (snprintf(target, size, "%.*s", (int)(colon - hop), hop) >= (int)size) return GEKKO_ERROR;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Build the command line that runs a relay, the gekko binary and every argument quoted
+    arguments:      line:   buffer to store
+                    size:   buffer size
+                    gekko:  gekko binary on the host
+                    root:   sync root on the host
+                    hops:   hops after the host
+                    count:  number of hops
+    return:         error code
+**********************************************************************************************************************/
+static int gko_relay_command(char *line, size_t size, const char *gekko, const char *root, char **hops, int count)
+{
+    char    quoted[PATH_MAX * 4 + 3]    = {0};
+    size_t  n                           = 0;
+    int     i                           = 0;
+
+    if (gko_shell_quote(quoted, sizeof(quoted), gekko) != GEKKO_OK) return GEKKO_ERROR;
+    n = (size_t)snprintf(line, size, "%s remote relay %s", quoted, quoted);
+    if (n >= size) return GEKKO_ERROR;
+
+    if (gko_shell_quote(quoted, sizeof(quoted), root) != GEKKO_OK) return GEKKO_ERROR;
+    n += (size_t)snprintf(line + n, size - n, " %s", quoted);
+    if (n >= size) return GEKKO_ERROR;
+
+    for (i = 0; i < count; i++) {
+        if (gko_shell_quote(quoted, sizeof(quoted), hops[i]) != GEKKO_OK) return GEKKO_ERROR;
+        n += (size_t)snprintf(line + n, size - n, " %s", quoted);
+        if (n >= size) return GEKKO_ERROR;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Start the relay of the next hop, the rest of the chain is its to reach
+    arguments:      gekko:  gekko binary, the same on every host
+                    root:   sync root, the same on every host
+                    hops:   hops left, the first one is started
+                    count:  number of hops
+                    to:     pipe into its stream to store
+                    from:   pipe from its report to store
+    return:         process id, -1 on error
+**********************************************************************************************************************/
+static pid_t gko_relay_spawn(const char *gekko, const char *root, char **hops, int count, int *to, int *from)
+{
+    const char     *ssh                                 = getenv(GEKKO_RELAY_SSH_ENV);
+    char            target[PATH_MAX]                    = {0};
+    char            quoted[PATH_MAX * 4 + 3]            = {0};
+    char            command[GEKKO_RELAY_COMMAND_MAX]    = {0};
+    char            line[GEKKO_RELAY_COMMAND_MAX * 2]   = {0};
+    char            remote[GEKKO_RELAY_COMMAND_MAX * 2] = {0};
+    unsigned int    port                                = 0;
+    int             in[2]                               = {-1, -1};
+    int             out[2]                              = {-1, -1};
+    pid_t           pid                                 = -1;
+
+    if (!ssh || !ssh[0]) ssh = GEKKO_RELAY_SSH;
+
+    if (gko_relay_target(hops[0], target, sizeof(target), &port) != GEKKO_OK) {
+        fprintf(stderr, "Invalid hop %s.\n", hops[0]);
+        return -1;
+    }
+
+    if (gko_relay_command(command, sizeof(command), gekko, root, hops + 1, count - 1) != GEKKO_OK ||
+        gko_shell_quote(remote, sizeof(remote), command) != GEKKO_OK ||
+        gko_shell_quote(quoted, sizeof(quoted), target) != GEKKO_OK ||
+        snprintf(line, sizeof(line), "%s -p %u %s %s", ssh, port, quoted, remote) >= (int)sizeof(line)) {
+        fprintf(stderr, "Relay command too long.\n");
+        return -1;
+    }
+
+    if (pipe(in) != GEKKO_OK) return -1;
+    if (pipe(out) != GEKKO_OK) {
+        close(in[0]);
+        close(in[1]);
+        return -1;
+    }
+
+    pid = fork();
+    if (pid == 0) {
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        close(in[0]);
+        close(in[1]);
+        close(out[0]);
+        close(out[1]);
+        execl("/bin/sh", "sh", "-c", line, (char *)NULL);
+        _exit(127);
+    }
+
+    close(in[0]);
+    close(out[1]);
+    if (pid < 0) {
+        close(in[1]);
+        close(out[0]);
+        return -1;
+    }
+
+    *to = in[1];
+    *from = out[0];
+
+    return pid;
+}
+/**********************************************************************************************************************
+    description:    Write all of a buffer to a descriptor
+    arguments:      fd:     descriptor
+                    data:   bytes
+                    len:    length
+    return:         error code
+**********************************************************************************************************************/
+static int gko_relay_write(int fd, const void *data, size_t len)
+{
+    ssize_t n = 0;
+
+    while (len) {
+        n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return GEKKO_ERROR;
+        data = (const char *)data + n;
+        len -= (size_t)n;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Check that a member path stays inside the sync root
+    arguments:      path:   relative path from the archive
+    return:         true or false
+**********************************************************************************************************************/
+static bool gko_relay_safe(const char *path)
+{
+    const char *p = path;
+
+    if (!path[0] || path[0] == '/') return false;
+
+    while (*p) {
+        if (p[0] == '.' && p[1] == '.' && (p[2] == '/' || p[2] == '\0')) return false;
+        p = strchr(p, '/');
+        if (!p) break;
+        p++;
+    }
+
+    return true;
+}
+/**********************************************************************************************************************
+    description:    Create the missing parents of a path below the sync root
+    arguments:      root:   sync root
+                    path:   relative path
+    return:         -
+**********************************************************************************************************************/
+static void gko_relay_parents(const char *root, const char *path)
+{
+    char        full[PATH_MAX]  = {0};
+    const char *slash           = path;
+
+    while ((slash = strchr(slash, '/'))) {
+        snprintf(full, sizeof(full), "%s/%.*s", root, (int)(slash - path), path);
+        mkdir(full, 0755);
+        slash++;
+    }
+}
+/**********************************************************************************************************************
+    description:    Remove a directory and everything below it
+    arguments:      parent: directory holding it, AT_FDCWD for a full path
+                    name:   directory name
+    return:         error code
+**********************************************************************************************************************/
+static int gko_relay_purge(int parent, const char *name)
+{
+    struct dirent  *ent = NULL;
+    DIR            *dir = NULL;
+    int             fd  = -1;
+    int             ret = GEKKO_OK;
+
+    fd = openat(parent, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return GEKKO_ERROR;
+
+    dir = fdopendir(fd);
+    if (!dir) {
+        close(fd);
+        return GEKKO_ERROR;
+    }
+
+    while (ret == GEKKO_OK && (ent = readdir(dir))) {
+        if (strcmp(ent->d_name, ".") == GEKKO_OK || strcmp(ent->d_name, "..") == GEKKO_OK) continue;
+        if (unlinkat(dirfd(dir), ent->d_name, 0) == GEKKO_OK) continue;
+        ret = (errno == EISDIR || errno == EPERM) ? gko_relay_purge(dirfd(dir), ent->d_name) : GEKKO_ERROR;
+    }
+    closedir(dir);
+
+    if (ret == GEKKO_OK && unlinkat(parent, name, AT_REMOVEDIR) != GEKKO_OK) ret = GEKKO_ERROR;
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Remove the paths of the removal list, they come deepest first
+    arguments:      sink:   relay sink
+    return:         -
+**********************************************************************************************************************/
+static void gko_relay_remove(GKO_RELAY_SINK *sink)
+{
+    char    full[PATH_MAX]  = {0};
+    size_t  i               = 0;
+
+    for (i = 0; i < sink->names_length; i += strlen(sink->names + i) + 1) {
+        if (!gko_relay_safe(sink->names + i)) {
+            sink->failed = true;
+            continue;
+        }
+
+        // a directory that became a file was emptied when the file arrived, its old children are gone already
+        snprintf(full, sizeof(full), "%s/%s", sink->root, sink->names + i);
+        if (unlink(full) == GEKKO_OK || errno == ENOENT || errno == ENOTDIR) {
+            sink->removed++;
+            continue;
+        }
+        if ((errno == EISDIR || errno == EPERM) && (rmdir(full) == GEKKO_OK || errno == ENOENT)) {
+            sink->removed++;
+            continue;
+        }
+
+        fprintf(stderr, "Cannot remove %s.\n", full);
+        sink->failed = true;
+    }
+}
+/**********************************************************************************************************************
+    description:    Check a member name against the removal lists, one per host named after the hosts behind it
+    arguments:      path:   member path
+                    rest:   hosts after the one the list is for to store
+    return:         true if the name is kept for a removal list
+**********************************************************************************************************************/
+static bool gko_relay_list_name(const char *path, int *rest)
+{
+    const size_t    len = strlen(GEKKO_RELAY_DELETE);
+    char           *end = NULL;
+    long            n   = 0;
+
+    if (strncmp(path, GEKKO_RELAY_DELETE, len) != GEKKO_OK) return false;
+    if (path[len] == '\0') {
+        *rest = -1;
+        return true;
+    }
+    if (path[len] != '.' || path[len + 1] < '0' || path[len + 1] > '9') return false;
+
+    n = strtol(path + len + 1, &end, 10);
+    *rest = (*end == '\0' && n <= GEKKO_RELAY_HOPS_MAX) ? (int)n : -1;
+
+    return true;
+}
+/**********************************************************************************************************************
+    description:    Start a member from its header
+    arguments:      sink:   relay sink, holds a complete header
+    return:         -
+**********************************************************************************************************************/
+static void gko_relay_member(GKO_RELAY_SINK *sink)
+{
+    GKO_TAR_HEADER *header                          = (GKO_TAR_HEADER *)sink->header;
+    unsigned char  *p                               = (unsigned char *)sink->header;
+    struct stat     st;
+    char            field[sizeof(header->size) + 1] = {0};
+    unsigned int    sum                             = 0;
+    size_t          i                               = 0;
+    size_t          len                             = 0;
+    int             rest                            = 0;
+
+    for (i = 0; i < GEKKO_TAR_BLOCK && !p[i]; i++) {}
+    if (i == GEKKO_TAR_BLOCK) {
+        sink->ended = true;
+        return;
+    }
+
+    for (i = 0; i < GEKKO_TAR_BLOCK; i++) {
+        sum += (i >= offsetof(GKO_TAR_HEADER, chksum) && i < offsetof(GKO_TAR_HEADER, typeflag)) ? ' ' : p[i];
+    }
+    memcpy(field, header->chksum, sizeof(header->chksum));
+    if (memcmp(header->magic, "ustar", 5) != 0 || strtoul(field, NULL, 8) != sum) {
+        fprintf(stderr, "Corrupt relay stream.\n");
+        sink->failed = true;
+        sink->ended = true;
+        return;
+    }
+
+    memcpy(field, header->size, sizeof(header->size));
+    sink->left = strtoull(field, NULL, 8);
+    sink->pad = (size_t)((GEKKO_TAR_BLOCK - sink->left % GEKKO_TAR_BLOCK) % GEKKO_TAR_BLOCK);
+    memset(field, 0, sizeof(field));
+    memcpy(field, header->mode, sizeof(header->mode));
+    sink->mode = (uint32_t)strtoul(field, NULL, 8) & 07777;
+    sink->fd = -1;
+    sink->list = false;
+
+    if (header->prefix[0]) {
+        snprintf(sink->path, sizeof(sink->path), "%.*s/%.*s", (int)strnlen(header->prefix, sizeof(header->prefix)),
+                 header->prefix, (int)strnlen(header->name, sizeof(header->name)), header->name);
+    } else {
+        snprintf(sink->path, sizeof(sink->path), "%.*s", (int)strnlen(header->name, sizeof(header->name)),
+                 header->name);
+    }
+
+    // tar tools name directories with a trailing slash, the entry itself is meant
+    for (len = strlen(sink->path); len > 1 && sink->path[len - 1] == '/'; len--) sink->path[len - 1] = '\0';
+
+    // a removal list is told apart by its typeflag, a file of the same name is never read as one; every host
+    // only applies its own, what one snapshot lost may be untracked and kept on another host
+    if (header->typeflag == GEKKO_RELAY_DELETE_TYPE) {
+        if (!gko_relay_list_name(sink->path, &rest) || rest < 0) {
+            fprintf(stderr, "Corrupt relay stream.\n");
+            sink->failed = true;
+            sink->ended = true;
+            return;
+        }
+        sink->list = (rest == sink->rest);
+        return;
+    }
+
+    if (gko_relay_list_name(sink->path, &rest)) {
+        fprintf(stderr, "Refused %s, the name is kept for removal lists.\n", sink->path);
+        sink->failed = true;
+        return;
+    }
+
+    if (!gko_relay_safe(sink->path)) {
+        fprintf(stderr, "Refused %s, outside the sync root.\n", sink->path);
+        sink->failed = true;
+        return;
+    }
+
+    if (snprintf(sink->full, sizeof(sink->full), "%s/%s", sink->root, sink->path) >= (int)sizeof(sink->full)) {
+        fprintf(stderr, "Refused %s, path too long.\n", sink->path);
+        sink->failed = true;
+        return;
+    }
+    gko_relay_parents(sink->root, sink->path);
+
+    if (header->typeflag == GEKKO_TAR_DIR) {
+        // a file where the directory goes has changed type, an existing entry only counts if it is a directory
+        if (lstat(sink->full, &st) == GEKKO_OK && !S_ISDIR(st.st_mode) && unlink(sink->full) != GEKKO_OK) {
+            fprintf(stderr, "Cannot remove %s.\n", sink->full);
+            sink->failed = true;
+            return;
+        }
+        if (mkdir(sink->full, sink->mode) != GEKKO_OK && errno != EEXIST) {
+            fprintf(stderr, "Cannot create directory %s.\n", sink->full);
+            sink->failed = true;
+        }
+        return;
+    }
+
+    if (header->typeflag != GEKKO_TAR_FILE && header->typeflag != '\0') return;
+
+    // the old copy stays readable until the new one is complete
+    if (snprintf(sink->temp, sizeof(sink->temp), "%s.gekko-XXXXXX", sink->full) < (int)sizeof(sink->temp)) {
+        sink->fd = mkstemp(sink->temp);
+    }
+    if (sink->fd < 0) {
+        fprintf(stderr, "Cannot create file %s.\n", sink->full);
+        sink->failed = true;
+    }
+}
+/**********************************************************************************************************************
+    description:    Settle a member whose data is complete
+    arguments:      sink:   relay sink
+    return:         -
+**********************************************************************************************************************/
+static void gko_relay_settle(GKO_RELAY_SINK *sink)
+{
+    struct stat st;
+    bool        ok  = true;
+
+    if (sink->list) {
+        gko_relay_remove(sink);
+        sink->names_length = 0;
+        sink->list = false;
+        return;
+    }
+
+    if (sink->fd < 0) return;
+
+    if (fchmod(sink->fd, sink->mode) != GEKKO_OK) ok = false;
+    if (close(sink->fd) != GEKKO_OK) ok = false;
+    sink->fd = -1;
+
+    // a directory where the file goes has changed type, it is emptied and removed to make way
+    if (ok && lstat(sink->full, &st) == GEKKO_OK && S_ISDIR(st.st_mode)) {
+        ok = (gko_relay_purge(AT_FDCWD, sink->full) == GEKKO_OK);
+    }
+
+    if (ok && rename(sink->temp, sink->full) == GEKKO_OK) {
+        sink->files++;
+        return;
+    }
+
+    fprintf(stderr, "Cannot write file %s.\n", sink->full);
+    unlink(sink->temp);
+    sink->failed = true;
+}
+/**********************************************************************************************************************
+    description:    Store a piece of the stream, members may start and end anywhere in it
+    arguments:      sink:   relay sink
+                    data:   bytes
+                    len:    length
+    return:         -
+**********************************************************************************************************************/
+static void gko_relay_store(GKO_RELAY_SINK *sink, const uint8_t *data, size_t len)
+{
+    char   *grown   = NULL;
+    size_t  n       = 0;
+
+    while (len && !sink->ended) {
+        if (sink->left) {
+            n = (sink->left < len) ? (size_t)sink->left : len;
+
+            if (sink->list) {
+                if (sink->names_length + n + 1 > sink->names_capacity) {
+                    sink->names_capacity = (sink->names_length + n + 1) * 2;
+                    grown = (char *)realloc(sink->names, sink->names_capacity);
+                    if (!grown) {
+                        fprintf(stderr, "Insufficient memory.\n");
+                        sink->failed = true;
+                        sink->ended = true;
+                        return;
+                    }
+                    sink->names = grown;
+                }
+                memcpy(sink->names + sink->names_length, data, n);
+                sink->names_length += n;
+                sink->names[sink->names_length] = '\0';
+            } else if (sink->fd >= 0 && gko_relay_write(sink->fd, data, n) != GEKKO_OK) {
+                fprintf(stderr, "Cannot write file %s.\n", sink->full);
+                close(sink->fd);
+                unlink(sink->temp);
+                sink->fd = -1;
+                sink->failed = true;
+            }
+
+            sink->bytes += n;
+            sink->left -= n;
+            data += n;
+            len -= n;
+            if (!sink->left) gko_relay_settle(sink);
+            continue;
+        }
+
+        if (sink->pad) {
+            n = (sink->pad < len) ? sink->pad : len;
+            sink->pad -= n;
+            data += n;
+            len -= n;
+            continue;
+        }
+
+        n = GEKKO_TAR_BLOCK - sink->fill;
+        if (n > len) n = len;
+        memcpy(sink->header + sink->fill, data, n);
+        sink->fill += n;
+        data += n;
+        len -= n;
+
+        if (sink->fill < GEKKO_TAR_BLOCK) continue;
+        sink->fill = 0;
+        gko_relay_member(sink);
+        if (!sink->left) gko_relay_settle(sink);
+    }
+}
+/**********************************************************************************************************************
+    description:    Relay end of a chain, stores the stream on stdin under the root and passes it to the next hop
+                    as it arrives. The report on stdout has one line for this host, then one for each host after it.
+    arguments:      in:     stream from the previous hop
+                    out:    report to the previous hop
+                    gekko:  gekko binary, the same on every host
+                    root:   sync root, the same on every host
+                    hops:   user@host:port of the hosts after this one, in chain order
+                    count:  number of hops
+    return:         error code, any host of the rest of the chain failing fails this one too
+**********************************************************************************************************************/
+int gko_relay_serve(int in, int out, const char *gekko, const char *root, char **hops, int count)
+{
+    GKO_RELAY_SINK      sink;
+    struct sigaction    sa;
+    char                report[GEKKO_RELAY_REPORT]  = {0};
+    char                line[128]                   = {0};
+    uint8_t            *buffer                      = NULL;
+    size_t              fill                        = 0;
+    ssize_t             n                           = 0;
+    pid_t               pid                         = -1;
+    int                 to                          = -1;
+    int                 from                        = -1;
+    int                 status                      = 0;
+    bool                forward                     = false;
+
+    if (!gekko || !root) return GEKKO_ERROR;
+    if (count < 0 || count > GEKKO_RELAY_HOPS_MAX) return GEKKO_ERROR;
+
+    memset(&sink, 0, sizeof(sink));
+    sink.root = root;
+    sink.rest = count;
+    sink.fd = -1;
+
+    buffer = (uint8_t *)malloc(GEKKO_RELAY_BUFFER);
+    if (!buffer) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    // a hop that goes away must not take this one down, it still stores its copy
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+
+    if (count) pid = gko_relay_spawn(gekko, root, hops, count, &to, &from);
+    forward = (pid > 0);
+
+    // the next hop gets every piece before it is stored here, the chain moves at the pace of its slowest link
+    while ((n = read(in, buffer, GEKKO_RELAY_BUFFER)) != 0) {
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) break;
+
+        if (forward && gko_relay_write(to, buffer, (size_t)n) != GEKKO_OK) {
+            fprintf(stderr, "Lost the relay to %s.\n", hops[0]);
+            forward = false;
+        }
+        gko_relay_store(&sink, buffer, (size_t)n);
+    }
+
+    if (n < 0 || !sink.ended || sink.left || sink.fd >= 0) {
+        fprintf(stderr, "Relay stream cut short.\n");
+        if (sink.fd >= 0) {
+            close(sink.fd);
+            unlink(sink.temp);
+        }
+        sink.failed = true;
+    }
+
+    if (to >= 0) close(to);
+    if (from >= 0) {
+        while (fill < sizeof(report) - 1 && (n = read(from, report + fill, sizeof(report) - 1 - fill)) != 0) {
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) break;
+            fill += (size_t)n;
+        }
+        close(from);
+    }
+    if (pid > 0 && (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status))) forward = false;
+    if (count && !forward) sink.failed = true;
+
+    snprintf(line, sizeof(line), "%s %llu %llu %llu\n", (sink.failed) ? "failed" : "ok",
+             (unsigned long long)sink.files, (unsigned long long)sink.bytes, (unsigned long long)sink.removed);
+    gko_relay_write(out, line, strlen(line));
+    gko_relay_write(out, report, fill);
+
+    free(sink.names);
+    free(buffer);
+
+    return (sink.failed) ? GEKKO_ERROR : GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Push the dirty entries and the removal list down a chain of hosts through its first one,
+                    the uplink carries the tree once however long the chain is
+    arguments:      xfer:           transfer context on the first host
+                    scan:           local scan, dirty entries are sent
+                    hops:           user@host:port of the hosts after the first one, in chain order
+                    count:          number of hops
+                    removed:        count + 1 lists of remote paths to remove, one per host, deepest first
+                    removed_count:  number of paths in each list
+                    results:        count + 1 results to store, the first host first
+    return:         error code
+**********************************************************************************************************************/
+int gko_relay_push(GKO_TRANSFER *xfer, const GKO_SCAN *scan, const char **hops, int count, const char ***removed,
+                   const size_t *removed_count, GKO_RELAY_RESULT *results)
+{
+    GKO_BULK_STREAM     stream;
+    struct timespec     begin, end;
+    char                line[GEKKO_RELAY_COMMAND_MAX]   = {0};
+    char                report[GEKKO_RELAY_REPORT]      = {0};
+    char                state[8]                        = {0};
+    char                name[sizeof(GEKKO_RELAY_DELETE) + 16] = {0};
+    const GKO_ENTRY    *entry                           = NULL;
+    char               *cursor                          = NULL;
+    uint64_t            length                          = 0;
+    uint64_t            files                           = 0;
+    uint64_t            bytes                           = 0;
+    double              elapsed                         = 0;
+    size_t              fill                            = 0;
+    size_t              i                               = 0;
+    ssize_t             n                               = 0;
+    int                 status                          = -1;
+    int                 ret                             = GEKKO_ERROR;
+    int                 h                               = 0;
+    bool                ok                              = true;
+
+    if (!xfer) return GEKKO_ERROR;
+    if (!scan) return GEKKO_ERROR;
+    if (!results) return GEKKO_ERROR;
+    if (!removed || !removed_count) return GEKKO_ERROR;
+    if (count < 0 || count > GEKKO_RELAY_HOPS_MAX) return GEKKO_ERROR;
+
+    memset(results, 0, (count + 1) * sizeof(GKO_RELAY_RESULT));
+
+    if (gko_relay_command(line, sizeof(line), xfer->gekko, xfer->remote, (char **)hops, count) != GEKKO_OK) {
+        fprintf(stderr, "Relay command too long.\n");
+        return GEKKO_ERROR;
+    }
+
+    memset(&stream, 0, sizeof(stream));
+    stream.rate = xfer->rate;
+    stream.cls = GKO_RATE_BULK;
+    stream.buffer = (char *)malloc(GEKKO_BULK_BUFFER);
+    if (!stream.buffer) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    stream.channel = gko_channel_exec(xfer->session, line);
+    if (!stream.channel) {
+        fprintf(stderr, "Cannot run %s on remote.\n", line);
+        free(stream.buffer);
+        return GEKKO_ERROR;
+    }
+
+    // the scan is in path order, a directory always arrives before what it holds
+    for (i = 0; ok && i < scan->count; i++) {
+        entry = &scan->entries[i];
+        if (!(entry->flags & GKO_ENTRY_DIRTY)) continue;
+
+        if (S_ISDIR(entry->mode)) {
+            ok = (gko_bulk_header(&stream, entry->path, entry->mode, 0, entry->mtime_ns / 1000000000LL,
+                                  GEKKO_TAR_DIR) == GEKKO_OK);
+        } else if (S_ISREG(entry->mode)) {
+            ok = (gko_bulk_file(&stream, xfer->rootfd, entry) == GEKKO_OK);
+            files++;
+            bytes += entry->size;
+        }
+        if (!ok) fprintf(stderr, "Cannot relay %s.\n", entry->path);
+    }
+
+    // a list is named after the hosts behind the one it is for, every host knows that number
+    for (h = 0; ok && h <= count; h++) {
+        if (!removed_count[h]) continue;
+
+        snprintf(name, sizeof(name), "%s.%d", GEKKO_RELAY_DELETE, count - h);
+        for (i = 0, length = 0; i < removed_count[h]; i++) length += strlen(removed[h][i]) + 1;
+
+        ok = (gko_bulk_header(&stream, name, 0600, length, 0, GEKKO_RELAY_DELETE_TYPE) == GEKKO_OK);
+        for (i = 0; ok && i < removed_count[h]; i++) {
+            ok = (gko_bulk_write(&stream, removed[h][i], strlen(removed[h][i]) + 1) == GEKKO_OK);
+        }
+        if (ok) ok = (gko_bulk_write(&stream, NULL, (GEKKO_TAR_BLOCK - length % GEKKO_TAR_BLOCK) % GEKKO_TAR_BLOCK) ==
+                      GEKKO_OK);
+    }
+
+    // two zero blocks end the archive
+    if (ok && gko_bulk_write(&stream, NULL, GEKKO_TAR_BLOCK * 2) == GEKKO_OK &&
+        gko_bulk_flush(&stream) == GEKKO_OK) {
+        ret = GEKKO_OK;
+    }
+
+    // the report comes once the whole chain is through
+    libssh2_channel_send_eof(stream.channel);
+    while (fill < sizeof(report) - 1 &&
+           (n = libssh2_channel_read(stream.channel, report + fill, sizeof(report) - 1 - fill)) > 0) {
+        fill += (size_t)n;
+    }
+    libssh2_channel_wait_eof(stream.channel);
+    libssh2_channel_close(stream.channel);
+    libssh2_channel_wait_closed(stream.channel);
+    status = libssh2_channel_get_exit_status(stream.channel);
+    libssh2_channel_free(stream.channel);
+    free(stream.buffer);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    for (cursor = report, h = 0; h <= count && *cursor; h++) {
+        if (sscanf(cursor, "%7s %llu %llu %llu", state, (unsigned long long *)&results[h].files,
+                   (unsigned long long *)&results[h].bytes, (unsigned long long *)&results[h].removed) != 4) break;
+        results[h].done = (strcmp(state, "ok") == GEKKO_OK);
+
+        cursor = strchr(cursor, '\n');
+        if (!cursor) break;
+        cursor++;
+    }
+
+    xfer->files += files;
+    xfer->bytes += bytes;
+    xfer->sent  += stream.total;
+
+    printf("relay: %llu files, %llu bytes through %d hosts in %.3f s (%.1f MB/s).\n", (unsigned long long)files,
+           (unsigned long long)bytes, count + 1, elapsed, (elapsed > 0) ? stream.total / elapsed / 1e6 : 0.0);
+
+    return (ret == GEKKO_OK && status == 0) ? GEKKO_OK : GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,47 @@
+/**********************************************************************************************************************
+    file:           relay.h
+    description:    Chained replication, every host stores the stream and passes it on while it arrives
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_RELAY_H
+#define __GEKKO_RELAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "scan.h"
+#include "transfer.h"
+/**********************************************************************************************************************
+    relay defaults
+**********************************************************************************************************************/
+#define GEKKO_RELAY_HOPS_MAX            (64)
+#define GEKKO_RELAY_SSH                 "ssh -o BatchMode=yes"  // a relay reaches the next hop with its own keys
+#define GEKKO_RELAY_SSH_ENV             "GEKKO_RELAY_SSH"       // replaces the command above on a relay
+#define GEKKO_RELAY_DELETE              ".gekko-delete"         // paths one host removes, .<hosts after it> added
+#define GEKKO_RELAY_DELETE_TYPE         'Z'                     // its typeflag, a vendor letter tar leaves unused
+#define GEKKO_RELAY_BUFFER              (1 << 16)
+#define GEKKO_RELAY_REPORT              (64 * GEKKO_RELAY_HOPS_MAX)
+#define GEKKO_RELAY_COMMAND_MAX         (GEKKO_TRANSFER_COMMAND_MAX * 4)
+/**********************************************************************************************************************
+    what one host of the chain reported
+**********************************************************************************************************************/
+typedef struct {
+    bool                done;
+    uint64_t            files;
+    uint64_t            bytes;
+    uint64_t            removed;
+} GKO_RELAY_RESULT;
+/**********************************************************************************************************************
+    relay functions
+**********************************************************************************************************************/
+int gko_relay_hop(char *hop, size_t size, const char *user, const char *host, unsigned int port);
+int gko_relay_push(GKO_TRANSFER *xfer, const GKO_SCAN *scan, const char **hops, int count, const char ***removed,
+                   const size_t *removed_count, GKO_RELAY_RESULT *results);
+int gko_relay_serve(int in, int out, const char *gekko, const char *root, char **hops, int count);
+
+#endif  // __GEKKO_RELAY_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
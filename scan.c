@@ -0,0 +1,593 @@
+/**********************************************************************************************************************
+    file:           scan.c
+    description:    Parallel local tree scanner of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "gekko.h"
+#include "scan.h"
+/**********************************************************************************************************************
+    scanner types
+**********************************************************************************************************************/
+typedef struct GKO_ARENA {
+    struct GKO_ARENA       *next;
+    size_t                  used;
+    size_t                  size;
+    char                    data[1];
+} GKO_ARENA;
+
+typedef struct GKO_SCAN_DIR {
+    struct GKO_SCAN_DIR    *parent;
+    DIR                    *dir;
+    int                     refs;
+    const char             *path;
+    size_t                  len;
+    const char             *name;
+    size_t                  nstates;
+    uint32_t                states[1];      // live ignore rule nodes of this directory
+} GKO_SCAN_DIR;
+
+typedef struct {
+    pthread_mutex_t         lock;
+    GKO_SCAN_DIR          **jobs;
+    size_t                  top;
+    size_t                  bottom;
+    size_t                  capacity;
+} GKO_DEQUE;
+
+struct GKO_SCAN_CTX;
+
+typedef struct {
+    struct GKO_SCAN_CTX    *ctx;
+    pthread_t               thread;
+    GKO_DEQUE               deque;
+    GKO_ENTRY              *entries;
+    size_t                  count;
+    size_t                  capacity;
+    GKO_ARENA              *arena;
+    uint32_t               *scratch;
+    size_t                  ignored;
+    unsigned int            seed;
+} GKO_SCAN_WORKER;
+
+typedef struct GKO_SCAN_CTX {
+    const char             *root;
+    const GKO_IGNORE       *ignore;
+    GKO_SCAN_WORKER        *workers;
+    int                     threads;
+    long                    pending;
+    int                     error;
+} GKO_SCAN_CTX;
+/**********************************************************************************************************************
+    description:    Copy "prefix/name" into arena
+    arguments:      head:   arena list of the calling worker
+                    prefix: parent path
+                    plen:   parent path length
+                    name:   entry name
+                    nlen:   entry name length
+    return:         pointer to copied string, NULL if out of memory
+**********************************************************************************************************************/
+static char *gko_arena_join(GKO_ARENA **head, const char *prefix, size_t plen, const char *name, size_t nlen)
+{
+    GKO_ARENA  *arena   = *head;
+    size_t      need    = plen + nlen + 2;
+    size_t      size    = GEKKO_SCAN_ARENA_CHUNK;
+    char       *str     = NULL;
+
+    if (!arena || arena->size - arena->used < need) {
+        if (need > size) size = need;
+
+        arena = (GKO_ARENA *)malloc(sizeof(GKO_ARENA) + size);
+        if (!arena) return NULL;
+
+        arena->next = *head;
+        arena->used = 0;
+        arena->size = size;
+        *head = arena;
+    }
+
+    str = arena->data + arena->used;
+    if (plen) {
+        memcpy(str, prefix, plen);
+        str[plen++] = '/';
+    }
+    memcpy(str + plen, name, nlen);
+    str[plen + nlen] = '\0';
+    arena->used += plen + nlen + 1;
+
+    return str;
+}
+/**********************************************************************************************************************
+    description:    Push directory job to the bottom of the owner's deque
+    arguments:      deque:  deque of the calling worker
+                    job:    directory job
+    return:         error code
+**********************************************************************************************************************/
+static int gko_deque_push(GKO_DEQUE *deque, GKO_SCAN_DIR *job)
+{
+    GKO_SCAN_DIR  **jobs    = NULL;
+    size_t          cap     = 0;
+
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->bottom == deque->capacity) {
+        if (deque->top) {
+            memmove(deque->jobs, deque->jobs + deque->top, (deque->bottom - deque->top) * sizeof(*jobs));
+            deque->bottom -= deque->top;
+            deque->top = 0;
+        } else {
+            cap = deque->capacity ? deque->capacity * 2 : 256;
+            jobs = (GKO_SCAN_DIR **)realloc(deque->jobs, cap * sizeof(*jobs));
+            if (!jobs) {
+                pthread_mutex_unlock(&deque->lock);
+                return GEKKO_ERROR;
+            }
+            deque->jobs = jobs;
+            deque->capacity = cap;
+        }
+    }
+
+    deque->jobs[deque->bottom++] = job;
+    pthread_mutex_unlock(&deque->lock);
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Pop directory job from the bottom (owner) or the top (thief) of a deque
+    arguments:      deque:  deque to take from
+                    steal:  take the oldest job instead of the newest
+    return:         directory job, NULL if the deque is empty
+**********************************************************************************************************************/
+static GKO_SCAN_DIR *gko_deque_take(GKO_DEQUE *deque, bool steal)
+{
+    GKO_SCAN_DIR   *job = NULL;
+
+    if (steal) {
+        if (pthread_mutex_trylock(&deque->lock) != 0) return NULL;
+    } else {
+        pthread_mutex_lock(&deque->lock);
+    }
+
+    if (deque->top != deque->bottom) {
+        job = (steal) ? deque->jobs[deque->top++] : deque->jobs[--deque->bottom];
+        if (deque->top == deque->bottom) deque->top = deque->bottom = 0;
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+
+    return job;
+}
+/**********************************************************************************************************************
+    description:    Drop a reference of directory job, closing the directory when nobody needs its fd anymore
+    arguments:      job:    directory job
+    return:         -
+**********************************************************************************************************************/
+static void gko_scan_dir_release(GKO_SCAN_DIR *job)
+{
+    if (__atomic_sub_fetch(&job->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+
+    if (job->dir) closedir(job->dir);
+    free(job);
+}
+/**********************************************************************************************************************
+    description:    Append an entry to the worker table
+    arguments:      worker: calling worker
+    return:         pointer to new entry, NULL if out of memory
+**********************************************************************************************************************/
+static GKO_ENTRY *gko_scan_add(GKO_SCAN_WORKER *worker)
+{
+    GKO_ENTRY  *entries = NULL;
+    size_t      cap     = 0;
+
+    if (worker->count == worker->capacity) {
+        cap = worker->capacity ? worker->capacity * 2 : 4096;
+        entries = (GKO_ENTRY *)realloc(worker->entries, cap * sizeof(GKO_ENTRY));
+        if (!entries) return NULL;
+        worker->entries = entries;
+        worker->capacity = cap;
+    }
+
+    return &worker->entries[worker->count++];
+}
+/**********************************************************************************************************************
+    description:    Read one directory, record its entries and queue its sub-directories
+    arguments:      worker: calling worker
+                    job:    directory job
+    return:         error code
+**********************************************************************************************************************/
+static int gko_scan_dir(GKO_SCAN_WORKER *worker, GKO_SCAN_DIR *job)
+{
+    GKO_SCAN_CTX   *ctx     = worker->ctx;
+    GKO_SCAN_DIR   *child   = NULL;
+    GKO_ENTRY      *entry   = NULL;
+    struct dirent  *ent     = NULL;
+    struct stat     st;
+    char           *path    = NULL;
+    size_t          nlen    = 0;
+    size_t          nstates = 0;
+    int             fd      = -1;
+    int             ret     = GEKKO_OK;
+
+    if (job->parent) {
+        fd = openat(dirfd(job->parent->dir), job->name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        gko_scan_dir_release(job->parent);
+        job->parent = NULL;
+    } else {
+        fd = open(ctx->root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+
+    // a directory removed or replaced since it was listed is simply gone, the next scan picks up what replaced it
+    if (fd < 0 && job->len && (errno == ENOENT || errno == ENOTDIR)) return GEKKO_OK;
+
+    // any other subtree left out would read as deleted and be removed from the remote, the whole scan fails instead
+    if (fd < 0 || !(job->dir = fdopendir(fd))) {
+        fprintf(stderr, "Cannot open directory: %s (%s).\n", job->len ? job->path : ctx->root, strerror(errno));
+        if (fd >= 0) close(fd);
+        return GEKKO_ERROR;
+    }
+
+    while ((ent = readdir(job->dir))) {
+        if (ent->d_name[0] == '.') {
+            if (ent->d_name[1] == '\0') continue;
+            if (ent->d_name[1] == '.' && ent->d_name[2] == '\0') continue;
+            if (!job->len && strcmp(ent->d_name, ".gekko") == GEKKO_OK) continue;
+        }
+
+        if (fstatat(dirfd(job->dir), ent->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            if (errno == ENOENT || errno == ENOTDIR) continue;
+            fprintf(stderr, "Cannot stat %s%s%s (%s).\n", job->len ? job->path : "", job->len ? "/" : "",
+                    ent->d_name, strerror(errno));
+            ret = GEKKO_ERROR;
+            break;
+        }
+
+        nlen = strlen(ent->d_name);
+
+        // an ignored directory is never opened, nothing below it is looked at
+        if (ctx->ignore && gko_ignore_next(ctx->ignore, job->states, job->nstates, ent->d_name, nlen,
+                                           S_ISDIR(st.st_mode), worker->scratch, &nstates)) {
+            worker->ignored++;
+            continue;
+        }
+
+        path = gko_arena_join(&worker->arena, job->path, job->len, ent->d_name, nlen);
+        entry = gko_scan_add(worker);
+        if (!path || !entry) {
+            ret = GEKKO_ERROR;
+            break;
+        }
+
+        entry->path     = path;
+        entry->size     = (uint64_t)st.st_size;
+        entry->mtime_ns = GKO_STAT_MTIME_NS(&st);
+        entry->ctime_ns = GKO_STAT_CTIME_NS(&st);
+        entry->mode     = (uint32_t)st.st_mode;
+        entry->flags    = 0;
+        entry->inode    = (uint64_t)st.st_ino;
+        entry->dev      = (uint64_t)st.st_dev;
+        entry->hash     = 0;
+
+        if (!S_ISDIR(st.st_mode)) continue;
+
+        child = (GKO_SCAN_DIR *)malloc(sizeof(GKO_SCAN_DIR) + nstates * sizeof(uint32_t));
+        if (!child) {
+            ret = GEKKO_ERROR;
+            break;
+        }
+
+        child->parent  = job;
+        child->dir     = NULL;
+        child->refs    = 1;
+        child->path    = path;
+        child->len     = (job->len ? job->len + 1 : 0) + nlen;
+        child->name    = path + child->len - nlen;
+        child->nstates = (ctx->ignore) ? nstates : 0;
+        if (child->nstates) memcpy(child->states, worker->scratch, nstates * sizeof(uint32_t));
+
+        __atomic_add_fetch(&job->refs, 1, __ATOMIC_ACQ_REL);
+        __atomic_add_fetch(&ctx->pending, 1, __ATOMIC_ACQ_REL);
+
+        if (gko_deque_push(&worker->deque, child) != GEKKO_OK) {
+            __atomic_sub_fetch(&ctx->pending, 1, __ATOMIC_ACQ_REL);
+            gko_scan_dir_release(job);
+            free(child);
+            ret = GEKKO_ERROR;
+            break;
+        }
+    }
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Compare two entries by path
+    arguments:      a:      entry
+                    b:      entry
+    return:         strcmp result
+**********************************************************************************************************************/
+static int gko_entry_cmp(const void *a, const void *b)
+{
+    return strcmp(((const GKO_ENTRY *)a)->path, ((const GKO_ENTRY *)b)->path);
+}
+/**********************************************************************************************************************
+    description:    Scanner worker thread, works its own deque and steals from others when it runs dry
+    arguments:      arg:    worker
+    return:         NULL
+**********************************************************************************************************************/
+static void *gko_scan_worker(void *arg)
+{
+    GKO_SCAN_WORKER    *worker  = (GKO_SCAN_WORKER *)arg;
+    GKO_SCAN_CTX       *ctx     = worker->ctx;
+    GKO_SCAN_DIR       *job     = NULL;
+    struct timespec     nap     = {0, 50000};
+    int                 idle    = 0;
+    int                 victim  = 0;
+    int                 i       = 0;
+
+    for (;;) {
+        job = gko_deque_take(&worker->deque, false);
+
+        for (i = 0; !job && i < ctx->threads; i++) {
+            victim = (int)(rand_r(&worker->seed) % (unsigned int)ctx->threads);
+            if (&ctx->workers[victim] == worker) continue;
+            job = gko_deque_take(&ctx->workers[victim].deque, true);
+        }
+
+        if (!job) {
+            if (__atomic_load_n(&ctx->pending, __ATOMIC_ACQUIRE) == 0) break;
+            if (++idle < 64) {
+                sched_yield();
+            } else {
+                nanosleep(&nap, NULL);
+            }
+            continue;
+        }
+
+        idle = 0;
+        if (gko_scan_dir(worker, job) != GEKKO_OK) {
+            __atomic_store_n(&ctx->error, 1, __ATOMIC_RELEASE);
+        }
+        gko_scan_dir_release(job);
+        __atomic_sub_fetch(&ctx->pending, 1, __ATOMIC_ACQ_REL);
+    }
+
+    qsort(worker->entries, worker->count, sizeof(GKO_ENTRY), gko_entry_cmp);
+
+    return NULL;
+}
+/**********************************************************************************************************************
+    description:    Merge sorted per-worker tables into one sorted table
+    arguments:      ctx:    scanner context
+                    scan:   scan result to fill
+    return:         error code
+**********************************************************************************************************************/
+static int gko_scan_merge(GKO_SCAN_CTX *ctx, GKO_SCAN *scan)
+{
+    size_t         *cursor  = NULL;
+    int            *heap    = NULL;
+    size_t          total   = 0;
+    size_t          out     = 0;
+    int             size    = 0;
+    int             i, c, p, tmp;
+
+#define gko_heap_less(x, y) \
+    (strcmp(ctx->workers[x].entries[cursor[x]].path, ctx->workers[y].entries[cursor[y]].path) < 0)
+
+    for (i = 0; i < ctx->threads; i++) total += ctx->workers[i].count;
+
+    scan->count = 0;
+    scan->entries = (GKO_ENTRY *)malloc((total ? total : 1) * sizeof(GKO_ENTRY));
+    cursor = (size_t *)zalloc(ctx->threads * sizeof(size_t));
+    heap = (int *)zalloc(ctx->threads * sizeof(int));
+    if (!scan->entries || !cursor || !heap) {
+        free(cursor);
+        free(heap);
+        return GEKKO_ERROR;
+    }
+
+    for (i = 0; i < ctx->threads; i++) {
+        if (!ctx->workers[i].count) continue;
+
+        heap[size] = i;
+        for (c = size++; c > 0 && gko_heap_less(heap[c], heap[(c - 1) / 2]); c = p) {
+            p = (c - 1) / 2;
+            tmp = heap[c]; heap[c] = heap[p]; heap[p] = tmp;
+        }
+    }
+
+    while (size) {
+        i = heap[0];
+        scan->entries[out++] = ctx->workers[i].entries[cursor[i]++];
+
+        if (cursor[i] == ctx->workers[i].count) heap[0] = heap[--size];
+
+        for (p = 0; (c = 2 * p + 1) < size; p = c) {
+            if (c + 1 < size && gko_heap_less(heap[c + 1], heap[c])) c++;
+            if (!gko_heap_less(heap[c], heap[p])) break;
+            tmp = heap[c]; heap[c] = heap[p]; heap[p] = tmp;
+        }
+    }
+
+#undef gko_heap_less
+
+    scan->count = out;
+    free(cursor);
+    free(heap);
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Scan a local tree with a pool of work-stealing threads
+    arguments:      root:       root directory to scan
+                    threads:    worker count, 0 for one per online CPU
+                    ignore:     ignore rules relative to root, NULL for none
+                    scan:       scan result, release with gko_scan_free()
+    return:         error code
+**********************************************************************************************************************/
+int gko_scan(const char *root, int threads, const GKO_IGNORE *ignore, GKO_SCAN *scan)
+{
+    GKO_SCAN_CTX        ctx;
+    GKO_SCAN_DIR       *job     = NULL;
+    GKO_ARENA          *arena   = NULL;
+    struct timespec     begin, end;
+    size_t              width   = 0;
+    int                 started = 0;
+    int                 ret     = GEKKO_ERROR;
+    int                 i       = 0;
+
+    if (!root) return GEKKO_ERROR;
+    if (!scan) return GEKKO_ERROR;
+
+    memset(scan, 0, sizeof(GKO_SCAN));
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    if (threads > GEKKO_SCAN_THREADS_MAX) threads = GEKKO_SCAN_THREADS_MAX;
+
+    if (ignore && ignore->rules) width = gko_ignore_width(ignore);
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.root    = root;
+    ctx.ignore  = (width) ? ignore : NULL;
+    ctx.threads = threads;
+    ctx.pending = 1;
+    ctx.workers = (GKO_SCAN_WORKER *)zalloc(threads * sizeof(GKO_SCAN_WORKER));
+    job = (GKO_SCAN_DIR *)zalloc(sizeof(GKO_SCAN_DIR) + width * sizeof(uint32_t));
+    if (!ctx.workers || !job) {
+        fprintf(stderr, "Insufficient memory.\n");
+        free(ctx.workers);
+        free(job);
+        return GEKKO_ERROR;
+    }
+
+    job->refs    = 1;
+    job->path    = "";
+    job->nstates = gko_ignore_root(ctx.ignore, job->states);
+
+    for (i = 0; i < threads; i++) {
+        ctx.workers[i].ctx  = &ctx;
+        ctx.workers[i].seed = (unsigned int)i * 2654435761u + 1;
+        pthread_mutex_init(&ctx.workers[i].deque.lock, NULL);
+    }
+
+    for (i = 0; i < threads && width; i++) {
+        ctx.workers[i].scratch = (uint32_t *)malloc(width * sizeof(uint32_t));
+        if (!ctx.workers[i].scratch) {
+            fprintf(stderr, "Insufficient memory.\n");
+            gko_scan_dir_release(job);
+            goto __error_threads;
+        }
+    }
+
+    gko_deque_push(&ctx.workers[0].deque, job);
+
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&ctx.workers[i].thread, NULL, gko_scan_worker, &ctx.workers[i]) != 0) break;
+        started++;
+    }
+
+    if (!started) {
+        fprintf(stderr, "Cannot start scanner threads.\n");
+        gko_scan_dir_release(job);
+        goto __error_threads;
+    }
+
+    for (i = 0; i < started; i++) {
+        pthread_join(ctx.workers[i].thread, NULL);
+    }
+
+    if (ctx.error) {
+        fprintf(stderr, "Failed to scan %s.\n", root);
+        goto __error_threads;
+    }
+
+    ret = gko_scan_merge(&ctx, scan);
+
+__error_threads:
+    for (i = 0; i < threads; i++) {
+        while (ctx.workers[i].arena) {
+            arena = ctx.workers[i].arena;
+            ctx.workers[i].arena = arena->next;
+            arena->next = (GKO_ARENA *)scan->arenas;
+            scan->arenas = arena;
+        }
+        scan->ignored += ctx.workers[i].ignored;
+        free(ctx.workers[i].entries);
+        free(ctx.workers[i].scratch);
+        free(ctx.workers[i].deque.jobs);
+        pthread_mutex_destroy(&ctx.workers[i].deque.lock);
+    }
+    free(ctx.workers);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    scan->threads = started;
+    scan->elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    if (ret != GEKKO_OK) gko_scan_free(scan);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Copy "prefix/name" into the string arenas of a scan built by hand
+    arguments:      scan:   scan result
+                    prefix: parent path
+                    plen:   parent path length, 0 for an entry of the root
+                    name:   entry name
+                    nlen:   entry name length
+    return:         pointer to copied string, released by gko_scan_free(), NULL if out of memory
+**********************************************************************************************************************/
+char *gko_scan_join(GKO_SCAN *scan, const char *prefix, size_t plen, const char *name, size_t nlen)
+{
+    if (!scan) return NULL;
+
+    return gko_arena_join((GKO_ARENA **)&scan->arenas, prefix, plen, name, nlen);
+}
+/**********************************************************************************************************************
+    description:    Sort entries of a scan built by hand by path
+    arguments:      scan:   scan result
+    return:         -
+**********************************************************************************************************************/
+void gko_scan_sort(GKO_SCAN *scan)
+{
+    if (!scan || !scan->count) return;
+
+    qsort(scan->entries, scan->count, sizeof(GKO_ENTRY), gko_entry_cmp);
+}
+/**********************************************************************************************************************
+    description:    Release scan result
+    arguments:      scan:   scan result
+    return:         -
+**********************************************************************************************************************/
+void gko_scan_free(GKO_SCAN *scan)
+{
+    GKO_ARENA  *arena   = NULL;
+
+    if (!scan) return;
+
+    while (scan->arenas) {
+        arena = (GKO_ARENA *)scan->arenas;
+        scan->arenas = arena->next;
+        free(arena);
+    }
+
+    free(scan->entries);
+    scan->entries = NULL;
+    scan->count = 0;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,71 @@
+/**********************************************************************************************************************
+    file:           scan.h
+    description:    Parallel local tree scanner of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_SCAN_H
+#define __GEKKO_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ignore.h"
+/**********************************************************************************************************************
+    scanner defaults
+**********************************************************************************************************************/
+#define GEKKO_SCAN_THREADS_MAX          (64)
+#define GEKKO_SCAN_ARENA_CHUNK          (1 << 20)
+/**********************************************************************************************************************
+    stat timestamps in nanoseconds
+**********************************************************************************************************************/
+#ifdef DARWIN
+#define GKO_STAT_MTIME_NS(st)           ((int64_t)(st)->st_mtimespec.tv_sec * 1000000000LL + (st)->st_mtimespec.tv_nsec)
+#define GKO_STAT_CTIME_NS(st)           ((int64_t)(st)->st_ctimespec.tv_sec * 1000000000LL + (st)->st_ctimespec.tv_nsec)
+#else
+#define GKO_STAT_MTIME_NS(st)           ((int64_t)(st)->st_mtim.tv_sec * 1000000000LL + (st)->st_mtim.tv_nsec)
+#define GKO_STAT_CTIME_NS(st)           ((int64_t)(st)->st_ctim.tv_sec * 1000000000LL + (st)->st_ctim.tv_nsec)
+#endif
+/**********************************************************************************************************************
+    entry flags
+**********************************************************************************************************************/
+#define GKO_ENTRY_NEW                   (1 << 0)    // not in the index
+#define GKO_ENTRY_STALE                 (1 << 1)    // stat tuple differs from the index, hash is unknown
+#define GKO_ENTRY_DIRTY                 (1 << 2)    // content differs from the last sync
+/**********************************************************************************************************************
+    scanned entry, path is relative to the scan root and always '/' separated
+**********************************************************************************************************************/
+typedef struct {
+    const char     *path;
+    uint64_t        size;
+    int64_t         mtime_ns;
+    int64_t         ctime_ns;
+    uint32_t        mode;
+    uint32_t        flags;
+    uint64_t        inode;
+    uint64_t        dev;
+    uint64_t        hash;
+} GKO_ENTRY;
+/**********************************************************************************************************************
+    flat scan result, entries are sorted by path
+**********************************************************************************************************************/
+typedef struct {
+    GKO_ENTRY      *entries;
+    size_t          count;
+    void           *arenas;
+    size_t          ignored;
+    int             threads;
+    double          elapsed;
+} GKO_SCAN;
+/**********************************************************************************************************************
+    scanner functions
+**********************************************************************************************************************/
+int   gko_scan(const char *root, int threads, const GKO_IGNORE *ignore, GKO_SCAN *scan);
+char *gko_scan_join(GKO_SCAN *scan, const char *prefix, size_t plen, const char *name, size_t nlen);
+void  gko_scan_sort(GKO_SCAN *scan);
+void  gko_scan_free(GKO_SCAN *scan);
+
+#endif  // __GEKKO_SCAN_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,309 @@
+/**********************************************************************************************************************
+    file:           schedule.c
+    description:    Transfer ordering of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "gekko.h"
+#include "schedule.h"
+/**********************************************************************************************************************
+    description:    Parse a policy name
+    arguments:      name:   lpt, path or split
+                    policy: policy to store
+    return:         error code
+**********************************************************************************************************************/
+int gko_schedule_policy(const char *name, GEKKO_SCHEDULE *policy)
+{
+    int p = 0;
+
+    if (!name) return GEKKO_ERROR;
+    if (!policy) return GEKKO_ERROR;
+
+    for (p = 0; p < GEKKO_SCHEDULE_MAX; p++) {
+        if (strcmp(name, gko_schedule_name((GEKKO_SCHEDULE)p)) == GEKKO_OK) {
+            *policy = (GEKKO_SCHEDULE)p;
+            return GEKKO_OK;
+        }
+    }
+
+    return GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Name of a policy
+    arguments:      policy: policy
+    return:         name
+**********************************************************************************************************************/
+const char *gko_schedule_name(GEKKO_SCHEDULE policy)
+{
+    switch (policy) {
+    case GEKKO_SCHEDULE_LPT:    return "lpt";
+    case GEKKO_SCHEDULE_PATH:   return "path";
+    case GEKKO_SCHEDULE_SPLIT:  return "split";
+    default:                    return "unknown";
+    }
+}
+/**********************************************************************************************************************
+    description:    Job order for longest first, ranges of one item stay in offset order
+    arguments:      a, b:   jobs
+    return:         qsort order
+**********************************************************************************************************************/
+static int gko_schedule_cmp(const void *a, const void *b)
+{
+    const GKO_JOB *x = (const GKO_JOB *)a;
+    const GKO_JOB *y = (const GKO_JOB *)b;
+
+    if (x->length != y->length) return (x->length > y->length) ? -1 : 1;
+    if (x->item != y->item) return (x->item < y->item) ? -1 : 1;
+    if (x->offset != y->offset) return (x->offset < y->offset) ? -1 : 1;
+
+    return 0;
+}
+/**********************************************************************************************************************
+    description:    Turn a work list into jobs in the order workers should take them from a shared queue. Taking the
+                    longest job first whenever a worker frees up is LPT list scheduling, the small items land last
+                    and fill whatever gaps the big ones leave. With splitting, an item bigger than a fair share of
+                    the total is cut into aligned ranges, so no single job outlasts the others
+    arguments:      sizes:      item sizes
+                    splittable: items that may be cut into ranges, NULL for all
+                    count:      number of items
+                    workers:    parallel workers
+                    policy:     ordering policy
+                    jobs:       jobs to store, free() after use
+                    njobs:      number of jobs to store
+    return:         error code
+**********************************************************************************************************************/
+int gko_schedule_build(const uint64_t *sizes, const bool *splittable, size_t count, int workers,
+                       GEKKO_SCHEDULE policy, GKO_JOB **jobs, size_t *njobs)
+{
+    GKO_JOB    *list    = NULL;
+    uint64_t    total   = 0;
+    uint64_t    share   = 0;
+    uint64_t    range   = 0;
+    uint64_t    offset  = 0;
+    uint32_t    parts   = 0;
+    size_t      cap     = 0;
+    size_t      n       = 0;
+    size_t      i       = 0;
+
+    if (!jobs) return GEKKO_ERROR;
+    if (!njobs) return GEKKO_ERROR;
+    if (count && !sizes) return GEKKO_ERROR;
+
+    *jobs = NULL;
+    *njobs = 0;
+    if (workers < 1) workers = 1;
+
+    for (i = 0; i < count; i++) total += sizes[i];
+    share = (total + workers - 1) / workers;
+
+    // every split item takes at most one range per worker
+    cap = count;
+    if (policy == GEKKO_SCHEDULE_SPLIT && workers > 1) {
+        for (i = 0; i < count; i++) {
+            if (sizes[i] >= GEKKO_SCHEDULE_SPLIT_MIN && sizes[i] > share) cap += workers - 1;
+        }
+    }
+
+    list = (GKO_JOB *)malloc((cap ? cap : 1) * sizeof(GKO_JOB));
+    if (!list) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    for (i = 0; i < count; i++) {
+        parts = 1;
+        range = sizes[i];
+
+        if (policy == GEKKO_SCHEDULE_SPLIT && workers > 1 && (!splittable || splittable[i]) &&
+            sizes[i] >= GEKKO_SCHEDULE_SPLIT_MIN && sizes[i] > share) {
+            parts = (uint32_t)((sizes[i] + share - 1) / share);
+            if (parts > (uint32_t)workers) parts = (uint32_t)workers;
+
+            range = (sizes[i] + parts - 1) / parts;
+            range = (range + GEKKO_SCHEDULE_ALIGN - 1) / GEKKO_SCHEDULE_ALIGN * GEKKO_SCHEDULE_ALIGN;
+            parts = (uint32_t)((sizes[i] + range - 1) / range);
+        }
+
+        if (parts <= 1) {
+            list[n].item   = i;
+            list[n].offset = 0;
+            list[n].length = sizes[i];
+            list[n].parts  = 1;
+            n++;
+            continue;
+        }
+
+        for (offset = 0; offset < sizes[i]; offset += range) {
+            list[n].item   = i;
+            list[n].offset = offset;
+            list[n].length = (sizes[i] - offset < range) ? sizes[i] - offset : range;
+            list[n].parts  = parts;
+            n++;
+        }
+    }
+
+    if (policy != GEKKO_SCHEDULE_PATH) qsort(list, n, sizeof(GKO_JOB), gko_schedule_cmp);
+
+    *jobs = list;
+    *njobs = n;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Replay jobs over workers pulling from a shared queue
+    arguments:      jobs:       jobs in queue order
+                    njobs:      number of jobs
+                    workers:    parallel workers
+                    rate:       bytes per second of one worker
+                    overhead:   seconds every job costs on top of its bytes
+                    idle:       share of worker time spent waiting for the last one, may be NULL
+    return:         makespan in seconds
+**********************************************************************************************************************/
+double gko_schedule_simulate(const GKO_JOB *jobs, size_t njobs, int workers, double rate, double overhead,
+                             double *idle)
+{
+    double     *free_at = NULL;
+    double      span    = 0;
+    double      wasted  = 0;
+    size_t      i       = 0;
+    int         w       = 0;
+    int         best    = 0;
+
+    if (idle) *idle = 0;
+    if (!jobs || !njobs || rate <= 0) return 0;
+    if (workers < 1) workers = 1;
+
+    free_at = (double *)zalloc(workers * sizeof(double));
+    if (!free_at) return 0;
+
+    for (i = 0; i < njobs; i++) {
+        for (best = 0, w = 1; w < workers; w++) {
+            if (free_at[w] < free_at[best]) best = w;
+        }
+        free_at[best] += overhead + jobs[i].length / rate;
+    }
+
+    for (w = 0; w < workers; w++) {
+        if (free_at[w] > span) span = free_at[w];
+    }
+    for (w = 0; w < workers; w++) wasted += span - free_at[w];
+
+    if (idle && span > 0) *idle = wasted / (span * workers);
+    free(free_at);
+
+    return span;
+}
+/**********************************************************************************************************************
+    description:    Load a recorded size distribution, one size in bytes per line, i.e. find -printf '%s\n'
+    arguments:      path:   file to read
+                    sizes:  sizes to store, free() after use
+                    count:  number of sizes to store
+    return:         error code
+**********************************************************************************************************************/
+int gko_schedule_load(const char *path, uint64_t **sizes, size_t *count)
+{
+    FILE       *file    = NULL;
+    uint64_t   *list    = NULL;
+    uint64_t   *grown   = NULL;
+    char        line[64];
+    size_t      cap     = 0;
+    size_t      n       = 0;
+
+    if (!path) return GEKKO_ERROR;
+    if (!sizes) return GEKKO_ERROR;
+    if (!count) return GEKKO_ERROR;
+
+    file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s.\n", path);
+        return GEKKO_ERROR;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] < '0' || line[0] > '9') continue;
+
+        if (n == cap) {
+            cap = (cap) ? cap * 2 : 1024;
+            grown = (uint64_t *)realloc(list, cap * sizeof(uint64_t));
+            if (!grown) {
+                fprintf(stderr, "Insufficient memory.\n");
+                free(list);
+                fclose(file);
+                return GEKKO_ERROR;
+            }
+            list = grown;
+        }
+
+        list[n++] = strtoull(line, NULL, 10);
+    }
+
+    fclose(file);
+
+    *sizes = list;
+    *count = n;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Simulate every policy over a size distribution and report makespan against the lower bound
+    arguments:      sizes:      item sizes in work list order
+                    count:      number of items
+                    workers:    parallel workers
+    return:         error code
+**********************************************************************************************************************/
+int gko_schedule_bench(const uint64_t *sizes, size_t count, int workers)
+{
+    GKO_JOB    *jobs    = NULL;
+    size_t      njobs   = 0;
+    uint64_t    total   = 0;
+    uint64_t    largest = 0;
+    double      bound   = 0;
+    double      span    = 0;
+    double      idle    = 0;
+    size_t      i       = 0;
+    int         p       = 0;
+
+    if (!sizes || !count) {
+        fprintf(stderr, "No sizes to schedule.\n");
+        return GEKKO_ERROR;
+    }
+    if (workers < 1) workers = 1;
+
+    for (i = 0; i < count; i++) {
+        total += sizes[i];
+        if (sizes[i] > largest) largest = sizes[i];
+    }
+
+    // no order beats every session busy until the very end
+    bound = (total / GEKKO_SCHEDULE_SIM_RATE + count * GEKKO_SCHEDULE_SIM_OVERHEAD) / workers;
+
+    printf("%lu files, %.1f MB, largest %.1f MB, %d sessions at %.0f MB/s each, %.0f ms per file.\n",
+           (unsigned long)count, total / 1e6, largest / 1e6, workers, GEKKO_SCHEDULE_SIM_RATE / 1e6,
+           GEKKO_SCHEDULE_SIM_OVERHEAD * 1e3);
+    printf("Lower bound %.2f s with perfect balance.\n", bound);
+
+    for (p = 0; p < GEKKO_SCHEDULE_MAX; p++) {
+        if (gko_schedule_build(sizes, NULL, count, workers, (GEKKO_SCHEDULE)p, &jobs, &njobs) != GEKKO_OK) {
+            return GEKKO_ERROR;
+        }
+
+        span = gko_schedule_simulate(jobs, njobs, workers, GEKKO_SCHEDULE_SIM_RATE,
+                                     GEKKO_SCHEDULE_SIM_OVERHEAD, &idle);
+        printf("\t%-8s%lu jobs, makespan %.2f s (%.2fx bound), %.1f%% of session time idle\n",
+               gko_schedule_name((GEKKO_SCHEDULE)p), (unsigned long)njobs, span,
+               (bound > 0) ? span / bound : 0.0, idle * 100);
+
+        free(jobs);
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,46 @@
+/**********************************************************************************************************************
+    file:           schedule.h
+    description:    Transfer ordering of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_SCHEDULE_H
+#define __GEKKO_SCHEDULE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gekko.h"
+/**********************************************************************************************************************
+    schedule defaults
+**********************************************************************************************************************/
+#define GEKKO_SCHEDULE_SPLIT_MIN        (256ULL << 20)  // smaller files are never cut into ranges
+#define GEKKO_SCHEDULE_ALIGN            (1ULL << 20)    // range boundaries
+#define GEKKO_SCHEDULE_SIM_RATE         (50e6)          // simulated bytes per second of one session
+#define GEKKO_SCHEDULE_SIM_OVERHEAD     (0.002)         // simulated seconds per job: open, close, round trips
+/**********************************************************************************************************************
+    one unit of work: a whole item, or a range of it when parts is above one
+**********************************************************************************************************************/
+typedef struct {
+    size_t          item;
+    uint64_t        offset;
+    uint64_t        length;
+    uint32_t        parts;
+} GKO_JOB;
+/**********************************************************************************************************************
+    schedule functions
+**********************************************************************************************************************/
+int         gko_schedule_policy(const char *name, GEKKO_SCHEDULE *policy);
+const char *gko_schedule_name(GEKKO_SCHEDULE policy);
+int         gko_schedule_build(const uint64_t *sizes, const bool *splittable, size_t count, int workers,
+                               GEKKO_SCHEDULE policy, GKO_JOB **jobs, size_t *njobs);
+double      gko_schedule_simulate(const GKO_JOB *jobs, size_t njobs, int workers, double rate, double overhead,
+                                  double *idle);
+int         gko_schedule_load(const char *path, uint64_t **sizes, size_t *count);
+int         gko_schedule_bench(const uint64_t *sizes, size_t count, int workers);
+
+#endif  // __GEKKO_SCHEDULE_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
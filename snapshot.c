@@ -0,0 +1,725 @@
+/**********************************************************************************************************************
+    file:           snapshot.c
+    description:    Cached remote tree of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/stat.h>
+
+#include "gekko.h"
+#include "hash.h"
+#include "transfer.h"
+#include "snapshot.h"
+/**********************************************************************************************************************
+    sftp walk types
+**********************************************************************************************************************/
+typedef enum {
+    GKO_WALK_IDLE   = 0,
+    GKO_WALK_INIT   = 1,
+    GKO_WALK_OPEN   = 2,
+    GKO_WALK_READ   = 3,
+    GKO_WALK_CLOSE  = 4,
+    GKO_WALK_DEAD   = 5,
+} GKO_WALK_STATE;
+
+typedef struct {
+    GKO_WALK_STATE          state;
+    LIBSSH2_SFTP           *sftp;
+    LIBSSH2_SFTP_HANDLE    *handle;
+    const char             *prefix;
+    size_t                  plen;
+    char                    full[PATH_MAX];
+} GKO_WALK_SLOT;
+
+typedef struct {
+    GKO_SESSION            *session;
+    const GKO_IGNORE       *ignore;
+    uint32_t               *scratch;
+    GKO_SCAN               *listing;
+    size_t                 *capacity;
+    bool                    initing;
+    bool                    error;
+} GKO_WALK;
+
+#define GKO_STEP_BLOCKED                (0)
+#define GKO_STEP_PROGRESS               (1)
+/**********************************************************************************************************************
+    description:    Snapshot file of a grip and remote root
+    arguments:      path:   buffer to store the file path
+                    size:   buffer size
+                    dir:    grip directory
+                    remark: grip name
+                    remote: remote sync root
+    return:         error code
+**********************************************************************************************************************/
+int gko_snapshot_path(char *path, size_t size, const char *dir, const char *remark, const char *remote)
+{
+    int     n   = 0;
+
+    if (!path) return GEKKO_ERROR;
+    if (!dir) return GEKKO_ERROR;
+    if (!remark) return GEKKO_ERROR;
+    if (!remote) return GEKKO_ERROR;
+
+    // one grip may sync several trees, each remote root gets its own snapshot
+    n = snprintf(path, size, "%s%s%s.%016llx%s", dir, SEP, remark,
+                 (unsigned long long)gko_hash(remote, strlen(remote)), GEKKO_SNAPSHOT_SUFFIX);
+    if (n < 0 || (size_t)n >= size) {
+        fprintf(stderr, "Snapshot path of %s is too long.\n", remark);
+        return GEKKO_ERROR;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Append one remote entry to a listing
+    arguments:      listing:    listing to extend
+                    capacity:   allocated entries of the listing
+                    prefix:     parent path relative to the remote root, "" for the root
+                    plen:       length of prefix
+                    name:       entry name, or whole relative path with an empty prefix
+                    nlen:       length of name
+                    mode:       file type and permissions
+                    size:       file size
+                    mtime_ns:   modification time
+                    ignore:     ignore rules, NULL for none
+                    scratch:    buffer of 2 * gko_ignore_width() states
+    return:         error code
+**********************************************************************************************************************/
+static int gko_snapshot_add(GKO_SCAN *listing, size_t *capacity, const char *prefix, size_t plen,
+                            const char *name, size_t nlen, uint32_t mode, uint64_t size, int64_t mtime_ns,
+                            const GKO_IGNORE *ignore, uint32_t *scratch)
+{
+    GKO_ENTRY  *grown   = NULL;
+    GKO_ENTRY  *entry   = NULL;
+    const char *path    = NULL;
+
+    path = gko_scan_join(listing, prefix, plen, name, nlen);
+    if (!path) goto __error_memory;
+
+    if (ignore && gko_ignore_path(ignore, path, S_ISDIR(mode), scratch)) {
+        listing->ignored++;
+        return GEKKO_OK;
+    }
+
+    if (listing->count == *capacity) {
+        grown = (GKO_ENTRY *)realloc(listing->entries, *capacity * 2 * sizeof(GKO_ENTRY));
+        if (!grown) goto __error_memory;
+        listing->entries = grown;
+        *capacity *= 2;
+    }
+
+    entry = &listing->entries[listing->count++];
+    memset(entry, 0, sizeof(GKO_ENTRY));
+    entry->path     = path;
+    entry->mode     = mode;
+    entry->size     = size;
+    entry->mtime_ns = mtime_ns;
+
+    return GEKKO_OK;
+
+__error_memory:
+    fprintf(stderr, "Insufficient memory.\n");
+
+    return GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Advance one slot of the sftp walk as far as it goes without blocking
+    arguments:      walk:   walk state
+                    slot:   slot
+    return:         GKO_STEP_PROGRESS if anything moved, GKO_STEP_BLOCKED otherwise
+**********************************************************************************************************************/
+static int gko_walk_step(GKO_WALK *walk, GKO_WALK_SLOT *slot)
+{
+    LIBSSH2_SFTP_ATTRIBUTES     attrs;
+    char                        name[NAME_MAX + 1]  = {0};
+    int                         progress            = GKO_STEP_BLOCKED;
+    int                         len                 = 0;
+
+    switch (slot->state) {
+    case GKO_WALK_INIT:
+        // one more sftp channel on the same connection, each channel carries one request at a time
+        slot->sftp = libssh2_sftp_init(walk->session->session);
+        if (!slot->sftp) {
+            if (libssh2_session_last_errno(walk->session->session) == LIBSSH2_ERROR_EAGAIN) return GKO_STEP_BLOCKED;
+            slot->state = GKO_WALK_DEAD;
+        } else {
+            slot->state = GKO_WALK_IDLE;
+        }
+        walk->initing = false;
+        return GKO_STEP_PROGRESS;
+
+    case GKO_WALK_OPEN:
+        slot->handle = libssh2_sftp_opendir(slot->sftp, slot->full);
+        if (!slot->handle) {
+            if (libssh2_session_last_errno(walk->session->session) == LIBSSH2_ERROR_EAGAIN) return GKO_STEP_BLOCKED;
+
+            // a directory removed under our feet, or a remote root that was never created
+            if (libssh2_sftp_last_error(slot->sftp) != LIBSSH2_FX_NO_SUCH_FILE) {
+                fprintf(stderr, "Cannot open remote directory %s (%lu).\n", slot->full,
+                        libssh2_sftp_last_error(slot->sftp));
+                walk->error = true;
+            }
+            slot->state = GKO_WALK_IDLE;
+            return GKO_STEP_PROGRESS;
+        }
+        slot->state = GKO_WALK_READ;
+        progress = GKO_STEP_PROGRESS;
+        // fall through
+
+    case GKO_WALK_READ:
+        // every name comes with its attributes, no stat per entry
+        while ((len = libssh2_sftp_readdir(slot->handle, name, sizeof(name), &attrs)) > 0) {
+            progress = GKO_STEP_PROGRESS;
+            if (strcmp(name, ".") == GEKKO_OK || strcmp(name, "..") == GEKKO_OK) continue;
+            if (!(attrs.flags & LIBSSH2_SFTP_ATTR_PERMISSIONS)) continue;
+
+            if (gko_snapshot_add(walk->listing, walk->capacity, slot->prefix, slot->plen, name, (size_t)len,
+                                 (uint32_t)attrs.permissions,
+                                 (attrs.flags & LIBSSH2_SFTP_ATTR_SIZE) ? attrs.filesize : 0,
+                                 (attrs.flags & LIBSSH2_SFTP_ATTR_ACMODTIME) ? (int64_t)attrs.mtime * 1000000000LL : 0,
+                                 walk->ignore, walk->scratch) != GEKKO_OK) {
+                walk->error = true;
+                break;
+            }
+        }
+        if (len == LIBSSH2_ERROR_EAGAIN) return progress;
+
+        if (len < 0) {
+            fprintf(stderr, "Cannot list remote directory %s.\n", slot->full);
+            walk->error = true;
+        }
+        slot->state = GKO_WALK_CLOSE;
+        progress = GKO_STEP_PROGRESS;
+        // fall through
+
+    case GKO_WALK_CLOSE:
+        if (libssh2_sftp_closedir(slot->handle) == LIBSSH2_ERROR_EAGAIN) return progress;
+        slot->handle = NULL;
+        slot->state = GKO_WALK_IDLE;
+        return GKO_STEP_PROGRESS;
+
+    default:
+        return GKO_STEP_BLOCKED;
+    }
+}
+/**********************************************************************************************************************
+    description:    Wait until the session socket is ready for what libssh2 is blocked on
+    arguments:      walk:   walk state
+    return:         -
+**********************************************************************************************************************/
+static void gko_walk_wait(GKO_WALK *walk)
+{
+    struct pollfd   pfd;
+    int             dirs    = 0;
+
+    dirs = libssh2_session_block_directions(walk->session->session);
+
+    pfd.fd      = walk->session->sock;
+    pfd.events  = 0;
+    pfd.revents = 0;
+    if (dirs & LIBSSH2_SESSION_BLOCK_INBOUND) pfd.events |= POLLIN;
+    if (dirs & LIBSSH2_SESSION_BLOCK_OUTBOUND) pfd.events |= POLLOUT;
+    if (!pfd.events) pfd.events = POLLIN;
+
+    poll(&pfd, 1, GEKKO_SNAPSHOT_TIMEOUT_MS);
+}
+/**********************************************************************************************************************
+    description:    Walk the remote tree over sftp with READDIR requests in flight on many directories at once
+    arguments:      session:    ssh session with its sftp subsystem
+                    remote:     remote sync root
+                    ignore:     ignore rules, NULL for none
+                    scratch:    buffer of 2 * gko_ignore_width() states
+                    window:     directories listed at once
+                    listing:    listing to extend
+                    capacity:   allocated entries of the listing
+    return:         error code
+**********************************************************************************************************************/
+static int gko_snapshot_walk(GKO_SESSION *session, const char *remote, const GKO_IGNORE *ignore, uint32_t *scratch,
+                             int window, GKO_SCAN *listing, size_t *capacity)
+{
+    GKO_WALK            walk;
+    GKO_WALK_SLOT      *slot        = NULL;
+    GKO_WALK_SLOT      *slots       = NULL;
+    size_t              next        = 0;
+    bool                root        = false;
+    bool                progress    = false;
+    bool                busy        = false;
+    int                 i           = 0;
+
+    if (window <= 0) window = GEKKO_SNAPSHOT_WINDOW;
+    if (window > GEKKO_SNAPSHOT_WINDOW_MAX) window = GEKKO_SNAPSHOT_WINDOW_MAX;
+
+    slots = (GKO_WALK_SLOT *)zalloc(window * sizeof(GKO_WALK_SLOT));
+    if (!slots) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    memset(&walk, 0, sizeof(walk));
+    walk.session  = session;
+    walk.ignore   = ignore;
+    walk.scratch  = scratch;
+    walk.listing  = listing;
+    walk.capacity = capacity;
+
+    // the first slot uses the subsystem the session already has, more are opened while there is work for them
+    slots[0].sftp = session->sftp;
+
+    libssh2_session_set_blocking(session->session, 0);
+
+    for (;;) {
+        progress = false;
+        busy = false;
+
+        for (i = 0; i < window; i++) {
+            slot = &slots[i];
+
+            if (slot->state == GKO_WALK_IDLE && !walk.error) {
+                // the listing is its own queue, directories are entered in the order they were found
+                while (root && next < listing->count && !S_ISDIR(listing->entries[next].mode)) next++;
+
+                if (!root || next < listing->count) {
+                    if (!slot->sftp) {
+                        if (!walk.initing) {
+                            walk.initing = true;
+                            slot->state = GKO_WALK_INIT;
+                        }
+                    } else if (!root) {
+                        root = true;
+                        slot->prefix = "";
+                        slot->plen = 0;
+                        snprintf(slot->full, PATH_MAX, "%s", remote);
+                        slot->state = GKO_WALK_OPEN;
+                    } else {
+                        slot->prefix = listing->entries[next].path;
+                        slot->plen = strlen(slot->prefix);
+                        snprintf(slot->full, PATH_MAX, "%s/%s", remote, slot->prefix);
+                        slot->state = GKO_WALK_OPEN;
+                        next++;
+                    }
+                }
+            }
+
+            if (gko_walk_step(&walk, slot) == GKO_STEP_PROGRESS) progress = true;
+            if (slot->state != GKO_WALK_IDLE && slot->state != GKO_WALK_DEAD) busy = true;
+        }
+
+        if (!busy && (walk.error || (root && next >= listing->count))) break;
+        if (!progress) gko_walk_wait(&walk);
+    }
+
+    libssh2_session_set_blocking(session->session, 1);
+
+    for (i = 1; i < window; i++) {
+        if (slots[i].sftp) libssh2_sftp_shutdown(slots[i].sftp);
+    }
+    free(slots);
+
+    return (walk.error) ? GEKKO_ERROR : GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Parse one record of the find stream: path, type, size, mtime and permissions, each NUL terminated
+    arguments:      data:       stream data
+                    len:        bytes available
+                    fields:     the five fields found
+    return:         bytes taken by the record, 0 if it is not complete yet
+**********************************************************************************************************************/
+static size_t gko_snapshot_record(const char *data, size_t len, const char *fields[5])
+{
+    const char *p       = data;
+    const char *end     = data + len;
+    const char *nul     = NULL;
+    int         i       = 0;
+
+    for (i = 0; i < 5; i++) {
+        nul = (const char *)memchr(p, '\0', (size_t)(end - p));
+        if (!nul) return 0;
+        fields[i] = p;
+        p = nul + 1;
+    }
+
+    return (size_t)(p - data);
+}
+/**********************************************************************************************************************
+    description:    Convert a find "%T@" timestamp to nanoseconds
+    arguments:      str:    seconds with an optional fraction
+    return:         nanoseconds
+**********************************************************************************************************************/
+static int64_t gko_snapshot_time(const char *str)
+{
+    char       *dot     = NULL;
+    int64_t     ns      = 0;
+    int64_t     scale   = 100000000LL;
+
+    ns = strtoll(str, &dot, 10) * 1000000000LL;
+    if (*dot != '.') return ns;
+
+    for (dot++; *dot >= '0' && *dot <= '9' && scale; dot++, scale /= 10) ns += (*dot - '0') * scale;
+
+    return ns;
+}
+/**********************************************************************************************************************
+    description:    List the remote tree with one find command on an exec channel, parsing the stream as it arrives
+    arguments:      session:    ssh session
+                    remote:     remote sync root
+                    ignore:     ignore rules, NULL for none
+                    scratch:    buffer of 2 * gko_ignore_width() states
+                    listing:    listing to extend
+                    capacity:   allocated entries of the listing
+    return:         error code, any failure of the command asks for the sftp walk instead
+**********************************************************************************************************************/
+static int gko_snapshot_find(LIBSSH2_SESSION *session, const char *remote, const GKO_IGNORE *ignore,
+                             uint32_t *scratch, GKO_SCAN *listing, size_t *capacity)
+{
+    LIBSSH2_CHANNEL    *channel                                 = NULL;
+    char                quoted[PATH_MAX * 4 + 3]                = {0};
+    char                command[GEKKO_TRANSFER_COMMAND_MAX * 2] = {0};
+    char               *buffer                                  = NULL;
+    const char         *fields[5];
+    size_t              fill                                    = 0;
+    size_t              used                                    = 0;
+    size_t              taken                                   = 0;
+    ssize_t             n                                       = 0;
+    uint32_t            type                                    = 0;
+    int                 ret                                     = GEKKO_OK;
+
+    if (gko_shell_quote(quoted, sizeof(quoted), remote) != GEKKO_OK) return GEKKO_ERROR;
+    snprintf(command, sizeof(command), "LC_ALL=C find -H %s -mindepth 1 -printf '%%P\\0%%y\\0%%s\\0%%T@\\0%%m\\0'",
+             quoted);
+
+    buffer = (char *)malloc(GEKKO_SNAPSHOT_STREAM);
+    if (!buffer) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    channel = gko_channel_exec(session, command);
+    if (!channel) {
+        free(buffer);
+        return GEKKO_ERROR;
+    }
+
+    while (ret == GEKKO_OK) {
+        n = libssh2_channel_read(channel, buffer + fill, GEKKO_SNAPSHOT_STREAM - fill);
+        if (n <= 0) break;
+        fill += (size_t)n;
+
+        for (used = 0; ret == GEKKO_OK && (taken = gko_snapshot_record(buffer + used, fill - used, fields)); ) {
+            used += taken;
+
+            switch (fields[1][0]) {
+            case 'd':   type = S_IFDIR; break;
+            case 'f':   type = S_IFREG; break;
+            case 'l':   type = S_IFLNK; break;
+            default:    continue;
+            }
+
+            ret = gko_snapshot_add(listing, capacity, "", 0, fields[0], strlen(fields[0]),
+                                   type | (uint32_t)strtoul(fields[4], NULL, 8), strtoull(fields[2], NULL, 10),
+                                   gko_snapshot_time(fields[3]), ignore, scratch);
+        }
+
+        // keep the partial record for the next read, a record never outgrows the buffer
+        memmove(buffer, buffer + used, fill - used);
+        fill -= used;
+        if (fill == GEKKO_SNAPSHOT_STREAM) ret = GEKKO_ERROR;
+    }
+
+    if (n < 0 || fill) ret = GEKKO_ERROR;
+    if (gko_channel_finish(channel) != 0) ret = GEKKO_ERROR;
+    free(buffer);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    List the remote tree, with one find command when the server allows it, or a READDIR walk over sftp
+    arguments:      session:    ssh session with its sftp subsystem
+                    remote:     remote sync root
+                    ignore:     ignore rules, NULL for none
+                    window:     directories listed at once by the sftp walk, 0 for default
+                    listing:    remote entries sorted by path, release with gko_scan_free()
+    return:         error code
+**********************************************************************************************************************/
+int gko_snapshot_list(GKO_SESSION *session, const char *remote, const GKO_IGNORE *ignore, int window,
+                      GKO_SCAN *listing)
+{
+    struct timespec     begin, end;
+    uint32_t           *scratch     = NULL;
+    size_t              capacity    = GEKKO_SNAPSHOT_ENTRIES;
+    int                 ret         = GEKKO_ERROR;
+
+    if (!session) return GEKKO_ERROR;
+    if (!remote) return GEKKO_ERROR;
+    if (!listing) return GEKKO_ERROR;
+
+    memset(listing, 0, sizeof(GKO_SCAN));
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    if (ignore && !ignore->rules) ignore = NULL;
+    if (ignore) scratch = (uint32_t *)malloc(2 * gko_ignore_width(ignore) * sizeof(uint32_t));
+
+    listing->entries = (GKO_ENTRY *)malloc(capacity * sizeof(GKO_ENTRY));
+    if (!listing->entries || (ignore && !scratch)) {
+        fprintf(stderr, "Insufficient memory.\n");
+        free(scratch);
+        gko_scan_free(listing);
+        return GEKKO_ERROR;
+    }
+
+    ret = gko_snapshot_find(session->session, remote, ignore, scratch, listing, &capacity);
+
+    if (ret != GEKKO_OK) {
+        // no shell, no GNU find or no remote root yet, start over over sftp
+        listing->count = 0;
+        listing->ignored = 0;
+        ret = gko_snapshot_walk(session, remote, ignore, scratch, window, listing, &capacity);
+    }
+
+    free(scratch);
+
+    if (ret != GEKKO_OK) {
+        gko_scan_free(listing);
+        return GEKKO_ERROR;
+    }
+
+    gko_scan_sort(listing);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    listing->threads = 1;
+    listing->elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Check whether a sorted scan holds a path
+    arguments:      scan:   scan sorted by path
+                    path:   path relative to sync root
+    return:         true if found
+**********************************************************************************************************************/
+static bool gko_snapshot_in_scan(const GKO_SCAN *scan, const char *path)
+{
+    size_t  lo  = 0;
+    size_t  hi  = scan->count;
+    size_t  mid = 0;
+    int     cmp = 0;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        cmp = strcmp(scan->entries[mid].path, path);
+        if (cmp == 0) return true;
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return false;
+}
+/**********************************************************************************************************************
+    description:    Rebuild a snapshot from a remote listing
+    arguments:      session:    ssh session with its sftp subsystem
+                    remote:     remote sync root
+                    ignore:     ignore rules, NULL for none
+                    window:     directories listed at once by the sftp walk, 0 for default
+                    scan:       local scan
+                    known:      paths synced before, NULL for none
+                    path:       snapshot file path
+    return:         error code
+**********************************************************************************************************************/
+int gko_snapshot_refresh(GKO_SESSION *session, const char *remote, const GKO_IGNORE *ignore, int window,
+                         const GKO_SCAN *scan, const GKO_INDEX *known, const char *path)
+{
+    GKO_SCAN    listing;
+    size_t      listed      = 0;
+    size_t      i           = 0;
+    int         ret         = GEKKO_ERROR;
+
+    if (!scan) return GEKKO_ERROR;
+    if (!path) return GEKKO_ERROR;
+
+    if (gko_snapshot_list(session, remote, ignore, window, &listing) != GEKKO_OK) return GEKKO_ERROR;
+
+    // only what we track is ours to delete, anything else found on the remote is left alone
+    for (i = 0, listed = listing.count, listing.count = 0; i < listed; i++) {
+        if (gko_snapshot_in_scan(scan, listing.entries[i].path) ||
+            (known && gko_index_find(known, listing.entries[i].path) != known->count)) {
+            listing.entries[listing.count++] = listing.entries[i];
+        }
+    }
+
+    printf("Listed %lu remote entries in %.3f s, %lu untracked left alone.\n",
+           (unsigned long)listed, listing.elapsed, (unsigned long)(listed - listing.count));
+
+    ret = gko_index_write(path, &listing);
+    gko_scan_free(&listing);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Flag a hashed scan against the remote snapshot, collecting remote entries gone from the tree
+    arguments:      snapshot:       remote snapshot
+                    scan:           local scan, flagged and hashed against the local index
+                    ignore:         ignore rules the scan was taken with, NULL for none
+                    deleted:        snapshot records to remove from the remote, release with free()
+                    deleted_count:  number of deleted records
+                    dirty:          number of entries to push
+    return:         error code
+**********************************************************************************************************************/
+int gko_snapshot_reconcile(const GKO_INDEX *snapshot, GKO_SCAN *scan, const GKO_IGNORE *ignore,
+                           size_t **deleted, size_t *deleted_count, size_t *dirty)
+{
+    const GKO_INDEX_RECORD     *rec     = NULL;
+    GKO_ENTRY                  *entry   = NULL;
+    size_t                     *gone    = NULL;
+    uint32_t                   *scratch = NULL;
+    size_t                      ngone   = 0;
+    size_t                      ndirty  = 0;
+    size_t                      i       = 0;
+    size_t                      j       = 0;
+    int                         cmp     = 0;
+
+    if (!snapshot) return GEKKO_ERROR;
+    if (!scan) return GEKKO_ERROR;
+    if (!deleted) return GEKKO_ERROR;
+    if (!deleted_count) return GEKKO_ERROR;
+    if (!dirty) return GEKKO_ERROR;
+
+    *deleted = NULL;
+    *deleted_count = 0;
+
+    if (ignore && !ignore->rules) ignore = NULL;
+
+    if (snapshot->count) {
+        gone = (size_t *)malloc(snapshot->count * sizeof(size_t));
+        if (ignore) scratch = (uint32_t *)malloc(2 * gko_ignore_width(ignore) * sizeof(uint32_t));
+        if (!gone || (ignore && !scratch)) {
+            fprintf(stderr, "Insufficient memory.\n");
+            free(gone);
+            free(scratch);
+            return GEKKO_ERROR;
+        }
+    }
+
+    while (i < scan->count || j < snapshot->count) {
+        if (i == scan->count) {
+            cmp = 1;
+        } else if (j == snapshot->count) {
+            cmp = -1;
+        } else {
+            cmp = strcmp(scan->entries[i].path, gko_index_path(snapshot, j));
+        }
+
+        if (cmp > 0) {
+            if (!ignore || !gko_ignore_path(ignore, gko_index_path(snapshot, j),
+                                            S_ISDIR(snapshot->records[j].mode), scratch)) gone[ngone++] = j;
+            j++;
+            continue;
+        }
+
+        entry = &scan->entries[i++];
+
+        if (cmp < 0) {
+            // not on the remote, whatever the local index says
+            entry->flags |= GKO_ENTRY_NEW | GKO_ENTRY_DIRTY;
+            ndirty++;
+            continue;
+        }
+
+        // the remote has a copy, a delta against it is worth trying
+        rec = &snapshot->records[j++];
+        entry->flags &= ~GKO_ENTRY_NEW;
+
+        if (entry->mode != rec->mode) {
+            entry->flags |= GKO_ENTRY_DIRTY;
+        } else if (S_ISDIR(entry->mode)) {
+            entry->flags &= ~GKO_ENTRY_DIRTY;
+        } else if (entry->size != rec->size) {
+            entry->flags |= GKO_ENTRY_DIRTY;
+        } else if (rec->hash) {
+            // a hash in the snapshot is what we pushed last time, a listed entry has none and keeps the index verdict
+            entry->flags = (entry->hash == rec->hash) ? (entry->flags & ~GKO_ENTRY_DIRTY)
+                                                      : (entry->flags | GKO_ENTRY_DIRTY);
+        }
+
+        if (entry->flags & GKO_ENTRY_DIRTY) ndirty++;
+    }
+
+    free(scratch);
+    *deleted = gone;
+    *deleted_count = ngone;
+    *dirty = ndirty;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Make the freshly written index the snapshot of the remote, atomically replacing the old one
+    arguments:      idx:    index file written after a complete sync
+                    path:   snapshot file path
+    return:         error code
+**********************************************************************************************************************/
+int gko_snapshot_commit(const char *idx, const char *path)
+{
+    char        temp[PATH_MAX]  = {0};
+    char        buffer[65536];
+    ssize_t     n               = 0;
+    int         in              = -1;
+    int         out             = -1;
+    bool        error           = false;
+
+    if (!idx) return GEKKO_ERROR;
+    if (!path) return GEKKO_ERROR;
+
+    snprintf(temp, PATH_MAX, "%s.tmp", path);
+    unlink(temp);
+
+#ifndef WINDOWS
+    // the index is replaced by rename and never written in place, sharing its inode is safe
+    if (link(idx, temp) == 0) goto __rename;
+#endif
+
+    in = open(idx, O_RDONLY);
+    out = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    error = (in < 0 || out < 0);
+
+    while (!error && (n = read(in, buffer, sizeof(buffer))) > 0) {
+        error = (write(out, buffer, (size_t)n) != n);
+    }
+
+    error |= (n < 0);
+    error |= (out >= 0 && fsync(out) != 0);
+    if (in >= 0) close(in);
+    if (out >= 0) error |= (close(out) != 0);
+
+    if (error) {
+        fprintf(stderr, "Cannot write snapshot %s.\n", path);
+        unlink(temp);
+        return GEKKO_ERROR;
+    }
+
+#ifndef WINDOWS
+__rename:
+#endif
+    if (rename(temp, path) != 0) {
+        fprintf(stderr, "Cannot write snapshot %s.\n", path);
+        unlink(temp);
+        return GEKKO_ERROR;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,44 @@
+/**********************************************************************************************************************
+    file:           snapshot.h
+    description:    Cached remote tree of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_SNAPSHOT_H
+#define __GEKKO_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libssh2.h>
+#include <libssh2_sftp.h>
+
+#include "scan.h"
+#include "index.h"
+#include "ignore.h"
+#include "pool.h"
+/**********************************************************************************************************************
+    snapshot defaults
+**********************************************************************************************************************/
+#define GEKKO_SNAPSHOT_SUFFIX           ".remote"
+#define GEKKO_SNAPSHOT_ENTRIES          (1024)      // initial capacity of a remote listing
+#define GEKKO_SNAPSHOT_STREAM           (256 * 1024)    // read buffer of the find stream
+#define GEKKO_SNAPSHOT_WINDOW           (16)        // directories listed at once over sftp
+#define GEKKO_SNAPSHOT_WINDOW_MAX       (256)
+#define GEKKO_SNAPSHOT_TIMEOUT_MS       (1000)
+/**********************************************************************************************************************
+    A snapshot is an index file describing the remote tree of one grip and remote root as of the last complete sync.
+    It is kept in the grip directory, trusted by default, and rebuilt from a remote listing when missing or asked for.
+**********************************************************************************************************************/
+int gko_snapshot_path(char *path, size_t size, const char *dir, const char *remark, const char *remote);
+int gko_snapshot_list(GKO_SESSION *session, const char *remote, const GKO_IGNORE *ignore, int window,
+                      GKO_SCAN *listing);
+int gko_snapshot_refresh(GKO_SESSION *session, const char *remote, const GKO_IGNORE *ignore, int window,
+                         const GKO_SCAN *scan, const GKO_INDEX *known, const char *path);
+int gko_snapshot_reconcile(const GKO_INDEX *snapshot, GKO_SCAN *scan, const GKO_IGNORE *ignore,
+                           size_t **deleted, size_t *deleted_count, size_t *dirty);
+int gko_snapshot_commit(const char *idx, const char *path);
+
+#endif  // __GEKKO_SNAPSHOT_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,412 @@
+/**********************************************************************************************************************
+    file:           source.c
+    description:    Upload read path of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "gekko.h"
+#include "source.h"
+/**********************************************************************************************************************
+    bench types
+**********************************************************************************************************************/
+typedef enum {
+    GKO_SOURCE_BENCH_READ = 0,          // read into a malloc'd window and slide it, the old path
+    GKO_SOURCE_BENCH_PREAD,
+    GKO_SOURCE_BENCH_MMAP,
+    GKO_SOURCE_BENCH_MAX,
+} GKO_SOURCE_BENCH;
+
+#define GEKKO_SOURCE_PACKET             (32768)     // libssh2 copies every write request into a packet this big
+/**********************************************************************************************************************
+    description:    Page size, mapping offsets must be aligned to it
+    arguments:      -
+    return:         bytes
+**********************************************************************************************************************/
+static uint64_t gko_source_page(void)
+{
+    long page = sysconf(_SC_PAGESIZE);
+
+    return (page > 0) ? (uint64_t)page : GEKKO_SOURCE_ALIGN;
+}
+/**********************************************************************************************************************
+    description:    Aligned buffer for pread, page aligned so the kernel copies whole pages, release with free()
+    arguments:      size:   bytes
+    return:         buffer, NULL on error
+**********************************************************************************************************************/
+void *gko_source_buffer(size_t size)
+{
+    void *buffer = NULL;
+
+    if (posix_memalign(&buffer, GEKKO_SOURCE_ALIGN, (size) ? size : 1) != 0) return NULL;
+
+    return buffer;
+}
+/**********************************************************************************************************************
+    description:    Open a range of a file for reading in place. Large ranges are mapped and handed out straight from
+                    the page cache, the rest is read with pread into the caller's buffer. A mapped file cut short
+                    under us faults like the delta path does, the scan promised its size
+    arguments:      src:    source to set up, release with gko_source_close()
+                    fd:     open file, stays owned by the caller
+                    offset: first byte
+                    length: bytes, 0 for up to the end of the file
+                    buffer: pread buffer of size bytes, used only for small ranges
+                    size:   most bytes pending at once
+                    map:    map large ranges, false always reads
+    return:         error code
+**********************************************************************************************************************/
+static int gko_source_setup(GKO_SOURCE *src, int fd, uint64_t offset, uint64_t length, void *buffer, size_t size,
+                            bool map)
+{
+    struct stat     st;
+    uint64_t        page    = gko_source_page();
+
+    if (!src) return GEKKO_ERROR;
+    if (!size) return GEKKO_ERROR;
+
+    memset(src, 0, sizeof(GKO_SOURCE));
+    src->fd = fd;
+    src->size = size;
+    src->head = src->tail = src->base = src->dropped = offset;
+
+    if (!length) {
+        if (fstat(fd, &st) != 0) return GEKKO_ERROR;
+        length = ((uint64_t)st.st_size > offset) ? (uint64_t)st.st_size - offset : 0;
+    }
+    src->end = offset + length;
+
+    if (map && length >= GEKKO_SOURCE_MMAP_MIN) {
+        src->map_base = offset / page * page;
+        src->map_size = (size_t)(src->end - src->map_base);
+        src->map = (uint8_t *)mmap(NULL, src->map_size, PROT_READ, MAP_SHARED, fd, (off_t)src->map_base);
+
+        if (src->map != MAP_FAILED) {
+            src->mode = GKO_SOURCE_MMAP;
+            madvise(src->map, src->map_size, MADV_SEQUENTIAL);
+            return GEKKO_OK;
+        }
+        src->map = NULL;
+    }
+
+    if (!buffer) return GEKKO_ERROR;
+
+    src->mode = GKO_SOURCE_PREAD;
+    src->buffer = (uint8_t *)buffer;
+#ifdef LINUX
+    posix_fadvise(fd, (off_t)offset, (off_t)length, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    return GEKKO_OK;
+}
+
+int gko_source_open(GKO_SOURCE *src, int fd, uint64_t offset, uint64_t length, void *buffer, size_t size)
+{
+    return gko_source_setup(src, fd, offset, length, buffer, size, true);
+}
+/**********************************************************************************************************************
+    description:    Hand out contents already in memory through the same interface
+    arguments:      src:    source to set up, gko_source_close() leaves the contents alone
+                    data:   contents, valid until the source is closed
+                    offset: file position of the first byte
+                    length: bytes
+                    size:   most bytes pending at once
+    return:         -
+**********************************************************************************************************************/
+void gko_source_memory(GKO_SOURCE *src, const uint8_t *data, uint64_t offset, size_t length, size_t size)
+{
+    memset(src, 0, sizeof(GKO_SOURCE));
+    src->mode = GKO_SOURCE_MEMORY;
+    src->fd = -1;
+    src->map = (uint8_t *)data;
+    src->map_base = offset;
+    src->size = (size) ? size : length;
+    src->head = src->tail = src->base = src->dropped = offset;
+    src->end = offset + length;
+}
+/**********************************************************************************************************************
+    description:    Make more bytes pending
+    arguments:      src:    source
+                    want:   bytes wanted
+    return:         bytes added, 0 at the end, negative on error
+**********************************************************************************************************************/
+ssize_t gko_source_fill(GKO_SOURCE *src, size_t want)
+{
+    uint64_t    page    = 0;
+    uint64_t    from    = 0;
+    size_t      room    = 0;
+    ssize_t     n       = 0;
+
+    if (!src) return -1;
+
+    room = src->size - (size_t)(src->tail - src->head);
+    if (src->mode == GKO_SOURCE_PREAD) room = src->size - (size_t)(src->tail - src->base);
+    if (want > room) want = room;
+    if (want > src->end - src->tail) want = (size_t)(src->end - src->tail);
+    if (!want) return 0;
+
+    if (src->mode == GKO_SOURCE_MEMORY) {
+        src->tail += want;
+        return (ssize_t)want;
+    }
+
+    if (src->mode == GKO_SOURCE_MMAP) {
+        // nothing to copy, ask the kernel to start reading what the writer is about to touch
+        page = gko_source_page();
+        from = src->tail / page * page;
+        madvise(src->map + (from - src->map_base), (size_t)(src->tail + want - from), MADV_WILLNEED);
+
+        src->tail += want;
+        return (ssize_t)want;
+    }
+
+    n = pread(src->fd, src->buffer + (src->tail - src->base), want, (off_t)src->tail);
+    if (n < 0) return -1;
+    if (n == 0) src->end = src->tail;
+
+    src->tail += (uint64_t)n;
+
+    return n;
+}
+/**********************************************************************************************************************
+    description:    Pending bytes
+    arguments:      src:    source
+    return:         first pending byte / number of pending bytes
+**********************************************************************************************************************/
+const uint8_t *gko_source_data(const GKO_SOURCE *src)
+{
+    if (src->mode != GKO_SOURCE_PREAD) return src->map + (src->head - src->map_base);
+
+    return src->buffer + (src->head - src->base);
+}
+
+size_t gko_source_pending(const GKO_SOURCE *src)
+{
+    return (size_t)(src->tail - src->head);
+}
+/**********************************************************************************************************************
+    description:    Retire bytes the writer is done with, releasing what lies behind them
+    arguments:      src:    source
+                    n:      bytes
+    return:         -
+**********************************************************************************************************************/
+void gko_source_consume(GKO_SOURCE *src, size_t n)
+{
+    uint64_t    page    = gko_source_page();
+    uint64_t    upto    = 0;
+
+    if (n > src->tail - src->head) n = (size_t)(src->tail - src->head);
+    src->head += n;
+
+    if (src->mode == GKO_SOURCE_PREAD) {
+        if (src->head == src->tail) {
+            src->base = src->head;
+        } else if (src->head - src->base >= src->size / 2) {
+            memmove(src->buffer, src->buffer + (src->head - src->base), (size_t)(src->tail - src->head));
+            src->base = src->head;
+        }
+    }
+
+    if (src->mode == GKO_SOURCE_MEMORY || src->keep) return;
+
+    // sent bytes are not read again, keep them from piling up in the page cache and in our mapping
+    if (src->head - src->dropped < GEKKO_SOURCE_DROP) return;
+
+    upto = src->head / page * page;
+    if (src->mode == GKO_SOURCE_MMAP && upto > src->map_base) {
+        madvise(src->map + (src->dropped / page * page - src->map_base),
+                (size_t)(upto - src->dropped / page * page), MADV_DONTNEED);
+    }
+#ifdef LINUX
+    posix_fadvise(src->fd, (off_t)src->dropped, (off_t)(upto - src->dropped), POSIX_FADV_DONTNEED);
+#endif
+    src->dropped = upto;
+}
+/**********************************************************************************************************************
+    description:    Release a source, the buffer and the file stay with the caller
+    arguments:      src:    source
+    return:         -
+**********************************************************************************************************************/
+void gko_source_close(GKO_SOURCE *src)
+{
+    if (!src) return;
+
+    if (src->mode == GKO_SOURCE_MMAP && src->map) munmap(src->map, src->map_size);
+    src->map = NULL;
+}
+/**********************************************************************************************************************
+    description:    Name of a read strategy
+    arguments:      mode:   strategy
+    return:         name
+**********************************************************************************************************************/
+const char *gko_source_name(GKO_SOURCE_MODE mode)
+{
+    switch (mode) {
+    case GKO_SOURCE_PREAD:  return "pread";
+    case GKO_SOURCE_MMAP:   return "mmap";
+    case GKO_SOURCE_MEMORY: return "read-ahead";
+    default:                return "unknown";
+    }
+}
+/**********************************************************************************************************************
+    description:    Push a whole file through one read strategy the way an upload does, every pending byte copied
+                    into write packets
+    arguments:      path:       file
+                    window:     bytes in flight
+                    strategy:   read strategy
+    return:         error code
+**********************************************************************************************************************/
+static int gko_source_bench_run(const char *path, size_t window, GKO_SOURCE_BENCH strategy)
+{
+    GKO_SOURCE      src;
+    uint8_t        *buffer  = NULL;
+    uint8_t        *packet  = NULL;
+    uint64_t        sum     = 0;
+    size_t          head    = 0;
+    size_t          tail    = 0;
+    size_t          len     = 0;
+    size_t          i       = 0;
+    ssize_t         n       = 0;
+    int             fd      = -1;
+    int             ret     = GEKKO_ERROR;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return GEKKO_ERROR;
+
+    buffer = (strategy == GKO_SOURCE_BENCH_READ) ? (uint8_t *)malloc(window) : (uint8_t *)gko_source_buffer(window);
+    packet = (uint8_t *)malloc(GEKKO_SOURCE_PACKET);
+    if (!buffer || !packet) goto __error;
+
+    if (strategy == GKO_SOURCE_BENCH_READ) {
+        for (;;) {
+            n = read(fd, buffer + tail, window - tail);
+            if (n < 0) goto __error;
+            tail += (size_t)n;
+            if (head == tail) break;
+
+            for (; head < tail; head += len) {
+                len = (tail - head < GEKKO_SOURCE_PACKET) ? tail - head : GEKKO_SOURCE_PACKET;
+                memcpy(packet, buffer + head, len);
+                sum += packet[0];
+            }
+
+            memmove(buffer, buffer + head, tail - head);
+            tail -= head;
+            head = 0;
+        }
+        ret = GEKKO_OK;
+        goto __error;
+    }
+
+    if (gko_source_setup(&src, fd, 0, 0, buffer, window, strategy == GKO_SOURCE_BENCH_MMAP) != GEKKO_OK) {
+        goto __error;
+    }
+
+    while ((n = gko_source_fill(&src, window)) > 0) {
+        len = gko_source_pending(&src);
+        for (i = 0; i < len; i += GEKKO_SOURCE_PACKET) {
+            memcpy(packet, gko_source_data(&src) + i, (len - i < GEKKO_SOURCE_PACKET) ? len - i : GEKKO_SOURCE_PACKET);
+            sum += packet[0];
+        }
+        gko_source_consume(&src, len);
+    }
+
+    gko_source_close(&src);
+    if (n == 0) ret = GEKKO_OK;
+
+__error:
+    free(packet);
+    free(buffer);
+    close(fd);
+
+    return (ret == GEKKO_OK && sum != (uint64_t)-1) ? GEKKO_OK : GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Compare read strategies over a file, each in its own process so peak RSS is its own
+    arguments:      path:   file, a multi-GB one shows the difference
+                    window: bytes in flight, 0 for default
+    return:         error code
+**********************************************************************************************************************/
+int gko_source_bench(const char *path, size_t window)
+{
+    static const char  *names[GKO_SOURCE_BENCH_MAX] = {"read", "pread", "mmap"};
+    struct rusage       usage;
+    struct timespec     begin, end;
+    struct stat         st;
+    char               *warm    = NULL;
+    double              cpu     = 0;
+    double              elapsed = 0;
+    double              gb      = 0;
+    pid_t               pid     = 0;
+    int                 status  = 0;
+    int                 fd      = -1;
+    int                 s       = 0;
+
+    if (!path) return GEKKO_ERROR;
+    if (!window) window = GEKKO_SOURCE_BENCH_WINDOW;
+
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "Cannot open file %s.\n", path);
+        return GEKKO_ERROR;
+    }
+    gb = st.st_size / 1e9;
+
+    warm = (char *)malloc(1 << 20);
+    if (!warm) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    printf("%s: %.2f GB, window %lu KiB.\n", path, gb, (unsigned long)(window / 1024));
+
+    for (s = 0; s < GKO_SOURCE_BENCH_MAX; s++) {
+        // every run starts from a warm page cache, the previous one may have dropped it
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            while (read(fd, warm, 1 << 20) > 0) {}
+            close(fd);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+
+        pid = fork();
+        if (pid == 0) _exit(gko_source_bench_run(path, window, (GKO_SOURCE_BENCH)s));
+        if (pid < 0 || wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status)) {
+            fprintf(stderr, "%s: failed.\n", names[s]);
+            continue;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+        cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec +
+              usage.ru_stime.tv_usec / 1e6;
+
+        printf("\t%-8s%.3f s CPU per GB (user %.3f, sys %.3f), %.2f GB/s, peak RSS %.1f MB\n", names[s],
+               (gb > 0) ? cpu / gb : 0.0, usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6,
+               usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6, (elapsed > 0) ? gb / elapsed : 0.0,
+#ifdef DARWIN
+               usage.ru_maxrss / 1e6);
+#else
+               usage.ru_maxrss / 1e3);
+#endif
+    }
+
+    free(warm);
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
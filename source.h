@@ -0,0 +1,66 @@
+/**********************************************************************************************************************
+    file:           source.h
+    description:    Upload read path of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_SOURCE_H
+#define __GEKKO_SOURCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+/**********************************************************************************************************************
+    source defaults
+**********************************************************************************************************************/
+#define GEKKO_SOURCE_MMAP_MIN           (4 << 20)   // smaller files are read with pread into a reused buffer
+#define GEKKO_SOURCE_DROP               (8 << 20)   // pages behind the cursor are released in steps of this
+#define GEKKO_SOURCE_ALIGN              (4096)
+#define GEKKO_SOURCE_BENCH_WINDOW       (2 << 20)   // the default upload window
+/**********************************************************************************************************************
+    read strategies
+**********************************************************************************************************************/
+typedef enum {
+    GKO_SOURCE_PREAD = 0,
+    GKO_SOURCE_MMAP,
+    GKO_SOURCE_MEMORY,                  // contents already read, i.e. by the read-ahead
+} GKO_SOURCE_MODE;
+/**********************************************************************************************************************
+    a file range handed out in place: [head, tail) is pending, always contiguous in memory
+**********************************************************************************************************************/
+typedef struct {
+    GKO_SOURCE_MODE     mode;
+    int                 fd;
+    uint8_t            *map;            // mmap and memory: contents from map_base
+    size_t              map_size;
+    uint64_t            map_base;
+    uint8_t            *buffer;         // pread: caller's buffer holding bytes from base
+    uint64_t            base;
+    size_t              size;           // most bytes pending at once
+    uint64_t            end;
+    uint64_t            head;
+    uint64_t            tail;
+    uint64_t            dropped;        // pages before this are released
+    bool                keep;           // leave sent pages cached, other readers of the file follow
+} GKO_SOURCE;
+/**********************************************************************************************************************
+    source functions
+**********************************************************************************************************************/
+int             gko_source_open(GKO_SOURCE *src, int fd, uint64_t offset, uint64_t length, void *buffer,
+                                size_t size);
+void            gko_source_memory(GKO_SOURCE *src, const uint8_t *data, uint64_t offset, size_t length,
+                                  size_t size);
+ssize_t         gko_source_fill(GKO_SOURCE *src, size_t want);
+const uint8_t  *gko_source_data(const GKO_SOURCE *src);
+size_t          gko_source_pending(const GKO_SOURCE *src);
+void            gko_source_consume(GKO_SOURCE *src, size_t n);
+void            gko_source_close(GKO_SOURCE *src);
+const char     *gko_source_name(GKO_SOURCE_MODE mode);
+void           *gko_source_buffer(size_t size);
+int             gko_source_bench(const char *path, size_t window);
+
+#endif  // __GEKKO_SOURCE_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,556 @@
+/**********************************************************************************************************************
+    file:           sync.c
+    description:    Synchronization driver of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "gekko.h"
+#include "pool.h"
+#include "transfer.h"
+#include "bulk.h"
+#include "loop.h"
+#include "schedule.h"
+#include "sync.h"
+/**********************************************************************************************************************
+    sync types
+**********************************************************************************************************************/
+typedef struct {
+    GKO_TRANSFER        xfer;
+    pthread_t           thread;
+    bool                started;
+    bool                error;
+    const GKO_SCAN     *scan;
+    const size_t       *files;
+    const GKO_JOB      *jobs;               // queue order, items index files
+    size_t              count;
+    size_t             *next;
+    uint32_t           *left;               // ranges still in flight per item of a split file
+    const size_t       *bulk;
+    size_t              bulk_count;
+    const char         *bulk_command;
+} GKO_SYNC_WORKER;
+/**********************************************************************************************************************
+    description:    Sync worker thread, drains the shared file queue through its own session
+    arguments:      arg:    worker
+    return:         NULL
+**********************************************************************************************************************/
+static void *gko_sync_worker(void *arg)
+{
+    GKO_SYNC_WORKER    *worker  = (GKO_SYNC_WORKER *)arg;
+    const GKO_JOB      *job     = NULL;
+    const GKO_ENTRY    *entry   = NULL;
+    size_t              i       = 0;
+
+    gko_fanout_join(worker->xfer.fanout);
+
+    // the small-file archive runs on this session while the others already drain the queue
+    if (worker->bulk_count &&
+        gko_bulk_upload(&worker->xfer, worker->scan, worker->bulk, worker->bulk_count,
+                        worker->bulk_command) != GEKKO_OK) {
+        printf("bulk: not available, uploading %lu files one by one.\n", (unsigned long)worker->bulk_count);
+        for (i = 0; i < worker->bulk_count; i++) {
+            if (gko_transfer_entry(&worker->xfer, &worker->scan->entries[worker->bulk[i]]) != GEKKO_OK) {
+                worker->error = true;
+            }
+        }
+    }
+
+    // archived files never take their shared buffers, the other hosts must not keep them for this one
+    for (i = 0; i < worker->bulk_count; i++) {
+        gko_fanout_release(worker->xfer.fanout, worker->xfer.host, &worker->scan->entries[worker->bulk[i]]);
+    }
+
+    while ((i = __atomic_fetch_add(worker->next, 1, __ATOMIC_RELAXED)) < worker->count) {
+        job = &worker->jobs[i];
+        entry = &worker->scan->entries[worker->files[job->item]];
+
+        if (job->parts <= 1) {
+            if (gko_transfer_entry(&worker->xfer, entry) != GEKKO_OK) worker->error = true;
+            continue;
+        }
+
+        // whichever session lands the last range settles the file
+        if (gko_transfer_range(&worker->xfer, entry, job->offset, job->length) != GEKKO_OK) worker->error = true;
+        if (__atomic_sub_fetch(&worker->left[job->item], 1, __ATOMIC_ACQ_REL) == 0 &&
+            gko_transfer_range_done(&worker->xfer, entry) != GEKKO_OK) {
+            worker->error = true;
+        }
+    }
+
+    gko_fanout_leave(worker->xfer.fanout);
+
+    return NULL;
+}
+/**********************************************************************************************************************
+    description:    Check if a file goes up as plain bytes and is big enough to be cut into ranges
+    arguments:      rootfd:     local sync root
+                    entry:      dirty local entry
+                    compress:   grip compression level
+    return:         true or false
+**********************************************************************************************************************/
+static bool gko_sync_splittable(int rootfd, const GKO_ENTRY *entry, int compress)
+{
+    int level   = 0;
+    int fd      = -1;
+
+    if (!S_ISREG(entry->mode)) return false;
+    if (entry->size < GEKKO_SCHEDULE_SPLIT_MIN) return false;
+    if (gko_transfer_wants_delta(entry)) return false;
+    if (!gko_transfer_wants_compress(entry, compress)) return true;
+
+    // the same sniff the transfer makes, a stream cannot be cut
+    fd = openat(rootfd, entry->path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return false;
+    level = gko_compress_level(gko_compress_sniff(fd, NULL), compress);
+    close(fd);
+
+    return level == 0;
+}
+/**********************************************************************************************************************
+    description:    Order a work list for the sessions pulling from it
+    arguments:      grip:       grip instance, holds the policy
+                    rootfd:     local sync root
+                    scan:       local scan
+                    files:      scan entries
+                    count:      number of entries
+                    workers:    sessions
+                    split:      allow ranges, only the blocking workers can take them
+                    jobs:       jobs to store, free() after use
+                    njobs:      number of jobs to store
+    return:         error code
+**********************************************************************************************************************/
+static int gko_sync_order(const GRIP *grip, int rootfd, const GKO_SCAN *scan, const size_t *files, size_t count,
+                          int workers, bool split, GKO_JOB **jobs, size_t *njobs)
+{
+    GEKKO_SCHEDULE  policy      = grip->schedule;
+    uint64_t       *sizes       = NULL;
+    bool           *splittable  = NULL;
+    size_t          i           = 0;
+    int             ret         = GEKKO_ERROR;
+
+    if (policy == GEKKO_SCHEDULE_SPLIT && !split) policy = GEKKO_SCHEDULE_LPT;
+
+    sizes = (uint64_t *)malloc((count ? count : 1) * sizeof(uint64_t));
+    splittable = (bool *)malloc((count ? count : 1) * sizeof(bool));
+    if (!sizes || !splittable) {
+        fprintf(stderr, "Insufficient memory.\n");
+        goto __error_malloc;
+    }
+
+    for (i = 0; i < count; i++) {
+        sizes[i] = scan->entries[files[i]].size;
+        splittable[i] = (policy == GEKKO_SCHEDULE_SPLIT) &&
+                        gko_sync_splittable(rootfd, &scan->entries[files[i]], grip->compress);
+    }
+
+    ret = gko_schedule_build(sizes, splittable, count, workers, policy, jobs, njobs);
+
+__error_malloc:
+    free(sizes);
+    free(splittable);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Start reading ahead the files of a plan for every session, deltas read the remote copy first
+                    and are left out
+    arguments:      pf:         read-ahead to set up
+                    grip:       grip instance, holds the engine
+                    rootfd:     local sync root
+                    scan:       local scan
+                    plan:       scan entries in the order the sessions take them, reordered in place
+                    count:      number of entries
+                    xfers:      transfer context of each session
+                    sessions:   number of sessions
+    return:         -
+**********************************************************************************************************************/
+static void gko_sync_prefetch(GKO_PREFETCH *pf, const GRIP *grip, int rootfd, const GKO_SCAN *scan, size_t *plan,
+                              size_t count, GKO_TRANSFER **xfers, int sessions)
+{
+    size_t  keep    = 0;
+    size_t  i       = 0;
+    int     n       = 0;
+
+    // fan-out hosts share one set of buffers instead
+    if (xfers[0]->fanout) return;
+
+    for (i = 0; i < count; i++) {
+        if (!gko_transfer_wants_delta(&scan->entries[plan[i]])) plan[keep++] = plan[i];
+    }
+
+    if (gko_prefetch_start(pf, grip->readahead, grip->readahead_depth, rootfd, scan, plan, keep) != GEKKO_OK) return;
+
+    printf("readahead %s: %lu files, depth %lu.\n", gko_prefetch_name(pf->engine), (unsigned long)pf->count,
+           (unsigned long)pf->depth);
+    for (n = 0; n < sessions; n++) xfers[n]->prefetch = pf;
+}
+/**********************************************************************************************************************
+    description:    Stop a read-ahead started by gko_sync_prefetch()
+    arguments:      pf:         read-ahead
+                    xfers:      transfer context of each session
+                    sessions:   number of sessions
+    return:         -
+**********************************************************************************************************************/
+static void gko_sync_prefetch_stop(GKO_PREFETCH *pf, GKO_TRANSFER **xfers, int sessions)
+{
+    int n = 0;
+
+    if (!xfers[0]->prefetch) return;
+
+    printf("readahead %s: %llu files sent from memory, %llu read by the sender.\n", gko_prefetch_name(pf->engine),
+           (unsigned long long)pf->hits, (unsigned long long)pf->misses);
+    gko_prefetch_stop(pf);
+    for (n = 0; n < sessions; n++) xfers[n]->prefetch = NULL;
+}
+/**********************************************************************************************************************
+    description:    Remove remote entries whose type changed before anything is created in their place: a file
+                    that became a directory goes first, a directory that became a file goes with what it held
+    arguments:      xfer:           transfer context
+                    scan:           local scan
+                    index:          index of the last sync
+                    deleted:        index records gone from the local tree
+                    deleted_count:  number of deleted records
+                    kept:           deleted records still to remove to store
+                    kept_count:     number of records stored
+    return:         error code
+**********************************************************************************************************************/
+static int gko_sync_retype(GKO_TRANSFER *xfer, const GKO_SCAN *scan, const GKO_INDEX *index, const size_t *deleted,
+                           size_t deleted_count, size_t *kept, size_t *kept_count)
+{
+    const GKO_ENTRY    *entry   = NULL;
+    bool               *done    = NULL;
+    size_t              len     = 0;
+    size_t              i       = 0;
+    size_t              j       = 0;
+    size_t              k       = 0;
+    int                 ret     = GEKKO_OK;
+
+    done = (bool *)zalloc((deleted_count + 1) * sizeof(bool));
+    if (!done) {
+        fprintf(stderr, "Insufficient memory.\n");
+        return GEKKO_ERROR;
+    }
+
+    for (i = 0; i < scan->count && ret == GEKKO_OK; i++) {
+        entry = &scan->entries[i];
+        if (!(entry->flags & GKO_ENTRY_DIRTY) || (entry->flags & GKO_ENTRY_NEW)) continue;
+
+        j = gko_index_find(index, entry->path);
+        if (j == index->count || (index->records[j].mode & S_IFMT) == (entry->mode & S_IFMT)) continue;
+
+        // what the old directory held sorts right after it, deepest last
+        len = strlen(entry->path);
+        for (k = deleted_count; k-- > 0 && ret == GEKKO_OK; ) {
+            if (deleted[k] <= j || done[k]) continue;
+            if (strncmp(gko_index_path(index, deleted[k]), entry->path, len) != GEKKO_OK ||
+                gko_index_path(index, deleted[k])[len] != '/') continue;
+            ret = gko_transfer_delete(xfer, gko_index_path(index, deleted[k]), index->records[deleted[k]].mode);
+            done[k] = true;
+        }
+
+        if (ret == GEKKO_OK) ret = gko_transfer_delete(xfer, entry->path, index->records[j].mode);
+    }
+
+    for (k = 0, *kept_count = 0; k < deleted_count; k++) {
+        if (!done[k]) kept[(*kept_count)++] = deleted[k];
+    }
+    free(done);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Push dirty entries and deletions to the remote
+    arguments:      pool:           open sessions to reuse, NULL to open a pool for this call only
+                    grip:           grip instance
+                    remote:         remote sync root
+                    rootfd:         local sync root
+                    scan:           local scan
+                    index:          index of the last sync
+                    deleted:        index records gone from the local tree
+                    deleted_count:  number of deleted records
+                    fanout:         buffers shared with the other hosts of a fan-out, NULL for none
+                    host:           this host's number in the fan-out
+    return:         error code
+**********************************************************************************************************************/
+int gko_sync(GKO_POOL *pool, const GRIP *grip, const char *remote, int rootfd, const GKO_SCAN *scan,
+             const GKO_INDEX *index, const size_t *deleted, size_t deleted_count, GKO_FANOUT *fanout, int host)
+{
+    GKO_POOL            local;
+    GKO_SYNC_WORKER    *workers = NULL;
+    GKO_TRANSFER       *first   = NULL;
+    GKO_TRANSFER       *xfers[GEKKO_POOL_SESSIONS_MAX];
+    GKO_TRANSFER        total;
+    GKO_RATE           *rate    = NULL;
+    GKO_PREFETCH        prefetch;
+    struct timespec     begin, end;
+    char                key[NAME_MAX + 8];
+    size_t             *files   = NULL;
+    size_t             *bulk    = NULL;
+    size_t             *gone    = NULL;
+    size_t             *kept    = NULL;
+    size_t             *plan    = NULL;
+    GKO_JOB            *jobs    = NULL;
+    uint32_t           *left    = NULL;
+    size_t              njobs   = 0;
+    size_t              count   = 0;
+    size_t              removed = 0;
+    size_t              small   = 0;
+    size_t              events  = 0;
+    size_t              planned = 0;
+    size_t              swap    = 0;
+    size_t              next    = 0;
+    size_t              i       = 0;
+    double              elapsed = 0;
+    bool                error   = false;
+    int                 ret     = GEKKO_ERROR;
+    int                 n       = 0;
+    int                 c       = 0;
+
+    if (!grip) return GEKKO_ERROR;
+    if (!remote) return GEKKO_ERROR;
+    if (!scan) return GEKKO_ERROR;
+    if (!index) return GEKKO_ERROR;
+
+    files = (size_t *)malloc((scan->count ? scan->count : 1) * sizeof(size_t));
+    bulk = (size_t *)malloc((scan->count ? scan->count : 1) * sizeof(size_t));
+    if (!files || !bulk) {
+        fprintf(stderr, "Insufficient memory.\n");
+        free(files);
+        free(bulk);
+        return GEKKO_ERROR;
+    }
+
+    if (!pool) {
+        ret = gko_pool_create(&local, grip, grip->sessions);
+        if (ret != GEKKO_OK) {
+            fprintf(stderr, "Cannot create SSH instance (%d).\n", ret);
+            free(files);
+            free(bulk);
+            return GEKKO_ERROR;
+        }
+        pool = &local;
+    }
+
+    workers = (GKO_SYNC_WORKER *)zalloc(pool->count * sizeof(GKO_SYNC_WORKER));
+    if (!workers) {
+        fprintf(stderr, "Insufficient memory.\n");
+        error = true;
+        goto __error_malloc;
+    }
+
+    // every session and every grip to the same host share one bucket, they share the uplink too
+    snprintf(key, sizeof(key), "%s:%u", grip->host, grip->port);
+    rate = gko_rate_get(key, grip->rate_limit);
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (n = 0; n < pool->count; n++) {
+        workers[n].xfer.session  = pool->sessions[n].session;
+        workers[n].xfer.sftp     = pool->sessions[n].sftp;
+        workers[n].xfer.sock     = pool->sessions[n].sock;
+        workers[n].xfer.rootfd   = rootfd;
+        workers[n].xfer.remote   = remote;
+        workers[n].xfer.gekko    = (grip->gekko[0]) ? grip->gekko : GEKKO_REMOTE_GEKKO;
+        workers[n].xfer.window   = grip->window;
+        workers[n].xfer.compress = grip->compress;
+        workers[n].xfer.rate     = rate;
+        workers[n].xfer.fanout   = fanout;
+        workers[n].xfer.host     = host;
+        workers[n].scan          = scan;
+        workers[n].next          = &next;
+    }
+    first = &workers[0].xfer;
+    for (n = 0; n < pool->count; n++) xfers[n] = &workers[n].xfer;
+
+    // the rest of the sync only removes what is left of the list
+    kept = (size_t *)malloc((deleted_count ? deleted_count : 1) * sizeof(size_t));
+    if (!kept || gko_sync_retype(first, scan, index, deleted, deleted_count, kept, &deleted_count) != GEKKO_OK) {
+        fprintf(stderr, "Cannot clear remote entries that changed type.\n");
+        free(workers);
+        error = true;
+        goto __error_malloc;
+    }
+    deleted = kept;
+
+    // directories go first and in path order on one session, parents exist before anything lands in them
+    for (i = 0; i < scan->count; i++) {
+        if (!(scan->entries[i].flags & GKO_ENTRY_DIRTY)) continue;
+
+        if (S_ISDIR(scan->entries[i].mode)) {
+            if (gko_transfer_entry(first, &scan->entries[i]) != GEKKO_OK) error = true;
+        } else if (gko_bulk_eligible(&scan->entries[i], grip->bulk_threshold)) {
+            bulk[small++] = i;
+        } else {
+            files[count++] = i;
+        }
+    }
+
+    // a handful of small files is not worth a remote process
+    if (small < GEKKO_BULK_MIN_FILES) {
+        for (i = 0; i < small; i++) files[count++] = bulk[i];
+        small = 0;
+    }
+
+    // whole-file uploads, compressed streams and file removals multiplex over every session from this thread,
+    // delta stays on the blocking workers
+    if (grip->engine == GEKKO_ENGINE_EVENTS) {
+        for (i = 0; i < count; i++) {
+            if (!S_ISREG(scan->entries[files[i]].mode)) continue;
+            if (gko_transfer_wants_delta(&scan->entries[files[i]])) continue;
+
+            swap = files[events];
+            files[events++] = files[i];
+            files[i] = swap;
+        }
+
+        // the loop hands files to free slots in list order, the same queue discipline as the workers
+        if (events &&
+            gko_sync_order(grip, rootfd, scan, files, events, pool->count, false, &jobs, &njobs) == GEKKO_OK) {
+            for (i = 0; i < njobs; i++) jobs[i].item = files[jobs[i].item];
+            for (i = 0; i < njobs; i++) files[i] = jobs[i].item;
+        }
+        free(jobs);
+        jobs = NULL;
+
+        gone = (size_t *)malloc((deleted_count ? deleted_count : 1) * sizeof(size_t));
+        if (gone) {
+            for (i = 0; i < deleted_count; i++) {
+                if (!S_ISDIR(index->records[deleted[i]].mode)) gone[removed++] = deleted[i];
+            }
+        }
+
+        plan = (size_t *)malloc((events ? events : 1) * sizeof(size_t));
+        if (plan) {
+            memcpy(plan, files, events * sizeof(size_t));
+            gko_sync_prefetch(&prefetch, grip, rootfd, scan, plan, events, xfers, pool->count);
+        }
+
+        if ((events || removed) &&
+            gko_loop_sync(xfers, pool->count, scan, files, events, index, gone, removed, grip->ops) != GEKKO_OK) {
+            error = true;
+        }
+
+        gko_sync_prefetch_stop(&prefetch, xfers, pool->count);
+        free(plan);
+        plan = NULL;
+    }
+
+    workers[0].bulk         = bulk;
+    workers[0].bulk_count   = small;
+    workers[0].bulk_command = grip->bulk_command;
+
+    left = (uint32_t *)zalloc((count - events + 1) * sizeof(uint32_t));
+    if (!left || gko_sync_order(grip, rootfd, scan, files + events, count - events, pool->count, true,
+                                &jobs, &njobs) != GEKKO_OK) {
+        fprintf(stderr, "Cannot schedule %lu files.\n", (unsigned long)(count - events));
+        error = true;
+        njobs = 0;
+    }
+
+    for (i = 0; i < njobs; i++) {
+        if (jobs[i].parts > 1) left[jobs[i].item] = jobs[i].parts;
+    }
+
+    if (njobs) {
+        printf("schedule %s: %lu jobs for %lu files over %d sessions.\n", gko_schedule_name(grip->schedule),
+               (unsigned long)njobs, (unsigned long)(count - events), pool->count);
+    }
+
+    // whole files in the order the workers pull them, ranges belong to files too large to read ahead
+    plan = (size_t *)malloc((njobs ? njobs : 1) * sizeof(size_t));
+    if (plan) {
+        for (i = 0; i < njobs; i++) {
+            if (jobs[i].parts <= 1) plan[planned++] = files[events + jobs[i].item];
+        }
+        gko_sync_prefetch(&prefetch, grip, rootfd, scan, plan, planned, xfers, pool->count);
+    }
+
+    for (n = 0; n < pool->count; n++) {
+        workers[n].files = files + events;
+        workers[n].jobs  = jobs;
+        workers[n].count = njobs;
+        workers[n].left  = left;
+        workers[n].started = (pthread_create(&workers[n].thread, NULL, gko_sync_worker, &workers[n]) == 0);
+    }
+
+    // a session whose thread could not start is still served, from here
+    for (n = 0; n < pool->count; n++) {
+        if (!workers[n].started) gko_sync_worker(&workers[n]);
+    }
+
+    for (n = 0; n < pool->count; n++) {
+        if (workers[n].started) pthread_join(workers[n].thread, NULL);
+    }
+    gko_sync_prefetch_stop(&prefetch, xfers, pool->count);
+
+    // deepest paths sort last, remove them first so directories are empty by the time we get there
+    for (i = deleted_count; i-- > 0; ) {
+        if (gone && !S_ISDIR(index->records[deleted[i]].mode)) continue;
+        if (gko_transfer_delete(first, gko_index_path(index, deleted[i]),
+                                index->records[deleted[i]].mode) != GEKKO_OK) error = true;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    memset(&total, 0, sizeof(total));
+    for (n = 0; n < pool->count; n++) {
+        total.files    += workers[n].xfer.files;
+        total.bytes    += workers[n].xfer.bytes;
+        total.sent     += workers[n].xfer.sent;
+        total.received += workers[n].xfer.received;
+        for (c = 0; c < GKO_CLASS_MAX; c++) {
+            total.classes[c].files += workers[n].xfer.classes[c].files;
+            total.classes[c].bytes += workers[n].xfer.classes[c].bytes;
+            total.classes[c].wire  += workers[n].xfer.classes[c].wire;
+            total.classes[c].cpu   += workers[n].xfer.classes[c].cpu;
+        }
+        if (workers[n].error) error = true;
+        free(workers[n].xfer.buffer);
+    }
+
+    printf("Transferred %llu files, %llu bytes, %llu bytes sent, %llu bytes received "
+           "in %.3f s over %d sessions (%.1f MB/s, %.0f files/s).\n",
+           (unsigned long long)total.files, (unsigned long long)total.bytes,
+           (unsigned long long)total.sent, (unsigned long long)total.received,
+           elapsed, pool->count, (elapsed > 0) ? total.sent / elapsed / 1e6 : 0.0,
+           (elapsed > 0) ? total.files / elapsed : 0.0);
+    gko_compress_report(total.classes);
+
+    if (rate) {
+        pthread_mutex_lock(&rate->lock);
+        printf("rate %s: limited to %.2f MB/s, throttled meta %.3f s, small %.3f s, bulk %.3f s since start.\n",
+               rate->key, rate->limit / 1e6, rate->waited[GKO_RATE_META], rate->waited[GKO_RATE_SMALL],
+               rate->waited[GKO_RATE_BULK]);
+        pthread_mutex_unlock(&rate->lock);
+    }
+
+    free(workers);
+
+__error_malloc:
+    if (pool == &local) gko_pool_destroy(pool);
+    free(kept);
+    free(files);
+    free(bulk);
+    free(gone);
+    free(plan);
+    free(jobs);
+    free(left);
+
+    return (error) ? GEKKO_ERROR : GEKKO_OK;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
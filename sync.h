@@ -0,0 +1,27 @@
+/**********************************************************************************************************************
+    file:           sync.h
+    description:    Synchronization driver of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_SYNC_H
+#define __GEKKO_SYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gekko.h"
+#include "scan.h"
+#include "index.h"
+#include "pool.h"
+#include "fanout.h"
+/**********************************************************************************************************************
+    sync functions
+**********************************************************************************************************************/
+int gko_sync(GKO_POOL *pool, const GRIP *grip, const char *remote, int rootfd, const GKO_SCAN *scan,
+             const GKO_INDEX *index, const size_t *deleted, size_t deleted_count, GKO_FANOUT *fanout, int host);
+
+#endif  // __GEKKO_SYNC_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
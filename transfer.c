@@ -0,0 +1,634 @@
+/**********************************************************************************************************************
+    file:           transfer.c
+    description:    File transfer of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gekko.h"
+#include "delta.h"
+#include "source.h"
+#include "transfer.h"
+/**********************************************************************************************************************
+    description:    Quote a string for a POSIX shell
+    arguments:      dst:    destination
+                    size:   destination size
+                    src:    string to quote
+    return:         error code
+**********************************************************************************************************************/
+int gko_shell_quote(char *dst, size_t size, const char *src)
+{
+    size_t n = 0;
+
+    if (size < 3) return GEKKO_ERROR;
+
+    dst[n++] = '\'';
+    for (; *src; src++) {
+        if (*src == '\'') {
+            if (n + 4 >= size) return GEKKO_ERROR;
+            memcpy(dst + n, "'\\''", 4);
+            n += 4;
+        } else {
+            if (n + 1 >= size) return GEKKO_ERROR;
+            dst[n++] = *src;
+        }
+    }
+
+    if (n + 2 > size) return GEKKO_ERROR;
+    dst[n++] = '\'';
+    dst[n] = '\0';
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Channel stream adapters for delta encoding
+    arguments:      ctx:    channel
+                    data:   buffer
+                    len:    length
+    return:         error code / bytes read
+**********************************************************************************************************************/
+int gko_channel_writer(void *ctx, const void *data, size_t len)
+{
+    const char *p   = (const char *)data;
+    ssize_t     n   = 0;
+
+    while (len) {
+        n = libssh2_channel_write((LIBSSH2_CHANNEL *)ctx, p, len);
+        if (n < 0) return GEKKO_ERROR;
+        p += n;
+        len -= (size_t)n;
+    }
+
+    return GEKKO_OK;
+}
+
+ssize_t gko_channel_reader(void *ctx, void *data, size_t len)
+{
+    return libssh2_channel_read((LIBSSH2_CHANNEL *)ctx, (char *)data, len);
+}
+/**********************************************************************************************************************
+    description:    Channel writer waiting for the bandwidth limit before every piece
+    arguments:      ctx:    GKO_LIMITED_CHANNEL
+                    data:   buffer
+                    len:    length
+    return:         error code
+**********************************************************************************************************************/
+int gko_limited_writer(void *ctx, const void *data, size_t len)
+{
+    GKO_LIMITED_CHANNEL    *limited = (GKO_LIMITED_CHANNEL *)ctx;
+    const char             *p       = (const char *)data;
+    size_t                  grant   = 0;
+
+    while (len) {
+        grant = gko_rate_wait(limited->rate, len, limited->cls);
+        if (gko_channel_writer(limited->channel, p, grant) != GEKKO_OK) return GEKKO_ERROR;
+        p += grant;
+        len -= grant;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Run a command on an exec channel, stderr of the command is discarded
+    arguments:      session:    ssh session
+                    command:    command line
+    return:         channel, NULL on error
+**********************************************************************************************************************/
+LIBSSH2_CHANNEL *gko_channel_exec(LIBSSH2_SESSION *session, const char *command)
+{
+    LIBSSH2_CHANNEL *channel = NULL;
+
+    channel = libssh2_channel_open_session(session);
+    if (!channel) return NULL;
+
+    libssh2_channel_handle_extended_data2(channel, LIBSSH2_CHANNEL_EXTENDED_DATA_IGNORE);
+
+    if (libssh2_channel_exec(channel, command) != GEKKO_OK) {
+        libssh2_channel_free(channel);
+        return NULL;
+    }
+
+    return channel;
+}
+/**********************************************************************************************************************
+    description:    Finish an exec channel
+    arguments:      channel:    channel
+    return:         exit status of the remote command
+**********************************************************************************************************************/
+int gko_channel_finish(LIBSSH2_CHANNEL *channel)
+{
+    int status = -1;
+
+    libssh2_channel_send_eof(channel);
+    libssh2_channel_wait_eof(channel);
+    libssh2_channel_close(channel);
+    libssh2_channel_wait_closed(channel);
+    status = libssh2_channel_get_exit_status(channel);
+    libssh2_channel_free(channel);
+
+    return status;
+}
+/**********************************************************************************************************************
+    description:    Upload a file or a range of it over SFTP, keeping a window of write requests in flight
+    arguments:      xfer:   transfer context
+                    entry:  local entry
+                    remote: remote path
+                    offset: first byte of the range
+                    length: bytes in the range, 0 for the whole file, which is truncated first
+    return:         error code
+**********************************************************************************************************************/
+static int gko_transfer_upload(GKO_TRANSFER *xfer, const GKO_ENTRY *entry, const char *remote,
+                               uint64_t offset, uint64_t length)
+{
+    LIBSSH2_SFTP_HANDLE    *handle  = NULL;
+    GKO_SOURCE              src;
+    struct timespec         begin, end;
+    GKO_RATE_CLASS          cls     = gko_rate_class(entry->size);
+    const uint8_t          *ahead   = NULL;
+    size_t                  held    = 0;
+    size_t                  size    = 0;
+    size_t                  grant   = 0;
+    uint64_t                done    = 0;
+    uint64_t                calls   = 0;
+    double                  fill    = 0;
+    double                  elapsed = 0;
+    bool                    eof     = false;
+    ssize_t                 n       = 0;
+    int                     fd      = -1;
+    int                     ret     = GEKKO_ERROR;
+
+    size = (size_t)((xfer->window > 0) ? xfer->window : GEKKO_TRANSFER_WINDOW) * GEKKO_TRANSFER_CHUNK;
+
+    // a small file read ahead is sent from the read-ahead buffer, the disk was busy while the last one went out
+    if (!length && gko_prefetch_take(xfer->prefetch, entry, true, &ahead, &held) == GKO_PREFETCH_READY) {
+        gko_source_memory(&src, ahead, 0, held, size);
+        goto __open_remote;
+    }
+
+    // in a fan-out the first host to send a file reads it, the others send the same buffer
+    if (!length && gko_fanout_take(xfer->fanout, xfer->host, entry, true, &ahead, &held)) {
+        gko_source_memory(&src, ahead, 0, held, size);
+        goto __open_remote;
+    }
+
+    fd = openat(xfer->rootfd, entry->path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open file %s.\n", entry->path);
+        return GEKKO_ERROR;
+    }
+
+    // the pread buffer lives as long as the session, every small file reuses it
+    if (xfer->buffer_size < size) {
+        free(xfer->buffer);
+        xfer->buffer_size = 0;
+        xfer->buffer = (uint8_t *)gko_source_buffer(size);
+        if (!xfer->buffer) {
+            fprintf(stderr, "Insufficient memory.\n");
+            goto __error_malloc;
+        }
+        xfer->buffer_size = size;
+    }
+
+    if (gko_source_open(&src, fd, offset, length, xfer->buffer, size) != GEKKO_OK) {
+        fprintf(stderr, "Cannot read file %s.\n", entry->path);
+        goto __error_malloc;
+    }
+    src.keep = (xfer->fanout != NULL);
+
+__open_remote:
+    // ranges of one file land from several sessions at once, none of them may cut the others short
+    handle = libssh2_sftp_open(xfer->sftp, remote,
+                               LIBSSH2_FXF_WRITE | LIBSSH2_FXF_CREAT | ((length) ? 0 : LIBSSH2_FXF_TRUNC),
+                               entry->mode & 0777);
+    if (!handle) {
+        fprintf(stderr, "Cannot open remote file %s (%lu).\n", remote, libssh2_sftp_last_error(xfer->sftp));
+        goto __error_sftp_open;
+    }
+
+    if (length) libssh2_sftp_seek64(handle, offset);
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    /*
+     * libssh2 splits whatever we hand it into write requests, sends all of them and returns once the
+     * leading ones are acknowledged, reordering and short writes are sorted out inside. Bytes not yet
+     * acknowledged must be offered again at the same file position, so the pending bytes are handed
+     * over every round while the source tops them up, straight from the mapping for large files.
+     */
+    for (;;) {
+        // bytes are charged to the limit as they become pending, re-offered ones are already paid for
+        if (!eof && gko_source_pending(&src) < size) {
+            grant = gko_rate_wait(xfer->rate, size - gko_source_pending(&src), cls);
+            n = (grant) ? gko_source_fill(&src, grant) : 0;
+            if (n < 0) goto __error_write;
+            if (n == 0 && grant) eof = true;
+            gko_rate_refund(xfer->rate, grant - (size_t)n, cls);
+        }
+
+        if (!gko_source_pending(&src)) {
+            if (eof) break;
+            continue;
+        }
+
+        fill += (double)gko_source_pending(&src) / size;
+        calls++;
+
+        n = libssh2_sftp_write(handle, (const char *)gko_source_data(&src), gko_source_pending(&src));
+        if (n < 0) goto __error_write;
+
+        gko_source_consume(&src, (size_t)n);
+        done += (uint64_t)n;
+        xfer->sent += (uint64_t)n;
+    }
+
+    ret = GEKKO_OK;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    if (done >= GEKKO_TRANSFER_REPORT_MIN && length) {
+        printf("upload %s at %llu: %llu bytes in %.3f s (%.1f MB/s), window occupancy %.0f%% of %lu KiB, %s.\n",
+               entry->path, (unsigned long long)offset, (unsigned long long)done, elapsed,
+               (elapsed > 0) ? done / elapsed / 1e6 : 0.0, calls ? 100.0 * fill / calls : 0.0,
+               (unsigned long)(size / 1024), gko_source_name(src.mode));
+    } else if (done >= GEKKO_TRANSFER_REPORT_MIN) {
+        printf("upload %s: %llu bytes in %.3f s (%.1f MB/s), window occupancy %.0f%% of %lu KiB, %s.\n",
+               entry->path, (unsigned long long)done, elapsed, (elapsed > 0) ? done / elapsed / 1e6 : 0.0,
+               calls ? 100.0 * fill / calls : 0.0, (unsigned long)(size / 1024),
+               gko_source_name(src.mode));
+    }
+
+__error_write:
+    if (libssh2_sftp_close(handle) != GEKKO_OK) ret = GEKKO_ERROR;
+
+__error_sftp_open:
+    gko_source_close(&src);
+
+__error_malloc:
+    if (fd >= 0) close(fd);
+
+    if (ret != GEKKO_OK) fprintf(stderr, "Failed to upload %s.\n", entry->path);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Update remote copy with a rolling checksum delta, the remote gekko rebuilds and renames it
+    arguments:      xfer:   transfer context
+                    entry:  local entry
+                    remote: remote path
+    return:         error code
+**********************************************************************************************************************/
+static int gko_transfer_delta(GKO_TRANSFER *xfer, const GKO_ENTRY *entry, const char *remote)
+{
+    LIBSSH2_CHANNEL    *channel                             = NULL;
+    GKO_LIMITED_CHANNEL limited;
+    GKO_SIGNATURE       sig;
+    GKO_DELTA_STATS     stats;
+    struct stat         st;
+    char                gekko[PATH_MAX * 2]                 = {0};
+    char                quoted[PATH_MAX * 2]                = {0};
+    char                command[GEKKO_TRANSFER_COMMAND_MAX] = {0};
+    uint8_t            *data                                = NULL;
+    uint64_t            sig_bytes                           = 0;
+    int                 fd                                  = -1;
+    int                 ret                                 = GEKKO_ERROR;
+
+    if (gko_shell_quote(gekko, sizeof(gekko), xfer->gekko) != GEKKO_OK) return GEKKO_ERROR;
+    if (gko_shell_quote(quoted, sizeof(quoted), remote) != GEKKO_OK) return GEKKO_ERROR;
+
+    fd = openat(xfer->rootfd, entry->path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return GEKKO_ERROR;
+
+    // pages past the end of a file that shrank since the scan fault instead of reading zeros
+    if (fstat(fd, &st) != GEKKO_OK || (uint64_t)st.st_size != entry->size) {
+        fprintf(stderr, "File %s changed during sync.\n", entry->path);
+        close(fd);
+        return GEKKO_ERROR;
+    }
+
+    data = (uint8_t *)mmap(NULL, (size_t)entry->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return GEKKO_ERROR;
+
+    // a command cut short would run on the wrong path
+    if (snprintf(command, sizeof(command), "%s remote sig %u %s",
+                 gekko, gko_delta_block_size(entry->size), quoted) >= (int)sizeof(command)) goto __error_sig;
+    channel = gko_channel_exec(xfer->session, command);
+    if (!channel) goto __error_sig;
+
+    if (gko_delta_signature_read(gko_channel_reader, channel, &sig) != GEKKO_OK) {
+        gko_channel_finish(channel);
+        goto __error_sig;
+    }
+    if (gko_channel_finish(channel) != GEKKO_OK) goto __error_patch;
+
+    sig_bytes = 20 + (uint64_t)sig.count * 12;
+
+    if (snprintf(command, sizeof(command), "%s remote patch %o %s",
+                 gekko, entry->mode & 0777, quoted) >= (int)sizeof(command)) goto __error_patch;
+    channel = gko_channel_exec(xfer->session, command);
+    if (!channel) goto __error_patch;
+
+    limited.channel = channel;
+    limited.rate    = xfer->rate;
+    limited.cls     = gko_rate_class(entry->size);
+
+    ret = gko_delta_encode(data, (size_t)entry->size, &sig, gko_limited_writer, &limited, &stats);
+    if (gko_channel_finish(channel) != GEKKO_OK) ret = GEKKO_ERROR;
+
+    if (ret == GEKKO_OK) {
+        xfer->sent += stats.wire;
+        xfer->received += sig_bytes;
+        printf("delta %s: %llu + %llu bytes on the wire for %llu bytes (%.1f%%).\n", entry->path,
+               (unsigned long long)stats.wire, (unsigned long long)sig_bytes,
+               (unsigned long long)entry->size,
+               entry->size ? 100.0 * (stats.wire + sig_bytes) / entry->size : 0.0);
+    }
+
+__error_patch:
+    gko_delta_signature_free(&sig);
+
+__error_sig:
+    munmap(data, (size_t)entry->size);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Upload a file as a zstd stream, the remote gekko decompresses and renames it
+    arguments:      xfer:   transfer context
+                    entry:  local entry
+                    remote: remote path
+                    fd:     open file, already sniffed
+                    cls:    file class from the sniff
+    return:         error code
+**********************************************************************************************************************/
+static int gko_transfer_compressed(GKO_TRANSFER *xfer, const GKO_ENTRY *entry, const char *remote, int fd,
+                                   GKO_CLASS cls)
+{
+    LIBSSH2_CHANNEL    *channel                             = NULL;
+    GKO_LIMITED_CHANNEL limited;
+    GKO_COMPRESS_STATS *stats                               = &xfer->classes[cls];
+    struct timespec     begin, end;
+    char                gekko[PATH_MAX * 2]                 = {0};
+    char                quoted[PATH_MAX * 2]                = {0};
+    char                command[GEKKO_TRANSFER_COMMAND_MAX] = {0};
+    uint64_t            wire                                = 0;
+    int                 level                               = gko_compress_level(cls, xfer->compress);
+    int                 ret                                 = GEKKO_ERROR;
+
+    if (gko_shell_quote(gekko, sizeof(gekko), xfer->gekko) != GEKKO_OK) return GEKKO_ERROR;
+    if (gko_shell_quote(quoted, sizeof(quoted), remote) != GEKKO_OK) return GEKKO_ERROR;
+    if (lseek(fd, 0, SEEK_SET) != 0) return GEKKO_ERROR;
+
+    if (snprintf(command, sizeof(command), "%s remote unzstd %o %s",
+                 gekko, entry->mode & 0777, quoted) >= (int)sizeof(command)) return GEKKO_ERROR;
+    channel = gko_channel_exec(xfer->session, command);
+    if (!channel) return GEKKO_ERROR;
+
+    limited.channel = channel;
+    limited.rate    = xfer->rate;
+    limited.cls     = gko_rate_class(entry->size);
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &begin);
+    ret = gko_compress_encode(fd, level, gko_limited_writer, &limited, &wire);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+
+    if (gko_channel_finish(channel) != GEKKO_OK) ret = GEKKO_ERROR;
+
+    stats->cpu += (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    if (ret != GEKKO_OK) return GEKKO_ERROR;
+
+    stats->files++;
+    stats->bytes += entry->size;
+    stats->wire  += wire;
+    xfer->sent   += wire;
+
+    if (entry->size >= GEKKO_TRANSFER_REPORT_MIN) {
+        printf("zstd %s: %llu bytes as %llu at level %d (%.1f%%).\n", entry->path,
+               (unsigned long long)entry->size, (unsigned long long)wire, level,
+               entry->size ? 100.0 * wire / entry->size : 0.0);
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Sniff an entry and send it compressed when its class is worth it
+    arguments:      xfer:   transfer context
+                    entry:  local entry
+                    remote: remote path
+                    cls:    file class to store, GKO_CLASS_MAX when the file was not sniffed
+    return:         GEKKO_OK if the file went compressed, GEKKO_ERROR if it still has to be uploaded
+**********************************************************************************************************************/
+static int gko_transfer_adaptive(GKO_TRANSFER *xfer, const GKO_ENTRY *entry, const char *remote, GKO_CLASS *cls)
+{
+    struct timespec     begin, end;
+    double              entropy = 0;
+    int                 fd      = -1;
+    int                 ret     = GEKKO_ERROR;
+
+    *cls = GKO_CLASS_MAX;
+    if (!gko_transfer_wants_compress(entry, xfer->compress)) return GEKKO_ERROR;
+
+    fd = openat(xfer->rootfd, entry->path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return GEKKO_ERROR;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &begin);
+    *cls = gko_compress_sniff(fd, &entropy);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    xfer->classes[*cls].cpu += (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    if (gko_compress_level(*cls, xfer->compress) > 0) {
+        ret = gko_transfer_compressed(xfer, entry, remote, fd, *cls);
+        if (ret != GEKKO_OK) printf("zstd %s: not available, uploading whole file.\n", entry->path);
+    }
+
+    close(fd);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Check if an entry goes through the delta path rather than a whole-file upload
+    arguments:      entry:  dirty local entry
+    return:         true or false
+**********************************************************************************************************************/
+int gko_transfer_wants_delta(const GKO_ENTRY *entry)
+{
+    if (!entry) return false;
+
+    return S_ISREG(entry->mode) && !(entry->flags & GKO_ENTRY_NEW) && entry->size >= GEKKO_DELTA_MIN_SIZE;
+}
+/**********************************************************************************************************************
+    description:    Check if an entry may go through the compressed path, the sniff has the final word
+    arguments:      entry:  dirty local entry
+                    level:  grip compression level
+    return:         true or false
+**********************************************************************************************************************/
+int gko_transfer_wants_compress(const GKO_ENTRY *entry, int level)
+{
+    if (!entry) return false;
+
+    return S_ISREG(entry->mode) && level >= 0 && entry->size >= GEKKO_COMPRESS_MIN_SIZE &&
+           gko_compress_available();
+}
+/**********************************************************************************************************************
+    description:    Bring a remote entry up to date
+    arguments:      xfer:   transfer context
+                    entry:  dirty local entry
+    return:         error code
+**********************************************************************************************************************/
+int gko_transfer_entry(GKO_TRANSFER *xfer, const GKO_ENTRY *entry)
+{
+    LIBSSH2_SFTP_ATTRIBUTES     attrs;
+    GKO_CLASS                   cls                 = GKO_CLASS_MAX;
+    char                        remote[PATH_MAX]    = {0};
+    int                         ret                 = GEKKO_OK;
+
+    if (!xfer) return GEKKO_ERROR;
+    if (!entry) return GEKKO_ERROR;
+
+    snprintf(remote, PATH_MAX, "%s/%s", xfer->remote, entry->path);
+
+    if (S_ISDIR(entry->mode)) {
+        gko_rate_wait(xfer->rate, GEKKO_RATE_META_BYTES, GKO_RATE_META);
+        // an existing directory is fine, a file of that name is not
+        if (libssh2_sftp_mkdir(xfer->sftp, remote, entry->mode & 0777) != GEKKO_OK &&
+            (libssh2_sftp_stat(xfer->sftp, remote, &attrs) != GEKKO_OK ||
+             !LIBSSH2_SFTP_S_ISDIR(attrs.permissions))) {
+            fprintf(stderr, "Cannot create remote directory %s.\n", remote);
+            return GEKKO_ERROR;
+        }
+        return GEKKO_OK;
+    }
+
+    if (!S_ISREG(entry->mode)) {
+        printf("Skipped %s, not a regular file.\n", entry->path);
+        return GEKKO_OK;
+    }
+
+    xfer->files++;
+    xfer->bytes += entry->size;
+
+    // a file known to the index is on the remote already, worth sending only what moved
+    if (gko_transfer_wants_delta(entry)) {
+        if (gko_transfer_delta(xfer, entry, remote) == GEKKO_OK) goto __done;
+        printf("delta %s: not available, uploading whole file.\n", entry->path);
+    }
+
+    // text and compressible binaries go through zstd, whatever is dense or cannot go that way is sent as is
+    if (gko_transfer_adaptive(xfer, entry, remote, &cls) == GEKKO_OK) goto __done;
+    if (gko_transfer_upload(xfer, entry, remote, 0, 0) != GEKKO_OK) {
+        ret = GEKKO_ERROR;
+        goto __done;
+    }
+
+    if (cls != GKO_CLASS_MAX) {
+        xfer->classes[cls].files++;
+        xfer->classes[cls].bytes += entry->size;
+        xfer->classes[cls].wire  += entry->size;
+    }
+
+__done:
+    // whichever way the file went, its read-ahead slot is free for the next one
+    gko_prefetch_release(xfer->prefetch, entry);
+    gko_fanout_release(xfer->fanout, xfer->host, entry);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Upload one range of a file that several sessions share
+    arguments:      xfer:   transfer context
+                    entry:  local regular file
+                    offset: first byte of the range
+                    length: bytes in the range
+    return:         error code
+**********************************************************************************************************************/
+int gko_transfer_range(GKO_TRANSFER *xfer, const GKO_ENTRY *entry, uint64_t offset, uint64_t length)
+{
+    char    remote[PATH_MAX]    = {0};
+
+    if (!xfer) return GEKKO_ERROR;
+    if (!entry) return GEKKO_ERROR;
+    if (!length) return GEKKO_ERROR;
+
+    snprintf(remote, PATH_MAX, "%s/%s", xfer->remote, entry->path);
+
+    if (gko_transfer_upload(xfer, entry, remote, offset, length) != GEKKO_OK) return GEKKO_ERROR;
+
+    xfer->bytes += length;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Settle a file uploaded in ranges once the last one is in: a longer remote copy is cut to size
+    arguments:      xfer:   transfer context
+                    entry:  local regular file
+    return:         error code
+**********************************************************************************************************************/
+int gko_transfer_range_done(GKO_TRANSFER *xfer, const GKO_ENTRY *entry)
+{
+    LIBSSH2_SFTP_ATTRIBUTES     attrs;
+    char                        remote[PATH_MAX]    = {0};
+
+    if (!xfer) return GEKKO_ERROR;
+    if (!entry) return GEKKO_ERROR;
+
+    snprintf(remote, PATH_MAX, "%s/%s", xfer->remote, entry->path);
+
+    memset(&attrs, 0, sizeof(attrs));
+    attrs.flags = LIBSSH2_SFTP_ATTR_SIZE;
+    attrs.filesize = entry->size;
+
+    if (libssh2_sftp_setstat(xfer->sftp, remote, &attrs) != GEKKO_OK) {
+        fprintf(stderr, "Cannot truncate remote file %s.\n", remote);
+        return GEKKO_ERROR;
+    }
+
+    xfer->files++;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Remove remote entry
+    arguments:      xfer:   transfer context
+                    path:   path relative to sync root
+                    mode:   file mode the entry had
+    return:         error code
+**********************************************************************************************************************/
+int gko_transfer_delete(GKO_TRANSFER *xfer, const char *path, uint32_t mode)
+{
+    char    remote[PATH_MAX]    = {0};
+    int     ret                 = GEKKO_OK;
+
+    if (!xfer) return GEKKO_ERROR;
+    if (!path) return GEKKO_ERROR;
+
+    snprintf(remote, PATH_MAX, "%s/%s", xfer->remote, path);
+    gko_rate_wait(xfer->rate, GEKKO_RATE_META_BYTES, GKO_RATE_META);
+
+    if (S_ISDIR(mode)) {
+        ret = libssh2_sftp_rmdir(xfer->sftp, remote);
+    } else {
+        ret = libssh2_sftp_unlink(xfer->sftp, remote);
+    }
+
+    if (ret != GEKKO_OK && libssh2_sftp_last_error(xfer->sftp) != LIBSSH2_FX_NO_SUCH_FILE) {
+        fprintf(stderr, "Cannot remove remote %s.\n", remote);
+        return GEKKO_ERROR;
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,81 @@
+/**********************************************************************************************************************
+    file:           transfer.h
+    description:    File transfer of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_TRANSFER_H
+#define __GEKKO_TRANSFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <libssh2.h>
+#include <libssh2_sftp.h>
+
+#include "scan.h"
+#include "compress.h"
+#include "rate.h"
+#include "prefetch.h"
+#include "fanout.h"
+/**********************************************************************************************************************
+    transfer defaults
+**********************************************************************************************************************/
+#define GEKKO_TRANSFER_CHUNK            (32768)
+#define GEKKO_TRANSFER_WINDOW           (64)
+#define GEKKO_TRANSFER_REPORT_MIN       (1 << 20)
+#define GEKKO_TRANSFER_COMMAND_MAX      (PATH_MAX * 2 + 64)
+#define GEKKO_REMOTE_GEKKO              "gekko"
+/**********************************************************************************************************************
+    transfer context of one session
+**********************************************************************************************************************/
+typedef struct {
+    LIBSSH2_SESSION    *session;
+    LIBSSH2_SFTP       *sftp;
+    int                 sock;
+    int                 rootfd;
+    const char         *remote;
+    const char         *gekko;
+    int                 window;
+    int                 compress;           // grip level, 0 for default, negative to never compress
+    GKO_RATE           *rate;               // shared bandwidth limit, NULL for none
+    uint8_t            *buffer;             // upload read buffer reused across files, free() after the session
+    size_t              buffer_size;
+    GKO_PREFETCH       *prefetch;           // read-ahead of the files this session sends, NULL for none
+    GKO_FANOUT         *fanout;             // buffers shared with the other hosts of a fan-out, NULL for none
+    int                 host;               // this host's number in the fan-out
+    uint64_t            files;
+    uint64_t            bytes;
+    uint64_t            sent;
+    uint64_t            received;
+    GKO_COMPRESS_STATS  classes[GKO_CLASS_MAX];
+} GKO_TRANSFER;
+/**********************************************************************************************************************
+    exec channel writing under a bandwidth limit
+**********************************************************************************************************************/
+typedef struct {
+    LIBSSH2_CHANNEL    *channel;
+    GKO_RATE           *rate;
+    GKO_RATE_CLASS      cls;
+} GKO_LIMITED_CHANNEL;
+/**********************************************************************************************************************
+    transfer functions
+**********************************************************************************************************************/
+LIBSSH2_CHANNEL *gko_channel_exec(LIBSSH2_SESSION *session, const char *command);
+int              gko_channel_finish(LIBSSH2_CHANNEL *channel);
+int              gko_channel_writer(void *ctx, const void *data, size_t len);
+int              gko_limited_writer(void *ctx, const void *data, size_t len);
+ssize_t          gko_channel_reader(void *ctx, void *data, size_t len);
+
+int gko_transfer_entry(GKO_TRANSFER *xfer, const GKO_ENTRY *entry);
+int gko_transfer_range(GKO_TRANSFER *xfer, const GKO_ENTRY *entry, uint64_t offset, uint64_t length);
+int gko_transfer_range_done(GKO_TRANSFER *xfer, const GKO_ENTRY *entry);
+int gko_transfer_wants_delta(const GKO_ENTRY *entry);
+int gko_transfer_wants_compress(const GKO_ENTRY *entry, int level);
+int gko_transfer_delete(GKO_TRANSFER *xfer, const char *path, uint32_t mode);
+int gko_shell_quote(char *dst, size_t size, const char *src);
+
+#endif  // __GEKKO_TRANSFER_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,797 @@
+/**********************************************************************************************************************
+    file:           watch.c
+    description:    Continuous synchronization of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <poll.h>
+#include <sys/stat.h>
+
+#ifdef LINUX
+#include <sys/inotify.h>
+#endif
+
+#include "gekko.h"
+#include "scan.h"
+#include "hash.h"
+#include "index.h"
+#include "sync.h"
+#include "watch.h"
+#include "snapshot.h"
+
+#ifdef LINUX
+/**********************************************************************************************************************
+    watch types
+**********************************************************************************************************************/
+#define GKO_WATCH_MASK  (IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | \
+                         IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+
+typedef struct {
+    GKO_POOL           *pool;
+    const GRIP         *grip;
+    const char         *remote;
+    const char         *root;
+    int                 rootfd;
+    const char         *idx;
+    const char         *snap;
+    int                 threads;
+    const GKO_IGNORE   *ignore;
+    uint32_t           *scratch;        // states for gko_ignore_path()
+    int                 fd;
+    char              **dirs;           // directory of each watch descriptor
+    int                 dirs_size;
+    char              **pending;        // paths touched since the last flush
+    size_t              pending_count;
+    size_t              pending_size;
+    bool                overflow;       // events were lost, only a full scan can tell what moved
+    bool                resync;         // last pass failed, the remote may be behind the tree
+} GKO_WATCH;
+
+static volatile sig_atomic_t gko_watch_stop = 0;
+/**********************************************************************************************************************
+    description:    Stop watching on SIGINT and SIGTERM, the index is consistent between flushes
+    arguments:      sig:    signal number
+    return:         -
+**********************************************************************************************************************/
+static void gko_watch_signal(int sig)
+{
+    (void)sig;
+    gko_watch_stop = 1;
+}
+/**********************************************************************************************************************
+    description:    Monotonic clock in milliseconds
+    arguments:      -
+    return:         milliseconds
+**********************************************************************************************************************/
+static int64_t gko_watch_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+/**********************************************************************************************************************
+    description:    strcmp for qsort over string pointers
+    arguments:      a:      first string pointer
+                    b:      second string pointer
+    return:         strcmp result
+**********************************************************************************************************************/
+static int gko_watch_path_cmp(const void *a, const void *b)
+{
+    return strcmp(*(const char * const *)a, *(const char * const *)b);
+}
+/**********************************************************************************************************************
+    description:    Compare entries by path for qsort
+    arguments:      a:      first entry
+                    b:      second entry
+    return:         strcmp result
+**********************************************************************************************************************/
+static int gko_watch_entry_cmp(const void *a, const void *b)
+{
+    return strcmp(((const GKO_ENTRY *)a)->path, ((const GKO_ENTRY *)b)->path);
+}
+/**********************************************************************************************************************
+    description:    Compare record numbers for qsort
+    arguments:      a:      first record number
+                    b:      second record number
+    return:         order
+**********************************************************************************************************************/
+static int gko_watch_record_cmp(const void *a, const void *b)
+{
+    size_t x = *(const size_t *)a;
+    size_t y = *(const size_t *)b;
+
+    return (x > y) - (x < y);
+}
+/**********************************************************************************************************************
+    description:    Watch one directory, a watch already on the same inode is relabelled
+    arguments:      w:      watch
+                    path:   directory relative to sync root, "" for the root
+    return:         error code
+**********************************************************************************************************************/
+static int gko_watch_add(GKO_WATCH *w, const char *path)
+{
+    char    full[PATH_MAX]  = {0};
+    char  **dirs            = NULL;
+    int     size            = 0;
+    int     wd              = 0;
+
+    snprintf(full, PATH_MAX, "%s%s%s", w->root, (path[0]) ? SEP : "", path);
+
+    wd = inotify_add_watch(w->fd, full, GKO_WATCH_MASK);
+    if (wd < 0) {
+        // gone again before we got to it, its parent reports that
+        if (errno == ENOENT || errno == ENOTDIR) return GEKKO_OK;
+
+        if (errno == ENOSPC) {
+            fprintf(stderr, "Cannot watch %s, raise fs.inotify.max_user_watches.\n", full);
+        } else {
+            fprintf(stderr, "Cannot watch %s.\n", full);
+        }
+        return GEKKO_ERROR;
+    }
+
+    if (wd >= w->dirs_size) {
+        size = (w->dirs_size) ? w->dirs_size : 1024;
+        while (size <= wd) size *= 2;
+
+        dirs = (char **)realloc(w->dirs, size * sizeof(char *));
+        if (!dirs) {
+            fprintf(stderr, "Insufficient memory.\n");
+            inotify_rm_watch(w->fd, wd);
+            return GEKKO_ERROR;
+        }
+        memset(dirs + w->dirs_size, 0, (size - w->dirs_size) * sizeof(char *));
+
+        w->dirs = dirs;
+        w->dirs_size = size;
+    }
+
+    free(w->dirs[wd]);
+    w->dirs[wd] = strdup(path);
+
+    return (w->dirs[wd]) ? GEKKO_OK : GEKKO_ERROR;
+}
+/**********************************************************************************************************************
+    description:    Drop watches of a directory moved away and of everything below it
+    arguments:      w:      watch
+                    path:   old directory path relative to sync root
+    return:         -
+**********************************************************************************************************************/
+static void gko_watch_forget(GKO_WATCH *w, const char *path)
+{
+    size_t  len = strlen(path);
+    int     wd  = 0;
+
+    for (wd = 0; wd < w->dirs_size; wd++) {
+        if (!w->dirs[wd] || strncmp(w->dirs[wd], path, len) != GEKKO_OK) continue;
+        if (w->dirs[wd][len] != '\0' && w->dirs[wd][len] != '/') continue;
+
+        inotify_rm_watch(w->fd, wd);
+        free(w->dirs[wd]);
+        w->dirs[wd] = NULL;
+    }
+}
+/**********************************************************************************************************************
+    description:    Remember a touched path until the burst settles
+    arguments:      w:      watch
+                    dir:    directory relative to sync root
+                    name:   entry name in that directory
+    return:         error code
+**********************************************************************************************************************/
+static int gko_watch_push(GKO_WATCH *w, const char *dir, const char *name)
+{
+    char    path[PATH_MAX]  = {0};
+    char  **pending         = NULL;
+    size_t  size            = 0;
+
+    snprintf(path, PATH_MAX, "%s%s%s", dir, (dir[0]) ? "/" : "", name);
+
+    if (w->pending_count == w->pending_size) {
+        size = (w->pending_size) ? w->pending_size * 2 : 256;
+        pending = (char **)realloc(w->pending, size * sizeof(char *));
+        if (!pending) {
+            fprintf(stderr, "Insufficient memory.\n");
+            return GEKKO_ERROR;
+        }
+        w->pending = pending;
+        w->pending_size = size;
+    }
+
+    w->pending[w->pending_count] = strdup(path);
+    if (!w->pending[w->pending_count]) return GEKKO_ERROR;
+    w->pending_count++;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Forget every pending path
+    arguments:      w:      watch
+    return:         -
+**********************************************************************************************************************/
+static void gko_watch_clear(GKO_WATCH *w)
+{
+    size_t i;
+
+    for (i = 0; i < w->pending_count; i++) free(w->pending[i]);
+    w->pending_count = 0;
+}
+/**********************************************************************************************************************
+    description:    Drain the inotify queue into pending paths
+    arguments:      w:      watch
+    return:         error code
+**********************************************************************************************************************/
+static int gko_watch_read(GKO_WATCH *w)
+{
+    char                        buffer[GEKKO_WATCH_BUFFER]
+                                __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev      = NULL;
+    const char                 *dir     = NULL;
+    char                        path[PATH_MAX];
+    ssize_t                     n       = 0;
+    ssize_t                     off     = 0;
+
+    for (;;) {
+        n = read(w->fd, buffer, sizeof(buffer));
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) return GEKKO_OK;
+            fprintf(stderr, "Cannot read inotify events.\n");
+            return GEKKO_ERROR;
+        }
+
+        for (off = 0; off < n; off += sizeof(struct inotify_event) + ev->len) {
+            ev = (const struct inotify_event *)(buffer + off);
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                w->overflow = true;
+                continue;
+            }
+
+            if (ev->wd < 0 || ev->wd >= w->dirs_size || !w->dirs[ev->wd]) continue;
+            dir = w->dirs[ev->wd];
+
+            if (ev->mask & IN_IGNORED) {
+                free(w->dirs[ev->wd]);
+                w->dirs[ev->wd] = NULL;
+                continue;
+            }
+
+            // events on a directory itself come from its parent as well
+            if (!ev->len) continue;
+            if (!dir[0] && strcmp(ev->name, ".gekko") == GEKKO_OK) continue;
+
+            // the watches follow the inode, they come back under the new name if it is ours
+            if ((ev->mask & IN_MOVED_FROM) && (ev->mask & IN_ISDIR)) {
+                snprintf(path, PATH_MAX, "%s%s%s", dir, (dir[0]) ? "/" : "", ev->name);
+                gko_watch_forget(w, path);
+            }
+
+            if (gko_watch_push(w, dir, ev->name) != GEKKO_OK) return GEKKO_ERROR;
+        }
+    }
+}
+/**********************************************************************************************************************
+    description:    Make sure the pool has sessions, reconnecting after a failure
+    arguments:      w:      watch
+    return:         error code
+**********************************************************************************************************************/
+static int gko_watch_connect(GKO_WATCH *w)
+{
+    int i;
+
+    if (w->pool->count) return GEKKO_OK;
+
+    if (gko_pool_create(w->pool, w->grip, w->grip->sessions) != GEKKO_OK) return GEKKO_ERROR;
+
+    for (i = 0; i < w->pool->count; i++) {
+        libssh2_keepalive_config(w->pool->sessions[i].session, 0, GEKKO_WATCH_KEEPALIVE_S);
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Push changes found by the caller, updating the index on success
+    arguments:      w:              watch
+                    scan:           changed entries, flagged
+                    index:          index of the last sync
+                    deleted:        index records gone from the tree
+                    deleted_count:  number of deleted records
+                    dirty:          number of dirty entries
+    return:         error code
+**********************************************************************************************************************/
+static int gko_watch_push_changes(GKO_WATCH *w, const GKO_SCAN *scan, const GKO_INDEX *index,
+                                  const size_t *deleted, size_t deleted_count, size_t dirty)
+{
+    int ret = GEKKO_OK;
+
+    if (dirty || deleted_count) {
+        ret = gko_watch_connect(w);
+        if (ret == GEKKO_OK) {
+            ret = gko_sync(w->pool, w->grip, w->remote, w->rootfd, scan, index, deleted, deleted_count, NULL, 0);
+        }
+
+        // a broken session stays broken, start over with fresh ones next time
+        if (ret != GEKKO_OK) {
+            gko_pool_destroy(w->pool);
+            w->resync = true;
+            return GEKKO_ERROR;
+        }
+    }
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Full pass over the tree, used at start and whenever events were lost
+    arguments:      w:      watch
+    return:         error code
+**********************************************************************************************************************/
+static int gko_watch_rescan(GKO_WATCH *w)
+{
+    GKO_SCAN    scan;
+    GKO_INDEX   index;
+    size_t     *deleted         = NULL;
+    size_t      deleted_count   = 0;
+    size_t      dirty           = 0;
+    size_t      i               = 0;
+    int         ret             = GEKKO_ERROR;
+
+    w->overflow = false;
+    w->resync = false;
+    gko_watch_clear(w);
+
+    if (gko_scan(w->root, w->threads, w->ignore, &scan) != GEKKO_OK) {
+        fprintf(stderr, "Cannot scan %s.\n", w->root);
+        w->resync = true;
+        return GEKKO_ERROR;
+    }
+
+    // watch before reading anything, whatever changes from here on is queued for the next flush
+    for (i = 0; i < scan.count; i++) {
+        if (S_ISDIR(scan.entries[i].mode) && gko_watch_add(w, scan.entries[i].path) != GEKKO_OK) {
+            goto __error_index_open;
+        }
+    }
+
+    if (gko_index_open(w->idx, &index) != GEKKO_OK) goto __error_index_open;
+    if (gko_index_diff(&index, &scan, w->ignore, &deleted, &deleted_count) != GEKKO_OK) goto __error_index_diff;
+    if (gko_hash_stale(w->rootfd, &scan, w->threads, NULL, NULL, &dirty) != GEKKO_OK) goto __error_hash;
+
+    printf("watch: scanned %lu entries, %lu changed, %lu deleted.\n",
+           (unsigned long)scan.count, (unsigned long)dirty, (unsigned long)deleted_count);
+
+    ret = gko_watch_push_changes(w, &scan, &index, deleted, deleted_count, dirty);
+    if (ret == GEKKO_OK) {
+        gko_index_close(&index);
+        ret = gko_index_write(w->idx, &scan);
+        if (ret == GEKKO_OK && w->snap) ret = gko_snapshot_commit(w->idx, w->snap);
+    }
+
+__error_hash:
+    free(deleted);
+
+__error_index_diff:
+    gko_index_close(&index);
+
+__error_index_open:
+    gko_scan_free(&scan);
+
+    // the events this pass stood in for are gone, only another full pass can catch up
+    if (ret != GEKKO_OK) w->resync = true;
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Append an entry to a change set, the change set owns the path
+    arguments:      changes:    change set
+                    size:       allocated entries
+                    path:       path relative to sync root, taken over
+                    st:         stat of the path
+    return:         error code
+**********************************************************************************************************************/
+static int gko_watch_change(GKO_SCAN *changes, size_t *size, char *path, const struct stat *st)
+{
+    GKO_ENTRY  *entries = NULL;
+    GKO_ENTRY  *entry   = NULL;
+
+    if (!path) return GEKKO_ERROR;
+
+    if (changes->count == *size) {
+        *size = (*size) ? *size * 2 : 64;
+        entries = (GKO_ENTRY *)realloc(changes->entries, *size * sizeof(GKO_ENTRY));
+        if (!entries) {
+            fprintf(stderr, "Insufficient memory.\n");
+            free(path);
+            return GEKKO_ERROR;
+        }
+        changes->entries = entries;
+    }
+
+    entry = &changes->entries[changes->count++];
+    memset(entry, 0, sizeof(GKO_ENTRY));
+    entry->path     = path;
+    entry->size     = S_ISDIR(st->st_mode) ? 0 : (uint64_t)st->st_size;
+    entry->mtime_ns = GKO_STAT_MTIME_NS(st);
+    entry->ctime_ns = GKO_STAT_CTIME_NS(st);
+    entry->mode     = (uint32_t)st->st_mode;
+    entry->inode    = (uint64_t)st->st_ino;
+    entry->dev      = (uint64_t)st->st_dev;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Add a directory that is new to the index together with everything below it
+    arguments:      w:          watch
+                    changes:    change set
+                    size:       allocated entries
+                    path:       directory relative to sync root
+    return:         error code
+**********************************************************************************************************************/
+static int gko_watch_walk(GKO_WATCH *w, GKO_SCAN *changes, size_t *size, const char *path)
+{
+    GKO_SCAN    sub;
+    struct stat st;
+    char        full[PATH_MAX]  = {0};
+    char        rel[PATH_MAX]   = {0};
+    size_t      i               = 0;
+    int         ret             = GEKKO_OK;
+
+    if (gko_watch_add(w, path) != GEKKO_OK) return GEKKO_ERROR;
+
+    snprintf(full, PATH_MAX, "%s%s%s", w->root, SEP, path);
+    if (gko_scan(full, w->threads, NULL, &sub) != GEKKO_OK) return GEKKO_ERROR;
+
+    for (i = 0; i < sub.count && ret == GEKKO_OK; i++) {
+        snprintf(rel, PATH_MAX, "%s/%s", path, sub.entries[i].path);
+        if (w->ignore && gko_ignore_path(w->ignore, rel, S_ISDIR(sub.entries[i].mode), w->scratch)) continue;
+
+        if (S_ISDIR(sub.entries[i].mode)) ret = gko_watch_add(w, rel);
+        if (ret != GEKKO_OK) break;
+
+        memset(&st, 0, sizeof(st));
+        st.st_mode = sub.entries[i].mode;
+        st.st_size = (off_t)sub.entries[i].size;
+        st.st_ino  = (ino_t)sub.entries[i].inode;
+#ifdef DARWIN
+        st.st_mtimespec.tv_sec  = sub.entries[i].mtime_ns / 1000000000LL;
+        st.st_mtimespec.tv_nsec = sub.entries[i].mtime_ns % 1000000000LL;
+        st.st_ctimespec.tv_sec  = sub.entries[i].ctime_ns / 1000000000LL;
+        st.st_ctimespec.tv_nsec = sub.entries[i].ctime_ns % 1000000000LL;
+#else
+        st.st_mtim.tv_sec  = sub.entries[i].mtime_ns / 1000000000LL;
+        st.st_mtim.tv_nsec = sub.entries[i].mtime_ns % 1000000000LL;
+        st.st_ctim.tv_sec  = sub.entries[i].ctime_ns / 1000000000LL;
+        st.st_ctim.tv_nsec = sub.entries[i].ctime_ns % 1000000000LL;
+#endif
+        ret = gko_watch_change(changes, size, strdup(rel), &st);
+    }
+
+    gko_scan_free(&sub);
+
+    return ret;
+}
+/**********************************************************************************************************************
+    description:    Append a record number to the deleted list
+    arguments:      deleted:        deleted list
+                    count:          number of records in the list
+                    size:           allocated records
+                    rec:            record number
+    return:         error code
+**********************************************************************************************************************/
+static int gko_watch_gone(size_t **deleted, size_t *count, size_t *size, size_t rec)
+{
+    size_t *grown   = NULL;
+
+    if (*count == *size) {
+        *size = (*size) ? *size * 2 : 64;
+        grown = (size_t *)realloc(*deleted, *size * sizeof(size_t));
+        if (!grown) {
+            fprintf(stderr, "Insufficient memory.\n");
+            return GEKKO_ERROR;
+        }
+        *deleted = grown;
+    }
+
+    (*deleted)[(*count)++] = rec;
+
+    return GEKKO_OK;
+}
+/**********************************************************************************************************************
+    description:    Push the paths touched by the last burst and nothing else
+    arguments:      w:      watch
+                    first:  time of the first event of the burst
+    return:         error code
+**********************************************************************************************************************/
+static int gko_watch_flush(GKO_WATCH *w, int64_t first)
+{
+    GKO_SCAN                    changes;
+    GKO_INDEX                   index;
+    GKO_ENTRY                   key;
+    struct stat                 st;
+    const GKO_INDEX_RECORD     *rec             = NULL;
+    const char                 *path            = NULL;
+    char                        prefix[PATH_MAX];
+    size_t                     *deleted         = NULL;
+    size_t                      deleted_count   = 0;
+    size_t                      deleted_size    = 0;
+    size_t                      size            = 0;
+    size_t                      dirty           = 0;
+    size_t                      len             = 0;
+    size_t                      i, j, k;
+    bool                        exists          = false;
+    bool                        walk            = false;
+    int64_t                     begin           = gko_watch_now();
+    int                         ret             = GEKKO_ERROR;
+
+    memset(&changes, 0, sizeof(changes));
+
+    qsort(w->pending, w->pending_count, sizeof(char *), gko_watch_path_cmp);
+
+    if (gko_index_open(w->idx, &index) != GEKKO_OK) return GEKKO_ERROR;
+
+    for (i = 0; i < w->pending_count; i++) {
+        path = w->pending[i];
+        if (i && strcmp(path, w->pending[i - 1]) == GEKKO_OK) continue;
+
+        exists = (fstatat(w->rootfd, path, &st, AT_SYMLINK_NOFOLLOW) == GEKKO_OK);
+        j = gko_index_find(&index, path);
+        rec = (j < index.count) ? &index.records[j] : NULL;
+
+        // ignored paths are neither pushed nor deleted, same as a full pass
+        if (w->ignore && gko_ignore_path(w->ignore, path, (exists) ? S_ISDIR(st.st_mode) : (rec && S_ISDIR(rec->mode)),
+                                         w->scratch)) continue;
+
+        if (exists && gko_watch_change(&changes, &size, strdup(path), &st) != GEKKO_OK) goto __error_change;
+
+        // a directory we have not seen is walked whole, whatever landed in it before the watch did not fire
+        walk = exists && S_ISDIR(st.st_mode) && (!rec || !S_ISDIR(rec->mode) || rec->inode != (uint64_t)st.st_ino);
+        if (walk && gko_watch_walk(w, &changes, &size, path) != GEKKO_OK) goto __error_change;
+
+        if (!rec) continue;
+        if (!exists && gko_watch_gone(&deleted, &deleted_count, &deleted_size, j) != GEKKO_OK) goto __error_change;
+
+        // children of a directory that is gone, replaced or walked again are candidates for deletion
+        if (!S_ISDIR(rec->mode)) continue;
+        if (exists && S_ISDIR(st.st_mode) && !walk) continue;
+
+        snprintf(prefix, PATH_MAX, "%s/", path);
+        len = strlen(prefix);
+        for (k = gko_index_lower(&index, prefix); k < index.count; k++) {
+            if (strncmp(gko_index_path(&index, k), prefix, len) != GEKKO_OK) break;
+            if (gko_watch_gone(&deleted, &deleted_count, &deleted_size, k) != GEKKO_OK) goto __error_change;
+        }
+    }
+
+    gko_watch_clear(w);
+
+    // a path both touched directly and found by a walk is listed twice
+    qsort(changes.entries, changes.count, sizeof(GKO_ENTRY), gko_watch_entry_cmp);
+    for (i = 0, j = 0; i < changes.count; i++) {
+        if (j && strcmp(changes.entries[i].path, changes.entries[j - 1].path) == GEKKO_OK) {
+            free((char *)changes.entries[i].path);
+            continue;
+        }
+        changes.entries[j++] = changes.entries[i];
+    }
+    changes.count = j;
+
+    // candidates still on disk are not deleted, the remote deletes children before their parent
+    qsort(deleted, deleted_count, sizeof(size_t), gko_watch_record_cmp);
+    for (i = 0, j = 0; i < deleted_count; i++) {
+        if (j && deleted[i] == deleted[j - 1]) continue;
+
+        key.path = gko_index_path(&index, deleted[i]);
+        if (bsearch(&key, changes.entries, changes.count, sizeof(GKO_ENTRY), gko_watch_entry_cmp)) continue;
+
+        deleted[j++] = deleted[i];
+    }
+    deleted_count = j;
+
+    if (!changes.count && !deleted_count) {
+        ret = GEKKO_OK;
+        goto __error_change;
+    }
+
+    if (gko_index_lookup(&index, &changes) != GEKKO_OK) goto __error_change;
+    if (gko_hash_stale(w->rootfd, &changes, w->threads, NULL, NULL, &dirty) != GEKKO_OK) goto __error_change;
+
+    ret = gko_watch_push_changes(w, &changes, &index, deleted, deleted_count, dirty);
+    if (ret != GEKKO_OK) goto __error_change;
+
+    ret = gko_index_merge(w->idx, &index, &changes, deleted, deleted_count);
+    if (ret == GEKKO_OK && w->snap) ret = gko_snapshot_commit(w->idx, w->snap);
+
+    if (dirty || deleted_count) {
+        printf("watch: pushed %lu changed, %lu deleted in %lld ms, %lld ms after the first event.\n",
+               (unsigned long)dirty, (unsigned long)deleted_count,
+               (long long)(gko_watch_now() - begin), (long long)(gko_watch_now() - first));
+    }
+
+__error_change:
+    gko_watch_clear(w);
+    gko_index_close(&index);
+    for (i = 0; i < changes.count; i++) free((char *)changes.entries[i].path);
+    free(changes.entries);
+    free(deleted);
+
+    // the pending events are cleared either way, a failed pass is made up by a full one
+    if (ret != GEKKO_OK) w->resync = true;
+
+    return ret;
+}
+#endif  // LINUX
+/**********************************************************************************************************************
+    description:    Keep the remote in sync with the local tree until interrupted
+    arguments:      pool:       sessions kept open across pushes, may be reconnected
+                    grip:       grip instance
+                    remote:     remote sync root
+                    root:       local sync root
+                    rootfd:     local sync root
+                    idx:        index file path
+                    snap:       remote snapshot kept in step with the index, NULL for none
+                    threads:    scanner threads
+                    ignore:     ignore rules, NULL for none
+    return:         error code
+**********************************************************************************************************************/
+int gko_watch(GKO_POOL *pool, const GRIP *grip, const char *remote, const char *root, int rootfd,
+              const char *idx, const char *snap, int threads, const GKO_IGNORE *ignore)
+{
+#ifdef LINUX
+    GKO_WATCH           w;
+    struct sigaction    sa;
+    struct pollfd       pfd;
+    int64_t             first   = 0;
+    int64_t             last    = 0;
+    int64_t             now     = 0;
+    int64_t             due     = 0;
+    int                 timeout = 0;
+    int                 next    = 0;
+    int                 n       = 0;
+    int                 ret     = GEKKO_OK;
+    int                 i       = 0;
+
+    if (!pool) return GEKKO_ERROR;
+    if (!grip) return GEKKO_ERROR;
+    if (!remote) return GEKKO_ERROR;
+    if (!root) return GEKKO_ERROR;
+    if (!idx) return GEKKO_ERROR;
+
+    memset(&w, 0, sizeof(w));
+    w.pool    = pool;
+    w.grip    = grip;
+    w.remote  = remote;
+    w.root    = root;
+    w.rootfd  = rootfd;
+    w.idx     = idx;
+    w.snap    = snap;
+    w.threads = threads;
+    w.ignore  = (ignore && ignore->rules) ? ignore : NULL;
+
+    if (w.ignore) {
+        w.scratch = (uint32_t *)malloc(2 * gko_ignore_width(w.ignore) * sizeof(uint32_t));
+        if (!w.scratch) {
+            fprintf(stderr, "Insufficient memory.\n");
+            return GEKKO_ERROR;
+        }
+    }
+
+    w.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (w.fd < 0) {
+        fprintf(stderr, "Cannot create inotify instance.\n");
+        free(w.scratch);
+        return GEKKO_ERROR;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = gko_watch_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    for (i = 0; i < pool->count; i++) {
+        libssh2_keepalive_config(pool->sessions[i].session, 0, GEKKO_WATCH_KEEPALIVE_S);
+    }
+
+    ret = gko_watch_add(&w, "");
+    if (ret == GEKKO_OK) ret = gko_watch_rescan(&w);
+    if (ret != GEKKO_OK) goto __error_rescan;
+
+    printf("Watching %s, press Ctrl-C to stop.\n", root);
+
+    pfd.fd     = w.fd;
+    pfd.events = POLLIN;
+
+    while (!gko_watch_stop) {
+        timeout = GEKKO_WATCH_KEEPALIVE_S * 1000;
+        if (first) {
+            due = last + GEKKO_WATCH_QUIET_MS;
+            if (due > first + GEKKO_WATCH_HOLD_MS) due = first + GEKKO_WATCH_HOLD_MS;
+            now = gko_watch_now();
+            timeout = (due > now) ? (int)(due - now) : 0;
+        }
+
+        pfd.revents = 0;
+        n = poll(&pfd, 1, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Cannot wait for inotify events.\n");
+            ret = GEKKO_ERROR;
+            break;
+        }
+
+        if (n > 0) {
+            ret = gko_watch_read(&w);
+            if (ret != GEKKO_OK) break;
+
+            if (w.pending_count || w.overflow) {
+                last = gko_watch_now();
+                if (!first) first = last;
+            }
+        }
+
+        // idle, keep the sessions from being dropped by the server or a middlebox
+        if (!first) {
+            for (i = 0; !n && i < pool->count; i++) {
+                libssh2_keepalive_send(pool->sessions[i].session, &next);
+            }
+            continue;
+        }
+
+        // the burst is still going, unless it has been held back long enough
+        due = last + GEKKO_WATCH_QUIET_MS;
+        if (due > first + GEKKO_WATCH_HOLD_MS) due = first + GEKKO_WATCH_HOLD_MS;
+        if (gko_watch_now() < due) continue;
+
+        if (w.overflow || w.resync) {
+            printf("watch: %s, rescanning.\n", (w.overflow) ? "event queue overflowed" : "last pass failed");
+            if (gko_watch_rescan(&w) != GEKKO_OK) fprintf(stderr, "watch: rescan failed.\n");
+        } else if (gko_watch_flush(&w, first) != GEKKO_OK) {
+            fprintf(stderr, "watch: push failed.\n");
+        }
+
+        // a failed pass is retried even if the tree goes quiet, new events bring the retry forward
+        first = 0;
+        if (w.resync) {
+            first = gko_watch_now() + GEKKO_WATCH_RETRY_MS - GEKKO_WATCH_QUIET_MS;
+            last  = first;
+        }
+    }
+
+__error_rescan:
+    gko_watch_clear(&w);
+    free(w.pending);
+    for (i = 0; i < w.dirs_size; i++) free(w.dirs[i]);
+    free(w.dirs);
+    free(w.scratch);
+    close(w.fd);
+
+    return ret;
+#else
+    (void)pool;
+    (void)grip;
+    (void)remote;
+    (void)root;
+    (void)rootfd;
+    (void)idx;
+    (void)snap;
+    (void)threads;
+    (void)ignore;
+
+    fprintf(stderr, "Watch mode needs inotify, not available on this platform.\n");
+
+    return GEKKO_ERROR;
+#endif
+}
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/
@@ -0,0 +1,33 @@
+/**********************************************************************************************************************
+    file:           watch.h
+    description:    Continuous synchronization of Gekko
+    author:         (C) 2021 PlayerCatboy (Ralf Ren).
+    date:           Oct.17, 2026
+**********************************************************************************************************************/
+#ifndef __GEKKO_WATCH_H
+#define __GEKKO_WATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gekko.h"
+#include "pool.h"
+#include "ignore.h"
+/**********************************************************************************************************************
+    watch defaults
+**********************************************************************************************************************/
+#define GEKKO_WATCH_QUIET_MS            (10)        // a burst ends after this long without events
+#define GEKKO_WATCH_HOLD_MS             (50)        // a burst never holds a change back longer than this
+#define GEKKO_WATCH_RETRY_MS            (5000)      // a failed pass is tried again after this long
+#define GEKKO_WATCH_KEEPALIVE_S         (30)
+#define GEKKO_WATCH_BUFFER              (64 * 1024)
+/**********************************************************************************************************************
+    watch functions
+**********************************************************************************************************************/
+int gko_watch(GKO_POOL *pool, const GRIP *grip, const char *remote, const char *root, int rootfd,
+              const char *idx, const char *snap, int threads, const GKO_IGNORE *ignore);
+
+#endif  // __GEKKO_WATCH_H
+/**********************************************************************************************************************
+    end
+**********************************************************************************************************************/